@@ -1,12 +1,19 @@
 #ifndef APPLICATION_SOLAR_HPP
 #define APPLICATION_SOLAR_HPP
 
+#include <functional>
 #include <vector>
 
 #include "application.hpp"
 #include "model.hpp"
 #include "structs.hpp"
 #include "scene_graph.hpp"
+#include "star_catalog.hpp"
+#include "texture_residency.hpp"
+#include "tile_cache.hpp"
+#include "cluster_culler.hpp"
+
+class GeometryNode;
 
 // GPU representation of model
 class ApplicationSolar : public Application {
@@ -34,6 +41,7 @@ class ApplicationSolar : public Application {
   void initializeShaderPrograms();
   void initializeTextures();
   void initializeGeometry();
+  void initializeGeometryCatalogStars();
   std::vector<float> generateGeometryStars();
   std::vector<float> generateGeometryCircle();
   void initializeScene();
@@ -43,6 +51,16 @@ class ApplicationSolar : public Application {
   void uploadProjection();
   // Upload view matrix
   void uploadView();
+  // Visit each geometry node with its world transformation, computed as in the render traversal
+  void forEachGeometry(std::function<void(GeometryNode&, glm::fmat4 const&)> const& visit) const;
+  // Request the texture levels needed at the projected size of each object
+  void updateTextureResidency(float delta_time_ms);
+  // Choose the level of detail of each object by its projected size
+  void updateLevelsOfDetail();
+  // Cull the meshlet clusters of each object against the view and its normal cones
+  void updateClusterCulling();
+  // Stream the tiles of virtual textures and render the feedback pass telling which are needed
+  void updateVirtualTextures();
 
 // Model objects (CPU representation of model)
   model_object planet_object;
@@ -53,15 +71,41 @@ class ApplicationSolar : public Application {
 
   // Skybox texture
   texture_object skybox_texture;
+  // Loads and evicts mip levels of the object textures
+  texture_residency residency;
+  // Tiles of very high resolution planet maps, only allocated if such a map exists
+  tile_cache virtual_textures;
+  std::size_t earth_virtual;
+  // Culls clusters of the models on the GPU with OpenGL 4.3, else on the CPU
+  cluster_culler cluster_culling;
+
+  // Star catalog (memory mapped cache) with one draw range per cell
+  star_catalog::catalog stars_catalog;
+  star_catalog::magnitude_limiter stars_limiter;
+  std::vector<GLint> stars_cell_firsts;
+  std::vector<GLsizei> stars_cell_counts;
   
   // Camera transform matrix
   glm::fmat4 m_view_transform;
   // Camera projection matrix
   glm::fmat4 m_view_projection;
+  // Viewport height in pixels for screen size estimates
+  float viewport_height;
+  // Camera motion to prefetch textures ahead of
+  glm::vec3 last_camera_position;
+  glm::vec3 camera_velocity;
 
   SceneGraph* scene;
 
   const float SIMULATION_SPEED = 0.18f;
+  const float STARS_DISTANCE = 1500.0f;
+  // Texture levels are requested for where the camera will be this far ahead
+  const float TEXTURE_PREFETCH_MS = 500.0f;
+  // Coarser levels of detail generated for the models at most
+  const std::size_t MODEL_LOD_LEVELS = 4;
+  // Tessellation of the full detail planet sphere, each level of detail halves both
+  const std::size_t PLANET_SLICES = 64;
+  const std::size_t PLANET_STACKS = 32;
 
   // Variables for input
   float movement_speed = 0.019f;
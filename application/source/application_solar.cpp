@@ -4,12 +4,20 @@
 #include "utils.hpp"
 #include "shader_loader.hpp"
 #include "model_loader.hpp"
+#include "sphere_generator.hpp"
+#include "meshlet_builder.hpp"
 #include "texture_loader.hpp"
 #include "scene_graph.hpp"
 #include "geometry_node.hpp"
 #include "camera_node.hpp"
 #include "point_light_node.hpp"
 #include "node.hpp"
+#include "star_catalog.hpp"
+#include "sim_clock.hpp"
+#include "profiler.hpp"
+#include "texture_streamer.hpp"
+#include "thread_pool.hpp"
+#include "skybox.hpp"
 
 #include <glbinding/gl/gl.h>
 // Use gl definitions from glbinding 
@@ -22,11 +30,14 @@ using namespace gl;
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/constants.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <numbers>
 #include <chrono>
+#include <cstddef>
 
 
 
@@ -35,8 +46,14 @@ ApplicationSolar::ApplicationSolar(std::string const& resource_path):
   planet_object{},
   stars_object{},
   circle_object{},
+  virtual_textures{thread_pool::shared()},
+  earth_virtual{0},
+  cluster_culling{resource_path + "shaders/cluster_cull.comp"},
   m_view_transform{glm::translate(glm::fmat4{}, glm::fvec3{0.0f, 0.0f, 30.0f})},
-  m_view_projection{utils::calculate_projection_matrix(initial_aspect_ratio)}
+  m_view_projection{utils::calculate_projection_matrix(initial_aspect_ratio)},
+  viewport_height{float(initial_resolution.y)},
+  last_camera_position{0.0f, 0.0f, 30.0f},
+  camera_velocity{0.0f}
 {
   // Modify far and near clipping planes of the projection matrix to extend render distance (https://www.terathon.com/gdc07_lengyel.pdf)
   m_view_projection[2][2] = -0.9999f;
@@ -57,6 +74,7 @@ ApplicationSolar::~ApplicationSolar()
   // Clean up buffers and VAOs
   glDeleteBuffers(1, &planet_object.vertex_BO);
   glDeleteBuffers(1, &planet_object.element_BO);
+  glDeleteBuffers(1, &planet_object.cluster_BO);
   glDeleteVertexArrays(1, &planet_object.vertex_AO);
 
   glDeleteBuffers(1, &stars_object.vertex_BO);
@@ -64,6 +82,109 @@ ApplicationSolar::~ApplicationSolar()
   
   glDeleteBuffers(1, &circle_object.vertex_BO);
   glDeleteVertexArrays(1, &circle_object.vertex_AO);
+
+  glDeleteBuffers(1, &cube_object.vertex_BO);
+  glDeleteBuffers(1, &cube_object.element_BO);
+  glDeleteVertexArrays(1, &cube_object.vertex_AO);
+
+  glDeleteBuffers(1, &spacestation_object.vertex_BO);
+  glDeleteBuffers(1, &spacestation_object.element_BO);
+  glDeleteBuffers(1, &spacestation_object.cluster_BO);
+  glDeleteVertexArrays(1, &spacestation_object.vertex_AO);
+}
+
+
+
+namespace
+{
+  // Point the attribute location at an attribute of the model in the bound array buffer, in the format it is stored in
+  void setVertexAttribute(GLuint location, model const& source, model::attribute const& attribute)
+  {
+    model::attribute const& format = source.formats.at(attribute);
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, format.components, format.type, GLboolean(format.normalized), source.vertex_bytes, source.offsets.at(attribute));
+  }
+
+  // Maps the stored positions of the model to model space, the vertex shaders apply it with the ModelMatrix
+  glm::fmat4 positionTransform(model const& source)
+  {
+    return glm::scale(glm::translate(glm::fmat4{}, source.position_offset), source.position_scale);
+  }
+
+  // Sphere around the model space bounds of the model for screen size estimates
+  glm::fvec4 boundingSphere(model const& source)
+  {
+    return glm::fvec4{(source.bounds_min + source.bounds_max) * 0.5f, glm::length(source.bounds_max - source.bounds_min) * 0.5f};
+  }
+
+  // Index type of the model, its parts drawn with their own base vertex, its levels of detail and its meshlets
+  void setIndices(model_object& object, model const& source)
+  {
+    object.num_elements = GLsizei(source.index_count());
+    object.index_type = source.index_type;
+    std::size_t index_size = source.index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    bool based = std::any_of(source.submeshes.begin(), source.submeshes.end(), [](model::submesh const& part)
+    {
+      return part.base_vertex != 0;
+    });
+    if (based)
+    {
+      for (model::submesh const& part : source.submeshes)
+      {
+        object.range_counts.push_back(GLsizei(part.index_count));
+        object.range_offsets.push_back(reinterpret_cast<GLvoid const*>(part.first_index * index_size));
+        object.range_base_vertices.push_back(GLint(part.base_vertex));
+      }
+    }
+    // Meshlets are drawn with the base vertex of the part they lie in
+    for (model::meshlet const& meshlet : source.meshlets)
+    {
+      GLint base_vertex = 0;
+      for (model::submesh const& part : source.submeshes)
+      {
+        if (meshlet.first_index >= part.first_index && meshlet.first_index < part.first_index + part.index_count)
+        {
+          base_vertex = GLint(part.base_vertex);
+        }
+      }
+      object.clusters.push_back(model_object::cluster{GLsizei(meshlet.index_count), reinterpret_cast<GLvoid const*>(meshlet.first_index * index_size),
+                                                      base_vertex, meshlet.sphere, meshlet.cone});
+    }
+    // Each level draws its index range, or the parts inside it if these have their own base vertex
+    for (model::lod const& lod : source.lods)
+    {
+      model_object::level_of_detail level{GLsizei(lod.index_count), reinterpret_cast<GLvoid const*>(lod.first_index * index_size), 0, 0, 0, 0, lod.error};
+      for (std::size_t i = 0; based && i < source.submeshes.size(); ++i)
+      {
+        model::submesh const& part = source.submeshes[i];
+        if (part.first_index >= lod.first_index && part.first_index < lod.first_index + lod.index_count)
+        {
+          level.first_range = level.range_count == 0 ? i : level.first_range;
+          ++level.range_count;
+        }
+      }
+      for (std::size_t i = 0; i < source.meshlets.size(); ++i)
+      {
+        model::meshlet const& meshlet = source.meshlets[i];
+        if (meshlet.first_index >= lod.first_index && meshlet.first_index < lod.first_index + lod.index_count)
+        {
+          level.first_cluster = level.cluster_count == 0 ? i : level.first_cluster;
+          ++level.cluster_count;
+        }
+      }
+      object.levels.push_back(level);
+    }
+  }
+
+  // GL_INT_2_10_10_10_REV vertex attributes are core since OpenGL 3.3
+  bool supportsPackedNormals()
+  {
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major > 3 || (major == 3 && minor >= 3) || glfwExtensionSupported("GL_ARB_vertex_type_2_10_10_10_rev") != 0;
+  }
 }
 
 
@@ -71,13 +192,23 @@ ApplicationSolar::~ApplicationSolar()
 // ########### LIFE CYCLE FUNCTIONS #################################
 void ApplicationSolar::physics()
 {
-  // Get delta time for frame rate independent physics
-  static auto time_last = std::chrono::steady_clock::now();
-  auto time_now = std::chrono::steady_clock::now();
-  long long delta_time_ms = (std::chrono::duration_cast<std::chrono::milliseconds>(time_now - time_last)).count();
-  delta_time_ms = std::min(delta_time_ms, (long long)50);
-  time_last = time_now;
+  // Get delta time for frame rate independent physics (fixed in headless runs)
+  float delta_time_ms = std::min(float(sim_clock::delta() * 1000.0), 50.0f);
 
+  // Adapt the star catalog magnitude cutoff to the work time of the last frame and trim the draw range of each cell,
+  // ...the frame time would include waiting for vsync or the frame rate limit
+  if (!stars_catalog.empty())
+  {
+    float magnitude_limit = stars_limiter.update(float(m_frame_work_ms));
+    for (std::size_t cell = 0; cell < stars_catalog.cell_count(); ++cell)
+    {
+      stars_cell_counts[cell] = GLsizei(stars_catalog.count_brighter(cell, magnitude_limit));
+    }
+  }
+
+
+  // Time the camera update and view upload until the end of physics
+  profiler::scope scene_update_scope{"scene update"};
 
   glm::fmat4 view_t = m_view_transform;
 
@@ -146,6 +277,176 @@ void ApplicationSolar::physics()
 
   // Update the shaders
   uploadView();
+
+  // Stream texture detail and choose the model detail for the new camera position
+  updateTextureResidency(delta_time_ms);
+  updateLevelsOfDetail();
+  updateClusterCulling();
+  updateVirtualTextures();
+}
+
+
+void ApplicationSolar::forEachGeometry(std::function<void(GeometryNode&, glm::fmat4 const&)> const& visit) const
+{
+  // Traverse the scene with the same transformations as the render traversal
+  std::list<std::pair<Node*, glm::fmat4>> remaining_nodes{ { scene->get_root(), scene->get_root()->get_world_transform() } };
+  while (!remaining_nodes.empty())
+  {
+    Node* node = remaining_nodes.front().first;
+    glm::fmat4 rotation_matrix = glm::rotate(glm::fmat4{}, float(sim_clock::time() * node->get_animation()), glm::fvec3{ 0.0f, 1.0f, 0.0f });
+    glm::fmat4 transform = remaining_nodes.front().second * rotation_matrix * node->get_local_transform();
+    remaining_nodes.pop_front();
+    for (Node* child : node->get_children())
+    {
+      remaining_nodes.push_back({ child, transform });
+    }
+
+    GeometryNode* geometry = dynamic_cast<GeometryNode*>(node);
+    if (geometry != nullptr)
+    {
+      visit(*geometry, transform);
+    }
+  }
+}
+
+
+void ApplicationSolar::updateTextureResidency(float delta_time_ms)
+{
+  profiler::scope residency_scope{"texture residency"};
+
+  glm::vec3 camera_position{ m_view_transform[3][0] / m_view_transform[3][3],
+                             m_view_transform[3][1] / m_view_transform[3][3],
+                             m_view_transform[3][2] / m_view_transform[3][3] };
+  if (delta_time_ms > 0.0f)
+  {
+    // Smoothed velocity in units per millisecond
+    camera_velocity = glm::mix(camera_velocity, (camera_position - last_camera_position) / delta_time_ms, 0.2f);
+  }
+  last_camera_position = camera_position;
+  glm::vec3 predicted_position = camera_position + camera_velocity * TEXTURE_PREFETCH_MS;
+
+  // Pixels a unit length covers at distance one
+  float pixels_per_unit = m_view_projection[1][1] * viewport_height * 0.5f;
+
+  forEachGeometry([&](GeometryNode& geometry, glm::fmat4 const& transform)
+  {
+    // The texture wraps once around the sphere, its density is highest at the nearest surface point
+    glm::vec3 center{ transform[3] };
+    float radius = glm::length(glm::vec3(transform[0]));
+    float distance = std::min(glm::distance(camera_position, center), glm::distance(predicted_position, center));
+    float surface_distance = std::max(distance - radius, 0.1f);
+    float screen_pixels = 2.0f * glm::pi<float>() * radius * pixels_per_unit / surface_distance;
+    for (texture_object const* texture : { geometry.get_texture(), geometry.get_texture_spec(), geometry.get_texture_normal() })
+    {
+      if (texture != nullptr)
+      {
+        residency.request(*texture, screen_pixels);
+      }
+    }
+  });
+  residency.update();
+}
+
+
+void ApplicationSolar::updateLevelsOfDetail()
+{
+  profiler::scope lod_scope{"levels of detail"};
+
+  glm::vec3 camera_position{ m_view_transform[3][0] / m_view_transform[3][3],
+                             m_view_transform[3][1] / m_view_transform[3][3],
+                             m_view_transform[3][2] / m_view_transform[3][3] };
+  // Pixels a unit length covers at distance one
+  float pixels_per_unit = m_view_projection[1][1] * viewport_height * 0.5f;
+
+  forEachGeometry([&](GeometryNode& geometry, glm::fmat4 const& transform)
+  {
+    if (geometry.get_model() == nullptr || geometry.get_model()->levels.empty())
+    {
+      return;
+    }
+    // Bounding sphere in world space, scaled by the largest axis of the transformation
+    glm::fvec4 const& sphere = geometry.get_model()->bounding_sphere;
+    glm::vec3 center{ transform * glm::vec4{ glm::vec3{ sphere }, 1.0f } };
+    float scale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+    float radius = sphere.w * scale;
+    // Projected radius of the sphere, very large once the camera is inside
+    float distance = glm::distance(camera_position, center);
+    float screen_radius = radius * pixels_per_unit / std::sqrt(std::max(distance * distance - radius * radius, 1.0e-6f * radius * radius));
+    geometry.set_lod(geometry.get_model()->select_level(screen_radius, geometry.get_lod()));
+  });
+}
+
+
+void ApplicationSolar::updateClusterCulling()
+{
+  profiler::scope cluster_scope{"cluster culling", cluster_culling.gpu()};
+
+  glm::vec3 camera_position{ m_view_transform[3][0] / m_view_transform[3][3],
+                             m_view_transform[3][1] / m_view_transform[3][3],
+                             m_view_transform[3][2] / m_view_transform[3][3] };
+  cluster_culling.begin_frame(m_view_projection * glm::inverse(m_view_transform), camera_position);
+
+  forEachGeometry([&](GeometryNode& geometry, glm::fmat4 const& transform)
+  {
+    if (geometry.get_model() == nullptr)
+    {
+      return;
+    }
+    // Clusters of the chosen level outside the view or facing away are left out of the draw
+    cluster_culling.cull(*geometry.get_model(), geometry.get_lod(), transform, geometry.get_clusters());
+  });
+
+  // The culled triangles are reported to the profiler
+  cluster_culling.end_frame();
+}
+
+
+void ApplicationSolar::updateVirtualTextures()
+{
+  if (virtual_textures.empty())
+  {
+    return;
+  }
+  profiler::scope virtual_scope{"virtual textures", true};
+
+  // Upload the tiles requested by earlier feedback passes
+  virtual_textures.update();
+
+  // Feedback pass: all objects are drawn at low resolution for occlusion,
+  // ...those with a virtual texture write which of its tiles they sample
+  shader_program const& feedback = m_shaders.at("feedback");
+  glUseProgram(feedback.handle);
+  // Shift by a fraction of a feedback pixel each pass so that every screen pixel is covered over time
+  glm::vec2 jitter = virtual_textures.feedback_jitter();
+  glm::fmat4 projection = glm::translate(glm::fmat4{}, glm::vec3{ jitter, 0.0f }) * m_view_projection;
+  glUniformMatrix4fv(feedback.u_locs.at("ProjectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
+  glUniformMatrix4fv(feedback.u_locs.at("ViewMatrix"), 1, GL_FALSE, glm::value_ptr(glm::inverse(m_view_transform)));
+  virtual_textures.begin_feedback();
+
+  forEachGeometry([&](GeometryNode& geometry, glm::fmat4 const& transform)
+  {
+    if (geometry.get_model() == nullptr)
+    {
+      return;
+    }
+    glm::fmat4 model_matrix = transform * geometry.get_model()->position_transform;
+    glUniformMatrix4fv(feedback.u_locs.at("ModelMatrix"), 1, GL_FALSE, glm::value_ptr(model_matrix));
+    glUniform4fv(feedback.u_locs.at("TexCoordTransform"), 1, glm::value_ptr(geometry.get_model()->texcoord_transform));
+    if (geometry.get_virtual_cache() != nullptr)
+    {
+      geometry.get_virtual_cache()->bind_feedback(geometry.get_virtual_texture(), feedback);
+    }
+    else
+    {
+      glUniform1i(feedback.u_locs.at("VirtualId"), 0);
+    }
+    glBindVertexArray(geometry.get_model()->vertex_AO);
+    geometry.get_model()->draw_elements(geometry.get_lod());
+  });
+  glBindVertexArray(0);
+
+  // The tiles are read back without waiting and analysed in a later frame
+  virtual_textures.end_feedback();
 }
 
 
@@ -160,31 +461,53 @@ void ApplicationSolar::render() const
 
   // Render skybox (Ass4):
   // ...(is done before the scene but without depth info); (Tutorial I used as assistance: https://learnopengl.com/Advanced-OpenGL/Cubemaps)
-  glDepthMask(GL_FALSE);
-  // Bind cube shader
-  glUseProgram(m_shaders.at("skybox").handle);
-
-  // Texture 'color'
-  // Select texture unit
-  glActiveTexture(GL_TEXTURE0);
-  // Bind texture object
-  glBindTexture(skybox_texture.target, skybox_texture.handle);
-  glUniform1i(m_shaders.at("skybox").u_locs.at("TextureColor"), 0);
-
-  // Bind the VAO to draw
-  glBindVertexArray(cube_object.vertex_AO);
-  // Draw bound vertex array using bound shader
-  glDrawElements(cube_object.draw_mode, cube_object.num_elements, model::INDEX.type, NULL);
-
-  // Unbind VA
-  glBindVertexArray(0);
-  // Reactivate depth mas so that everything else is drawn on top of the skybox
-  glDepthMask(GL_TRUE);
+  {
+    profiler::scope skybox_scope{"skybox", true};
+    glDepthMask(GL_FALSE);
+    // Bind cube shader
+    glUseProgram(m_shaders.at("skybox").handle);
+
+    // Texture 'color'
+    // Select texture unit
+    glActiveTexture(GL_TEXTURE0);
+    // Bind texture object
+    glBindTexture(skybox_texture.target, skybox_texture.handle);
+    glUniform1i(m_shaders.at("skybox").u_locs.at("TextureColor"), 0);
+
+    // Bind the VAO to draw
+    glBindVertexArray(cube_object.vertex_AO);
+    // Draw bound vertex array using bound shader
+    cube_object.draw_elements();
+
+    // Unbind VA
+    glBindVertexArray(0);
+    // Reactivate depth mas so that everything else is drawn on top of the skybox
+    glDepthMask(GL_TRUE);
+  }
 
   
   // Traverse the scene graph tree
-  scene->get_root()->render(&m_shaders, &m_view_transform, scene->get_root()->get_world_transform());
+  {
+    profiler::scope traversal_scope{"scene traversal", true};
+    scene->get_root()->render(&m_shaders, &m_view_transform, scene->get_root()->get_world_transform());
+  }
+
+
+  // Stars are timed until the end of the frame
+  profiler::scope stars_scope{"stars", true};
 
+  // Render catalog stars, only the cells' stars brighter than the cutoff
+  if (!stars_catalog.empty())
+  {
+    glUseProgram(m_shaders.at("stars").handle);
+    float magnitude_range = stars_catalog.magnitude_max() - stars_catalog.magnitude_min();
+    float magnitude_limit = magnitude_range > 0.0f ? (stars_limiter.limit() - stars_catalog.magnitude_min()) / magnitude_range : 1.0f;
+    glUniform1f(m_shaders.at("stars").u_locs.at("MagnitudeLimit"), magnitude_limit);
+
+    glBindVertexArray(stars_object.vertex_AO);
+    glMultiDrawArrays(stars_object.draw_mode, stars_cell_firsts.data(), stars_cell_counts.data(), GLsizei(stars_cell_firsts.size()));
+    return;
+  }
 
   // Render Stars (Ass2):
   // Bind shader
@@ -276,6 +599,14 @@ void ApplicationSolar::uploadView() {
   glUseProgram(m_shaders.at("skybox").handle);
   glUniformMatrix4fv(m_shaders.at("skybox").u_locs.at("ViewMatrix"),
                      1, GL_FALSE, glm::value_ptr(view_matrix));
+
+  // Bind and upload to star catalog shader
+  if (m_shaders.count("stars") > 0)
+  {
+    glUseProgram(m_shaders.at("stars").handle);
+    glUniformMatrix4fv(m_shaders.at("stars").u_locs.at("ViewMatrix"),
+                       1, GL_FALSE, glm::value_ptr(view_matrix));
+  }
 }
 
 
@@ -300,6 +631,14 @@ void ApplicationSolar::uploadProjection() {
   glUseProgram(m_shaders.at("skybox").handle);
   glUniformMatrix4fv(m_shaders.at("skybox").u_locs.at("ProjectionMatrix"),
                      1, GL_FALSE, glm::value_ptr(m_view_projection));
+
+  // Bind and upload to star catalog shader
+  if (m_shaders.count("stars") > 0)
+  {
+    glUseProgram(m_shaders.at("stars").handle);
+    glUniformMatrix4fv(m_shaders.at("stars").u_locs.at("ProjectionMatrix"),
+                       1, GL_FALSE, glm::value_ptr(m_view_projection));
+  }
 }
 
 
@@ -308,6 +647,13 @@ void ApplicationSolar::uploadUniforms() {
   // upload uniform values to new locations
   uploadView();
   uploadProjection();
+
+  // Radius of the sky sphere doesn't change
+  if (m_shaders.count("stars") > 0)
+  {
+    glUseProgram(m_shaders.at("stars").handle);
+    glUniform1f(m_shaders.at("stars").u_locs.at("Distance"), STARS_DISTANCE);
+  }
 }
 
 
@@ -317,12 +663,15 @@ void ApplicationSolar::uploadUniforms() {
 void ApplicationSolar::initializeShaderPrograms()
 {
   // Planet shader:
-  // Store shader program objects in container
+  // Store shader program objects in container, the variant reads the tangents of the sphere for normal textures,
+  // the space station has none but also no normal texture
   m_shaders.emplace("planet", shader_program{{{GL_VERTEX_SHADER,m_resource_path + "shaders/simple.vert"},
-                                           {GL_FRAGMENT_SHADER, m_resource_path + "shaders/simple.frag"}}});
+                                           {GL_FRAGMENT_SHADER, m_resource_path + "shaders/simple.frag"}},
+                                           {"TANGENT_FRAME"}});
   // Request uniform locations for shader program
   m_shaders.at("planet").u_locs["NormalMatrix"] = -1;
   m_shaders.at("planet").u_locs["ModelMatrix"] = -1;
+  m_shaders.at("planet").u_locs["TexCoordTransform"] = -1;
   m_shaders.at("planet").u_locs["ViewMatrix"] = -1;
   m_shaders.at("planet").u_locs["ProjectionMatrix"] = -1;
 
@@ -341,6 +690,14 @@ void ApplicationSolar::initializeShaderPrograms()
   m_shaders.at("planet").u_locs["TextureSpecularIsSet"] = -1;
   m_shaders.at("planet").u_locs["TextureNormal"] = -1;
   m_shaders.at("planet").u_locs["TextureNormalIsSet"] = -1;
+  m_shaders.at("planet").u_locs["TextureNormalPacked"] = -1;
+  m_shaders.at("planet").u_locs["TextureColorIsVirtual"] = -1;
+  m_shaders.at("planet").u_locs["TextureIndirection"] = -1;
+  m_shaders.at("planet").u_locs["TexturePhysical"] = -1;
+  m_shaders.at("planet").u_locs["VirtualSize"] = -1;
+  m_shaders.at("planet").u_locs["VirtualTileSize"] = -1;
+  m_shaders.at("planet").u_locs["VirtualTileBorder"] = -1;
+  m_shaders.at("planet").u_locs["VirtualLevels"] = -1;
 
 
   // Sun shader:
@@ -350,6 +707,7 @@ void ApplicationSolar::initializeShaderPrograms()
   // Request uniform locations for shader program
   m_shaders.at("sun").u_locs["NormalMatrix"] = -1;
   m_shaders.at("sun").u_locs["ModelMatrix"] = -1;
+  m_shaders.at("sun").u_locs["TexCoordTransform"] = -1;
   m_shaders.at("sun").u_locs["ViewMatrix"] = -1;
   m_shaders.at("sun").u_locs["ProjectionMatrix"] = -1;
 
@@ -379,444 +737,157 @@ void ApplicationSolar::initializeShaderPrograms()
   m_shaders.at("skybox").u_locs["ProjectionMatrix"] = -1;
 
   m_shaders.at("skybox").u_locs["TextureColor"] = -1;
-}
 
 
-// Load textures
-void ApplicationSolar::initializeTextures()
-{
-  // Load mercury texture:
-  m_textures.emplace("mercury", texture_object{});
-  texture_object* texture = &m_textures.at("mercury");
-  texture->target = GL_TEXTURE_2D;
-  // 24bit PNG worked. JPG has some issues where the buffer size doesn't account for the alpha values but still puts alpha in the buffer
-  pixel_data texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/mercurymap1k.png"));
-
-  // DEBUG print pixel buffer contents to file
-  /*
-  std::ofstream debug_file(m_resource_path + "../DEBUG.txt");
-  debug_file << "DEBUG:\n";
-  int len = texture_data->pixels.size();
-  debug_file << "Lenght: " << len << "\n";
-  for (int i = 0; i < len / 4; ++i)
+  // Star catalog shader (only if a catalog was loaded):
+  if (!stars_catalog.empty())
   {
-    std::string temp{ "Pixel " + std::to_string(i) + " (" + std::to_string(i % 1000) + "x" + std::to_string(i / 1000) + "): " };
-    debug_file << temp;
-    for (int j = temp.size(); j < 22; ++j) { debug_file << " "; }
-    debug_file
-      << (int)texture_data->pixels[i * 4 + 0] << " "
-      << (int)texture_data->pixels[i * 4 + 1] << " "
-      << (int)texture_data->pixels[i * 4 + 2] << "\n";
+    // Store shader program objects in container
+    m_shaders.emplace("stars", shader_program{ {{GL_VERTEX_SHADER, m_resource_path + "shaders/stars.vert"},
+                                              {GL_FRAGMENT_SHADER, m_resource_path + "shaders/vao.frag"}} });
+    // Request uniform locations for shader program
+    m_shaders.at("stars").u_locs["ViewMatrix"] = -1;
+    m_shaders.at("stars").u_locs["ProjectionMatrix"] = -1;
+    m_shaders.at("stars").u_locs["Distance"] = -1;
+    m_shaders.at("stars").u_locs["MagnitudeLimit"] = -1;
   }
-  debug_file << "Lenght: " << len << "\n";
-  */
-
-  // Initialize texture
-  glActiveTexture(GL_TEXTURE0);                     // Activate and select 0 as the Texture Unit which subsequent texture state calls will affect
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-    
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-                                                                      // -> minification filter will perform a linear blend between samples to get the end color
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-                                                                      // -> magnification filter will perform a linear blend between samples to get the end color
-
-  // Define texture data and format
-  glTexImage2D(texture->target,       // Texturing target (binding point of the texture)
-               0,                     // Level of detail number (0 for only base image)
-               GL_RGBA8,              // Color format for the texture (number of color components)
-               1000,                  // Width
-               500,                   // Height
-               0,                     // Border thickness (must be 0 (cool parameter bro))
-               GL_RGBA,               // Format of source file data
-               GL_UNSIGNED_BYTE,      // Data type of source file (mostly precision)
-               texture_data.ptr());  // Pointer to texture data in memory
-
-  // Load mercury texture normal:
-  m_textures.emplace("mercury_normal", texture_object{});
-  texture = &m_textures.at("mercury_normal");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/mercurynormal1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load venus texture:
-  m_textures.emplace("venus", texture_object{});
-  texture = &m_textures.at("venus");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/venusmap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-  // Load venus texture normal:
-  m_textures.emplace("venus_normal", texture_object{});
-  texture = &m_textures.at("venus_normal");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/venusnormal1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load earth texture color:
-  m_textures.emplace("earth", texture_object{});
-  texture = &m_textures.at("earth");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/earthmap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-  // Load earth texture specular:
-  m_textures.emplace("earth_spec", texture_object{});
-  texture = &m_textures.at("earth_spec");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/earthspec1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-  
-  // Load earth texture normal:
-  m_textures.emplace("earth_normal", texture_object{});
-  texture = &m_textures.at("earth_normal");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/earthnormal1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-  
-  // Load moon texture:
-  m_textures.emplace("moon", texture_object{});
-  texture = &m_textures.at("moon");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/moonmap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-  // Load moon texture normal:
-  m_textures.emplace("moon_normal", texture_object{});
-  texture = &m_textures.at("moon_normal");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/moonnormal1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load mars texture:
-  m_textures.emplace("mars", texture_object{});
-  texture = &m_textures.at("mars");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/marsmap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
 
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
 
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-  // Load mars normal specular:
-  m_textures.emplace("mars_normal", texture_object{});
-  texture = &m_textures.at("mars_normal");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/marsnormal1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load jupiter texture:
-  m_textures.emplace("jupiter", texture_object{});
-  texture = &m_textures.at("jupiter");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/jupitermap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load saturn texture:
-  m_textures.emplace("saturn", texture_object{});
-  texture = &m_textures.at("saturn");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/saturnmap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load uranus texture:
-  m_textures.emplace("uranus", texture_object{});
-  texture = &m_textures.at("uranus");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/uranusmap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load neptune texture:
-  m_textures.emplace("neptune", texture_object{});
-  texture = &m_textures.at("neptune");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/neptunemap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load pluto texture:
-  m_textures.emplace("pluto", texture_object{});
-  texture = &m_textures.at("pluto");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/plutomap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load sun texture:
-  m_textures.emplace("sun", texture_object{});
-  texture = &m_textures.at("sun");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/sunmap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load geralt texture:
-  m_textures.emplace("geralt", texture_object{});
-  texture = &m_textures.at("geralt");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/geraltmap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load deathstar texture:
-  m_textures.emplace("deathstar", texture_object{});
-  texture = &m_textures.at("deathstar");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/deathstarmap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-  // Load deathstar texture normal:
-  m_textures.emplace("deathstar_normal", texture_object{});
-  texture = &m_textures.at("deathstar_normal");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/deathstarnormal1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
-
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-
-
-  // Load spacestation texture:
-  m_textures.emplace("spacestation", texture_object{});
-  texture = &m_textures.at("spacestation");
-  texture->target = GL_TEXTURE_2D;
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/spacestationmap1k.png"));
-
-  // Initialize texture
-  glGenTextures(1, &texture->handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(texture->target, texture->handle);  // Bind texture to texturing target (basically determines texture dimension)
-
-  // Define texture sampling parameters
-  glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
+  // Virtual texture feedback shader (only if a virtual texture was loaded):
+  if (!virtual_textures.empty())
+  {
+    // Store shader program objects in container
+    m_shaders.emplace("feedback", shader_program{ {{GL_VERTEX_SHADER, m_resource_path + "shaders/simple.vert"},
+                                                 {GL_FRAGMENT_SHADER, m_resource_path + "shaders/virtual_feedback.frag"}} });
+    // Request uniform locations for shader program
+    m_shaders.at("feedback").u_locs["ModelMatrix"] = -1;
+    m_shaders.at("feedback").u_locs["TexCoordTransform"] = -1;
+    m_shaders.at("feedback").u_locs["ViewMatrix"] = -1;
+    m_shaders.at("feedback").u_locs["ProjectionMatrix"] = -1;
+    m_shaders.at("feedback").u_locs["VirtualId"] = -1;
+    m_shaders.at("feedback").u_locs["VirtualSize"] = -1;
+    m_shaders.at("feedback").u_locs["VirtualTileSize"] = -1;
+    m_shaders.at("feedback").u_locs["VirtualLevels"] = -1;
+    m_shaders.at("feedback").u_locs["FeedbackBias"] = -1;
+  }
+}
 
-  // Define texture data and format
-  glTexImage2D(texture->target, 0, GL_RGBA8, 1000, 500, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
 
+// Load textures
+void ApplicationSolar::initializeTextures()
+{
+  auto time_start = std::chrono::steady_clock::now();
+
+  // Textures of the planets and other objects (name, file)
+  const std::vector<std::pair<std::string, std::string>> texture_files{
+    { "mercury", "mercurymap1k.png" },
+    { "mercury_normal", "mercurynormal1k.png" },
+    { "venus", "venusmap1k.png" },
+    { "venus_normal", "venusnormal1k.png" },
+    { "earth", "earthmap1k.png" },
+    { "moon", "moonmap1k.png" },
+    { "moon_normal", "moonnormal1k.png" },
+    { "mars", "marsmap1k.png" },
+    { "mars_normal", "marsnormal1k.png" },
+    { "jupiter", "jupitermap1k.png" },
+    { "saturn", "saturnmap1k.png" },
+    { "uranus", "uranusmap1k.png" },
+    { "neptune", "neptunemap1k.png" },
+    { "pluto", "plutomap1k.png" },
+    { "sun", "sunmap1k.png" },
+    { "geralt", "geraltmap1k.png" },
+    { "deathstar", "deathstarmap1k.png" },
+    { "deathstar_normal", "deathstarnormal1k.png" },
+    { "spacestation", "spacestationmap1k.png" }
+  };
+
+  // Decode all images in parallel on the loader threads and stream them to the GPU through pixel buffers
+  glActiveTexture(GL_TEXTURE0);
+  texture_streamer streamer{thread_pool::shared()};
+  // Object textures start with their coarse levels, finer ones are loaded once they are seen up close
+  streamer.set_residency(&residency);
+  for (auto const& texture_file : texture_files)
+  {
+    texture_object& texture = m_textures.emplace(texture_file.first, texture_object{}).first->second;
+    texture.target = GL_TEXTURE_2D;
+    // Color maps are filtered in linear light, normals are renormalized, specular values averaged as they are
+    std::string const& name = texture_file.first;
+    mipmap::color_space space = mipmap::color_space::srgb;
+    if (name.size() > 7 && name.compare(name.size() - 7, 7, "_normal") == 0)
+    {
+      space = mipmap::color_space::normal;
+    }
+    else if (name.size() > 5 && name.compare(name.size() - 5, 5, "_spec") == 0)
+    {
+      space = mipmap::color_space::linear;
+    }
+    streamer.load(texture, GL_TEXTURE_2D, m_resource_path + "textures/" + texture_file.second, space);
+  }
 
-  // Load skybox texture:
+  // Earth specular and normal map share one texture (specular in red, normal Y in green, normal X in alpha)
+  texture_object& earth_surface = m_textures.emplace("earth_surface", texture_object{}).first->second;
+  earth_surface.target = GL_TEXTURE_2D;
+  std::string earth_spec = m_resource_path + "textures/earthspec1k.png";
+  std::string earth_normal = m_resource_path + "textures/earthnormal1k.png";
+  streamer.load_packed(earth_surface, m_resource_path + "textures/earthsurface1k.packed", {
+    { earth_spec, mipmap::color_space::linear, 0 },
+    { earth_normal, mipmap::color_space::normal, 1 },
+    { "", mipmap::color_space::linear, 0 },
+    { earth_normal, mipmap::color_space::normal, 0 }
+  });
+
+  // Load skybox texture (each image is decoded once and shared by three faces), at the size the viewport shows:
   skybox_texture = texture_object{};
-  skybox_texture.target = GL_TEXTURE_CUBE_MAP;
+  std::size_t skybox_size = skybox::face_size(initial_resolution.y, m_view_projection);
+  skybox::load(streamer, skybox_texture, m_resource_path + "textures/skybox1map2k.png",
+               m_resource_path + "textures/skybox2map2k.png", skybox_size);
 
-  // Initialize texture
-  glGenTextures(1, &skybox_texture.handle);               // Generate the texture object as GLuint (acts as a pointer / referenceID)
-  glBindTexture(skybox_texture.target, skybox_texture.handle);  // Bind texture to texturing target (basically determines texture dimension)
+  // Upload the images in the order their decoding finishes
+  streamer.flush();
 
-  // Define texture sampling parameters
-  glTexParameteri(skybox_texture.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MIN_FILTER to GL_LINEAR
-  glTexParameteri(skybox_texture.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // Set the parameter TEXTURE_MAG_FILTER to GL_LINEAR
+  // Very high resolution earth maps are split into tiles that are streamed as they are seen (virtual texturing)
+  for (char const* earth_map : { "earthmap32k.png", "earthmap16k.png", "earthmap8k.png" })
+  {
+    std::string path = m_resource_path + "textures/" + earth_map;
+    if (std::ifstream{ path }.good())
+    {
+      earth_virtual = virtual_textures.add(path, mipmap::color_space::srgb, streamer.compression());
+      virtual_textures.resize(initial_resolution.x, initial_resolution.y);
+      break;
+    }
+  }
 
-  // Define texture data and format
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/skybox1map2k.png"));
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_RGBA8, 2000, 2000, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_RGBA8, 2000, 2000, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_RGBA8, 2000, 2000, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-  
-  texture_data = pixel_data(texture_loader::file(m_resource_path + "textures/skybox2map2k.png"));
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_RGBA8, 2000, 2000, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_RGBA8, 2000, 2000, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
-  glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_RGBA8, 2000, 2000, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data.ptr());
+  std::cout << "Loaded " << texture_files.size() + 2 << " textures on " << thread_pool::shared().size() << " threads in "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count() << " ms, "
+            << double(streamer.texture_memory() + residency.resident_bytes()) / (1024.0 * 1024.0) << " MB" << (streamer.compression() ? " block compressed" : "")
+            << ", peak process memory " << double(utils::peak_memory()) / (1024.0 * 1024.0) << " MB" << std::endl;
+  std::cout << "Skybox faces of at least " << skybox_size << " texels" << (skybox::default_settings().compress && streamer.compression() ? ", block compressed" : "") << std::endl;
+  if (!virtual_textures.empty())
+  {
+    std::cout << "Virtual texture tile cache with " << virtual_textures.capacity() << " tiles, "
+              << double(virtual_textures.texture_memory()) / (1024.0 * 1024.0) << " MB" << std::endl;
+  }
 }
 
 
 // Load models (the raw model files containing the vertices information)
 void ApplicationSolar::initializeGeometry()
 {
+  // Vertex formats the loader may quantize the attributes to within their tolerances
+  vertex_quantizer::format_flag_t packed_formats = vertex_quantizer::PACKED_POSITION | vertex_quantizer::PACKED_TEXCOORD;
+  if (supportsPackedNormals())
+  {
+    packed_formats |= vertex_quantizer::PACKED_NORMAL;
+  }
+
   // Sphere:
-  model planet_model = model_loader::obj(m_resource_path + "models/sphere.obj", model::NORMAL | model::TEXCOORD);
+  // Generated with its levels of detail instead of read from a file, coarser levels are drawn for small or distant planets
+  // ...tangents spare the planet shader deriving a tangent frame per fragment for normal textures
+  model planet_model = vertex_quantizer::quantize(sphere_generator::uv_sphere_lods(PLANET_SLICES, PLANET_STACKS, MODEL_LOD_LEVELS,
+                                                                                   model::NORMAL | model::TEXCOORD | model::TANGENT),
+                                                  packed_formats);
+  // Clusters of triangles culled against the view, small planets are drawn from few of them
+  meshlet_builder::generate_meshlets(planet_model);
 
   // Generate vertex array object
   glGenVertexArrays(1, &planet_object.vertex_AO);
@@ -827,65 +898,74 @@ void ApplicationSolar::initializeGeometry()
   glGenBuffers(1, &planet_object.vertex_BO);
   // Bind this as an vertex array buffer containing all attributes
   glBindBuffer(GL_ARRAY_BUFFER, planet_object.vertex_BO);
-  // Configure currently bound array buffer
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * planet_model.data.size(), planet_model.data.data(), GL_STATIC_DRAW);
-
-  // Activate first attribute on GPU
-  glEnableVertexAttribArray(0);
-  // First attribute (in_Position) is 3 floats
-  glVertexAttribPointer(0, model::POSITION.components, model::POSITION.type, GL_FALSE, planet_model.vertex_bytes, planet_model.offsets[model::POSITION]);
-  // Activate second attribute on GPU
-  glEnableVertexAttribArray(1);
-  // Second attribute (in_Normal) is 3 floats
-  glVertexAttribPointer(1, model::NORMAL.components, model::NORMAL.type, GL_FALSE, planet_model.vertex_bytes, planet_model.offsets[model::NORMAL]);
-  // Activate third attribute on GPU
-  glEnableVertexAttribArray(2);
-  // Third attribute (in_TexCoord) is 2 floats
-  glVertexAttribPointer(2, model::TEXCOORD.components, model::TEXCOORD.type, GL_FALSE, planet_model.vertex_bytes, planet_model.offsets[model::TEXCOORD]);
+  // Configure currently bound array buffer with the generated vertices of all levels
+  glBufferData(GL_ARRAY_BUFFER, planet_model.vertex_data_bytes(), planet_model.vertex_data(), GL_STATIC_DRAW);
+
+  // First attribute (in_Position) is 3 floats or 16 bit integers inside the bounds of the model
+  setVertexAttribute(0, planet_model, model::POSITION);
+  planet_object.position_transform = positionTransform(planet_model);
+  planet_object.bounding_sphere = boundingSphere(planet_model);
+  // Second attribute (in_Normal) is 3 floats or 10 bit integers
+  setVertexAttribute(1, planet_model, model::NORMAL);
+  // Third attribute (in_TexCoord) is 2 floats or 16 bit integers inside the range of the texture coordinates
+  setVertexAttribute(2, planet_model, model::TEXCOORD);
+  planet_object.texcoord_transform = glm::fvec4{planet_model.texcoord_offset, planet_model.texcoord_scale};
+  // Fourth attribute (in_Tangent) is 4 floats or 10 bit integers with 2 bits of handedness
+  setVertexAttribute(3, planet_model, model::TANGENT);
 
   // Generate generic buffer
   glGenBuffers(1, &planet_object.element_BO);
   // Bind this as an vertex array buffer containing all attributes
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planet_object.element_BO);
   // Configure currently bound array buffer
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, model::INDEX.size * planet_model.indices.size(), planet_model.indices.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, planet_model.index_data_bytes(), planet_model.index_data(), GL_STATIC_DRAW);
 
   // Store type of primitive to draw
   planet_object.draw_mode = GL_TRIANGLES;
-  // Transfer number of indices to model object 
-  planet_object.num_elements = GLsizei(planet_model.indices.size());
+  // Transfer number, type and draw ranges of the indices to model object
+  setIndices(planet_object, planet_model);
+  cluster_culling.upload(planet_object);
 
 
   // Points:
-  std::vector<float> stars_model = generateGeometryStars();
-
-  // Generate vertex array object
-  glGenVertexArrays(1, &stars_object.vertex_AO);
-  // Bind the array for attaching buffers
-  glBindVertexArray(stars_object.vertex_AO);
-
-  // Generate generic buffer
-  glGenBuffers(1, &stars_object.vertex_BO);
-  // Bind this as an vertex array buffer containing all attributes
-  glBindBuffer(GL_ARRAY_BUFFER, stars_object.vertex_BO);
-  // Configure currently bound array buffer
-  glBufferData(GL_ARRAY_BUFFER, stars_model.size() * sizeof(float), stars_model.data(), GL_STATIC_DRAW);
-
-  // Activate first attribute on GPU (in_Position)
-  glEnableVertexAttribArray(0);
-  // First attribute are the positions (3 floats for each vertex attribute with 6 floats offset (stride) between the vertex attributes and no initial offset)
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(0));
-  // Activate second attribute on GPU (in_Color)
-  glEnableVertexAttribArray(1);
-  // Second attribute are the colors (3 floats for each vertex attribute with 6 floats offset (stride) between the vertex attributes and 3 floats initial offset)
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));  
-
-  // Element Array Buffer (for draw order of vertecies) not needed as the stars_model are drawn as single points (point cloud)
-
-  // Store type of primitive to draw (single points without edges or faces inbetween)
-  stars_object.draw_mode = GL_POINTS;
-  // Transfer number of indices to model object 
-  stars_object.num_elements = GLsizei(stars_model.size() / 6);
+  // Prefer a real star catalog (csv with ra, dec and magnitude columns) over random stars
+  stars_catalog = star_catalog::load(m_resource_path + "stars/catalog.csv");
+  if (!stars_catalog.empty())
+  {
+    initializeGeometryCatalogStars();
+  }
+  else
+  {
+    std::vector<float> stars_model = generateGeometryStars();
+
+    // Generate vertex array object
+    glGenVertexArrays(1, &stars_object.vertex_AO);
+    // Bind the array for attaching buffers
+    glBindVertexArray(stars_object.vertex_AO);
+
+    // Generate generic buffer
+    glGenBuffers(1, &stars_object.vertex_BO);
+    // Bind this as an vertex array buffer containing all attributes
+    glBindBuffer(GL_ARRAY_BUFFER, stars_object.vertex_BO);
+    // Configure currently bound array buffer
+    glBufferData(GL_ARRAY_BUFFER, stars_model.size() * sizeof(float), stars_model.data(), GL_STATIC_DRAW);
+
+    // Activate first attribute on GPU (in_Position)
+    glEnableVertexAttribArray(0);
+    // First attribute are the positions (3 floats for each vertex attribute with 6 floats offset (stride) between the vertex attributes and no initial offset)
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(0));
+    // Activate second attribute on GPU (in_Color)
+    glEnableVertexAttribArray(1);
+    // Second attribute are the colors (3 floats for each vertex attribute with 6 floats offset (stride) between the vertex attributes and 3 floats initial offset)
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));  
+
+    // Element Array Buffer (for draw order of vertecies) not needed as the stars_model are drawn as single points (point cloud)
+
+    // Store type of primitive to draw (single points without edges or faces inbetween)
+    stars_object.draw_mode = GL_POINTS;
+    // Transfer number of indices to model object 
+    stars_object.num_elements = GLsizei(stars_model.size() / 6);
+  }
 
 
   // Circle:
@@ -921,6 +1001,7 @@ void ApplicationSolar::initializeGeometry()
 
 
   // Cube:
+  // Stays unquantized, the skybox shader uses the positions as directions without a model matrix
   model cube_model = model_loader::obj(m_resource_path + "models/cube.obj");
 
   // Generate vertex array object
@@ -933,28 +1014,28 @@ void ApplicationSolar::initializeGeometry()
   // Bind this as an vertex array buffer containing all attributes
   glBindBuffer(GL_ARRAY_BUFFER, cube_object.vertex_BO);
   // Configure currently bound array buffer
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float)* cube_model.data.size(), cube_model.data.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, cube_model.vertex_data_bytes(), cube_model.vertex_data(), GL_STATIC_DRAW);
 
-  // Activate first attribute on GPU
-  glEnableVertexAttribArray(0);
   // First attribute (in_Position) is 3 floats
-  glVertexAttribPointer(0, model::POSITION.components, model::POSITION.type, GL_FALSE, cube_model.vertex_bytes, cube_model.offsets[model::POSITION]);
+  setVertexAttribute(0, cube_model, model::POSITION);
 
   // Generate generic buffer
   glGenBuffers(1, &cube_object.element_BO);
   // Bind this as a vertex array buffer containing all attributes
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cube_object.element_BO);
   // Configure currently bound array buffer
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, model::INDEX.size* cube_model.indices.size(), cube_model.indices.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, cube_model.index_data_bytes(), cube_model.index_data(), GL_STATIC_DRAW);
 
   // Store type of primitive to draw
   cube_object.draw_mode = GL_TRIANGLES;
-  // Transfer number of indices to model object 
-  cube_object.num_elements = GLsizei(cube_model.indices.size());
+  // Transfer number, type and draw ranges of the indices to model object
+  setIndices(cube_object, cube_model);
 
 
   // Space station:
-  model spacestation_model = model_loader::obj(m_resource_path + "models/spacestation.obj");
+  // Faces with their own texture coordinates and normals keep it at full detail, levels of detail need shared vertices
+  model spacestation_model = model_loader::obj(m_resource_path + "models/spacestation.obj", model::NORMAL | model::TEXCOORD, packed_formats,
+                                               index_codec::NONE, model_loader::normal_options{}, MODEL_LOD_LEVELS);
 
   // Generate vertex array object
   glGenVertexArrays(1, &spacestation_object.vertex_AO);
@@ -966,20 +1047,17 @@ void ApplicationSolar::initializeGeometry()
   // Bind this as an vertex array buffer containing all attributes
   glBindBuffer(GL_ARRAY_BUFFER, spacestation_object.vertex_BO);
   // Configure currently bound array buffer
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float)* spacestation_model.data.size(), spacestation_model.data.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, spacestation_model.vertex_data_bytes(), spacestation_model.vertex_data(), GL_STATIC_DRAW);
 
-  // Activate first attribute on GPU
-  glEnableVertexAttribArray(0);
-  // First attribute (in_Position) is 3 floats
-  glVertexAttribPointer(0, model::POSITION.components, model::POSITION.type, GL_FALSE, spacestation_model.vertex_bytes, spacestation_model.offsets[model::POSITION]);
-  // Activate second attribute on GPU
-  glEnableVertexAttribArray(1);
-  // Second attribute (in_Normal) is 3 floats
-  glVertexAttribPointer(1, model::NORMAL.components, model::NORMAL.type, GL_FALSE, spacestation_model.vertex_bytes, spacestation_model.offsets[model::NORMAL]);
-  // Activate third attribute on GPU
-  glEnableVertexAttribArray(2);
-  // Third attribute (in_TexCoord) is 2 floats
-  glVertexAttribPointer(2, model::TEXCOORD.components, model::TEXCOORD.type, GL_FALSE, spacestation_model.vertex_bytes, spacestation_model.offsets[model::TEXCOORD]);
+  // First attribute (in_Position) is 3 floats or 16 bit integers inside the bounds of the model
+  setVertexAttribute(0, spacestation_model, model::POSITION);
+  spacestation_object.position_transform = positionTransform(spacestation_model);
+  spacestation_object.bounding_sphere = boundingSphere(spacestation_model);
+  // Second attribute (in_Normal) is 3 floats or 10 bit integers
+  setVertexAttribute(1, spacestation_model, model::NORMAL);
+  // Third attribute (in_TexCoord) is 2 floats or 16 bit integers inside the range of the texture coordinates
+  setVertexAttribute(2, spacestation_model, model::TEXCOORD);
+  spacestation_object.texcoord_transform = glm::fvec4{spacestation_model.texcoord_offset, spacestation_model.texcoord_scale};
 
 
   // Generate generic buffer
@@ -987,12 +1065,13 @@ void ApplicationSolar::initializeGeometry()
   // Bind this as a vertex array buffer containing all attributes
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, spacestation_object.element_BO);
   // Configure currently bound array buffer
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, model::INDEX.size* spacestation_model.indices.size(), spacestation_model.indices.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, spacestation_model.index_data_bytes(), spacestation_model.index_data(), GL_STATIC_DRAW);
 
   // Store type of primitive to draw
   spacestation_object.draw_mode = GL_TRIANGLES;
-  // Transfer number of indices to model object 
-  spacestation_object.num_elements = GLsizei(spacestation_model.indices.size());
+  // Transfer number, type and draw ranges of the indices to model object
+  setIndices(spacestation_object, spacestation_model);
+  cluster_culling.upload(spacestation_object);
 
 
   // Unbind VA
@@ -1000,17 +1079,57 @@ void ApplicationSolar::initializeGeometry()
 }
 
 
+// Upload the memory mapped star catalog as vertex buffer
+void ApplicationSolar::initializeGeometryCatalogStars()
+{
+  // Generate vertex array object
+  glGenVertexArrays(1, &stars_object.vertex_AO);
+  // Bind the array for attaching buffers
+  glBindVertexArray(stars_object.vertex_AO);
+
+  // Generate generic buffer
+  glGenBuffers(1, &stars_object.vertex_BO);
+  // Bind this as an vertex array buffer containing all attributes
+  glBindBuffer(GL_ARRAY_BUFFER, stars_object.vertex_BO);
+  // Upload straight from the mapped cache file (no parsing or copying on the CPU)
+  glBufferData(GL_ARRAY_BUFFER, stars_catalog.byte_size(), stars_catalog.stars(), GL_STATIC_DRAW);
+
+  // First attribute is the octahedral encoded direction (2 normalized unsigned shorts)
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(star_catalog::star), (void*)(0));
+  // Second attribute is color and quantized magnitude (4 normalized unsigned bytes)
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(star_catalog::star), (void*)(offsetof(star_catalog::star, color)));
+
+  // Store type of primitive to draw
+  stars_object.draw_mode = GL_POINTS;
+  stars_object.num_elements = GLsizei(stars_catalog.size());
+
+  // Stars are sorted by cell and brightness, so every cell is one draw range
+  // ...that gets shortened when the magnitude cutoff drops
+  stars_limiter.set_range(stars_catalog.magnitude_min(), stars_catalog.magnitude_max());
+  stars_cell_firsts.resize(stars_catalog.cell_count());
+  stars_cell_counts.resize(stars_catalog.cell_count());
+  for (std::size_t cell = 0; cell < stars_catalog.cell_count(); ++cell)
+  {
+    stars_cell_firsts[cell] = GLint(stars_catalog.cell_begin(cell));
+    stars_cell_counts[cell] = GLsizei(stars_catalog.count_brighter(cell, stars_limiter.limit()));
+  }
+}
+
+
 // (Randomly) create geometry for the stars (Ass2)
 std::vector<float> ApplicationSolar::generateGeometryStars()
 {
   // Add stars (Ass2)
-  std::srand(std::time(nullptr));
+  // Fixed step runs have to render the same image every time
+  std::srand(sim_clock::is_fixed_step() ? 0u : unsigned(std::time(nullptr)));
 
   std::vector<float> star_data{};
 
   // Create data for the stars
   int star_count = 50'000;
-  float distance = 1500.0f;
+  float distance = STARS_DISTANCE;
   float pi = acos(0.0f) * 2.0f;
   for (int i = 0; i < star_count; ++i)
   {
@@ -1155,7 +1274,8 @@ void ApplicationSolar::initializeScene()
   // Earth and moon
   local_transform = glm::scale(glm::fmat4{}, glm::vec3{ 0.8f });
   GeometryNode* ear = new GeometryNode{ "Earth", holder_ear, {}, local_transform, glm::fmat4{}, 4.0f * SIMULATION_SPEED,
-                                        &planet_object, glm::vec3{ 1.0f }, &m_textures.at("earth"), &m_textures.at("earth_spec"), &m_textures.at("earth_normal")};
+                                        &planet_object, glm::vec3{ 1.0f }, &m_textures.at("earth"), &m_textures.at("earth_surface"), &m_textures.at("earth_surface")};
+  ear->set_virtual_texture(&virtual_textures, earth_virtual);
   local_transform = glm::scale(glm::fmat4{}, glm::vec3{ 0.25f });
   GeometryNode* moo = new GeometryNode{ "Moon", holder_moo, {}, local_transform, glm::fmat4{}, 0.0f * SIMULATION_SPEED,
                                         &planet_object, glm::vec3{ 1.0f }, &m_textures.at("moon"), nullptr, &m_textures.at("moon_normal") };
@@ -1331,6 +1451,14 @@ void ApplicationSolar::mouseCallback(double pos_x, double pos_y) {
 void ApplicationSolar::resizeCallback(unsigned width, unsigned height) {
   // Recalculate projection matrix for new aspect ration
   m_view_projection = utils::calculate_projection_matrix(float(width) / float(height));
+  // Keep the extended render distance
+  m_view_projection[2][2] = -0.9999f;
+  m_view_projection[3][2] = -0.1999f;
+  viewport_height = float(height);
+  if (!virtual_textures.empty())
+  {
+    virtual_textures.resize(width, height);
+  }
   // Upload new projection matrix
   uploadProjection();
 }
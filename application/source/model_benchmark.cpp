@@ -0,0 +1,386 @@
+#include "index_codec.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "meshlet_builder.hpp"
+#include "model_loader.hpp"
+#include "sphere_generator.hpp"
+#include "thread_pool.hpp"
+#include "utils.hpp"
+#include "vertex_quantizer.hpp"
+
+#include "tiny_obj_loader.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Compares the obj parsing throughput of model_loader with tinyobjloader, which it replaced,
+// and with loading the mesh cache written next to the file, also reports the vertex cache efficiency, vertex and index size
+// of both, compares the normal generation with the serial scatter it replaced, reports the levels of detail,
+// the meshlets and the triangles their cones cull and times the procedural spheres
+// Usage: model_benchmark [--normals] [--texcoords] [--packed] [--compress-indices] [--no-tinyobj] [--generate-normals]
+//                        [--lods] [--meshlets] [--spheres] <model.obj>...
+
+namespace
+{
+  // Fastest of a few runs against noise from other processes
+  const int BENCH_RUNS = 3;
+  // Coarser levels of detail generated with --lods, as many as the application uses
+  const std::size_t LOD_LEVELS = 4;
+  // Cameras around the model the cone culling is measured from, at this many bounding radii from its center
+  const std::size_t CONE_VIEWS = 64;
+  const float CONE_VIEW_DISTANCE = 3.0f;
+
+  template<typename F>
+  double fastest_ms(F function)
+  {
+    double best = 0.0;
+    for (int i = 0; i < BENCH_RUNS; ++i)
+    {
+      auto start = std::chrono::steady_clock::now();
+      function();
+      double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      best = i == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+  }
+
+  std::size_t file_size(std::string const& file_name)
+  {
+    std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+      throw std::runtime_error("could not open " + file_name);
+    }
+    return std::size_t(file.tellg());
+  }
+
+  // Fastest of a few runs on fresh copies of the model, copying is not measured
+  template<typename F>
+  double fastest_ms(model const& source, F function)
+  {
+    double best = 0.0;
+    for (int i = 0; i < BENCH_RUNS; ++i)
+    {
+      model copy = source;
+      auto start = std::chrono::steady_clock::now();
+      function(copy);
+      double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      best = i == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+  }
+
+  void print_load(std::string const& name, std::size_t bytes, double ms)
+  {
+    std::cout << "  " << name << " " << ms << " ms, " << double(bytes) / (ms * 1000.0) << " MB/s\n";
+  }
+
+  // The normal generation model_loader used before, face normals scattered into their vertices one after another
+  void scatter_normals(model& mesh)
+  {
+    std::size_t stride = std::size_t(mesh.vertex_bytes) / sizeof(float);
+    std::size_t normal_offset = std::size_t(reinterpret_cast<std::uintptr_t>(mesh.offsets.at(model::NORMAL))) / sizeof(float);
+    std::vector<glm::fvec3> normals(mesh.vertex_num, glm::fvec3{0.0f});
+    for (std::size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+      float const* v0 = &mesh.data[mesh.indices[i] * stride];
+      float const* v1 = &mesh.data[mesh.indices[i + 1] * stride];
+      float const* v2 = &mesh.data[mesh.indices[i + 2] * stride];
+      glm::fvec3 normal = glm::cross(glm::fvec3{v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]},
+                                     glm::fvec3{v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]});
+      normals[mesh.indices[i]] += normal;
+      normals[mesh.indices[i + 1]] += normal;
+      normals[mesh.indices[i + 2]] += normal;
+    }
+    for (std::size_t i = 0; i < mesh.vertex_num; ++i)
+    {
+      glm::fvec3 normal = glm::dot(normals[i], normals[i]) > 0.0f ? glm::normalize(normals[i]) : normals[i];
+      std::memcpy(&mesh.data[i * stride + normal_offset], &normal, sizeof(normal));
+    }
+  }
+
+  // Largest angle in degrees between the normals of two models with the same vertices
+  float largest_angle(model const& a, model const& b)
+  {
+    std::size_t stride = std::size_t(a.vertex_bytes) / sizeof(float);
+    std::size_t normal_offset = std::size_t(reinterpret_cast<std::uintptr_t>(a.offsets.at(model::NORMAL))) / sizeof(float);
+    float smallest_cos = 1.0f;
+    for (std::size_t i = 0; i < std::min(a.vertex_num, b.vertex_num); ++i)
+    {
+      glm::fvec3 normal_a = glm::make_vec3(&a.data[i * stride + normal_offset]);
+      glm::fvec3 normal_b = glm::make_vec3(&b.data[i * stride + normal_offset]);
+      if (glm::dot(normal_a, normal_a) > 0.0f && glm::dot(normal_b, normal_b) > 0.0f)
+      {
+        smallest_cos = std::min(smallest_cos, glm::dot(normal_a, normal_b));
+      }
+    }
+    return glm::degrees(std::acos(glm::clamp(smallest_cos, -1.0f, 1.0f)));
+  }
+
+  // Serial scatter against the parallel gather, area weighted like the scatter, angle weighted and with a crease angle
+  void benchmark_normals(std::string const& file_name)
+  {
+    model parsed = model_loader::parse_obj(file_name, model::NORMAL);
+    double scatter_ms = fastest_ms(parsed, scatter_normals);
+    std::cout << "  normals: serial scatter " << scatter_ms << " ms\n";
+    model scattered = parsed;
+    scatter_normals(scattered);
+    model_loader::normal_options settings[] = {{180.0f, false}, {180.0f, true}, {60.0f, true}};
+    for (model_loader::normal_options const& options : settings)
+    {
+      double gather_ms = fastest_ms(parsed, [&options](model& mesh) { model_loader::generate_normals(mesh, options); });
+      model gathered = parsed;
+      model_loader::generate_normals(gathered, options);
+      std::cout << "  normals: gather, " << (options.angle_weighted ? "angle" : "area") << " weighted, crease "
+                << options.crease_angle << ": " << gather_ms << " ms, speedup " << scatter_ms / gather_ms << "x";
+      if (options.crease_angle >= 180.0f)
+      {
+        std::cout << ", largest difference " << largest_angle(scattered, gathered) << " degrees\n";
+      }
+      else
+      {
+        std::cout << ", " << gathered.vertex_num - parsed.vertex_num << " vertices split at creases\n";
+      }
+    }
+  }
+
+  // Triangles and error of each level of detail in the cache and the time to simplify them from the parsed model
+  void benchmark_lods(std::string const& file_name, model::attrib_flag_t attributes, model const& loaded)
+  {
+    model parsed = model_loader::parse_obj(file_name, attributes);
+    double lod_ms = fastest_ms(parsed, [](model& mesh) { mesh_simplifier::generate_lods(mesh, LOD_LEVELS); });
+    std::cout << "  levels of detail: " << lod_ms << " ms";
+    for (model::lod const& lod : loaded.lods)
+    {
+      std::cout << ", " << lod.index_count / 3 << " triangles (error " << lod.error << ")";
+    }
+    std::cout << (loaded.lods.empty() ? ", none within the error\n" : "\n");
+  }
+
+  // Meshlet sizes, the time to build them and the fraction of the full detail triangles their cones cull
+  // on average from cameras spread around the model
+  void benchmark_meshlets(std::string const& file_name, model::attrib_flag_t attributes, model const& loaded)
+  {
+    model parsed = model_loader::parse_obj(file_name, attributes);
+    mesh_optimizer::optimize(parsed);
+    double build_ms = fastest_ms(parsed, [](model& mesh) { meshlet_builder::build(mesh); });
+    std::size_t full_detail = loaded.lods.empty() ? loaded.index_count() : loaded.lods.front().index_count;
+    std::size_t meshlets = 0;
+    std::size_t triangles = 0;
+    std::size_t vertices = 0;
+    std::vector<GLuint> indices = loaded.vertex_indices();
+    for (model::meshlet const& meshlet : loaded.meshlets)
+    {
+      if (meshlet.first_index >= full_detail)
+      {
+        break;
+      }
+      std::vector<GLuint> used(indices.begin() + std::ptrdiff_t(meshlet.first_index),
+                               indices.begin() + std::ptrdiff_t(meshlet.first_index + meshlet.index_count));
+      std::sort(used.begin(), used.end());
+      vertices += std::size_t(std::unique(used.begin(), used.end()) - used.begin());
+      triangles += meshlet.index_count / 3;
+      ++meshlets;
+    }
+    if (meshlets == 0)
+    {
+      std::cout << "  meshlets: none\n";
+      return;
+    }
+
+    // Directions on a spiral cover the sphere evenly
+    glm::vec3 center = (loaded.bounds_min + loaded.bounds_max) * 0.5f;
+    float radius = glm::length(loaded.bounds_max - loaded.bounds_min) * 0.5f;
+    std::size_t culled = 0;
+    for (std::size_t view = 0; view < CONE_VIEWS; ++view)
+    {
+      float z = 1.0f - 2.0f * (float(view) + 0.5f) / float(CONE_VIEWS);
+      float angle = float(view) * 2.39996f;
+      float ring = std::sqrt(1.0f - z * z);
+      glm::vec3 camera = center + glm::vec3{ring * std::cos(angle), ring * std::sin(angle), z} * radius * CONE_VIEW_DISTANCE;
+      for (std::size_t i = 0; i < meshlets; ++i)
+      {
+        model::meshlet const& meshlet = loaded.meshlets[i];
+        glm::vec3 to_center = glm::vec3{meshlet.sphere} - camera;
+        if (glm::dot(to_center, glm::vec3{meshlet.cone}) >= meshlet.cone.w * glm::length(to_center) + meshlet.sphere.w)
+        {
+          culled += meshlet.index_count / 3;
+        }
+      }
+    }
+    std::cout << "  meshlets: " << build_ms << " ms, " << meshlets << " of " << double(vertices) / double(meshlets)
+              << " vertices and " << double(triangles) / double(meshlets) << " triangles on average, cones cull "
+              << 100.0 * double(culled) / double(triangles * CONE_VIEWS) << "% of the triangles\n";
+  }
+
+  void print_levels(std::string const& name, model const& sphere, double ms)
+  {
+    std::cout << "  " << name << ": " << ms << " ms, " << sphere.vertex_num << " vertices";
+    for (model::lod const& lod : sphere.lods)
+    {
+      std::cout << ", " << lod.index_count / 3 << " triangles (error " << lod.error << ")";
+    }
+    std::cout << "\n";
+  }
+
+  // Whole level of detail sets of the generated spheres with the attributes of the planets
+  void benchmark_spheres()
+  {
+    model::attrib_flag_t attributes = model::NORMAL | model::TEXCOORD | model::TANGENT;
+    std::cout << "procedural spheres with " << LOD_LEVELS << " coarser levels:\n";
+    std::size_t const uv_sizes[][2] = {{64, 32}, {256, 128}};
+    for (auto const& size : uv_sizes)
+    {
+      double ms = fastest_ms([&]() { sphere_generator::uv_sphere_lods(size[0], size[1], LOD_LEVELS, attributes); });
+      print_levels("uv sphere " + std::to_string(size[0]) + "x" + std::to_string(size[1]),
+                   sphere_generator::uv_sphere_lods(size[0], size[1], LOD_LEVELS, attributes), ms);
+    }
+    for (std::size_t subdivisions : {std::size_t(4), std::size_t(6)})
+    {
+      double ms = fastest_ms([&]() { sphere_generator::ico_sphere_lods(subdivisions, LOD_LEVELS, attributes); });
+      print_levels("icosphere " + std::to_string(subdivisions) + " subdivisions",
+                   sphere_generator::ico_sphere_lods(subdivisions, LOD_LEVELS, attributes), ms);
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  model::attrib_flag_t attributes = model::POSITION;
+  if (utils::has_option(argc, argv, "normals"))
+  {
+    attributes |= model::NORMAL;
+  }
+  if (utils::has_option(argc, argv, "texcoords"))
+  {
+    attributes |= model::TEXCOORD;
+  }
+  vertex_quantizer::format_flag_t packed_formats = 0;
+  if (utils::has_option(argc, argv, "packed"))
+  {
+    packed_formats = vertex_quantizer::PACKED_ALL;
+  }
+  std::uint32_t codec = index_codec::NONE;
+  if (utils::has_option(argc, argv, "compress-indices"))
+  {
+    codec = index_codec::VERTEX_FIFO;
+  }
+  bool tinyobj = !utils::has_option(argc, argv, "no-tinyobj");
+  bool normals = utils::has_option(argc, argv, "generate-normals");
+  std::size_t lod_levels = utils::has_option(argc, argv, "lods") ? LOD_LEVELS : 0;
+  bool meshlets = utils::has_option(argc, argv, "meshlets");
+  bool spheres = utils::has_option(argc, argv, "spheres");
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string argument{argv[i]};
+    if (argument.compare(0, 2, "--") != 0)
+    {
+      files.push_back(argument);
+    }
+  }
+  if (spheres)
+  {
+    benchmark_spheres();
+  }
+  if (files.empty() && !spheres)
+  {
+    std::cerr << "Usage: model_benchmark [--normals] [--texcoords] [--packed] [--compress-indices] [--no-tinyobj]\n"
+              << "                       [--generate-normals] [--lods] [--meshlets] [--spheres] <model.obj>...\n"
+              << "  --normals     import normals, generated if the file has none\n"
+              << "  --texcoords   import texture coordinates\n"
+              << "  --packed      cache the attributes in quantized formats where they stay within tolerance\n"
+              << "  --compress-indices  cache the indices compressed, they are decoded on load\n"
+              << "  --no-tinyobj  skip the comparison, tinyobjloader takes minutes for large files\n"
+              << "  --generate-normals  compare the normal generation with the serial scatter, the file's normals are replaced\n"
+              << "  --lods        cache levels of detail and report their triangles, error and simplification time\n"
+              << "  --meshlets    report the meshlet sizes, build time and the triangles their cones cull from around the model\n"
+              << "  --spheres     time generating the procedural spheres with their levels of detail, no file needed\n"
+              << "MB/s are measured against the size of the obj file\n";
+    return 1;
+  }
+
+  int result = 0;
+  for (std::string const& file_name : files)
+  {
+    try
+    {
+      std::size_t bytes = file_size(file_name);
+      model loaded = model_loader::obj(file_name, attributes, packed_formats, codec, model_loader::normal_options{}, lod_levels);
+      std::cout << file_name << ": " << bytes / 1024 << " KiB, " << loaded.vertex_num << " vertices, "
+                << (loaded.lods.empty() ? loaded.index_count() : loaded.lods.front().index_count) / 3 << " triangles, " << thread_pool::shared().size() << " threads\n";
+
+      double loader_ms = fastest_ms([&]() { model_loader::parse_obj(file_name, attributes); });
+      print_load("model_loader", bytes, loader_ms);
+      // The cached data is copied once like glBufferData does, otherwise only the header would be read
+      std::vector<std::uint8_t> upload;
+      double cache_ms = fastest_ms([&]()
+      {
+        model cached = model_loader::obj(file_name, attributes, packed_formats, codec, model_loader::normal_options{}, lod_levels);
+        upload.resize(cached.vertex_data_bytes() + cached.index_data_bytes());
+        std::memcpy(upload.data(), cached.vertex_data(), cached.vertex_data_bytes());
+        std::memcpy(upload.data() + cached.vertex_data_bytes(), cached.index_data(), cached.index_data_bytes());
+      });
+      print_load("mesh cache", bytes, cache_ms);
+
+      // The cache holds the optimized order, the parser returns the file order
+      model parsed = model_loader::parse_obj(file_name, attributes);
+      std::vector<GLuint> parsed_indices = parsed.vertex_indices();
+      std::vector<GLuint> loaded_indices = loaded.vertex_indices();
+      mesh_optimizer::cache_statistics before = mesh_optimizer::analyze_vertex_cache(parsed_indices.data(), parsed_indices.size(), parsed.vertex_num);
+      mesh_optimizer::cache_statistics after = mesh_optimizer::analyze_vertex_cache(loaded_indices.data(), loaded_indices.size(), loaded.vertex_num);
+      std::cout << "  vertex cache (" << mesh_optimizer::CACHE_SIZE << " entries): ACMR " << before.acmr << " -> " << after.acmr
+                << ", ATVR " << before.atvr << " -> " << after.atvr << "\n";
+      std::cout << "  vertex size " << parsed.vertex_bytes << " -> " << loaded.vertex_bytes << " bytes, index buffer "
+                << parsed.index_data_bytes() / 1024 << " -> " << loaded.index_data_bytes() / 1024 << " KiB"
+                << (loaded.submeshes.empty() ? "" : " in " + std::to_string(loaded.submeshes.size()) + " draws")
+                << ", mesh cache " << file_size(mesh_cache::cache_path(file_name)) / 1024 << " KiB\n";
+      if (tinyobj)
+      {
+        // Parsing only, the interleaving the old loader did afterwards is not included
+        double tinyobj_ms = fastest_ms([&file_name]()
+        {
+          std::vector<tinyobj::shape_t> shapes;
+          std::vector<tinyobj::material_t> materials;
+          std::string error = tinyobj::LoadObj(shapes, materials, file_name.c_str());
+          if (!error.empty() && error.compare(0, 3, "WAR") != 0)
+          {
+            throw std::runtime_error("tinyobjloader: " + error);
+          }
+        });
+        print_load("tinyobj", bytes, tinyobj_ms);
+        std::cout << "  speedup " << tinyobj_ms / loader_ms << "x\n";
+      }
+      if (normals)
+      {
+        benchmark_normals(file_name);
+      }
+      if (lod_levels > 0)
+      {
+        benchmark_lods(file_name, attributes, loaded);
+      }
+      if (meshlets)
+      {
+        benchmark_meshlets(file_name, attributes, loaded);
+      }
+    }
+    catch (std::exception& error)
+    {
+      std::cerr << file_name << ": " << error.what() << "\n";
+      result = 1;
+    }
+  }
+  return result;
+}
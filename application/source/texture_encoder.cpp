@@ -0,0 +1,130 @@
+#include "texture_loader.hpp"
+#include "qoi.hpp"
+#include "thread_pool.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Converts images to qoi files next to them, bands are encoded on all hardware threads
+// Usage: texture_encoder [--linear] [--bench] <image>...
+
+namespace
+{
+  // Fastest of a few runs against noise from other processes
+  const int BENCH_RUNS = 5;
+
+  std::string qoi_path(std::string const& file_name)
+  {
+    std::size_t dot = file_name.find_last_of('.');
+    std::size_t slash = file_name.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    {
+      return file_name + ".qoi";
+    }
+    return file_name.substr(0, dot) + ".qoi";
+  }
+
+  template<typename F>
+  double fastest_ms(F function)
+  {
+    double best = 0.0;
+    for (int i = 0; i < BENCH_RUNS; ++i)
+    {
+      auto start = std::chrono::steady_clock::now();
+      function();
+      double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      best = i == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+  }
+
+  void print_decode(std::string const& name, std::size_t bytes, double ms)
+  {
+    std::cout << "  " << name << " decode " << ms << " ms, " << double(bytes) / (ms * 1000.0) << " MB/s\n";
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  bool linear = utils::has_option(argc, argv, "linear");
+  bool bench = utils::has_option(argc, argv, "bench");
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string argument{argv[i]};
+    if (argument.compare(0, 2, "--") != 0)
+    {
+      files.push_back(argument);
+    }
+  }
+  if (files.empty())
+  {
+    std::cerr << "Usage: texture_encoder [--linear] [--bench] <image>...\n"
+              << "  --linear  mark the images as linear data instead of srgb color\n"
+              << "  --bench   compare the decode time of source and qoi file\n";
+    return 1;
+  }
+
+  int result = 0;
+  for (std::string const& file_name : files)
+  {
+    try
+    {
+      // Qoi stores rgb and rgba only, grey images are expanded
+      pixel_data image = texture_loader::file(file_name);
+      std::size_t channels = texture_loader::channel_count(image.channels);
+      if (channels < 3)
+      {
+        image = texture_loader::convert(std::move(image), channels == 1 ? GL_RGB : GL_RGBA);
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::uint8_t> encoded = qoi::encode(image, linear);
+      double encode_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+      std::string target = qoi_path(file_name);
+      std::string temp_path = target + ".tmp";
+      {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<char const*>(encoded.data()), std::streamsize(encoded.size()));
+        if (!out)
+        {
+          throw std::runtime_error("could not write " + temp_path);
+        }
+      }
+      std::remove(target.c_str());
+      if (std::rename(temp_path.c_str(), target.c_str()) != 0)
+      {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error("could not write " + target);
+      }
+
+      std::size_t raw = image.pixels.size();
+      std::cout << file_name << " -> " << target << ": " << image.width << "x" << image.height << ", "
+                << encoded.size() / 1024 << " KiB (" << 100.0 * double(encoded.size()) / double(raw) << "% of raw), encoded in "
+                << encode_ms << " ms on " << thread_pool::shared().size() << " threads\n";
+
+      if (bench)
+      {
+        double source_ms = fastest_ms([&file_name]() { texture_loader::file(file_name); });
+        double qoi_ms = fastest_ms([&target]() { texture_loader::file(target); });
+        print_decode("source", raw, source_ms);
+        print_decode("qoi", raw, qoi_ms);
+        std::cout << "  speedup " << source_ms / qoi_ms << "x\n";
+      }
+    }
+    catch (std::exception& error)
+    {
+      std::cerr << file_name << ": " << error.what() << "\n";
+      result = 1;
+    }
+  }
+  return result;
+}
@@ -27,6 +27,8 @@ class Application {
   void mouse_callback(GLFWwindow* window, double pos_x, double pos_y);
   // Recompile shaders form source files
   void reloadShaders(bool throwing);
+  // Time the last frame spent on cpu and gpu work, without waiting for vsync or the frame rate limit
+  void set_frame_work(double work_ms);
 
 // Functions which are implemented in derived classes
   // Update uniform locations and values
@@ -46,6 +48,8 @@ class Application {
   void updateUniformLocations();
   
   std::string m_resource_path; 
+  // Work time of the last frame, see set_frame_work
+  double m_frame_work_ms;
 
   // Container for the shader programs
   std::map<std::string, shader_program> m_shaders{};
@@ -60,16 +64,45 @@ class Application {
 
 #include "utils.hpp"
 #include "window_handler.hpp"
+#include "frame_scheduler.hpp"
+#include "frame_recorder.hpp"
+#include "headless.hpp"
+#include "profiler.hpp"
+#include "sim_clock.hpp"
+#include "texture_residency.hpp"
+#include "tile_cache.hpp"
+#include "skybox.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
 
 template<typename T>
 void Application::run(int argc, char* argv[], unsigned ver_major, unsigned ver_minor) {  
 
-    GLFWwindow* window = window_handler::initialize(initial_resolution, ver_major, ver_minor);
+    headless::settings offscreen = headless::read_settings(argc, argv, initial_resolution);
+    // Fixed steps make the simulation reproducible from the start
+    sim_clock::set_fixed_step(offscreen.enabled);
+
+    GLFWwindow* window = window_handler::initialize(offscreen.enabled ? offscreen.resolution : initial_resolution, ver_major, ver_minor, !offscreen.enabled);
     
+    // Section timings for --profile and --trace
+    profiler::initialize(argc, argv);
+    // Texture memory budget for --texture-budget
+    texture_residency::read_settings(argc, argv);
+    // Tile cache size for --vt-cache and --vt-uploads
+    tile_cache::read_settings(argc, argv);
+    // Skybox resolution for --skybox-size, --skybox-half and --skybox-compress
+    skybox::read_settings(argc, argv);
+
     std::string resource_path = utils::read_resource_path(argc, argv);
     T* application = new T{resource_path};
 
-    window_handler::set_callback_object(window, application);
+    if (!offscreen.enabled) {
+      window_handler::set_callback_object(window, application);
+    }
 
     // Do intial shader load an uniform upload
     application->reloadShaders(true);
@@ -77,22 +110,101 @@ void Application::run(int argc, char* argv[], unsigned ver_major, unsigned ver_m
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
-    
-    // Rendering loop
-    while (!glfwWindowShouldClose(window)) {
-      // Query input
-      glfwPollEvents();
-      // Clear buffer
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-      // Execute logic and physics
-      application->physics();
-      // Draw geometry
-      application->render();
-      // Swap draw buffer to front
-      glfwSwapBuffers(window);
-      // Display fps
-      window_handler::show_fps(window);
+
+    if (offscreen.enabled) {
+      // Render a fixed number of frames into a framebuffer and report the frame times
+      headless::render_target target{offscreen.resolution};
+      target.bind();
+      application->resize_callback(offscreen.resolution.x, offscreen.resolution.y);
+
+      std::vector<double> frame_ms{};
+      frame_ms.reserve(offscreen.frames);
+      for (std::size_t frame = 0; frame < offscreen.frames; ++frame) {
+        auto frame_start = std::chrono::steady_clock::now();
+        profiler::begin_frame();
+        sim_clock::step(offscreen.step_ms / 1000.0);
+        glfwPollEvents();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+          profiler::scope scope{"physics"};
+          application->physics();
+        }
+        {
+          profiler::scope scope{"render"};
+          application->render();
+        }
+        // Wait for the gpu so the measured time covers the whole frame
+        glFinish();
+        profiler::end_frame();
+        frame_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
+        // Nothing waits besides the gpu work, so the whole frame is work
+        application->set_frame_work(frame_ms.back());
+      }
+
+      std::string image_hash{};
+      if (offscreen.hash_image) {
+        std::vector<std::uint8_t> pixels = target.read_pixels();
+        std::ostringstream hex{};
+        hex << std::hex << std::setw(16) << std::setfill('0') << headless::hash(pixels.data(), pixels.size());
+        image_hash = hex.str();
+      }
+      headless::write_report(offscreen, frame_ms, image_hash);
+      profiler::print_summary(std::cout);
+    }
+    else {
+      // Pace frames to the requested rate and sync mode
+      frame_scheduler scheduler{frame_scheduler::read_settings(argc, argv)};
+      bool report_pacing = utils::has_option(argc, argv, "pacing-stats");
+      double last_report_time = glfwGetTime();
+      // Frame time percentiles, hitches and bottleneck
+      frame_recorder recorder{frame_recorder::read_settings(argc, argv)};
+
+      // Rendering loop
+      while (!glfwWindowShouldClose(window)) {
+        // Wait for next frame slot
+        scheduler.begin_frame();
+        profiler::begin_frame();
+        recorder.begin_frame();
+        // Advance simulation time
+        sim_clock::tick();
+        // Query input
+        glfwPollEvents();
+        // Clear buffer
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Execute logic and physics
+        {
+          profiler::scope scope{"physics"};
+          application->physics();
+        }
+        // Draw geometry
+        {
+          profiler::scope scope{"render"};
+          application->render();
+        }
+        recorder.end_frame();
+        application->set_frame_work(recorder.last_work_ms());
+        // Swap draw buffer to front
+        glfwSwapBuffers(window);
+        scheduler.end_frame();
+        profiler::end_frame();
+        // Display fps
+        window_handler::show_fps(window, recorder);
+        // Print pacing quality and section timings periodically
+        if (glfwGetTime() - last_report_time >= 5.0) {
+          if (report_pacing) {
+            std::cout << "Frame pacing: " << scheduler.get_metrics() << std::endl;
+            scheduler.reset_metrics();
+          }
+          profiler::print_summary(std::cout);
+          last_report_time = glfwGetTime();
+        }
+      }
+      std::cout << "Frame pacing: " << scheduler.get_metrics() << std::endl;
+      recorder.finish();
+      std::cout << "Frame times: " << recorder.get_total_summary() << std::endl;
     }
+    // Write the trace while the context still exists
+    profiler::shutdown();
 
     delete application;
     window_handler::close_and_quit(window, EXIT_SUCCESS);
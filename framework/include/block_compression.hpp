@@ -0,0 +1,43 @@
+#ifndef BLOCK_COMPRESSION_HPP
+#define BLOCK_COMPRESSION_HPP
+
+#include "pixel_data.hpp"
+
+#include <glbinding/gl/types.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// encoders for 4x4 block compressed texture formats
+namespace block_compression {
+  enum class format {
+    // rgb with 4 colors per block (s3tc dxt1)
+    bc1,
+    // bc1 color with interpolated alpha (s3tc dxt5)
+    bc3,
+    // single channel with 8 values per block (rgtc1)
+    bc4,
+    // two bc4 channels, used for normal xy (rgtc2)
+    bc5
+  };
+
+  GLenum internal_format(format f);
+  // format of images with 1 to 4 channels: bc4, bc5, bc1 and bc3
+  format format_for(std::size_t channels);
+  // format matching the content of an 8 bit image, opaque rgba drops the alpha block
+  format choose_format(pixel_data const& image);
+  std::size_t block_bytes(format f);
+  // bytes of an image with partial blocks at the borders
+  std::size_t compressed_size(format f, std::size_t width, std::size_t height);
+
+  // encode an 8 bit image, rows of blocks are encoded in parallel on the shared thread pool
+  // bc4 reads the red and bc5 the red and green channel
+  std::vector<std::uint8_t> encode(pixel_data const& image, format f);
+  // decode to rgba8 for quality checks
+  pixel_data decode(std::uint8_t const* blocks, std::size_t width, std::size_t height, format f);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef CLUSTER_CULLER_HPP
+#define CLUSTER_CULLER_HPP
+
+#include "structs.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// culls the meshlet clusters of objects each frame against the view frustum and their normal cones, clusters
+// outside the view or with all triangles facing away are not drawn;
+// with OpenGL 4.3 a compute shader writes compacted indirect draw commands, otherwise the cpu merges the index
+// ranges of the visible clusters; the triangles culled per frame are counted by the profiler, those of the gpu
+// arrive a few frames later without stalling
+class cluster_culler {
+ public:
+  // compiles the compute shader if the context supports OpenGL 4.3
+  explicit cluster_culler(std::string const& compute_shader_path);
+  ~cluster_culler();
+
+  cluster_culler(cluster_culler const&) = delete;
+  cluster_culler& operator=(cluster_culler const&) = delete;
+
+  bool gpu() const;
+  // upload the clusters of the object for the compute shader, nothing to do when culling on the cpu
+  void upload(model_object& object) const;
+
+  // start culling for a view, view_projection maps world to clip space
+  void begin_frame(glm::fmat4 const& view_projection, glm::fvec3 const& camera_position);
+  // cull the clusters of a level of the object placed by the transform, the draw replaces the level's draw
+  // in this frame; objects without clusters get an inactive draw
+  void cull(model_object const& object, std::size_t level, glm::fmat4 const& transform, cluster_draw& draw);
+  // make the commands visible to the draws and report the culled triangles
+  void end_frame();
+
+  // triangles culled in the latest frame with known results
+  std::size_t culled_triangles() const;
+
+ private:
+  // buffer the culled triangle count is copied into and the fence of the copy
+  struct readback {
+    GLuint buffer;
+    GLsync fence;
+  };
+
+  // the clusters of the range are culled on the cpu
+  void cull_cpu(model_object const& object, std::size_t first, std::size_t count, cluster_draw& draw);
+  // grow the command and counter buffers to what the last frame needed
+  void reserve();
+  // read the newest finished count
+  void collect();
+
+  GLuint program_;
+  GLint planes_location_;
+  GLint camera_location_;
+  GLint cone_location_;
+  GLint cluster_first_location_;
+  GLint cluster_count_location_;
+  GLint command_offset_location_;
+  GLint counter_index_location_;
+
+  // indirect commands of all objects in a frame, one per cluster, and a compaction counter per object
+  // after the culled triangle count
+  GLuint commands_;
+  GLuint counters_;
+  std::size_t command_capacity_;
+  std::size_t counter_capacity_;
+  std::size_t commands_used_;
+  std::size_t counters_used_;
+  std::vector<readback> readbacks_;
+  std::size_t next_readback_;
+
+  // frame state, planes and camera in world space
+  glm::fvec4 planes_[6];
+  glm::fvec3 camera_position_;
+  std::size_t cpu_culled_;
+  std::size_t gpu_culled_;
+  std::size_t culled_;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef FRAME_RECORDER_HPP
+#define FRAME_RECORDER_HPP
+
+#include <glbinding/gl/types.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// histogram with logarithmic buckets, fixed memory and bounded relative error
+class log_histogram {
+ public:
+  // buckets grow by the relative step, values outside the range land in the first or last bucket
+  explicit log_histogram(double min_ms = 0.05, double max_ms = 10000.0, double step = 0.02);
+
+  void add(double ms);
+  void reset();
+
+  std::size_t count() const;
+  double mean() const;
+  double max() const;
+  // upper bound of the bucket containing the percentile, at most the recorded maximum
+  double percentile(double fraction) const;
+
+ private:
+  double log_min_;
+  double log_step_;
+  std::vector<std::uint32_t> buckets_;
+  std::size_t count_;
+  double sum_;
+  double max_;
+};
+
+// records frame, cpu and gpu times and reports percentiles, hitches and the bottleneck
+class frame_recorder {
+ public:
+  typedef std::chrono::steady_clock clock;
+
+  struct settings {
+    settings();
+    // frames longer than this count as hitch
+    double hitch_ms;
+    // seconds between periodic reports
+    double report_interval;
+    // csv or json file receiving the reports, empty for none
+    std::string report_path;
+  };
+
+  struct summary {
+    std::size_t frames;
+    double mean_ms;
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+    double max_ms;
+    std::size_t hitches;
+    double cpu_p50_ms;
+    double gpu_p50_ms;
+    // frames classified by comparing cpu and gpu time, frames without gpu time are not classified
+    std::size_t cpu_bound;
+    std::size_t gpu_bound;
+  };
+
+  // read settings from cmdline options --hitch-ms=, --report-interval=, --frame-report=
+  static settings read_settings(int argc, char* argv[]);
+
+  // requires a current context to check for timer query support
+  explicit frame_recorder(settings const& config);
+  ~frame_recorder();
+
+  frame_recorder(frame_recorder const&) = delete;
+  frame_recorder& operator=(frame_recorder const&) = delete;
+
+  // call when the frame work starts, after waiting for the frame slot
+  void begin_frame();
+  // call after submitting the frame, before swapping buffers
+  void end_frame();
+  // write the final report of the whole run
+  void finish();
+
+  // statistics of the current report period
+  summary get_period_summary() const;
+  summary get_total_summary() const;
+  // work of the last frame without the wait for the frame slot, the longer of its cpu time and the gpu time
+  // of the latest frame with results
+  double last_work_ms() const;
+
+ private:
+  // frame times of a period or the whole run
+  struct statistics {
+    statistics();
+
+    log_histogram frame_ms;
+    log_histogram cpu_ms;
+    log_histogram gpu_ms;
+    std::size_t hitches;
+    std::size_t cpu_bound;
+    std::size_t gpu_bound;
+
+    void reset();
+    summary get_summary() const;
+  };
+
+  // timestamp queries of a frame, read back two frames later
+  struct gpu_slot {
+    GLuint queries[2];
+    double cpu_ms;
+    bool pending;
+  };
+
+  void collect(gpu_slot& slot);
+  void report(summary const& s, std::string const& label);
+
+  settings settings_;
+  bool has_timer_query_;
+  gpu_slot slots_[2];
+  std::size_t frame_index_;
+  double last_cpu_ms_;
+  double last_gpu_ms_;
+
+  clock::time_point start_;
+  clock::time_point period_start_;
+  clock::time_point frame_begin_;
+  clock::time_point last_begin_;
+  bool has_begun_;
+
+  statistics period_;
+  statistics total_;
+  // rows written so far, json reports are rewritten completely
+  std::vector<std::string> json_rows_;
+};
+
+std::ostream& operator<<(std::ostream& os, frame_recorder::summary const& s);
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef FRAME_SCHEDULER_HPP
+#define FRAME_SCHEDULER_HPP
+
+#include <glbinding/gl/types.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <chrono>
+#include <iosfwd>
+#include <vector>
+
+// paces the render loop to a target rate and bounds the frames queued on the gpu
+class frame_scheduler {
+ public:
+  typedef std::chrono::steady_clock clock;
+
+  enum class sync_mode { off, vsync, adaptive };
+
+  struct settings {
+    settings();
+    // frames per second, 0 for no limit besides vsync
+    double target_fps;
+    sync_mode sync;
+    // number of frames the cpu may run ahead of the gpu
+    unsigned frames_in_flight;
+    // remaining wait time that is spun instead of slept
+    double spin_ms;
+  };
+
+  // frame interval statistics since the last reset
+  struct metrics {
+    std::size_t frames;
+    double mean_ms;
+    double stddev_ms;
+    double min_ms;
+    double max_ms;
+    // absolute deviation of the interval from the target interval
+    double mean_jitter_ms;
+    double max_jitter_ms;
+    // frames longer than one and a half target intervals
+    std::size_t missed;
+  };
+
+  // read settings from cmdline options --fps=, --sync=off|vsync|adaptive, --frames-in-flight=
+  static settings read_settings(int argc, char* argv[]);
+
+  // applies the swap interval to the current context
+  explicit frame_scheduler(settings const& config);
+  ~frame_scheduler();
+
+  frame_scheduler(frame_scheduler const&) = delete;
+  frame_scheduler& operator=(frame_scheduler const&) = delete;
+
+  // wait for the next frame slot, call before polling input
+  void begin_frame();
+  // mark the end of frame submission, call after swapping buffers
+  void end_frame();
+
+  settings const& get_settings() const;
+  metrics get_metrics() const;
+  void reset_metrics();
+
+ private:
+  // sleep for most of the remaining time, spin for the rest
+  void wait_until(clock::time_point deadline) const;
+
+  settings settings_;
+  clock::duration period_;
+  clock::time_point deadline_;
+  clock::time_point last_begin_;
+  bool has_begun_;
+
+  // fences of the last frames, used as ring buffer
+  std::vector<GLsync> fences_;
+  std::size_t frame_index_;
+
+  // running sums for metrics
+  std::size_t frames_;
+  double sum_ms_;
+  double sum_squared_ms_;
+  double min_ms_;
+  double max_ms_;
+  double sum_jitter_ms_;
+  double max_jitter_ms_;
+  std::size_t missed_;
+};
+
+std::ostream& operator<<(std::ostream& os, frame_scheduler::metrics const& m);
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "node.hpp"
 
+class tile_cache;
+
 
 class GeometryNode : public Node
 {
@@ -23,6 +25,18 @@ public:
   // Getter Setter
   model_object const* get_model() const;
   void set_model(model_object const* geometry_in);
+  texture_object const* get_texture() const;
+  texture_object const* get_texture_spec() const;
+  texture_object const* get_texture_normal() const;
+  // Color is read from a virtual texture of the tile cache instead of the color texture, id 0 to disable
+  void set_virtual_texture(tile_cache const* cache, std::size_t id);
+  tile_cache const* get_virtual_cache() const;
+  std::size_t get_virtual_texture() const;
+  // Level of detail of the model drawn, chosen per frame by the application
+  void set_lod(std::size_t level);
+  std::size_t get_lod() const;
+  // Visible clusters of the model, filled per frame by a cluster culler and drawn instead of the level if active
+  cluster_draw& get_clusters();
 
   // Methods
   void render(std::map<std::string, shader_program> const* shaders, glm::fmat4 const* view_transform, glm::fmat4 transform) const override;
@@ -33,7 +47,11 @@ private:
   texture_object const* texture_;
   texture_object const* texture_spec_;
   texture_object const* texture_normal_;
+  tile_cache const* virtual_cache_;
+  std::size_t virtual_texture_;
   glm::vec3 color_;
+  std::size_t lod_;
+  cluster_draw clusters_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef HEADLESS_HPP
+#define HEADLESS_HPP
+
+#include <glbinding/gl/types.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// offscreen rendering of a fixed number of frames for benchmarks and regression images
+namespace headless {
+  struct settings {
+    settings();
+    // render offscreen instead of into the window
+    bool enabled;
+    glm::uvec2 resolution;
+    std::size_t frames;
+    // simulated time per frame
+    double step_ms;
+    // json file receiving the frame statistics, empty for stdout only
+    std::string stats_path;
+    // hash the final image to detect rendering changes
+    bool hash_image;
+  };
+
+  // read settings from cmdline options --headless, --frames=, --dt=, --width=, --height=, --stats=, --hash
+  settings read_settings(int argc, char* argv[], glm::uvec2 const& default_resolution);
+
+  // framebuffer with color and depth renderbuffers
+  class render_target {
+   public:
+    explicit render_target(glm::uvec2 const& resolution);
+    ~render_target();
+
+    render_target(render_target const&) = delete;
+    render_target& operator=(render_target const&) = delete;
+
+    // bind for drawing and set the viewport
+    void bind() const;
+    glm::uvec2 const& resolution() const;
+    // read back the color attachment as rgba8, bottom row first
+    std::vector<std::uint8_t> read_pixels() const;
+
+   private:
+    glm::uvec2 resolution_;
+    GLuint framebuffer_;
+    GLuint color_buffer_;
+    GLuint depth_buffer_;
+  };
+
+  // fnv-1a hash of a byte range
+  std::uint64_t hash(std::uint8_t const* data, std::size_t size);
+
+  // write frame time statistics as json to the path and a summary to stdout
+  void write_report(settings const& config, std::vector<double> const& frame_ms, std::string const& image_hash);
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef IMAGE_BUFFER_HPP
+#define IMAGE_BUFFER_HPP
+
+#include "mapped_file.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// read-only texel memory released by a deleter of its owner, move-only so images are never copied implicitly
+class image_buffer {
+ public:
+  typedef std::function<void()> deleter;
+
+  image_buffer();
+  // take memory which the deleter frees, e.g. a buffer of the image decoder
+  image_buffer(std::uint8_t const* data, std::size_t size, deleter release);
+  // take the memory of the vector without copying
+  image_buffer(std::vector<std::uint8_t>&& memory);
+  // keep the file mapped as long as the buffer lives
+  explicit image_buffer(mapped_file&& file);
+  ~image_buffer();
+
+  image_buffer(image_buffer&& other);
+  image_buffer& operator=(image_buffer&& other);
+
+  image_buffer(image_buffer const&) = delete;
+  image_buffer& operator=(image_buffer const&) = delete;
+
+  std::uint8_t const* data() const;
+  std::size_t size() const;
+  bool empty() const;
+  std::uint8_t const& operator[](std::size_t index) const;
+
+  // free the memory, buffer is empty afterwards
+  void reset();
+
+ private:
+  std::uint8_t const* data_;
+  std::size_t size_;
+  deleter release_;
+};
+
+#endif
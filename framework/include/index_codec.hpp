@@ -0,0 +1,36 @@
+#ifndef INDEX_CODEC_HPP
+#define INDEX_CODEC_HPP
+
+#include "model.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// narrows the indices of a loaded model to 16 bits where the vertex range of each draw allows it
+// and compresses index streams for the mesh cache
+namespace index_codec {
+  // vertices a 16 bit index addresses from the base vertex
+  const std::size_t SHORT_RANGE = 65536;
+
+  // codecs of the indices in the mesh cache
+  const std::uint32_t NONE = 0;
+  // a 4 bit code per index for the next unused vertex, one of the last 14 new vertices or an escape
+  // followed by the delta to the previous index, below 2 bytes per triangle after mesh_optimizer
+  const std::uint32_t VERTEX_FIFO = 1;
+
+  // store the indices as GL_UNSIGNED_SHORT, meshes with more vertices are split into consecutive submeshes drawn
+  // relative to their base vertex, vertices shared across a split are copied; unchanged if the copies would take
+  // more memory than the narrowed indices save
+  // throws std::invalid_argument for a model referring to a mapped file or with narrowed indices
+  void narrow(model& mesh);
+
+  // append the compressed values to the stream, every call starts with an empty fifo,
+  // so submeshes with their own base vertex are encoded one at a time
+  void encode(GLuint const* values, std::size_t count, std::vector<std::uint8_t>& stream);
+  // decode count values from the start of the stream and return the bytes read
+  // throws std::runtime_error if the stream ends early
+  std::size_t decode(std::uint8_t const* stream, std::size_t size, GLuint* values, std::size_t count);
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// read-only memory mapping of a whole file, move-only
+class mapped_file {
+ public:
+  mapped_file();
+  // map file, throws std::runtime_error if it can not be opened
+  explicit mapped_file(std::string const& path);
+  ~mapped_file();
+
+  mapped_file(mapped_file&& other);
+  mapped_file& operator=(mapped_file&& other);
+
+  mapped_file(mapped_file const&) = delete;
+  mapped_file& operator=(mapped_file const&) = delete;
+
+  std::uint8_t const* data() const;
+  std::size_t size() const;
+  bool is_open() const;
+
+  // unmap file, mapping is empty afterwards
+  void close();
+
+ private:
+  std::uint8_t const* data_;
+  std::size_t size_;
+#ifdef _WIN32
+  void* file_handle_;
+  void* mapping_handle_;
+#endif
+};
+
+#endif
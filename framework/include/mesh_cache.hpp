@@ -0,0 +1,119 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include "model.hpp"
+
+#include <cstdint>
+#include <string>
+
+// loaded models in a binary file next to their source, later loads map the file and hand
+// vertices and indices from the page cache straight to the buffer objects without parsing
+namespace mesh_cache {
+  // layout of the cache file, followed by the attribute table, the submesh table, the level of detail table,
+  // the meshlet table, the vertices and the indices
+  struct file_header {
+    char magic[4];
+    std::uint32_t version;
+    // source file properties for invalidation
+    std::uint64_t source_size;
+    std::int64_t source_time;
+    // model::attrib_flag_t requested from the loader and the ones the vertices contain
+    std::uint32_t import_attributes;
+    std::uint32_t attributes;
+    // vertex_quantizer::format_flag_t the loader was allowed to use
+    std::uint32_t packed_formats;
+    // settings of generated normals, 1 for angle weighted
+    float crease_angle;
+    std::uint32_t angle_weighted;
+    // coarser levels of detail requested from the loader
+    std::uint32_t lod_levels;
+    std::uint32_t attribute_count;
+    std::uint32_t submesh_count;
+    std::uint32_t lod_count;
+    std::uint32_t meshlet_count;
+    std::uint32_t padding;
+    std::uint32_t vertex_bytes;
+    // gl enum of the index type and index_codec constant of their encoding
+    std::uint32_t index_type;
+    std::uint32_t index_codec;
+    std::uint64_t vertex_count;
+    std::uint64_t index_count;
+    // axis aligned box around all positions
+    float bounds_min[3];
+    float bounds_max[3];
+    // mapping of quantized positions and texture coordinates to their original range
+    float position_offset[3];
+    float position_scale[3];
+    float texcoord_offset[2];
+    float texcoord_scale[2];
+    // file offsets of the vertices and indices
+    std::uint64_t vertex_offset;
+    std::uint64_t index_offset;
+    // size of the stored indices
+    std::uint64_t index_bytes;
+  };
+
+  // vertex layout descriptor, one per contained attribute in the order of model::VERTEX_ATTRIBS
+  struct attribute_info {
+    std::uint32_t flag;
+    std::uint32_t components;
+    // gl enum of the component type
+    std::uint32_t type;
+    // 1 if integer components are normalized
+    std::uint32_t normalized;
+    // byte offset inside a vertex
+    std::uint32_t offset;
+  };
+
+  struct submesh_info {
+    std::uint64_t first_index;
+    std::uint64_t index_count;
+    std::uint64_t base_vertex;
+  };
+
+  struct lod_info {
+    std::uint64_t first_index;
+    std::uint64_t index_count;
+    // relative to the bounding sphere radius
+    float error;
+    std::uint32_t padding;
+  };
+
+  struct meshlet_info {
+    std::uint64_t first_index;
+    std::uint64_t index_count;
+    // bounding sphere and normal cone as in model::meshlet
+    float sphere[4];
+    float cone[4];
+  };
+
+  // what a cache has to match to be used
+  struct source_info {
+    std::uint64_t size;
+    std::int64_t time;
+    // model::attrib_flag_t requested from the loader
+    std::uint32_t import_attributes;
+    // vertex_quantizer::format_flag_t the loader may use
+    std::uint32_t packed_formats;
+    // index_codec constant the indices are stored with, compressed indices are decoded into memory on load
+    std::uint32_t index_codec;
+    // settings of normals generated for files without them
+    float crease_angle;
+    std::uint32_t angle_weighted;
+    // coarser levels of detail generated at most
+    std::uint32_t lod_levels;
+  };
+
+  // size and modification time of the source file, throws std::runtime_error if it can not be found
+  source_info source_of(std::string const& file_name, std::uint32_t import_attributes, std::uint32_t packed_formats,
+                        std::uint32_t index_codec, float crease_angle, bool angle_weighted, std::uint32_t lod_levels);
+  // map the cache file, throws std::runtime_error if it is missing or damaged, belongs to another source
+  // or its vertex layout contains attributes or formats the model does not support
+  model load(std::string const& cached, source_info const& source);
+  // write the model and return it backed by the written file, it is returned unchanged if the file can not be written
+  model store(std::string const& cached, model&& built, source_info const& source);
+  // path of the cache belonging to a model file
+  std::string cache_path(std::string const& file_name);
+}
+
+#endif
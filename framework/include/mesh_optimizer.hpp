@@ -0,0 +1,45 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include "model.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// reorders the triangles and vertices of a loaded model so that the gpu transforms fewer vertices,
+// shades fewer hidden fragments and fetches the vertices from fewer cache lines
+namespace mesh_optimizer {
+  // entries of the simulated post-transform vertex cache
+  const std::size_t CACHE_SIZE = 16;
+  // clusters are split while their cache efficiency stays within this factor of the unsplit cluster's
+  const float OVERDRAW_THRESHOLD = 1.05f;
+
+  struct cache_statistics {
+    // average cache miss ratio, transformed vertices per triangle from 3 down to about 0.5 for regular meshes
+    float acmr;
+    // average transform to vertex ratio, transformed vertices per referenced vertex, 1 is optimal
+    float atvr;
+  };
+
+  // simulate a fifo post-transform cache while drawing the triangles
+  cache_statistics analyze_vertex_cache(GLuint const* indices, std::size_t index_count, std::size_t vertex_count,
+                                        std::size_t cache_size = CACHE_SIZE);
+
+  // reorder the triangles for the vertex cache with tipsify (Sander et al. 2007),
+  // returns the first triangle of each cluster that started after the cache ran dry
+  std::vector<std::size_t> optimize_vertex_cache(GLuint* indices, std::size_t index_count, std::size_t vertex_count,
+                                                 std::size_t cache_size = CACHE_SIZE);
+  // split the clusters further where the cache allows it and draw clusters facing away from the mesh center first,
+  // they hide the clusters facing inwards from most view directions; positions are the first three of stride floats
+  void optimize_overdraw(GLuint* indices, std::size_t index_count, float const* positions, std::size_t stride,
+                         std::vector<std::size_t> const& clusters, float threshold = OVERDRAW_THRESHOLD,
+                         std::size_t cache_size = CACHE_SIZE);
+  // number the vertices in the order of their first use and remap the indices
+  void optimize_vertex_fetch(model& mesh);
+
+  // all of the above, triangles stay inside their submesh
+  // throws std::invalid_argument for a model referring to a mapped file, with quantized positions or narrowed indices
+  void optimize(model& mesh);
+}
+
+#endif
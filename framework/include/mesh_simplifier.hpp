@@ -0,0 +1,31 @@
+#ifndef MESH_SIMPLIFIER_HPP
+#define MESH_SIMPLIFIER_HPP
+
+#include "model.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// reduces the triangles of a loaded model by collapsing edges in the order of their quadric error (Garland and Heckbert 1997),
+// vertices only move onto their neighbours, so coarser levels of detail reuse the vertex buffer of the full detail
+namespace mesh_simplifier {
+  // coarser levels stop once the error exceeds this fraction of the bounding sphere radius
+  const float MAX_LOD_ERROR = 0.05f;
+  // a level is only kept if it has at most this fraction of the triangles of the previous one
+  const float MIN_LOD_REDUCTION = 0.8f;
+
+  // simplify the triangles towards target_index_count indices while the error stays below target_error, a fraction of
+  // the bounding sphere radius; texture and normal seams only collapse along the seam, open borders along the border,
+  // vertices shared by submeshes and collapses that would flip triangles or join differing normals are avoided
+  // returns the indices of the remaining triangles in their order, error receives the largest error of a collapse
+  // throws std::invalid_argument for a model referring to a mapped file, with quantized positions or narrowed indices
+  std::vector<GLuint> simplify(model const& mesh, std::size_t target_index_count, float target_error, float* error = nullptr);
+
+  // append up to levels coarser levels of detail behind the indices, each simplified from the previous one to about half
+  // its triangles while the summed error stays below max_error; every level keeps the submeshes of the full detail
+  // as submeshes of its own, the model's lods list them with the full detail first
+  // throws std::invalid_argument like simplify or for a model with levels of detail already
+  void generate_lods(model& mesh, std::size_t levels, float max_error = MAX_LOD_ERROR);
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef MESHLET_BUILDER_HPP
+#define MESHLET_BUILDER_HPP
+
+#include "model.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// splits the triangles of a model into meshlets, small clusters with a bounding sphere and a cone around their normals
+// that are culled as a whole when they are outside the view frustum or all of their triangles face away;
+// a meshlet is a run of consecutive triangles, so the visible ones are drawn as ranges of the same index buffer
+namespace meshlet_builder {
+  // distinct vertices and triangles of a meshlet at most, the sizes mesh shading hardware prefers
+  const std::size_t MAX_VERTICES = 64;
+  const std::size_t MAX_TRIANGLES = 124;
+  // a meshlet holding at least this fraction of MAX_TRIANGLES ends before a triangle turning away from its normals
+  // by more than 90 degrees, so that the cones of curved surfaces stay narrow enough to cull
+  const float CONE_SPLIT_FILL = 0.25f;
+  // new vertices a triangle may cost more than another one facing one unit of dot product further from the meshlet
+  const float CONE_WEIGHT = 2.0f;
+
+  // meshlets in index order covering all triangles, none crosses a submesh or level of detail boundary;
+  // each grows from the first remaining triangle in index order over adjacent ones, so the locality mesh_optimizer
+  // established stays, and the triangles of every submesh are reordered to form the runs, inside a meshlet
+  // in the vertex cache order of mesh_optimizer;
+  // reads float or quantized positions and narrowed indices
+  // throws std::invalid_argument for max_vertices below 3, max_triangles of 0 or a model referring to a mapped file
+  std::vector<model::meshlet> build(model& mesh, std::size_t max_vertices = MAX_VERTICES,
+                                    std::size_t max_triangles = MAX_TRIANGLES);
+  // reorder the triangles and replace the meshlets of the model with the built ones
+  void generate_meshlets(model& mesh);
+}
+
+#endif
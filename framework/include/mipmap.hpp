@@ -0,0 +1,34 @@
+#ifndef MIPMAP_HPP
+#define MIPMAP_HPP
+
+#include "pixel_data.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace mipmap {
+  // how texels are averaged
+  enum class color_space {
+    // values are averaged as they are
+    linear,
+    // color channels are averaged in linear light, alpha as it is
+    srgb,
+    // rgb holds a unit vector that is renormalized after filtering
+    normal
+  };
+
+  enum class filter {
+    // average of the covered texels
+    box,
+    // kaiser windowed sinc, sharper than box without visible ringing
+    kaiser
+  };
+
+  // number of levels of a full chain down to 1x1
+  std::size_t level_count(std::size_t width, std::size_t height);
+  // levels 1 to n of a full chain for an 8 bit image, the base level is not included
+  // rows of each level are filtered in parallel on the shared thread pool
+  std::vector<pixel_data> generate(pixel_data const& base, color_space space = color_space::srgb, filter kind = filter::kaiser);
+}
+
+#endif
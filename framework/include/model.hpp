@@ -1,9 +1,15 @@
 #ifndef MODEL_HPP
 #define MODEL_HPP
 
+#include "mapped_file.hpp"
+
+#include <glbinding/gl/boolean.h>
 #include <glbinding/gl/types.h>
+// use floats and med precision operations
+#include <glm/gtc/type_precision.hpp>
 
 #include <map>
+#include <memory>
 #include <vector>
 // use gl definitions from glbinding 
 using namespace gl;
@@ -16,13 +22,17 @@ struct model {
   // type holding info about a vertex/model attribute
   struct attribute {
 
-    attribute(attrib_flag_t f, GLsizei s, GLsizei c, GLenum t)
+    attribute(attrib_flag_t f, GLsizei s, GLsizei c, GLenum t, bool n = false)
      :flag{f}
      ,size{s}
      ,components{c}
      ,type{t}
+     ,normalized{n}
     {}
 
+    // bytes in a vertex, packed types hold all components in one value
+    GLsizei bytes() const;
+
     // conversion to flag type for use as enum
     operator attrib_flag_t const&() const{
       return flag;
@@ -30,12 +40,15 @@ struct model {
 
     // ugly enum to use as flag, must be unique power of two
     attrib_flag_t flag;
-    // size in bytes
+    // size in bytes of a component or of the packed value
     GLsizei size;
     // number of scalar components
     GLint components;
     // Gl type
     GLenum type;
+    // integer components are mapped to [0, 1] or [-1, 1]
+    // kept as bool since copying glbinding's GLboolean is deprecated
+    bool normalized;
     // offset from element beginning
     GLvoid* offset;
   };
@@ -50,17 +63,90 @@ struct model {
   static attribute const& BITANGENT;
   // is not a vertex attribute, so not stored in VERTEX_ATTRIBS
   static attribute const  INDEX;
+
+  // range of indices drawn together, e.g. an object or material group of the source file
+  struct submesh {
+    std::size_t first_index;
+    std::size_t index_count;
+    // added to the indices when drawing, lets 16 bit indices address more than 65536 vertices
+    std::size_t base_vertex;
+  };
+
+  // index range of a level of detail, drawn by the submeshes inside it
+  struct lod {
+    std::size_t first_index;
+    std::size_t index_count;
+    // largest distance to the full detail surface relative to the bounding sphere radius
+    float error;
+  };
+
+  // run of consecutive triangles inside one submesh culled as a whole, see meshlet_builder
+  struct meshlet {
+    std::size_t first_index;
+    std::size_t index_count;
+    // center (xyz) and radius (w) of a sphere around its vertices in model space
+    glm::fvec4 sphere;
+    // axis (xyz) and cutoff (w) of the cone around its triangle normals, all triangles face away from a camera
+    // at p if dot(center - p, axis) >= cutoff * length(center - p) + radius, a cutoff of 1 never culls
+    glm::fvec4 cone;
+  };
   
   model();
   model(std::vector<GLfloat> const& databuff, attrib_flag_t attribs, std::vector<GLuint> const& trianglebuff = std::vector<GLuint>{});
+  // takes over the buffers without copying them
+  model(std::vector<GLfloat>&& databuff, attrib_flag_t attribs, std::vector<GLuint>&& trianglebuff);
+  // vertices with the given attribute formats in their order, packed formats are stored bitwise in the floats
+  model(std::vector<GLfloat>&& databuff, std::vector<attribute> const& attribs, std::vector<GLuint>&& trianglebuff);
+  // refers to vertices and indices inside a mapped file, which stays mapped as long as a copy of the model exists,
+  // without indices these are expected in the indices vector
+  model(std::shared_ptr<mapped_file const> const& file, GLvoid const* vertices, std::size_t vertex_count,
+        GLvoid const* indices, std::size_t index_count, GLenum index_type, std::vector<attribute> const& attribs);
 
+  // vertices and indices in the vectors or in the mapped file, pass them straight to glBufferData
+  GLvoid const* vertex_data() const;
+  std::size_t vertex_data_bytes() const;
+  GLvoid const* index_data() const;
+  std::size_t index_data_bytes() const;
+  std::size_t index_count() const;
+  // stored value of an index, without the base vertex of its submesh
+  GLuint index(std::size_t i) const;
+  // vertex of every index with the base vertices applied, e.g. for analysis
+  std::vector<GLuint> vertex_indices() const;
+
+  // empty if the model refers to a mapped file
   std::vector<GLfloat> data;
+  // GL_UNSIGNED_SHORT indices are stored in pairs
   std::vector<GLuint> indices;
+  // GL_UNSIGNED_INT unless narrowed by index_codec
+  GLenum index_type;
   // byte offsets of individual element attributes
   std::map<attrib_flag_t, GLvoid*> offsets;
+  // format of the contained attributes, the float ones of VERTEX_ATTRIBS unless quantized
+  std::map<attrib_flag_t, attribute> formats;
   // size of one vertex element in bytes
   GLsizei vertex_bytes;
   std::size_t vertex_num;
+  std::size_t index_num;
+  // empty if the whole index range is one part
+  std::vector<submesh> submeshes;
+  // full detail first, then coarser levels behind its indices, empty without levels of detail
+  std::vector<lod> lods;
+  // in index order covering all indices, empty unless generated
+  std::vector<meshlet> meshlets;
+  // axis aligned box around all positions
+  glm::fvec3 bounds_min;
+  glm::fvec3 bounds_max;
+  // stored positions times scale plus offset give the model space positions, not identity for quantized positions
+  glm::fvec3 position_offset;
+  glm::fvec3 position_scale;
+  // same for texture coordinates
+  glm::fvec2 texcoord_offset;
+  glm::fvec2 texcoord_scale;
+
+  // mapping holding the data of a model loaded from a cache file
+  std::shared_ptr<mapped_file const> file;
+  GLvoid const* file_vertices;
+  GLvoid const* file_indices;
 };
 
 #endif
\ No newline at end of file
@@ -1,14 +1,54 @@
 #ifndef MODEL_LOADER_HPP
 #define MODEL_LOADER_HPP
 
+#include "index_codec.hpp"
 #include "model.hpp"
+#include "vertex_quantizer.hpp"
 
-#include "tiny_obj_loader.h"
+#include <string>
 
 namespace model_loader {
 
-model obj(std::string const& path, model::attrib_flag_t import_attribs = model::POSITION);
+// settings of the normals generated for files without them
+struct normal_options {
+  normal_options(float crease = 180.0f, bool angle = false)
+   :crease_angle{crease}
+   ,angle_weighted{angle}
+  {}
+
+  // faces meeting at a larger angle in degrees keep separate normals at their shared vertices, 180 smooths all edges
+  float crease_angle;
+  // weigh the face normals by their angle at the vertex instead of their area, independent of the tessellation
+  // but slower to gather
+  bool angle_weighted;
+};
+
+// load a wavefront obj file through its mesh cache (path + ".mesh"), the model refers to the mapped cache
+// which is written on the first load and whenever the file, the imported attributes, the packed formats,
+// the index codec or the levels of detail change; up to lod_levels coarser levels of detail are generated by
+// mesh_simplifier, triangles and vertices are reordered by mesh_optimizer, the attributes quantized
+// to the packed formats within their tolerances by vertex_quantizer, the indices narrowed by index_codec and
+// the triangles split into meshlets by meshlet_builder before writing, compressed indices trade the mapping
+// of the indices for a smaller file
+// throws std::runtime_error if the file can not be read or contains invalid elements
+model obj(std::string const& path, model::attrib_flag_t import_attribs = model::POSITION,
+          vertex_quantizer::format_flag_t packed_formats = 0, std::uint32_t codec = index_codec::NONE,
+          normal_options const& normals = normal_options{}, std::size_t lod_levels = 0);
+
+// load the triangles of all objects in a wavefront obj file, polygons are split into fans
+// the file is mapped and parsed in line-aligned chunks on the shared thread pool,
+// corners are merged into one vertex if they share all imported attributes
+// tangents are generated from normals and texture coordinates in the MikkTSpace convention with the handedness in w,
+// vertices shared by mirrored and unmirrored triangles are split
+// objects, groups and material changes become submeshes
+model parse_obj(std::string const& path, model::attrib_flag_t import_attribs = model::POSITION,
+                normal_options const& normals = normal_options{});
+
+// replace the normals of a parsed model, gathered per vertex from the adjacent faces in parallel,
+// vertices at creases are split; area weighted normals without creases are scattered when the pool has one thread
+// throws std::invalid_argument for a model referring to a mapped file, without float normals or with narrowed indices
+void generate_normals(model& mesh, normal_options const& normals = normal_options{});
 
 }
 
-#endif
\ No newline at end of file
+#endif
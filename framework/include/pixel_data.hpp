@@ -1,15 +1,17 @@
 #ifndef PIXEL_DATA_HPP
 #define PIXEL_DATA_HPP
 
-#include <vector>
+#include "image_buffer.hpp"
+
 #include <cstdint>
+#include <utility>
 
 // #include <glbinding/gl/types.h>
 #include <glbinding/gl/enum.h>
 // use gl definitions from glbinding 
 using namespace gl;
 
-// holds texture data and format information
+// holds texture data and format information, move-only like its buffer
 struct pixel_data {
   pixel_data()
    :pixels()
@@ -20,8 +22,8 @@ struct pixel_data {
    ,channel_type{GL_NONE}
   {}
 
-  pixel_data(std::vector<std::uint8_t> dat, GLenum c, GLenum ty, std::size_t w, std::size_t h = 1, std::size_t d = 1)
-   :pixels(dat)
+  pixel_data(image_buffer dat, GLenum c, GLenum ty, std::size_t w, std::size_t h = 1, std::size_t d = 1)
+   :pixels(std::move(dat))
    ,width{w}
    ,height{h}
    ,depth{d}
@@ -33,7 +35,7 @@ struct pixel_data {
     return pixels.data();
   }
 
-  std::vector<std::uint8_t> pixels;
+  image_buffer pixels;
   std::size_t width;
   std::size_t height;
   std::size_t depth;
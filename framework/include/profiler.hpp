@@ -0,0 +1,46 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <iosfwd>
+#include <string>
+
+// cpu and gpu timings of named frame sections
+// gpu timings use double buffered GL_TIME_ELAPSED queries, so results arrive two frames late without stalling
+namespace profiler {
+  // measures the lifetime of the object, names must be string literals
+  class scope {
+   public:
+    // gpu passes must not be nested, an inner gpu scope is only timed on the cpu
+    explicit scope(const char* name, bool gpu = false);
+    ~scope();
+
+    scope(scope const&) = delete;
+    scope& operator=(scope const&) = delete;
+
+   private:
+    const char* name_;
+    long long begin_us_;
+    bool gpu_;
+  };
+
+  // read cmdline options --profile and --trace=, --trace-frames=
+  // requires a current context to check for timer query support
+  void initialize(int argc, char* argv[]);
+  bool enabled();
+  // collect finished gpu queries and start recording a new frame
+  void begin_frame();
+  void end_frame();
+  // gpu time of the passes in the last frame with complete results, negative when unknown
+  double last_gpu_frame_ms();
+  // add to a named counter of the frame, e.g. culled triangles, names must be string literals
+  void count(const char* name, double value);
+
+  // print mean cpu and gpu time per frame of each section and the mean of each counter since the last summary
+  void print_summary(std::ostream& os);
+  // write the recorded events as chrome trace json, can be opened in chrome://tracing or perfetto
+  void write_trace(std::string const& path);
+  // write the trace if requested and free the queries
+  void shutdown();
+}
+
+#endif
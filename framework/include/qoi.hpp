@@ -0,0 +1,35 @@
+#ifndef QOI_HPP
+#define QOI_HPP
+
+#include "pixel_data.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// lossless rgb(a) images in the qoi format (https://qoiformat.org), decoding needs a fraction of the time of png
+// the image is cut into bands of rows which never refer to pixels of an earlier band, a table of the band offsets
+// after the end marker lets encoder and decoder work on all bands in parallel, other qoi decoders ignore it;
+// the ops of a band depend on each other, so simd only fills runs and the bands carry the parallelism,
+// images are decoded into memory since textures reach the gpu from the texture cache holding their mip chain
+namespace qoi {
+  struct info {
+    std::size_t width;
+    std::size_t height;
+    // 3 or 4
+    std::size_t channels;
+    // true if all channels are linear, false for srgb color with linear alpha
+    bool linear;
+  };
+
+  // read the header, throws std::runtime_error if the data is no qoi image
+  info read_info(std::uint8_t const* data, std::size_t size);
+  // decoded image with rows bottom-up as opengl expects, flipped while decoding;
+  // throws std::runtime_error on damaged data
+  pixel_data decode(std::uint8_t const* data, std::size_t size);
+
+  // encode an rgb or rgba image with rows bottom-up as loaded for opengl, bands are encoded on the shared thread pool
+  std::vector<std::uint8_t> encode(pixel_data const& image, bool linear);
+}
+
+#endif
@@ -3,15 +3,16 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <glbinding/gl/enum.h>
 using namespace gl;
 
 namespace shader_loader {
-  // compile shader
-  unsigned shader(std::string const& file_path, GLenum shader_type);
+  // compile shader, the defines are inserted after the version directive to select a variant
+  unsigned shader(std::string const& file_path, GLenum shader_type, std::vector<std::string> const& defines = {});
   // create program from given list of stages
-  unsigned program(std::map<GLenum, std::string> const&);
+  unsigned program(std::map<GLenum, std::string> const&, std::vector<std::string> const& defines = {});
 }
 
 #endif
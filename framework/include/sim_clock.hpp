@@ -0,0 +1,21 @@
+#ifndef SIM_CLOCK_HPP
+#define SIM_CLOCK_HPP
+
+// simulation time used for animation and physics,
+// follows the wall clock or advances in fixed steps for reproducible runs
+namespace sim_clock {
+  // advance by the wall time passed since the last tick
+  void tick();
+  // advance by a fixed step in seconds, makes the clock deterministic
+  void step(double seconds);
+  // simulated seconds since start
+  double time();
+  // seconds advanced by the last tick or step
+  double delta();
+  // true once the clock is advanced in fixed steps
+  bool is_fixed_step();
+  // switch to fixed steps before anything reads the clock
+  void set_fixed_step(bool fixed);
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SKYBOX_HPP
+#define SKYBOX_HPP
+
+#include "structs.hpp"
+
+#include <glm/mat4x4.hpp>
+
+#include <cstddef>
+#include <string>
+
+class texture_streamer;
+
+// cube map sky uploaded at the resolution the viewport can show, finer cached levels are left on disk
+namespace skybox {
+  struct settings {
+    settings();
+    // texels per face side, 0 picks it from the viewport height and the field of view
+    std::size_t face_size;
+    // halves the face size, for small gpus
+    bool half_resolution;
+    // block compress the faces if the driver supports it
+    bool compress;
+  };
+
+  // read cmdline options --skybox-size=<px>, --skybox-half, --skybox-compress=on|off
+  void read_settings(int argc, char* argv[]);
+  settings& default_settings();
+
+  // texels per face side needed for one texel per pixel in the center of the viewport
+  std::size_t face_size(unsigned viewport_height, glm::fmat4 const& projection);
+  // start loading a cube map with the side image on +x, -x, +z and the cap image on +y, -y, -z,
+  // each image is loaded once and uploaded at the smallest prefiltered mip level of at least the face size
+  void load(texture_streamer& streamer, texture_object& texture, std::string const& side, std::string const& cap,
+            std::size_t face_size);
+}
+
+#endif
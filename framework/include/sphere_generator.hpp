@@ -0,0 +1,39 @@
+#ifndef SPHERE_GENERATOR_HPP
+#define SPHERE_GENERATOR_HPP
+
+#include "model.hpp"
+
+#include <cstddef>
+
+// builds unit spheres around the origin at any tessellation without reading a file, with normals, tangents and
+// equirectangular texture coordinates, u following the longitude from +z towards +x and v the latitude from the south
+// pole; vertices on the seam at u = 0 are repeated at u = 1 and every pole triangle gets its own pole vertex at the
+// longitude of its other corners, so textures neither smear across the seam nor twist at the poles;
+// the indices are narrowed to 16 bits by index_codec
+namespace sphere_generator {
+  // coarsest spheres generated as level of detail
+  const std::size_t MIN_SLICES = 4;
+  const std::size_t MIN_STACKS = 2;
+  // finest icosphere, 20 * 4^10 triangles
+  const std::size_t MAX_SUBDIVISIONS = 10;
+
+  // sphere of slices meridians and stacks parallels, with 2 * slices * (stacks - 1) triangles
+  // the attributes may contain NORMAL, TEXCOORD, TANGENT and BITANGENT, positions are always generated
+  // throws std::invalid_argument for fewer than 3 slices or 2 stacks
+  model uv_sphere(std::size_t slices, std::size_t stacks, model::attrib_flag_t attributes = model::POSITION);
+  // icosahedron with each triangle subdivided into 4 subdivisions times, evenly spaced vertices without
+  // the crowding of the uv sphere at the poles
+  // throws std::invalid_argument for more than MAX_SUBDIVISIONS
+  model ico_sphere(std::size_t subdivisions, model::attrib_flag_t attributes = model::POSITION);
+
+  // the sphere followed by up to levels coarser ones in one model, each with half the slices and stacks or one
+  // subdivision less, as levels of detail in the layout mesh_simplifier produces: every level is a submesh of its own
+  // and the lods list them with the error of their surface relative to the full detail, the levels have vertices
+  // of their own
+  // throws std::invalid_argument like uv_sphere and ico_sphere
+  model uv_sphere_lods(std::size_t slices, std::size_t stacks, std::size_t levels,
+                       model::attrib_flag_t attributes = model::POSITION);
+  model ico_sphere_lods(std::size_t subdivisions, std::size_t levels, model::attrib_flag_t attributes = model::POSITION);
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef STAR_CATALOG_HPP
+#define STAR_CATALOG_HPP
+
+#include "mapped_file.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace star_catalog {
+  // packed star as stored in the binary cache and the vertex buffer
+  struct star {
+    // octahedral encoded unit direction, normalized unsigned shorts
+    std::uint16_t direction[2];
+    // linear rgb color
+    std::uint8_t color[3];
+    // quantized apparent magnitude, 0 is the brightest star in the catalog
+    std::uint8_t magnitude;
+  };
+
+  // layout of the binary cache file, followed by the cell offsets and the stars
+  struct cache_header {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t star_count;
+    // number of cells along each axis of the octahedral map
+    std::uint32_t grid_resolution;
+    // magnitude range covered by the quantized values
+    float magnitude_min;
+    float magnitude_max;
+    // source file properties for invalidation
+    std::uint64_t source_size;
+    std::int64_t source_time;
+  };
+
+  // star catalog in binary cache format, backed by a memory mapping
+  class catalog {
+   public:
+    catalog();
+    explicit catalog(mapped_file&& file);
+
+    bool empty() const;
+    std::size_t size() const;
+    // stars sorted by cell and by brightness inside each cell
+    star const* stars() const;
+    std::size_t byte_size() const;
+
+    std::size_t cell_count() const;
+    // index of the first star in the cell
+    std::uint32_t cell_begin(std::size_t cell) const;
+    // number of stars in the cell that are at least as bright as the magnitude
+    std::uint32_t count_brighter(std::size_t cell, float magnitude) const;
+
+    float magnitude_min() const;
+    float magnitude_max() const;
+
+   private:
+    mapped_file file_;
+    cache_header const* header_;
+    std::uint32_t const* cells_;
+    star const* stars_;
+  };
+
+  // map the binary cache of the csv file, (re)building it when missing or outdated
+  // returns an empty catalog when neither the csv nor a cache exists
+  catalog load(std::string const& csv_path);
+  // parse the csv file and write the binary cache
+  void build_cache(std::string const& csv_path, std::string const& cache_path);
+  // path of the binary cache belonging to a csv file
+  std::string cache_path(std::string const& csv_path);
+
+  // adapts the magnitude cutoff to a frame time budget
+  class magnitude_limiter {
+   public:
+    magnitude_limiter();
+
+    void set_range(float magnitude_min, float magnitude_max);
+    void set_budget(float frame_ms);
+    // feed the duration of the last frame, returns the new cutoff
+    float update(float frame_ms);
+    float limit() const;
+
+   private:
+    float min_;
+    float max_;
+    float limit_;
+    float budget_ms_;
+    float average_ms_;
+  };
+}
+
+#endif
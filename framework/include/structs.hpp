@@ -2,10 +2,28 @@
 #define STRUCTS_HPP
 
 #include <map>
+#include <vector>
 #include <glbinding/gl/gl.h>
+// use floats and med precision operations
+#include <glm/gtc/type_precision.hpp>
 // Use gl definitions from glbinding 
 using namespace gl;
 
+// Visible clusters of a model_object as drawn for one object in a frame, filled by a cluster_culler
+struct cluster_draw {
+  // Merged index counts, EBO byte offsets and base vertices of the visible clusters
+  std::vector<GLsizei> counts{};
+  std::vector<GLvoid const*> offsets{};
+  std::vector<GLint> base_vertices{};
+  // Or indirect draw commands written by the culling compute shader, the visible ones compacted to the front
+  // and the remaining ones drawing nothing
+  GLuint indirect_BO = 0;
+  GLintptr indirect_offset = 0;
+  GLsizei indirect_count = 0;
+  // Replaces the level of detail draw of the object, also if no cluster is visible
+  bool active = false;
+};
+
 // GPU representation of model
 struct model_object {
   // Vertex array object
@@ -18,6 +36,58 @@ struct model_object {
   GLenum draw_mode = GL_NONE;
   // Indices number, if EBO exists
   GLsizei num_elements = 0;
+  // Type of the indices in the EBO
+  GLenum index_type = GL_UNSIGNED_INT;
+  // Index counts, EBO byte offsets and base vertices of the parts drawn with their own base vertex,
+  // empty if all indices are drawn at once
+  std::vector<GLsizei> range_counts{};
+  std::vector<GLvoid const*> range_offsets{};
+  std::vector<GLint> range_base_vertices{};
+  // Maps the stored vertex positions to model space, scales and offsets quantized positions
+  glm::fmat4 position_transform{};
+  // Offset (xy) and scale (zw) of quantized texture coordinates
+  glm::fvec4 texcoord_transform{0.0f, 0.0f, 1.0f, 1.0f};
+  // Center (xyz) and radius (w) of a sphere around the model in model space
+  glm::fvec4 bounding_sphere{0.0f, 0.0f, 0.0f, 1.0f};
+
+  // Index range of a level of detail, or its parts if these have their own base vertex
+  struct level_of_detail {
+    GLsizei num_elements;
+    GLvoid const* offset;
+    std::size_t first_range;
+    std::size_t range_count;
+    // Clusters inside its index range
+    std::size_t first_cluster;
+    std::size_t cluster_count;
+    // Distance to the full detail surface relative to the bounding sphere radius
+    float error;
+  };
+  // Full detail first, empty without levels of detail
+  std::vector<level_of_detail> levels{};
+
+  // Index range, base vertex and bounds of a meshlet, culled as a whole
+  struct cluster {
+    GLsizei num_elements;
+    GLvoid const* offset;
+    GLint base_vertex;
+    // Center (xyz) and radius (w) of its bounding sphere, axis (xyz) and cutoff (w) of its normal cone in model space
+    glm::fvec4 sphere;
+    glm::fvec4 cone;
+  };
+  // Meshlets in index order, empty without meshlets
+  std::vector<cluster> clusters{};
+  // Clusters for the culling compute shader, 0 if culled on the CPU
+  GLuint cluster_BO = 0;
+
+  // Draw the indices of the bound VAO, the coarsest level if the level does not exist
+  void draw_elements(std::size_t level = 0) const;
+  // Draw the visible clusters of the bound VAO
+  void draw_clusters(cluster_draw const& draw) const;
+  // Clusters of a level, all of them without levels of detail
+  void cluster_range(std::size_t level, std::size_t& first, std::size_t& count) const;
+  // Coarsest level whose error covers at most pixel_error pixels at the projected radius of the bounding sphere,
+  // a level coarser than the current one has to stay below a smaller error so that levels do not alternate
+  std::size_t select_level(float screen_radius, std::size_t current, float pixel_error = 1.0f) const;
 };
 
 // GPU representation of texture
@@ -30,13 +100,16 @@ struct texture_object {
 
 // Shader handle and uniform storage
 struct shader_program {
-  shader_program(std::map<GLenum, std::string> paths)
+  shader_program(std::map<GLenum, std::string> paths, std::vector<std::string> symbols = {})
    :shader_paths{paths}
+   ,defines{symbols}
    ,handle{0}
    {}
 
   // Paths to shader sources
   std::map<GLenum, std::string> shader_paths;
+  // Preprocessor symbols defined in every stage, select a variant of the sources
+  std::vector<std::string> defines;
   // Object handle
   GLuint handle;
   // Uniform locations mapped to name
@@ -0,0 +1,118 @@
+#ifndef TEXTURE_CACHE_HPP
+#define TEXTURE_CACHE_HPP
+
+#include "block_compression.hpp"
+#include "image_buffer.hpp"
+#include "mapped_file.hpp"
+#include "mipmap.hpp"
+
+#include <glbinding/gl/types.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// gpu ready textures with full mip chain, cached next to the source image
+namespace texture_cache {
+  // layout of the cache file, followed by the level table and the texel data of all levels
+  struct cache_header {
+    char magic[4];
+    std::uint32_t version;
+    // source file content for invalidation
+    std::uint64_t source_hash;
+    std::uint64_t source_size;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t level_count;
+    // gl enums describing the texel data
+    std::uint32_t internal_format;
+    std::uint32_t format;
+    std::uint32_t type;
+    // nonzero if the levels are block compressed and uploaded with glCompressedTexSubImage2D
+    std::uint32_t compressed;
+    // mipmap::color_space the levels were filtered in
+    std::uint32_t color_space;
+  };
+
+  struct level_info {
+    std::uint32_t width;
+    std::uint32_t height;
+    // byte range in the file
+    std::uint64_t offset;
+    std::uint64_t size;
+  };
+
+  // cache file contents before writing, the levels stay in the buffers they were created in
+  struct contents {
+    cache_header header;
+    std::vector<level_info> levels;
+    std::vector<pixel_data> mips;
+  };
+
+  // cached texture, backed by a file mapping or by memory when the cache could not be written
+  class image {
+   public:
+    image();
+    // throws std::runtime_error if the data is no valid cache
+    explicit image(image_buffer&& buffer);
+    explicit image(mapped_file&& file);
+    explicit image(std::vector<std::uint8_t>&& memory);
+
+    bool empty() const;
+    cache_header const& header() const;
+    std::size_t level_count() const;
+    level_info const& level(std::size_t index) const;
+    std::uint8_t const* level_data(std::size_t index) const;
+
+    // the levels are stored back to back, starting with the base level
+    std::uint8_t const* data() const;
+    std::size_t data_size() const;
+
+   private:
+    void attach(std::uint8_t const* bytes, std::size_t size);
+
+    image_buffer buffer_;
+    cache_header const* header_;
+    level_info const* levels_;
+    std::uint8_t const* bytes_;
+    std::size_t size_;
+  };
+
+  // channel of a source image stored in a packed texture
+  struct packed_channel {
+    // empty to fill the channel with zero
+    std::string file_name;
+    // the source is filtered in this space before packing
+    mipmap::color_space space;
+    // channel of the right-sized source, see texture_loader::file_mipmapped
+    std::size_t channel;
+  };
+
+  // map the cache of an image file, (re)building it when missing, when the source content changed
+  // or when it was built with another color space or compression setting
+  image load(std::string const& file_name, mipmap::color_space space, bool compress);
+  // map the cache of a texture combining channels of several image files, cached at cache_path(name)
+  image load_packed(std::string const& name, std::vector<packed_channel> const& channels, bool compress);
+  // write the levels straight from their buffers and map the written file,
+  // the parts are only joined in memory if the file can not be written
+  image store(std::string const& cached, contents&& built);
+
+  // decode the image file and return the cache file contents, levels are right-sized
+  // compressed levels use bc4 for one, bc5 for two, bc1 for three and bc1 or bc3 for four channels
+  contents build(std::string const& file_name, mipmap::color_space space, bool compress,
+                 std::uint64_t source_hash, std::uint64_t source_size);
+  // pack the channels of all levels, compressed with bc3 if there are four channels
+  contents build_packed(std::vector<packed_channel> const& channels, bool compress,
+                        std::uint64_t source_hash, std::uint64_t source_size);
+  // header and level table for the levels, which are replaced by their blocks if compress is set
+  contents assemble(std::vector<pixel_data>&& mips, bool compress, block_compression::format block_format,
+                    std::uint32_t space, std::uint64_t source_hash, std::uint64_t source_size);
+  // path of the cache belonging to an image file
+  std::string cache_path(std::string const& file_name);
+  // 64 bit content hash
+  std::uint64_t hash(std::uint8_t const* data, std::size_t size);
+}
+
+#endif
@@ -2,11 +2,36 @@
 #define TEXTURE_LOADER_HPP
 
 #include "pixel_data.hpp"
+#include "mipmap.hpp"
 
 #include <string>
+#include <vector>
 
 namespace texture_loader {
+  // image with the channels stored in the file, GL_RED, GL_RG (grey alpha), GL_RGB or GL_RGBA,
+  // the decoder is chosen by the extension: .qoi by the qoi decoder, everything else by stb_image
   pixel_data file(std::string const& file_name);
+  // image with a full mip chain, base level first, stored with the channels the color space needs:
+  // color maps have at least rgb, grey data maps are reduced to red and normal maps to rg, z is left to the shader
+  std::vector<pixel_data> file_mipmapped(std::string const& file_name, mipmap::color_space space);
+
+  std::size_t channel_count(GLenum channels);
+  GLenum channel_format(std::size_t count);
+  // 8 bit internal format of the channel count, GL_R8 to GL_RGBA8
+  GLenum sized_format(std::size_t count);
+  // convert to another channel format, grey is replicated to rgb and missing alpha is opaque,
+  // the image is passed on unchanged if it already has the format
+  pixel_data convert(pixel_data image, GLenum channels);
+  // true if rgb is equal and alpha opaque in all texels
+  bool is_grey(pixel_data const& image);
+
+  // channel of an image copied into a packed image, no image fills the channel with zero
+  struct channel_source {
+    pixel_data const* image;
+    std::size_t channel;
+  };
+  // interleave channels of equally sized images, one output channel per source
+  pixel_data pack(std::vector<channel_source> const& sources);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef TEXTURE_RESIDENCY_HPP
+#define TEXTURE_RESIDENCY_HPP
+
+#include "structs.hpp"
+#include "texture_cache.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// keeps the mip levels of 2d textures resident that their size on screen needs,
+// detail of the least recently used textures is dropped first when the memory budget is exceeded
+class texture_residency {
+ public:
+  struct settings {
+    settings();
+    // bytes all managed textures may use, 0 for no limit
+    std::size_t budget;
+    // textures getting finer levels per update
+    unsigned loads_per_update;
+    // bytes uploaded per update, 0 for no limit; larger loads are split into steps of fewer levels,
+    // one level of one texture is loaded per update even if it exceeds the limit
+    std::size_t upload_bytes;
+    // levels up to this size are always resident
+    std::size_t min_size;
+    // updates a texture keeps detail it no longer needs, avoids reloading when the size oscillates
+    unsigned evict_delay;
+  };
+
+  // read cmdline options --texture-budget=<MB>, --texture-loads=<n>, --texture-upload=<MB> as defaults for instances created afterwards
+  static void read_settings(int argc, char* argv[]);
+  static settings& default_settings();
+
+  texture_residency();
+  explicit texture_residency(settings const& config);
+  ~texture_residency();
+
+  texture_residency(texture_residency const&) = delete;
+  texture_residency& operator=(texture_residency const&) = delete;
+
+  // manage a 2d texture, only the levels up to the minimum size are uploaded until it is requested
+  // the texture handle changes whenever levels are loaded or evicted
+  void add(texture_object& texture, std::shared_ptr<texture_cache::image> const& image);
+  bool contains(texture_object const& texture) const;
+  // the texture covers this many pixels across its full width on screen, call every frame it is needed
+  void request(texture_object const& texture, float screen_pixels);
+  // apply the requests since the last update: choose levels, fit the budget and reallocate changed textures
+  void update();
+
+  std::size_t resident_bytes() const;
+  settings const& get_settings() const;
+
+ private:
+  struct entry {
+    texture_object* texture;
+    std::shared_ptr<texture_cache::image> image;
+    // finest resident level
+    std::size_t resident;
+    // finest level requested since the last update, level count if not requested
+    std::size_t wanted;
+    // update the texture was last requested in
+    std::size_t last_used;
+    // update the resident detail was last needed in
+    std::size_t last_needed;
+  };
+
+  // bytes of the level and all coarser ones
+  std::size_t bytes(entry const& e, std::size_t level) const;
+  // finest level that is always resident
+  std::size_t base_level(entry const& e) const;
+  // replace the texture by one holding the level and all coarser ones
+  void allocate(entry& e, std::size_t level);
+
+  settings settings_;
+  std::vector<entry> entries_;
+  std::size_t update_;
+  std::size_t resident_bytes_;
+  bool has_texture_storage_;
+};
+
+#endif
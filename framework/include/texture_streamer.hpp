@@ -0,0 +1,84 @@
+#ifndef TEXTURE_STREAMER_HPP
+#define TEXTURE_STREAMER_HPP
+
+#include "structs.hpp"
+#include "texture_cache.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+class texture_residency;
+class thread_pool;
+
+// loads cached textures with mip chains on a thread pool and streams them into textures through a ring of pixel buffers
+class texture_streamer {
+ public:
+  explicit texture_streamer(thread_pool& pool, std::size_t ring_size = 3);
+  ~texture_streamer();
+
+  texture_streamer(texture_streamer const&) = delete;
+  texture_streamer& operator=(texture_streamer const&) = delete;
+
+  // start loading the file for the image of a 2d texture or a cube map face,
+  // the texture object is created if its handle is 0, a file used several times is loaded once
+  // missing or outdated caches are built from the image file, mips are filtered in the given color space
+  // the smallest level with at least detail_size texels per side becomes the base level, 0 keeps the full resolution
+  void load(texture_object& texture, GLenum image_target, std::string const& file_name,
+            mipmap::color_space space = mipmap::color_space::srgb, std::size_t detail_size = 0);
+  // start loading a 2d texture packed from channels of several files, name identifies its cache
+  void load_packed(texture_object& texture, std::string const& name, std::vector<texture_cache::packed_channel> const& channels);
+  // upload images in the order their loading finishes, returns once all uploads are submitted
+  void flush();
+
+  // block compress textures loaded afterwards, enabled by default if the driver supports s3tc
+  void set_compression(bool enabled);
+  bool compression() const;
+  // hand 2d textures to the residency manager instead of uploading all levels, nullptr to upload everything
+  void set_residency(texture_residency* residency);
+  // texel bytes of all textures uploaded so far, cube maps count every face
+  std::size_t texture_memory() const;
+
+ private:
+  struct destination {
+    texture_object* texture;
+    GLenum image_target;
+    std::size_t detail_size;
+  };
+
+  struct job {
+    std::string file_name;
+    std::future<texture_cache::image> image;
+    std::vector<destination> destinations;
+  };
+
+  // pixel buffer and the fence of the last upload reading from it
+  struct slot {
+    GLuint buffer;
+    std::size_t capacity;
+    GLsync fence;
+  };
+
+  void enqueue(texture_object& texture, GLenum image_target, std::string const& name, std::size_t detail_size,
+               std::function<texture_cache::image()> loader);
+  void upload(job& finished, texture_cache::image const& image);
+  // allocate the levels from first_level on once, cube map faces share the storage
+  void allocate(texture_object const& texture, texture_cache::image const& image, std::size_t first_level);
+
+  thread_pool& pool_;
+  std::vector<job> jobs_;
+  std::vector<slot> ring_;
+  std::size_t next_slot_;
+  bool has_texture_storage_;
+  // destinations sharing an image are copied on the gpu from the first one instead of uploaded again
+  bool has_copy_image_;
+  bool compress_;
+  texture_residency* residency_;
+  std::vector<GLuint> allocated_;
+  std::size_t texture_memory_;
+};
+
+#endif
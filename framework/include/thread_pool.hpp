@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// fixed set of worker threads executing queued tasks
+class thread_pool {
+ public:
+  // zero threads uses one per hardware thread
+  explicit thread_pool(std::size_t threads = 0);
+  // finishes queued tasks before joining
+  ~thread_pool();
+
+  thread_pool(thread_pool const&) = delete;
+  thread_pool& operator=(thread_pool const&) = delete;
+
+  std::size_t size() const;
+
+  // queue a task, exceptions are passed on through the future
+  template<typename F>
+  std::future<typename std::result_of<F()>::type> submit(F task);
+
+  // call body(chunk_begin, chunk_end) for chunks of at most grain indices and wait for all of them,
+  // the calling thread works on chunks too, so it may be used from inside a task
+  void parallel_for(std::size_t begin, std::size_t end, std::size_t grain,
+                    std::function<void(std::size_t, std::size_t)> const& body);
+
+  // pool shared by the loaders
+  static thread_pool& shared();
+
+ private:
+  void work();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_;
+};
+
+template<typename F>
+std::future<typename std::result_of<F()>::type> thread_pool::submit(F task) {
+  typedef typename std::result_of<F()>::type result_type;
+  // std::function needs a copyable callable
+  auto packaged = std::make_shared<std::packaged_task<result_type()>>(std::move(task));
+  std::future<result_type> result = packaged->get_future();
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    tasks_.push_back([packaged]() { (*packaged)(); });
+  }
+  condition_.notify_one();
+  return result;
+}
+
+#endif
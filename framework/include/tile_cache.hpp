@@ -0,0 +1,163 @@
+#ifndef TILE_CACHE_HPP
+#define TILE_CACHE_HPP
+
+#include "structs.hpp"
+#include "virtual_texture.hpp"
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+class thread_pool;
+
+// physical texture holding the resident tiles of virtual textures, the indirection texture of each virtual texture
+// points every tile to the finest resident tile covering it; a low resolution feedback pass tells which tiles are sampled,
+// they are read from the tiled files on the thread pool and uploaded in later updates, least recently seen tiles make room
+class tile_cache {
+ public:
+  struct settings {
+    settings();
+    // tiles per side of the physical texture, limited by the maximum texture size
+    unsigned cache_tiles;
+    // tiles uploaded per update, bounds the upload time per frame
+    unsigned uploads_per_update;
+    // the feedback pass renders at the viewport size divided by this
+    unsigned feedback_divisor;
+  };
+
+  // read cmdline options --vt-cache=<tiles>, --vt-uploads=<n> as defaults for instances created afterwards
+  static void read_settings(int argc, char* argv[]);
+  static settings& default_settings();
+
+  explicit tile_cache(thread_pool& pool);
+  tile_cache(thread_pool& pool, settings const& config);
+  ~tile_cache();
+
+  tile_cache(tile_cache const&) = delete;
+  tile_cache& operator=(tile_cache const&) = delete;
+
+  // map the tiled file of an image, built if missing or outdated, and upload its coarsest level which stays resident
+  // returns the id the feedback pass writes for the texture, all textures need the format of the first one
+  std::size_t add(std::string const& file_name, mipmap::color_space space, bool compress);
+  bool empty() const;
+
+  // viewport the feedback pass stands in for
+  void resize(unsigned width, unsigned height);
+  // bind the feedback framebuffer, the scene is drawn with the feedback shader afterwards
+  void begin_feedback();
+  // restore the previous framebuffer and start reading the feedback back without waiting for it
+  void end_feedback();
+  // offset of the feedback projection in normalized device coordinates, cycles through the viewport pixels
+  // a feedback texel covers so that small tiles are found over a few passes
+  glm::vec2 feedback_jitter() const;
+
+  // analyse the feedback that arrived, upload loaded tiles and start loading the missing ones
+  void update();
+
+  // bind the indirection and physical texture to the units and set the sampling uniforms of the shader
+  void bind(std::size_t id, shader_program const& shader, GLint indirection_unit, GLint physical_unit) const;
+  // set the uniforms of the feedback shader
+  void bind_feedback(std::size_t id, shader_program const& shader) const;
+
+  std::size_t resident_tiles() const;
+  std::size_t capacity() const;
+  // texel bytes of the physical and indirection textures
+  std::size_t texture_memory() const;
+
+ private:
+  struct texture_entry {
+    virtual_texture::tiled_image image;
+    GLuint indirection;
+    // cache slot of each tile, -1 if not resident
+    std::vector<std::int32_t> slots;
+    // feedback pass the tile or a finer one covered by it was last seen in
+    std::vector<std::uint32_t> last_seen;
+    // pass the tile was last requested in and its feedback texel count in that pass
+    std::vector<std::uint32_t> request_pass;
+    std::vector<std::uint32_t> hits;
+    std::vector<bool> loading;
+    // indirection needs to be rebuilt
+    bool dirty;
+  };
+
+  struct slot {
+    // texture id and tile index, texture 0 if free
+    std::size_t texture;
+    std::size_t tile;
+    // coarsest levels are never evicted
+    bool pinned;
+  };
+
+  struct request {
+    std::size_t texture;
+    std::size_t tile;
+    std::size_t level;
+    std::uint32_t hits;
+  };
+
+  struct load {
+    std::size_t texture;
+    std::size_t tile;
+    std::future<std::vector<std::uint8_t>> texels;
+  };
+
+  // pixel pack buffer the feedback is read into and the fence of the read
+  struct readback {
+    GLuint buffer;
+    GLsync fence;
+    unsigned width;
+    unsigned height;
+  };
+
+  texture_entry& entry(std::size_t id);
+  texture_entry const& entry(std::size_t id) const;
+  // create the physical texture in the format of the first tiled image
+  void allocate(virtual_texture::file_header const& header);
+  // (re)create the feedback framebuffer at the current feedback size
+  void allocate_feedback();
+  // collect the tiles of the mapped feedback and mark them and their coarser tiles as seen
+  std::vector<request> analyse(std::uint16_t const* texels, std::size_t count);
+  // free or least recently seen slot, -1 if every slot was seen in the last pass
+  std::int32_t find_slot() const;
+  void upload(std::size_t texture, std::size_t tile, std::int32_t slot_index, std::uint8_t const* texels);
+  // point every tile to its finest resident tile and upload all levels
+  void rebuild_indirection(texture_entry& texture);
+
+  thread_pool& pool_;
+  settings settings_;
+  std::vector<texture_entry> textures_;
+  std::vector<slot> slots_;
+  std::vector<load> loads_;
+
+  // physical texture
+  GLuint physical_;
+  GLenum internal_format_;
+  GLenum format_;
+  GLenum type_;
+  bool compressed_;
+  std::size_t padded_size_;
+  std::size_t tile_bytes_;
+  unsigned cache_tiles_;
+  bool has_texture_storage_;
+
+  // feedback pass
+  glm::uvec2 viewport_;
+  glm::uvec2 feedback_size_;
+  GLuint framebuffer_;
+  GLuint feedback_buffer_;
+  GLuint depth_buffer_;
+  std::vector<readback> readbacks_;
+  std::size_t next_readback_;
+  GLint previous_framebuffer_;
+  GLint previous_viewport_[4];
+  // feedback passes analysed so far
+  std::uint32_t pass_;
+  // feedback passes rendered so far, selects the jitter
+  std::uint32_t frame_;
+};
+
+#endif
@@ -8,6 +8,7 @@ using namespace gl;
 #include <glm/gtc/type_precision.hpp>
 
 #include <map>
+#include <string>
 #include <vector>
 
 struct pixel_data;
@@ -34,6 +35,14 @@ namespace utils {
   // return path to resources depending on cmdline args
   std::string read_resource_path(int argc, char* argv[]);
 
+  // return value of cmdline option given as "--name=value", fallback if not given
+  std::string read_option(int argc, char* argv[], std::string const& name, std::string const& fallback = "");
+  // check if cmdline option "--name" or "--name=value" is given
+  bool has_option(int argc, char* argv[], std::string const& name);
+
+  // highest resident memory of the process so far in bytes, 0 if unknown
+  std::size_t peak_memory();
+
   // calculate Vert+ FOV projection matrix
   glm::fmat4 calculate_projection_matrix(float aspect);
 }
@@ -0,0 +1,40 @@
+#ifndef VERTEX_QUANTIZER_HPP
+#define VERTEX_QUANTIZER_HPP
+
+#include "model.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// stores the attributes of a loaded model in normalized integer formats where the error stays within a tolerance,
+// roughly halving the bytes the gpu fetches per vertex; attributes exceeding their tolerance stay floats
+namespace vertex_quantizer {
+  // flag type to combine the formats the loader may choose
+  typedef std::uint32_t format_flag_t;
+  // positions as 16 bit unsigned normalized integers inside the bounds, the model transform has to apply
+  // position_offset and position_scale of the model
+  const format_flag_t PACKED_POSITION = 1 << 0;
+  // normals, tangents and bitangents as 10 bit signed normalized integers of GL_INT_2_10_10_10_REV,
+  // the handedness of tangents in the 2 bit w, needs gl 3.3 or ARB_vertex_type_2_10_10_10_rev
+  const format_flag_t PACKED_NORMAL = 1 << 1;
+  // texture coordinates as 16 bit unsigned normalized integers inside their range, the vertex shader has to apply
+  // texcoord_offset and texcoord_scale of the model
+  const format_flag_t PACKED_TEXCOORD = 1 << 2;
+  const format_flag_t PACKED_ALL = PACKED_POSITION | PACKED_NORMAL | PACKED_TEXCOORD;
+
+  // largest position error relative to the diagonal of the bounds
+  const float POSITION_TOLERANCE = 1.0e-4f;
+  // largest texture coordinate error, a quarter texel of a 4096 texture
+  const float TEXCOORD_TOLERANCE = 1.0f / 16384.0f;
+  // largest angle in degrees between an original and a packed direction
+  const float DIRECTION_TOLERANCE = 1.0f;
+
+  // formats of the model's attributes in their order, packed where allowed and within tolerance
+  // throws std::invalid_argument for a model referring to a mapped file or with attributes that are not floats
+  std::vector<model::attribute> choose_formats(model const& mesh, format_flag_t allowed);
+  // convert the vertices to the chosen formats, the model is returned unchanged if all attributes stay floats
+  // throws std::invalid_argument like choose_formats
+  model quantize(model&& mesh, format_flag_t allowed);
+}
+
+#endif
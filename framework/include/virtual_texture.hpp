@@ -0,0 +1,98 @@
+#ifndef VIRTUAL_TEXTURE_HPP
+#define VIRTUAL_TEXTURE_HPP
+
+#include "mapped_file.hpp"
+#include "mipmap.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// mip chain of a large texture split into tiles with borders, stored next to the source image
+// so that single tiles can be read from a file mapping when they are needed
+namespace virtual_texture {
+  // texels of a tile without its border, tiles at the right and bottom edge may be partially used
+  const std::size_t TILE_SIZE = 128;
+  // texels copied from the neighbours on each side for bilinear filtering, keeps tiles block aligned
+  const std::size_t TILE_BORDER = 4;
+
+  // layout of the tiled file, followed by the level table and the tiles of all levels
+  struct file_header {
+    char magic[4];
+    std::uint32_t version;
+    // source file content for invalidation
+    std::uint64_t source_hash;
+    std::uint64_t source_size;
+    // base level texels
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t level_count;
+    std::uint32_t tile_size;
+    std::uint32_t tile_border;
+    // gl enums describing the texel data
+    std::uint32_t internal_format;
+    std::uint32_t format;
+    std::uint32_t type;
+    // nonzero if the tiles are block compressed
+    std::uint32_t compressed;
+    // mipmap::color_space the levels were filtered in
+    std::uint32_t color_space;
+    // bytes of one tile and the distance between tiles in the file
+    std::uint64_t tile_bytes;
+    std::uint64_t tile_stride;
+    // file offset of the first tile, page aligned
+    std::uint64_t data_offset;
+  };
+
+  // tiles of a level are stored row by row
+  struct level_info {
+    // texels of the level, halved and rounded down per level like the mip chain
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t tiles_x;
+    std::uint32_t tiles_y;
+    // index of the first tile of the level across all levels
+    std::uint64_t first_tile;
+  };
+
+  // mapped tiled file, tiles are only paged in when they are read
+  class tiled_image {
+   public:
+    tiled_image();
+    // throws std::runtime_error if the file is no valid tiled image
+    explicit tiled_image(mapped_file&& file);
+
+    bool empty() const;
+    file_header const& header() const;
+    std::size_t level_count() const;
+    level_info const& level(std::size_t index) const;
+    std::size_t tile_count() const;
+    // texels per side of a tile including its borders
+    std::size_t padded_size() const;
+
+    // index of a tile across all levels
+    std::size_t tile_index(std::size_t level, std::size_t x, std::size_t y) const;
+    // level of a tile index
+    std::size_t tile_level(std::size_t index) const;
+    // index of the tile covering the center of this one in the next coarser level, the index itself for the coarsest level
+    std::size_t parent(std::size_t index) const;
+    std::uint8_t const* tile_data(std::size_t index) const;
+
+   private:
+    mapped_file file_;
+    file_header const* header_;
+    level_info const* levels_;
+  };
+
+  // map the tiled file of an image, (re)building it when missing, when the source content changed
+  // or when it was built with another color space or compression setting
+  tiled_image load(std::string const& file_name, mipmap::color_space space, bool compress);
+  // split the levels of the image down to the first one fitting into a single tile and write them to the tiled file,
+  // columns wrap around and rows are clamped at the borders like equirectangular maps
+  void build(std::string const& file_name, std::string const& tiled, mipmap::color_space space, bool compress,
+             std::uint64_t source_hash, std::uint64_t source_size);
+  // path of the tiled file belonging to an image file
+  std::string tiled_path(std::string const& file_name);
+}
+
+#endif
@@ -9,17 +9,18 @@
 
 // forward declarations
 class Application;
+class frame_recorder;
 struct GLFWwindow;
 
 namespace window_handler { 
-  // create window and set callbacks
-  GLFWwindow* initialize(glm::uvec2 const& resolution, unsigned ver_major, unsigned ver_minor);
+  // create window and set callbacks, an invisible window only provides the context
+  GLFWwindow* initialize(glm::uvec2 const& resolution, unsigned ver_major, unsigned ver_minor, bool visible = true);
   // load shader programs and update uniform locations
   void set_callback_object(GLFWwindow* window, Application* app);
   // free resources
   void close_and_quit(GLFWwindow* window, int status);
-    // calculate fps and show in window title
-  void show_fps(GLFWwindow* window);
+  // show frame rate and frame time percentiles of the recorder in the window title
+  void show_fps(GLFWwindow* window, frame_recorder const& recorder);
 }
 
 #endif
\ No newline at end of file
@@ -20,6 +20,7 @@ const float Application::initial_aspect_ratio = float(initial_resolution.x) / fl
 
 Application::Application(std::string const& resource_path)
  :m_resource_path{resource_path}
+ ,m_frame_work_ms{0.0}
  ,m_shaders{}
 {}
 
@@ -81,6 +82,10 @@ void Application::mouse_callback(GLFWwindow* window, double pos_x, double pos_y)
   glfwSetCursorPos(window, 0.0, 0.0);
 }
 
+void Application::set_frame_work(double work_ms) {
+  m_frame_work_ms = work_ms;
+}
+
 // handle window resizing
 void Application::resize_callback(unsigned width, unsigned height) {
   // resize framebuffer
@@ -94,7 +99,7 @@ static void update_shader_programs(std::map<std::string, shader_program>& shader
   // actual functionality in lambda to allow update with and without throwing
   auto update_lambda = [](shader_program& program){
     // throws exception when compiling was unsuccessfull
-    GLuint new_program = shader_loader::program(program.shader_paths);
+    GLuint new_program = shader_loader::program(program.shader_paths, program.defines);
     // free old shader program
     glDeleteProgram(program.handle);
     // save new shader program
@@ -0,0 +1,468 @@
+#include "block_compression.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+  // rows of blocks encoded per parallel task
+  const std::size_t BLOCK_ROW_GRAIN = 4;
+  // weight of the first endpoint for each bc1 index in four color mode
+  const float COLOR_WEIGHTS[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+
+  // texels of one block as separate channel arrays, aligned for sse loads
+  struct alignas(16) color_block {
+    float r[16];
+    float g[16];
+    float b[16];
+  };
+
+  std::size_t channel_count(GLenum channels) {
+    if (channels == GL_RED) {
+      return 1;
+    }
+    else if (channels == GL_RG) {
+      return 2;
+    }
+    else if (channels == GL_RGB) {
+      return 3;
+    }
+    else if (channels == GL_RGBA) {
+      return 4;
+    }
+    throw std::invalid_argument("block_compression: unsupported channel format");
+  }
+
+  std::uint16_t quantize_565(float const color[3]) {
+    unsigned r = unsigned(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    unsigned g = unsigned(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    unsigned b = unsigned(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return std::uint16_t((r << 11) | (g << 5) | b);
+  }
+
+  void expand_565(std::uint16_t packed, float color[3]) {
+    unsigned r = (packed >> 11) & 31u;
+    unsigned g = (packed >> 5) & 63u;
+    unsigned b = packed & 31u;
+    color[0] = float((r << 3) | (r >> 2));
+    color[1] = float((g << 2) | (g >> 4));
+    color[2] = float((b << 3) | (b >> 2));
+  }
+
+  // four color palette of the quantized endpoints
+  void color_palette(std::uint16_t c0, std::uint16_t c1, float palette[4][3]) {
+    expand_565(c0, palette[0]);
+    expand_565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+      palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+      palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+  }
+
+  // pick the closest palette entry for each texel, returns the summed squared error
+  float assign_indices(color_block const& block, float const palette[4][3], std::uint8_t indices[16]) {
+    float error = 0.0f;
+#ifdef BLOCK_COMPRESSION_SSE2
+    for (int i = 0; i < 16; i += 4) {
+      __m128 r = _mm_load_ps(block.r + i);
+      __m128 g = _mm_load_ps(block.g + i);
+      __m128 b = _mm_load_ps(block.b + i);
+      __m128 best = _mm_set1_ps(3.0e38f);
+      __m128 best_index = _mm_setzero_ps();
+      for (int k = 0; k < 4; ++k) {
+        __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+        __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+        __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+        __m128 closer = _mm_cmplt_ps(distance, best);
+        best = _mm_min_ps(distance, best);
+        best_index = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(float(k))), _mm_andnot_ps(closer, best_index));
+      }
+      alignas(16) std::int32_t lane_index[4];
+      alignas(16) float lane_error[4];
+      _mm_store_si128(reinterpret_cast<__m128i*>(lane_index), _mm_cvttps_epi32(best_index));
+      _mm_store_ps(lane_error, best);
+      for (int lane = 0; lane < 4; ++lane) {
+        indices[i + lane] = std::uint8_t(lane_index[lane]);
+        error += lane_error[lane];
+      }
+    }
+#else
+    for (int i = 0; i < 16; ++i) {
+      float best = 3.0e38f;
+      for (int k = 0; k < 4; ++k) {
+        float dr = block.r[i] - palette[k][0];
+        float dg = block.g[i] - palette[k][1];
+        float db = block.b[i] - palette[k][2];
+        float distance = dr * dr + dg * dg + db * db;
+        if (distance < best) {
+          best = distance;
+          indices[i] = std::uint8_t(k);
+        }
+      }
+      error += best;
+    }
+#endif
+    return error;
+  }
+
+  // endpoints minimizing the squared error for fixed indices, returns false if the system is singular
+  bool fit_endpoints(color_block const& block, std::uint8_t const indices[16], float start[3], float end[3]) {
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    float ap[3] = {0.0f, 0.0f, 0.0f};
+    float bp[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; ++i) {
+      float a = COLOR_WEIGHTS[indices[i]];
+      float b = 1.0f - a;
+      float texel[3] = {block.r[i], block.g[i], block.b[i]};
+      aa += a * a;
+      bb += b * b;
+      ab += a * b;
+      for (int c = 0; c < 3; ++c) {
+        ap[c] += a * texel[c];
+        bp[c] += b * texel[c];
+      }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f) {
+      return false;
+    }
+    for (int c = 0; c < 3; ++c) {
+      start[c] = (bb * ap[c] - ab * bp[c]) / determinant;
+      end[c] = (aa * bp[c] - ab * ap[c]) / determinant;
+    }
+    return true;
+  }
+
+  // bc1 color block in four color mode
+  void encode_color(color_block const& block, std::uint8_t* out) {
+    // principal axis of the texel colors by power iteration on the covariance
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; ++i) {
+      mean[0] += block.r[i];
+      mean[1] += block.g[i];
+      mean[2] += block.b[i];
+    }
+    for (float& m : mean) {
+      m /= 16.0f;
+    }
+    float covariance[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; ++i) {
+      float r = block.r[i] - mean[0];
+      float g = block.g[i] - mean[1];
+      float b = block.b[i] - mean[2];
+      covariance[0] += r * r;
+      covariance[1] += r * g;
+      covariance[2] += r * b;
+      covariance[3] += g * g;
+      covariance[4] += g * b;
+      covariance[5] += b * b;
+    }
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 4; ++iteration) {
+      float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+      float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+      float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+      float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+      if (length < 1e-6f) {
+        break;
+      }
+      axis[0] = x / length;
+      axis[1] = y / length;
+      axis[2] = z / length;
+    }
+
+    // texels at the extremes of the axis become the endpoints
+    int min_texel = 0;
+    int max_texel = 0;
+    float min_projection = 3.0e38f;
+    float max_projection = -3.0e38f;
+    for (int i = 0; i < 16; ++i) {
+      float projection = block.r[i] * axis[0] + block.g[i] * axis[1] + block.b[i] * axis[2];
+      if (projection < min_projection) {
+        min_projection = projection;
+        min_texel = i;
+      }
+      if (projection > max_projection) {
+        max_projection = projection;
+        max_texel = i;
+      }
+    }
+    float start[3] = {block.r[max_texel], block.g[max_texel], block.b[max_texel]};
+    float end[3] = {block.r[min_texel], block.g[min_texel], block.b[min_texel]};
+
+    std::uint16_t c0 = quantize_565(start);
+    std::uint16_t c1 = quantize_565(end);
+    float palette[4][3];
+    std::uint8_t indices[16];
+    color_palette(c0, c1, palette);
+    float error = assign_indices(block, palette, indices);
+
+    // one least squares refinement, kept if it lowers the error
+    if (error > 0.0f && fit_endpoints(block, indices, start, end)) {
+      std::uint16_t refined0 = quantize_565(start);
+      std::uint16_t refined1 = quantize_565(end);
+      std::uint8_t refined_indices[16];
+      color_palette(refined0, refined1, palette);
+      float refined_error = assign_indices(block, palette, refined_indices);
+      if (refined_error < error) {
+        c0 = refined0;
+        c1 = refined1;
+        std::memcpy(indices, refined_indices, sizeof(indices));
+      }
+    }
+
+    // four color mode needs the first endpoint to be larger, equal endpoints only need index 0
+    if (c0 == c1) {
+      std::memset(indices, 0, sizeof(indices));
+    }
+    else if (c0 < c1) {
+      std::swap(c0, c1);
+      for (std::uint8_t& index : indices) {
+        index ^= 1;
+      }
+    }
+
+    std::uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i) {
+      bits |= std::uint32_t(indices[i]) << (2 * i);
+    }
+    out[0] = std::uint8_t(c0 & 0xff);
+    out[1] = std::uint8_t(c0 >> 8);
+    out[2] = std::uint8_t(c1 & 0xff);
+    out[3] = std::uint8_t(c1 >> 8);
+    for (int i = 0; i < 4; ++i) {
+      out[4 + i] = std::uint8_t(bits >> (8 * i));
+    }
+  }
+
+  // bc4 block with eight interpolated values between the extremes
+  void encode_channel(std::uint8_t const values[16], std::uint8_t* out) {
+    int low = 255;
+    int high = 0;
+    for (int i = 0; i < 16; ++i) {
+      low = std::min(low, int(values[i]));
+      high = std::max(high, int(values[i]));
+    }
+
+    std::uint64_t bits = 0;
+    int range = high - low;
+    if (range > 0) {
+      for (int i = 0; i < 16; ++i) {
+        // steps from the high endpoint, palette order is high, low, then the six values in between
+        int step = ((high - int(values[i])) * 7 + range / 2) / range;
+        std::uint64_t index = step == 0 ? 0u : (step == 7 ? 1u : std::uint64_t(step + 1));
+        bits |= index << (3 * i);
+      }
+    }
+    out[0] = std::uint8_t(high);
+    out[1] = std::uint8_t(low);
+    for (int i = 0; i < 6; ++i) {
+      out[2 + i] = std::uint8_t(bits >> (8 * i));
+    }
+  }
+
+  void decode_channel(std::uint8_t const* block, std::uint8_t values[16]) {
+    int high = block[0];
+    int low = block[1];
+    int palette[8] = {high, low, 0, 0, 0, 0, 0, 0};
+    if (high > low) {
+      for (int i = 1; i < 7; ++i) {
+        palette[i + 1] = ((7 - i) * high + i * low) / 7;
+      }
+    }
+    else {
+      for (int i = 1; i < 5; ++i) {
+        palette[i + 1] = ((5 - i) * high + i * low) / 5;
+      }
+      palette[6] = 0;
+      palette[7] = 255;
+    }
+    std::uint64_t bits = 0;
+    for (int i = 0; i < 6; ++i) {
+      bits |= std::uint64_t(block[2 + i]) << (8 * i);
+    }
+    for (int i = 0; i < 16; ++i) {
+      values[i] = std::uint8_t(palette[(bits >> (3 * i)) & 7u]);
+    }
+  }
+
+  // rgba palette lookup, three color mode only exists in bc1 blocks
+  void decode_color(std::uint8_t const* block, bool allow_transparent, std::uint8_t texels[16][4]) {
+    std::uint16_t c0 = std::uint16_t(block[0] | (block[1] << 8));
+    std::uint16_t c1 = std::uint16_t(block[2] | (block[3] << 8));
+    float palette[4][3];
+    color_palette(c0, c1, palette);
+    std::uint8_t alpha[4] = {255, 255, 255, 255};
+    if (allow_transparent && c0 <= c1) {
+      for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+        palette[3][c] = 0.0f;
+      }
+      alpha[3] = 0;
+    }
+    for (int i = 0; i < 16; ++i) {
+      unsigned index = (block[4 + i / 4] >> (2 * (i % 4))) & 3u;
+      for (int c = 0; c < 3; ++c) {
+        texels[i][c] = std::uint8_t(palette[index][c] + 0.5f);
+      }
+      texels[i][3] = alpha[index];
+    }
+  }
+}
+
+namespace block_compression {
+
+GLenum internal_format(format f) {
+  switch (f) {
+    case format::bc1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case format::bc3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case format::bc4: return GL_COMPRESSED_RED_RGTC1;
+    case format::bc5: return GL_COMPRESSED_RG_RGTC2;
+  }
+  throw std::invalid_argument("block_compression: unknown format");
+}
+
+format format_for(std::size_t channels) {
+  static const format formats[] = {format::bc4, format::bc5, format::bc1, format::bc3};
+  if (channels < 1 || channels > 4) {
+    throw std::invalid_argument("block_compression: unsupported channel count");
+  }
+  return formats[channels - 1];
+}
+
+format choose_format(pixel_data const& image) {
+  std::size_t components = channel_count(image.channels);
+  if (components == 4) {
+    for (std::size_t i = 0; i < image.width * image.height; ++i) {
+      if (image.pixels[i * 4 + 3] != 255) {
+        return format::bc3;
+      }
+    }
+    return format::bc1;
+  }
+  return format_for(components);
+}
+
+std::size_t block_bytes(format f) {
+  return (f == format::bc1 || f == format::bc4) ? 8 : 16;
+}
+
+std::size_t compressed_size(format f, std::size_t width, std::size_t height) {
+  return ((width + 3) / 4) * ((height + 3) / 4) * block_bytes(f);
+}
+
+std::vector<std::uint8_t> encode(pixel_data const& image, format f) {
+  if (image.channel_type != GL_UNSIGNED_BYTE) {
+    throw std::invalid_argument("block_compression: only 8 bit images can be encoded");
+  }
+  std::size_t components = channel_count(image.channels);
+  if ((f == format::bc5 && components < 2) || ((f == format::bc1 || f == format::bc3) && components < 3)) {
+    throw std::invalid_argument("block_compression: image has too few channels for the format");
+  }
+
+  std::size_t blocks_x = (image.width + 3) / 4;
+  std::size_t blocks_y = (image.height + 3) / 4;
+  std::size_t stride = block_bytes(f);
+  std::vector<std::uint8_t> blocks(blocks_x * blocks_y * stride);
+
+  thread_pool::shared().parallel_for(0, blocks_y, BLOCK_ROW_GRAIN, [&](std::size_t row_begin, std::size_t row_end) {
+    color_block colors;
+    std::uint8_t first[16];
+    std::uint8_t second[16];
+    for (std::size_t by = row_begin; by < row_end; ++by) {
+      for (std::size_t bx = 0; bx < blocks_x; ++bx) {
+        // partial blocks at the borders repeat the edge texels
+        for (std::size_t i = 0; i < 16; ++i) {
+          std::size_t x = std::min(bx * 4 + i % 4, image.width - 1);
+          std::size_t y = std::min(by * 4 + i / 4, image.height - 1);
+          std::uint8_t const* texel = image.pixels.data() + (y * image.width + x) * components;
+          if (f == format::bc1 || f == format::bc3) {
+            colors.r[i] = float(texel[0]);
+            colors.g[i] = float(texel[1]);
+            colors.b[i] = float(texel[2]);
+            first[i] = components == 4 ? texel[3] : 255;
+          }
+          else {
+            first[i] = texel[0];
+            second[i] = f == format::bc5 ? texel[1] : 0;
+          }
+        }
+
+        std::uint8_t* out = blocks.data() + (by * blocks_x + bx) * stride;
+        if (f == format::bc1) {
+          encode_color(colors, out);
+        }
+        else if (f == format::bc3) {
+          encode_channel(first, out);
+          encode_color(colors, out + 8);
+        }
+        else if (f == format::bc4) {
+          encode_channel(first, out);
+        }
+        else {
+          encode_channel(first, out);
+          encode_channel(second, out + 8);
+        }
+      }
+    }
+  });
+  return blocks;
+}
+
+pixel_data decode(std::uint8_t const* blocks, std::size_t width, std::size_t height, format f) {
+  std::vector<std::uint8_t> pixels(width * height * 4);
+  std::size_t blocks_x = (width + 3) / 4;
+  std::size_t stride = block_bytes(f);
+  std::uint8_t texels[16][4];
+  std::uint8_t first[16];
+  std::uint8_t second[16];
+
+  for (std::size_t by = 0; by < (height + 3) / 4; ++by) {
+    for (std::size_t bx = 0; bx < blocks_x; ++bx) {
+      std::uint8_t const* block = blocks + (by * blocks_x + bx) * stride;
+      if (f == format::bc1) {
+        decode_color(block, true, texels);
+      }
+      else if (f == format::bc3) {
+        decode_channel(block, first);
+        decode_color(block + 8, false, texels);
+        for (int i = 0; i < 16; ++i) {
+          texels[i][3] = first[i];
+        }
+      }
+      else {
+        // missing channels read as zero like in a red or rg texture
+        decode_channel(block, first);
+        if (f == format::bc5) {
+          decode_channel(block + 8, second);
+        }
+        for (int i = 0; i < 16; ++i) {
+          texels[i][0] = first[i];
+          texels[i][1] = f == format::bc5 ? second[i] : 0;
+          texels[i][2] = 0;
+          texels[i][3] = 255;
+        }
+      }
+
+      for (std::size_t i = 0; i < 16; ++i) {
+        std::size_t x = bx * 4 + i % 4;
+        std::size_t y = by * 4 + i / 4;
+        if (x < width && y < height) {
+          std::memcpy(pixels.data() + (y * width + x) * 4, texels[i], 4);
+        }
+      }
+    }
+  }
+  return pixel_data{std::move(pixels), GL_RGBA, GL_UNSIGNED_BYTE, width, height};
+}
+
+}
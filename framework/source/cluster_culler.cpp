@@ -0,0 +1,328 @@
+#include "cluster_culler.hpp"
+
+#include "profiler.hpp"
+#include "shader_loader.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+  // readbacks in flight, the count of a frame is read a few frames later without stalling
+  const std::size_t READBACK_COUNT = 3;
+  // invocations per work group of the compute shader
+  const GLuint GROUP_SIZE = 64;
+  // commands and objects the buffers hold at first, they grow to what a frame needs
+  const std::size_t INITIAL_COMMANDS = 1024;
+  const std::size_t INITIAL_COUNTERS = 64;
+  // largest ratio of the axis scales the cone test stays valid for, normal cones do not survive non-uniform scaling
+  const float UNIFORM_SCALE = 1.001f;
+
+  // std430 layouts of the compute shader
+  struct gpu_cluster {
+    float sphere[4];
+    float cone[4];
+    std::uint32_t count;
+    std::uint32_t first_index;
+    std::int32_t base_vertex;
+    std::uint32_t padding;
+  };
+  struct draw_command {
+    std::uint32_t count;
+    std::uint32_t instance_count;
+    std::uint32_t first_index;
+    std::int32_t base_vertex;
+    std::uint32_t base_instance;
+  };
+
+  bool supports_compute() {
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major > 4 || (major == 4 && minor >= 3);
+  }
+
+  // world space plane in the model space of the transform, normalized so that it gives distances
+  glm::fvec4 model_plane(glm::fvec4 const& plane, glm::fmat4 const& transform) {
+    glm::fvec4 local = glm::transpose(transform) * plane;
+    float length = glm::length(glm::fvec3{local});
+    return length > 0.0f ? local / length : local;
+  }
+
+  bool visible(model_object::cluster const& cluster, glm::fvec4 const* planes, glm::fvec3 const& camera, bool cone) {
+    glm::fvec3 center{cluster.sphere};
+    for (std::size_t i = 0; i < 6; ++i) {
+      if (glm::dot(glm::fvec3{planes[i]}, center) + planes[i].w < -cluster.sphere.w) {
+        return false;
+      }
+    }
+    // all triangles face away if the view direction stays inside the cone mirrored along its axis
+    glm::fvec3 view = center - camera;
+    return !cone || glm::dot(view, glm::fvec3{cluster.cone}) < cluster.cone.w * glm::length(view) + cluster.sphere.w;
+  }
+}
+
+cluster_culler::cluster_culler(std::string const& compute_shader_path)
+ :program_{0}
+ ,planes_location_{-1}
+ ,camera_location_{-1}
+ ,cone_location_{-1}
+ ,cluster_first_location_{-1}
+ ,cluster_count_location_{-1}
+ ,command_offset_location_{-1}
+ ,counter_index_location_{-1}
+ ,commands_{0}
+ ,counters_{0}
+ ,command_capacity_{0}
+ ,counter_capacity_{0}
+ ,commands_used_{0}
+ ,counters_used_{0}
+ ,readbacks_{}
+ ,next_readback_{0}
+ ,planes_{}
+ ,camera_position_{0.0f}
+ ,cpu_culled_{0}
+ ,gpu_culled_{0}
+ ,culled_{0}
+{
+  if (!supports_compute()) {
+    return;
+  }
+  try {
+    program_ = shader_loader::program({{GL_COMPUTE_SHADER, compute_shader_path}});
+  }
+  catch (std::exception&) {
+    std::cerr << "Cluster culling compute shader not available, culling on the cpu" << std::endl;
+    return;
+  }
+  planes_location_ = glGetUniformLocation(program_, "Planes");
+  camera_location_ = glGetUniformLocation(program_, "CameraPosition");
+  cone_location_ = glGetUniformLocation(program_, "ConeCulling");
+  cluster_first_location_ = glGetUniformLocation(program_, "ClusterFirst");
+  cluster_count_location_ = glGetUniformLocation(program_, "ClusterCount");
+  command_offset_location_ = glGetUniformLocation(program_, "CommandOffset");
+  counter_index_location_ = glGetUniformLocation(program_, "CounterIndex");
+
+  glGenBuffers(1, &commands_);
+  glGenBuffers(1, &counters_);
+  commands_used_ = INITIAL_COMMANDS;
+  counters_used_ = INITIAL_COUNTERS;
+  reserve();
+  readbacks_.resize(READBACK_COUNT);
+  for (readback& r : readbacks_) {
+    glGenBuffers(1, &r.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, r.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+    r.fence = nullptr;
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+cluster_culler::~cluster_culler() {
+  for (readback& r : readbacks_) {
+    if (r.fence) {
+      glDeleteSync(r.fence);
+    }
+    glDeleteBuffers(1, &r.buffer);
+  }
+  glDeleteBuffers(1, &commands_);
+  glDeleteBuffers(1, &counters_);
+  glDeleteProgram(program_);
+}
+
+bool cluster_culler::gpu() const {
+  return program_ != 0;
+}
+
+void cluster_culler::upload(model_object& object) const {
+  if (!gpu() || object.clusters.empty()) {
+    return;
+  }
+  std::size_t index_size = object.index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+  std::vector<gpu_cluster> clusters;
+  for (model_object::cluster const& cluster : object.clusters) {
+    gpu_cluster stored{};
+    for (int i = 0; i < 4; ++i) {
+      stored.sphere[i] = cluster.sphere[i];
+      stored.cone[i] = cluster.cone[i];
+    }
+    stored.count = std::uint32_t(cluster.num_elements);
+    stored.first_index = std::uint32_t(reinterpret_cast<std::uintptr_t>(cluster.offset) / index_size);
+    stored.base_vertex = cluster.base_vertex;
+    clusters.push_back(stored);
+  }
+  if (object.cluster_BO == 0) {
+    glGenBuffers(1, &object.cluster_BO);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, object.cluster_BO);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(clusters.size() * sizeof(gpu_cluster)), clusters.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void cluster_culler::begin_frame(glm::fmat4 const& view_projection, glm::fvec3 const& camera_position) {
+  // left, right, bottom, top, near and far plane from the rows of the matrix (Gribb and Hartmann)
+  glm::fvec4 rows[4];
+  for (int i = 0; i < 4; ++i) {
+    rows[i] = glm::fvec4{view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]};
+  }
+  for (int i = 0; i < 3; ++i) {
+    planes_[2 * i] = rows[3] + rows[i];
+    planes_[2 * i + 1] = rows[3] - rows[i];
+  }
+  camera_position_ = camera_position;
+  cpu_culled_ = 0;
+
+  if (gpu()) {
+    collect();
+    reserve();
+    commands_used_ = 0;
+    counters_used_ = 0;
+    // culled commands keep a count of 0, the counters start at 0
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commands_);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters_);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  }
+}
+
+void cluster_culler::cull(model_object const& object, std::size_t level, glm::fmat4 const& transform, cluster_draw& draw) {
+  draw.counts.clear();
+  draw.offsets.clear();
+  draw.base_vertices.clear();
+  draw.indirect_count = 0;
+  draw.active = !object.clusters.empty();
+  if (!draw.active) {
+    return;
+  }
+  std::size_t first = 0;
+  std::size_t count = 0;
+  object.cluster_range(level, first, count);
+
+  // the frustum and the camera in model space, where the clusters are bounded
+  glm::fvec4 planes[6];
+  for (std::size_t i = 0; i < 6; ++i) {
+    planes[i] = model_plane(planes_[i], transform);
+  }
+  glm::fvec3 camera{glm::inverse(transform) * glm::fvec4{camera_position_, 1.0f}};
+  float scales[3] = {glm::length(glm::fvec3{transform[0]}), glm::length(glm::fvec3{transform[1]}), glm::length(glm::fvec3{transform[2]})};
+  bool cone = *std::max_element(scales, scales + 3) <= *std::min_element(scales, scales + 3) * UNIFORM_SCALE;
+
+  // objects that do not fit into the buffers this frame are culled on the cpu, the buffers grow next frame
+  bool uploaded = gpu() && object.cluster_BO != 0;
+  bool fits = commands_used_ + count <= command_capacity_ && counters_used_ + 2 <= counter_capacity_;
+  if (!uploaded || !fits) {
+    if (uploaded) {
+      commands_used_ += count;
+      counters_used_ += 1;
+    }
+    std::size_t index_size = object.index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    for (std::size_t i = first; i < first + count; ++i) {
+      model_object::cluster const& cluster = object.clusters[i];
+      if (!visible(cluster, planes, camera, cone)) {
+        cpu_culled_ += std::size_t(cluster.num_elements) / 3;
+        continue;
+      }
+      // adjacent visible clusters are drawn as one range
+      if (!draw.counts.empty() && draw.base_vertices.back() == cluster.base_vertex
+          && static_cast<std::uint8_t const*>(draw.offsets.back()) + std::size_t(draw.counts.back()) * index_size == cluster.offset) {
+        draw.counts.back() += cluster.num_elements;
+        continue;
+      }
+      draw.counts.push_back(cluster.num_elements);
+      draw.offsets.push_back(cluster.offset);
+      draw.base_vertices.push_back(cluster.base_vertex);
+    }
+    return;
+  }
+
+  glUseProgram(program_);
+  glUniform4fv(planes_location_, 6, glm::value_ptr(planes[0]));
+  glUniform3fv(camera_location_, 1, glm::value_ptr(camera));
+  glUniform1i(cone_location_, cone ? 1 : 0);
+  glUniform1ui(cluster_first_location_, GLuint(first));
+  glUniform1ui(cluster_count_location_, GLuint(count));
+  glUniform1ui(command_offset_location_, GLuint(commands_used_));
+  glUniform1ui(counter_index_location_, GLuint(counters_used_));
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, object.cluster_BO);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commands_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, counters_);
+  glDispatchCompute((GLuint(count) + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+  draw.indirect_BO = commands_;
+  draw.indirect_offset = GLintptr(commands_used_ * sizeof(draw_command));
+  draw.indirect_count = GLsizei(count);
+  commands_used_ += count;
+  counters_used_ += 1;
+}
+
+void cluster_culler::end_frame() {
+  if (gpu() && counters_used_ > 0) {
+    // the draws read the commands and the copy reads the culled triangle count written by the shader
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    readback& target = readbacks_[next_readback_];
+    if (target.fence) {
+      // not read in time, the newer count replaces it
+      glDeleteSync(target.fence);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, counters_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target.buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    target.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_UNUSED_BIT);
+    next_readback_ = (next_readback_ + 1) % readbacks_.size();
+  }
+  culled_ = cpu_culled_ + gpu_culled_;
+  profiler::count("culled triangles", double(culled_));
+}
+
+std::size_t cluster_culler::culled_triangles() const {
+  return culled_;
+}
+
+void cluster_culler::reserve() {
+  if (commands_used_ > command_capacity_) {
+    command_capacity_ = std::max(commands_used_, 2 * command_capacity_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commands_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(command_capacity_ * sizeof(draw_command)), nullptr, GL_DYNAMIC_DRAW);
+  }
+  // the first counter holds the culled triangles
+  if (counters_used_ + 1 > counter_capacity_) {
+    counter_capacity_ = std::max(counters_used_ + 1, 2 * counter_capacity_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(counter_capacity_ * sizeof(GLuint)), nullptr, GL_DYNAMIC_DRAW);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void cluster_culler::collect() {
+  // fences signal in order, only the newest finished count is kept
+  for (std::size_t i = 0; i < readbacks_.size(); ++i) {
+    readback& r = readbacks_[(next_readback_ + i) % readbacks_.size()];
+    if (!r.fence) {
+      continue;
+    }
+    GLenum status = glClientWaitSync(r.fence, GL_NONE_BIT, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      break;
+    }
+    glDeleteSync(r.fence);
+    r.fence = nullptr;
+    GLuint culled = 0;
+    glBindBuffer(GL_COPY_READ_BUFFER, r.buffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint), &culled);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    gpu_culled_ = std::size_t(culled);
+  }
+}
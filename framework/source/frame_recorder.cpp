@@ -0,0 +1,313 @@
+#include "frame_recorder.hpp"
+
+#include "utils.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+//dont load gl bindings from glfw
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+  bool ends_with(std::string const& text, std::string const& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+}
+
+log_histogram::log_histogram(double min_ms, double max_ms, double step)
+ :log_min_{std::log(min_ms)}
+ ,log_step_{std::log1p(step)}
+ ,buckets_(std::size_t(std::ceil((std::log(max_ms) - std::log(min_ms)) / std::log1p(step))) + 1, 0)
+ ,count_{0}
+ ,sum_{0.0}
+ ,max_{0.0}
+{}
+
+void log_histogram::add(double ms) {
+  double position = ms > 0.0 ? (std::log(ms) - log_min_) / log_step_ : 0.0;
+  std::size_t bucket = position > 0.0 ? std::min(std::size_t(position), buckets_.size() - 1) : 0;
+  ++buckets_[bucket];
+  ++count_;
+  sum_ += ms;
+  max_ = std::max(max_, ms);
+}
+
+void log_histogram::reset() {
+  std::fill(buckets_.begin(), buckets_.end(), 0);
+  count_ = 0;
+  sum_ = 0.0;
+  max_ = 0.0;
+}
+
+std::size_t log_histogram::count() const {
+  return count_;
+}
+
+double log_histogram::mean() const {
+  return count_ > 0 ? sum_ / double(count_) : 0.0;
+}
+
+double log_histogram::max() const {
+  return max_;
+}
+
+double log_histogram::percentile(double fraction) const {
+  if (count_ == 0) {
+    return 0.0;
+  }
+  std::size_t rank = std::max(std::size_t(std::ceil(fraction * double(count_))), std::size_t(1));
+  std::size_t seen = 0;
+  for (std::size_t bucket = 0; bucket < buckets_.size(); ++bucket) {
+    seen += buckets_[bucket];
+    if (seen >= rank) {
+      return std::min(std::exp(log_min_ + double(bucket + 1) * log_step_), max_);
+    }
+  }
+  return max_;
+}
+
+frame_recorder::statistics::statistics()
+ :frame_ms{}
+ ,cpu_ms{}
+ ,gpu_ms{}
+ ,hitches{0}
+ ,cpu_bound{0}
+ ,gpu_bound{0}
+{}
+
+void frame_recorder::statistics::reset() {
+  frame_ms.reset();
+  cpu_ms.reset();
+  gpu_ms.reset();
+  hitches = 0;
+  cpu_bound = 0;
+  gpu_bound = 0;
+}
+
+frame_recorder::summary frame_recorder::statistics::get_summary() const {
+  summary s{};
+  s.frames = frame_ms.count();
+  s.mean_ms = frame_ms.mean();
+  s.p50_ms = frame_ms.percentile(0.50);
+  s.p95_ms = frame_ms.percentile(0.95);
+  s.p99_ms = frame_ms.percentile(0.99);
+  s.max_ms = frame_ms.max();
+  s.hitches = hitches;
+  s.cpu_p50_ms = cpu_ms.percentile(0.50);
+  s.gpu_p50_ms = gpu_ms.percentile(0.50);
+  s.cpu_bound = cpu_bound;
+  s.gpu_bound = gpu_bound;
+  return s;
+}
+
+frame_recorder::settings::settings()
+ :hitch_ms{1000.0 / 30.0}
+ ,report_interval{10.0}
+ ,report_path{}
+{}
+
+frame_recorder::settings frame_recorder::read_settings(int argc, char* argv[]) {
+  settings config{};
+  config.hitch_ms = std::stod(utils::read_option(argc, argv, "hitch-ms", std::to_string(config.hitch_ms)));
+  config.report_interval = std::stod(utils::read_option(argc, argv, "report-interval", "10"));
+  config.report_path = utils::read_option(argc, argv, "frame-report");
+  if (!config.report_path.empty() && !ends_with(config.report_path, ".csv") && !ends_with(config.report_path, ".json")) {
+    throw std::invalid_argument("frame report '" + config.report_path + "' must be a .csv or .json file");
+  }
+  return config;
+}
+
+frame_recorder::frame_recorder(settings const& config)
+ :settings_{config}
+ ,has_timer_query_{glfwExtensionSupported("GL_ARB_timer_query") != 0}
+ ,slots_{}
+ ,frame_index_{0}
+ ,last_cpu_ms_{0.0}
+ ,last_gpu_ms_{0.0}
+ ,start_{clock::now()}
+ ,period_start_{start_}
+ ,frame_begin_{}
+ ,last_begin_{}
+ ,has_begun_{false}
+ ,period_{}
+ ,total_{}
+ ,json_rows_{}
+{
+  if (has_timer_query_) {
+    for (gpu_slot& slot : slots_) {
+      glGenQueries(2, slot.queries);
+      slot.pending = false;
+    }
+  }
+  // start a fresh csv, periods are appended
+  if (ends_with(settings_.report_path, ".csv")) {
+    std::ofstream file{settings_.report_path};
+    if (!file) {
+      throw std::runtime_error("could not write frame report to " + settings_.report_path);
+    }
+    file << "period,time_s,frames,mean_ms,p50_ms,p95_ms,p99_ms,max_ms,hitches,cpu_p50_ms,gpu_p50_ms,cpu_bound,gpu_bound\n";
+  }
+}
+
+frame_recorder::~frame_recorder() {
+  if (has_timer_query_) {
+    for (gpu_slot& slot : slots_) {
+      glDeleteQueries(2, slot.queries);
+    }
+  }
+}
+
+void frame_recorder::begin_frame() {
+  frame_begin_ = clock::now();
+  if (has_begun_) {
+    double interval_ms = std::chrono::duration<double, std::milli>(frame_begin_ - last_begin_).count();
+    for (statistics* stats : {&period_, &total_}) {
+      stats->frame_ms.add(interval_ms);
+      if (interval_ms > settings_.hitch_ms) {
+        ++stats->hitches;
+      }
+    }
+  }
+  last_begin_ = frame_begin_;
+  has_begun_ = true;
+
+  if (has_timer_query_) {
+    // this slot was used two frames ago, its result is usually there without waiting
+    gpu_slot& slot = slots_[frame_index_ % 2];
+    collect(slot);
+    glQueryCounter(slot.queries[0], GL_TIMESTAMP);
+  }
+}
+
+void frame_recorder::end_frame() {
+  double cpu_ms = std::chrono::duration<double, std::milli>(clock::now() - frame_begin_).count();
+  period_.cpu_ms.add(cpu_ms);
+  total_.cpu_ms.add(cpu_ms);
+  last_cpu_ms_ = cpu_ms;
+
+  if (has_timer_query_) {
+    gpu_slot& slot = slots_[frame_index_ % 2];
+    glQueryCounter(slot.queries[1], GL_TIMESTAMP);
+    slot.cpu_ms = cpu_ms;
+    slot.pending = true;
+  }
+  ++frame_index_;
+
+  clock::time_point now = clock::now();
+  if (std::chrono::duration<double>(now - period_start_).count() >= settings_.report_interval) {
+    if (!settings_.report_path.empty()) {
+      report(period_.get_summary(), "period");
+    }
+    period_.reset();
+    period_start_ = now;
+  }
+}
+
+void frame_recorder::finish() {
+  if (has_timer_query_) {
+    glFinish();
+    collect(slots_[frame_index_ % 2]);
+    collect(slots_[(frame_index_ + 1) % 2]);
+  }
+  if (!settings_.report_path.empty()) {
+    if (period_.frame_ms.count() > 0) {
+      report(period_.get_summary(), "period");
+    }
+    report(total_.get_summary(), "total");
+  }
+  period_.reset();
+}
+
+void frame_recorder::collect(gpu_slot& slot) {
+  if (!slot.pending) {
+    return;
+  }
+  slot.pending = false;
+  // drop the sample instead of stalling when the gpu is further behind
+  GLuint available = 0;
+  glGetQueryObjectuiv(slot.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (available == 0) {
+    return;
+  }
+  GLuint64 begin_ns = 0;
+  GLuint64 end_ns = 0;
+  glGetQueryObjectui64v(slot.queries[0], GL_QUERY_RESULT, &begin_ns);
+  glGetQueryObjectui64v(slot.queries[1], GL_QUERY_RESULT, &end_ns);
+  double gpu_ms = double(end_ns - begin_ns) / 1.0e6;
+  last_gpu_ms_ = gpu_ms;
+
+  // an idle gpu runs along with the submission, so a busy gpu takes clearly longer than the cpu
+  bool gpu_bound = gpu_ms > slot.cpu_ms * 1.2;
+  for (statistics* stats : {&period_, &total_}) {
+    stats->gpu_ms.add(gpu_ms);
+    if (gpu_bound) {
+      ++stats->gpu_bound;
+    }
+    else {
+      ++stats->cpu_bound;
+    }
+  }
+}
+
+void frame_recorder::report(summary const& s, std::string const& label) {
+  double time_s = std::chrono::duration<double>(clock::now() - start_).count();
+  std::ostringstream row{};
+  row << std::fixed << std::setprecision(3);
+
+  if (ends_with(settings_.report_path, ".csv")) {
+    row << label << "," << time_s << "," << s.frames << "," << s.mean_ms << "," << s.p50_ms << "," << s.p95_ms << ","
+        << s.p99_ms << "," << s.max_ms << "," << s.hitches << "," << s.cpu_p50_ms << "," << s.gpu_p50_ms << ","
+        << s.cpu_bound << "," << s.gpu_bound << "\n";
+    std::ofstream file{settings_.report_path, std::ios::app};
+    file << row.str();
+  }
+  else {
+    row << "{\"period\": \"" << label << "\", \"time_s\": " << time_s << ", \"frames\": " << s.frames
+        << ", \"mean_ms\": " << s.mean_ms << ", \"p50_ms\": " << s.p50_ms << ", \"p95_ms\": " << s.p95_ms
+        << ", \"p99_ms\": " << s.p99_ms << ", \"max_ms\": " << s.max_ms << ", \"hitches\": " << s.hitches
+        << ", \"hitch_ms\": " << settings_.hitch_ms << ", \"cpu_p50_ms\": " << s.cpu_p50_ms
+        << ", \"gpu_p50_ms\": " << s.gpu_p50_ms << ", \"cpu_bound\": " << s.cpu_bound
+        << ", \"gpu_bound\": " << s.gpu_bound << "}";
+    json_rows_.push_back(row.str());
+    // rewrite the whole array so the file stays valid json when the run is aborted
+    std::ofstream file{settings_.report_path};
+    file << "[\n";
+    for (std::size_t i = 0; i < json_rows_.size(); ++i) {
+      file << "  " << json_rows_[i] << (i + 1 < json_rows_.size() ? ",\n" : "\n");
+    }
+    file << "]\n";
+  }
+}
+
+frame_recorder::summary frame_recorder::get_period_summary() const {
+  return period_.get_summary();
+}
+
+frame_recorder::summary frame_recorder::get_total_summary() const {
+  return total_.get_summary();
+}
+
+double frame_recorder::last_work_ms() const {
+  return std::max(last_cpu_ms_, last_gpu_ms_);
+}
+
+std::ostream& operator<<(std::ostream& os, frame_recorder::summary const& s) {
+  std::size_t classified = s.cpu_bound + s.gpu_bound;
+  os << s.frames << " frames, mean " << s.mean_ms << " ms, p50 " << s.p50_ms << " ms, p95 " << s.p95_ms
+     << " ms, p99 " << s.p99_ms << " ms, max " << s.max_ms << " ms, hitches " << s.hitches;
+  if (classified > 0) {
+    os << ", " << (s.gpu_bound > s.cpu_bound ? "gpu" : "cpu") << " bound ("
+       << 100 * std::max(s.cpu_bound, s.gpu_bound) / classified << "% of frames)";
+  }
+  return os;
+}
@@ -0,0 +1,192 @@
+#include "frame_scheduler.hpp"
+
+#include "utils.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+//dont load gl bindings from glfw
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+frame_scheduler::settings::settings()
+ :target_fps{0.0}
+ ,sync{sync_mode::vsync}
+ ,frames_in_flight{2}
+ ,spin_ms{1.5}
+{}
+
+frame_scheduler::settings frame_scheduler::read_settings(int argc, char* argv[]) {
+  settings config{};
+  config.target_fps = std::stod(utils::read_option(argc, argv, "fps", "0"));
+  config.frames_in_flight = unsigned(std::stoul(utils::read_option(argc, argv, "frames-in-flight", "2")));
+  config.spin_ms = std::stod(utils::read_option(argc, argv, "spin-ms", "1.5"));
+
+  std::string sync = utils::read_option(argc, argv, "sync", "vsync");
+  if (sync == "off") {
+    config.sync = sync_mode::off;
+  }
+  else if (sync == "adaptive") {
+    config.sync = sync_mode::adaptive;
+  }
+  else if (sync == "vsync") {
+    config.sync = sync_mode::vsync;
+  }
+  else {
+    throw std::invalid_argument("unknown sync mode '" + sync + "', use off, vsync or adaptive");
+  }
+  return config;
+}
+
+frame_scheduler::frame_scheduler(settings const& config)
+ :settings_{config}
+ ,period_{clock::duration::zero()}
+ ,deadline_{}
+ ,last_begin_{}
+ ,has_begun_{false}
+ ,fences_(std::max(config.frames_in_flight, 1u), nullptr)
+ ,frame_index_{0}
+{
+  if (settings_.target_fps > 0.0) {
+    period_ = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / settings_.target_fps));
+  }
+
+  // adaptive sync tears late frames instead of waiting a whole refresh
+  int interval = 0;
+  if (settings_.sync == sync_mode::adaptive) {
+    if (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+      interval = -1;
+    }
+    else {
+      std::cerr << "Adaptive sync not supported, using vsync" << std::endl;
+      interval = 1;
+    }
+  }
+  else if (settings_.sync == sync_mode::vsync) {
+    interval = 1;
+  }
+  glfwSwapInterval(interval);
+
+  reset_metrics();
+}
+
+frame_scheduler::~frame_scheduler() {
+  for (GLsync fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+}
+
+void frame_scheduler::begin_frame() {
+  // limit frames in flight by waiting for the gpu to finish the oldest one
+  GLsync& fence = fences_[frame_index_ % fences_.size()];
+  if (fence) {
+    glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+
+  clock::time_point now = clock::now();
+  if (period_ > clock::duration::zero()) {
+    // schedule relative to the previous deadline to avoid drift,
+    // but resynchronize after stalls instead of rushing frames to catch up
+    if (!has_begun_ || now > deadline_ + period_) {
+      deadline_ = now;
+    }
+    else {
+      wait_until(deadline_);
+      now = clock::now();
+    }
+    deadline_ += period_;
+  }
+
+  if (has_begun_) {
+    double interval_ms = std::chrono::duration<double, std::milli>(now - last_begin_).count();
+    double target_ms = std::chrono::duration<double, std::milli>(period_).count();
+    // without target the deviation from the mean interval is the jitter
+    double reference_ms = target_ms > 0.0 ? target_ms : (frames_ > 0 ? sum_ms_ / double(frames_) : interval_ms);
+    double jitter_ms = std::fabs(interval_ms - reference_ms);
+
+    ++frames_;
+    sum_ms_ += interval_ms;
+    sum_squared_ms_ += interval_ms * interval_ms;
+    min_ms_ = std::min(min_ms_, interval_ms);
+    max_ms_ = std::max(max_ms_, interval_ms);
+    sum_jitter_ms_ += jitter_ms;
+    max_jitter_ms_ = std::max(max_jitter_ms_, jitter_ms);
+    if (target_ms > 0.0 && interval_ms > target_ms * 1.5) {
+      ++missed_;
+    }
+  }
+  last_begin_ = now;
+  has_begun_ = true;
+}
+
+void frame_scheduler::end_frame() {
+  GLsync& fence = fences_[frame_index_ % fences_.size()];
+  if (fence) {
+    glDeleteSync(fence);
+  }
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_UNUSED_BIT);
+  ++frame_index_;
+}
+
+void frame_scheduler::wait_until(clock::time_point deadline) const {
+  clock::duration spin = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::milli>(settings_.spin_ms));
+  // os sleep granularity is coarse, so only sleep until shortly before the deadline
+  clock::time_point sleep_end = deadline - spin;
+  if (clock::now() < sleep_end) {
+    std::this_thread::sleep_until(sleep_end);
+  }
+  while (clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+}
+
+frame_scheduler::settings const& frame_scheduler::get_settings() const {
+  return settings_;
+}
+
+frame_scheduler::metrics frame_scheduler::get_metrics() const {
+  metrics m{};
+  m.frames = frames_;
+  if (frames_ > 0) {
+    double count = double(frames_);
+    m.mean_ms = sum_ms_ / count;
+    m.stddev_ms = std::sqrt(std::max(sum_squared_ms_ / count - m.mean_ms * m.mean_ms, 0.0));
+    m.min_ms = min_ms_;
+    m.max_ms = max_ms_;
+    m.mean_jitter_ms = sum_jitter_ms_ / count;
+    m.max_jitter_ms = max_jitter_ms_;
+    m.missed = missed_;
+  }
+  return m;
+}
+
+void frame_scheduler::reset_metrics() {
+  frames_ = 0;
+  sum_ms_ = 0.0;
+  sum_squared_ms_ = 0.0;
+  min_ms_ = std::numeric_limits<double>::max();
+  max_ms_ = 0.0;
+  sum_jitter_ms_ = 0.0;
+  max_jitter_ms_ = 0.0;
+  missed_ = 0;
+}
+
+std::ostream& operator<<(std::ostream& os, frame_scheduler::metrics const& m) {
+  os << m.frames << " frames, interval mean " << m.mean_ms << " ms, stddev " << m.stddev_ms
+     << " ms, min " << m.min_ms << " ms, max " << m.max_ms << " ms, jitter mean " << m.mean_jitter_ms
+     << " ms, max " << m.max_jitter_ms << " ms, missed " << m.missed;
+  return os;
+}
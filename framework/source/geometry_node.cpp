@@ -1,4 +1,6 @@
 #include "geometry_node.hpp"
+#include "sim_clock.hpp"
+#include "tile_cache.hpp"
 
 
 // Constructors
@@ -25,7 +27,11 @@ GeometryNode::GeometryNode(std::string const& name, Node* parent, std::list<Node
   color_{ color },
   texture_{ texture },
   texture_spec_{ texture_spec },
-  texture_normal_{ texture_normal }
+  texture_normal_{ texture_normal },
+  virtual_cache_{ nullptr },
+  virtual_texture_{ 0 },
+  lod_{ 0 },
+  clusters_{}
 { }
 
 // Getter Setter
@@ -37,13 +43,50 @@ void GeometryNode::set_model(model_object const* geometry_in)
 {
   geometry_ = geometry_in;
 }
+texture_object const* GeometryNode::get_texture() const
+{
+  return texture_;
+}
+texture_object const* GeometryNode::get_texture_spec() const
+{
+  return texture_spec_;
+}
+texture_object const* GeometryNode::get_texture_normal() const
+{
+  return texture_normal_;
+}
+void GeometryNode::set_virtual_texture(tile_cache const* cache, std::size_t id)
+{
+  virtual_cache_ = id != 0 ? cache : nullptr;
+  virtual_texture_ = id;
+}
+tile_cache const* GeometryNode::get_virtual_cache() const
+{
+  return virtual_cache_;
+}
+std::size_t GeometryNode::get_virtual_texture() const
+{
+  return virtual_texture_;
+}
+void GeometryNode::set_lod(std::size_t level)
+{
+  lod_ = level;
+}
+std::size_t GeometryNode::get_lod() const
+{
+  return lod_;
+}
+cluster_draw& GeometryNode::get_clusters()
+{
+  return clusters_;
+}
 
 // Methods
 void GeometryNode::render(std::map<std::string, shader_program> const* shaders, glm::fmat4 const* view_transform, glm::fmat4 transform) const
 {
   // Transformations:
   // Create translation matrix with rotation
-  glm::fmat4 rotation_matrix = glm::rotate(glm::fmat4{}, float(glfwGetTime() * get_animation()), glm::fvec3{ 0.0f, 1.0f, 0.0f });
+  glm::fmat4 rotation_matrix = glm::rotate(glm::fmat4{}, float(sim_clock::time() * get_animation()), glm::fvec3{ 0.0f, 1.0f, 0.0f });
   // Add local transform
   glm::fmat4 new_local_transform = rotation_matrix * get_local_transform();
   // Inherit local transform of parent and add own local transform to it
@@ -55,8 +98,11 @@ void GeometryNode::render(std::map<std::string, shader_program> const* shaders,
   {
     // Bind shader to upload uniforms
     glUseProgram(shaders->at("sun").handle);
-    // Model Matrix
-    glUniformMatrix4fv(shaders->at("sun").u_locs.at("ModelMatrix"), 1, GL_FALSE, glm::value_ptr(new_transform));
+    // Model Matrix, also maps quantized vertex positions into model space
+    glm::fmat4 model_matrix = new_transform * get_model()->position_transform;
+    glUniformMatrix4fv(shaders->at("sun").u_locs.at("ModelMatrix"), 1, GL_FALSE, glm::value_ptr(model_matrix));
+    // Range of quantized texture coordinates
+    glUniform4fv(shaders->at("sun").u_locs.at("TexCoordTransform"), 1, glm::value_ptr(get_model()->texcoord_transform));
     // Normal Matrix
     // Extra matrix for normal transformation to keep them orthogonal to surface
     glm::fmat4 normal_matrix = glm::inverseTranspose(new_transform);
@@ -79,8 +125,11 @@ void GeometryNode::render(std::map<std::string, shader_program> const* shaders,
   {
     // Bind shader to upload uniforms
     glUseProgram(shaders->at("planet").handle);
-    // Model Matrix
-    glUniformMatrix4fv(shaders->at("planet").u_locs.at("ModelMatrix"), 1, GL_FALSE, glm::value_ptr(new_transform));
+    // Model Matrix, also maps quantized vertex positions into model space
+    glm::fmat4 model_matrix = new_transform * get_model()->position_transform;
+    glUniformMatrix4fv(shaders->at("planet").u_locs.at("ModelMatrix"), 1, GL_FALSE, glm::value_ptr(model_matrix));
+    // Range of quantized texture coordinates
+    glUniform4fv(shaders->at("planet").u_locs.at("TexCoordTransform"), 1, glm::value_ptr(get_model()->texcoord_transform));
     // Normal Matrix
     // Extra matrix for normal transformation to keep them orthogonal to surface
     glm::fmat4 normal_matrix = glm::inverseTranspose(new_transform);
@@ -101,8 +150,22 @@ void GeometryNode::render(std::map<std::string, shader_program> const* shaders,
     glBindTexture(texture_->target, texture_->handle);
     glUniform1i(shaders->at("planet").u_locs.at("TextureColor"), 0 );
 
-    // Texture specular
-    if (texture_spec_ != nullptr)
+    // Texture 'color' of a virtual texture, read from the tile cache
+    // ...(the units stay assigned without one, samplers of different types must not share a unit)
+    if (virtual_cache_ != nullptr)
+    {
+      virtual_cache_->bind(virtual_texture_, shaders->at("planet"), 3, 4);
+    }
+    else
+    {
+      glUniform1i(shaders->at("planet").u_locs.at("TextureIndirection"), 3);
+      glUniform1i(shaders->at("planet").u_locs.at("TexturePhysical"), 4);
+    }
+    glUniform1b(shaders->at("planet").u_locs.at("TextureColorIsVirtual"), virtual_cache_ != nullptr);
+
+    // Texture specular, packed into the normal texture if both are the same
+    bool packed = texture_spec_ != nullptr && texture_spec_ == texture_normal_;
+    if (texture_spec_ != nullptr && !packed)
     {
       // Select texture unit
       glActiveTexture(GL_TEXTURE1);
@@ -122,12 +185,20 @@ void GeometryNode::render(std::map<std::string, shader_program> const* shaders,
       glUniform1i(shaders->at("planet").u_locs.at("TextureNormal"), 2);
     }
     glUniform1b(shaders->at("planet").u_locs.at("TextureNormalIsSet"), texture_normal_ != nullptr);
+    glUniform1b(shaders->at("planet").u_locs.at("TextureNormalPacked"), packed);
   }
 
   // Bind the VAO to draw
   glBindVertexArray(geometry_->vertex_AO);
-  // Draw bound vertex array using bound shader
-  glDrawElements(geometry_->draw_mode, geometry_->num_elements, model::INDEX.type, NULL);
+  // Draw bound vertex array using bound shader, the visible clusters or the chosen level of detail
+  if (clusters_.active)
+  {
+    geometry_->draw_clusters(clusters_);
+  }
+  else
+  {
+    geometry_->draw_elements(lod_);
+  }
 
   // Unbind VA
   glBindVertexArray(0);
@@ -0,0 +1,184 @@
+#include "headless.hpp"
+
+#include "utils.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+  // nearest rank percentile of sorted values
+  double percentile(std::vector<double> const& sorted, double fraction) {
+    if (sorted.empty()) {
+      return 0.0;
+    }
+    std::size_t rank = std::size_t(fraction * double(sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+  }
+
+  // escape quotes and backslashes for json strings
+  std::string escape(std::string const& text) {
+    std::string escaped{};
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        escaped += '\\';
+      }
+      escaped += c;
+    }
+    return escaped;
+  }
+
+  std::string gl_string(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value ? std::string{reinterpret_cast<const char*>(value)} : std::string{};
+  }
+}
+
+namespace headless {
+
+settings::settings()
+ :enabled{false}
+ ,resolution{0, 0}
+ ,frames{600}
+ ,step_ms{1000.0 / 60.0}
+ ,stats_path{}
+ ,hash_image{false}
+{}
+
+settings read_settings(int argc, char* argv[], glm::uvec2 const& default_resolution) {
+  settings config{};
+  config.enabled = utils::has_option(argc, argv, "headless");
+  config.resolution.x = unsigned(std::stoul(utils::read_option(argc, argv, "width", std::to_string(default_resolution.x))));
+  config.resolution.y = unsigned(std::stoul(utils::read_option(argc, argv, "height", std::to_string(default_resolution.y))));
+  config.frames = std::size_t(std::stoul(utils::read_option(argc, argv, "frames", "600")));
+  config.step_ms = std::stod(utils::read_option(argc, argv, "dt", std::to_string(1000.0 / 60.0)));
+  config.stats_path = utils::read_option(argc, argv, "stats");
+  config.hash_image = utils::has_option(argc, argv, "hash");
+
+  if (config.resolution.x == 0 || config.resolution.y == 0) {
+    throw std::invalid_argument("headless resolution must not be zero");
+  }
+  if (config.step_ms < 0.0) {
+    throw std::invalid_argument("headless time step must not be negative");
+  }
+  return config;
+}
+
+render_target::render_target(glm::uvec2 const& resolution)
+ :resolution_{resolution}
+ ,framebuffer_{0}
+ ,color_buffer_{0}
+ ,depth_buffer_{0}
+{
+  GLsizei width = GLsizei(resolution_.x);
+  GLsizei height = GLsizei(resolution_.y);
+
+  glGenRenderbuffers(1, &color_buffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_buffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+  glGenRenderbuffers(1, &depth_buffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("offscreen framebuffer incomplete");
+  }
+}
+
+render_target::~render_target() {
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteRenderbuffers(1, &color_buffer_);
+  glDeleteRenderbuffers(1, &depth_buffer_);
+}
+
+void render_target::bind() const {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glViewport(0, 0, GLsizei(resolution_.x), GLsizei(resolution_.y));
+}
+
+glm::uvec2 const& render_target::resolution() const {
+  return resolution_;
+}
+
+std::vector<std::uint8_t> render_target::read_pixels() const {
+  std::vector<std::uint8_t> pixels(std::size_t(resolution_.x) * resolution_.y * 4);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, GLsizei(resolution_.x), GLsizei(resolution_.y), GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  return pixels;
+}
+
+std::uint64_t hash(std::uint8_t const* data, std::size_t size) {
+  std::uint64_t value = 14695981039346656037ull;
+  for (std::size_t i = 0; i < size; ++i) {
+    value ^= data[i];
+    value *= 1099511628211ull;
+  }
+  return value;
+}
+
+void write_report(settings const& config, std::vector<double> const& frame_ms, std::string const& image_hash) {
+  std::vector<double> sorted{frame_ms};
+  std::sort(sorted.begin(), sorted.end());
+  double total_ms = std::accumulate(frame_ms.begin(), frame_ms.end(), 0.0);
+  double mean_ms = frame_ms.empty() ? 0.0 : total_ms / double(frame_ms.size());
+
+  std::ostringstream json{};
+  json << std::setprecision(6) << std::fixed;
+  json << "{\n"
+       << "  \"renderer\": \"" << escape(gl_string(GL_RENDERER)) << "\",\n"
+       << "  \"version\": \"" << escape(gl_string(GL_VERSION)) << "\",\n"
+       << "  \"width\": " << config.resolution.x << ",\n"
+       << "  \"height\": " << config.resolution.y << ",\n"
+       << "  \"frames\": " << frame_ms.size() << ",\n"
+       << "  \"dt_ms\": " << config.step_ms << ",\n"
+       << "  \"total_ms\": " << total_ms << ",\n"
+       << "  \"mean_ms\": " << mean_ms << ",\n"
+       << "  \"min_ms\": " << (sorted.empty() ? 0.0 : sorted.front()) << ",\n"
+       << "  \"p50_ms\": " << percentile(sorted, 0.50) << ",\n"
+       << "  \"p95_ms\": " << percentile(sorted, 0.95) << ",\n"
+       << "  \"p99_ms\": " << percentile(sorted, 0.99) << ",\n"
+       << "  \"max_ms\": " << (sorted.empty() ? 0.0 : sorted.back()) << ",\n";
+  if (!image_hash.empty()) {
+    json << "  \"image_hash\": \"" << image_hash << "\",\n";
+  }
+  json << "  \"frame_ms\": [";
+  for (std::size_t i = 0; i < frame_ms.size(); ++i) {
+    json << (i > 0 ? ", " : "") << frame_ms[i];
+  }
+  json << "]\n}\n";
+
+  if (!config.stats_path.empty()) {
+    std::ofstream file{config.stats_path};
+    if (!file) {
+      throw std::runtime_error("could not write benchmark statistics to " + config.stats_path);
+    }
+    file << json.str();
+  }
+
+  std::cout << "Headless: " << frame_ms.size() << " frames at " << config.resolution.x << "x" << config.resolution.y
+            << ", mean " << mean_ms << " ms, p95 " << percentile(sorted, 0.95) << " ms, max "
+            << (sorted.empty() ? 0.0 : sorted.back()) << " ms";
+  if (!image_hash.empty()) {
+    std::cout << ", image " << image_hash;
+  }
+  std::cout << std::endl;
+}
+
+}
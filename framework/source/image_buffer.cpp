@@ -0,0 +1,87 @@
+#include "image_buffer.hpp"
+
+#include <memory>
+#include <utility>
+
+image_buffer::image_buffer()
+ :data_{nullptr}
+ ,size_{0}
+ ,release_{}
+{}
+
+image_buffer::image_buffer(std::uint8_t const* data, std::size_t size, deleter release)
+ :data_{data}
+ ,size_{size}
+ ,release_{std::move(release)}
+{}
+
+image_buffer::image_buffer(std::vector<std::uint8_t>&& memory)
+ :image_buffer{}
+{
+  // the deleter has to be copyable, so the vector is shared with it
+  std::shared_ptr<std::vector<std::uint8_t>> owner = std::make_shared<std::vector<std::uint8_t>>(std::move(memory));
+  data_ = owner->data();
+  size_ = owner->size();
+  release_ = [owner]() mutable { owner.reset(); };
+}
+
+image_buffer::image_buffer(mapped_file&& file)
+ :image_buffer{}
+{
+  std::shared_ptr<mapped_file> owner = std::make_shared<mapped_file>(std::move(file));
+  data_ = owner->data();
+  size_ = owner->size();
+  release_ = [owner]() mutable { owner.reset(); };
+}
+
+image_buffer::~image_buffer() {
+  reset();
+}
+
+image_buffer::image_buffer(image_buffer&& other)
+ :data_{other.data_}
+ ,size_{other.size_}
+ ,release_{std::move(other.release_)}
+{
+  other.data_ = nullptr;
+  other.size_ = 0;
+  other.release_ = nullptr;
+}
+
+image_buffer& image_buffer::operator=(image_buffer&& other) {
+  if (this != &other) {
+    reset();
+    data_ = other.data_;
+    size_ = other.size_;
+    release_ = std::move(other.release_);
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.release_ = nullptr;
+  }
+  return *this;
+}
+
+std::uint8_t const* image_buffer::data() const {
+  return data_;
+}
+
+std::size_t image_buffer::size() const {
+  return size_;
+}
+
+bool image_buffer::empty() const {
+  return size_ == 0;
+}
+
+std::uint8_t const& image_buffer::operator[](std::size_t index) const {
+  return data_[index];
+}
+
+void image_buffer::reset() {
+  if (release_) {
+    release_();
+  }
+  release_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+}
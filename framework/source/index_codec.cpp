@@ -0,0 +1,247 @@
+#include "index_codec.hpp"
+
+#include <glbinding/gl/enum.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+  // codes of the 4 bit stream, 1 to FIFO_SIZE refer to the fifo by age
+  const std::uint8_t CODE_NEXT = 0;
+  const std::uint8_t CODE_ESCAPE = 15;
+  const std::size_t FIFO_SIZE = 14;
+
+  // recently added vertices, shared by encoder and decoder so both take the same decisions
+  class vertex_fifo {
+   public:
+    vertex_fifo()
+     :entries_{}
+     ,head_{0}
+     ,next_{0}
+    {}
+
+    // age of the vertex in the fifo or FIFO_SIZE if it is missing
+    std::size_t find(GLuint vertex) const {
+      for (std::size_t age = 0; age < FIFO_SIZE; ++age) {
+        if (entries_[(head_ + FIFO_SIZE - 1 - age) % FIFO_SIZE] == vertex) {
+          return age;
+        }
+      }
+      return FIFO_SIZE;
+    }
+
+    GLuint at(std::size_t age) const {
+      return entries_[(head_ + FIFO_SIZE - 1 - age) % FIFO_SIZE];
+    }
+
+    // vertices not in the fifo are added, new vertices continue the numbering
+    void add(GLuint vertex) {
+      entries_[head_] = vertex;
+      head_ = (head_ + 1) % FIFO_SIZE;
+      if (vertex >= next_) {
+        next_ = vertex + 1;
+      }
+    }
+
+    GLuint next() const {
+      return next_;
+    }
+
+   private:
+    // all start as vertex 0, encoder and decoder see the same entries either way
+    GLuint entries_[FIFO_SIZE];
+    std::size_t head_;
+    GLuint next_;
+  };
+
+  std::uint32_t zigzag(GLuint value, GLuint previous) {
+    std::int64_t delta = std::int64_t(value) - std::int64_t(previous);
+    return std::uint32_t(delta < 0 ? -2 * delta - 1 : 2 * delta);
+  }
+
+  GLuint unzigzag(std::uint32_t code, GLuint previous) {
+    std::int64_t delta = code & 1 ? -std::int64_t(code >> 1) - 1 : std::int64_t(code >> 1);
+    return GLuint(std::int64_t(previous) + delta);
+  }
+
+  void write_varint(std::uint32_t value, std::vector<std::uint8_t>& stream) {
+    while (value >= 0x80) {
+      stream.push_back(std::uint8_t(value | 0x80));
+      value >>= 7;
+    }
+    stream.push_back(std::uint8_t(value));
+  }
+
+  // vertices of a model regrouped so that each part of the index ranges addresses a window of at most SHORT_RANGE
+  // consecutive vertices from its base vertex
+  struct vertex_windows {
+    std::vector<model::submesh> parts;
+    // original vertex of every vertex in the new order
+    std::vector<GLuint> sources;
+    // new vertex of every index
+    std::vector<GLuint> indices;
+  };
+
+  // triangles keep their order, a new window starts where the next triangle no longer fits, vertices of an earlier
+  // window are copied into the current one, so only vertices along the window borders are duplicated
+  vertex_windows split_windows(model const& mesh, std::vector<model::submesh> const& ranges) {
+    const GLuint UNASSIGNED = ~GLuint(0);
+    std::vector<GLuint> assigned(mesh.vertex_num, UNASSIGNED);
+    vertex_windows result;
+    result.sources.reserve(mesh.vertex_num);
+    result.indices.resize(mesh.indices.size());
+    std::size_t base = 0;
+    for (model::submesh const& range : ranges) {
+      std::size_t first = range.first_index;
+      std::size_t end = range.first_index + range.index_count;
+      for (std::size_t triangle = first; triangle < end; triangle += 3) {
+        std::size_t missing = 0;
+        for (std::size_t corner = triangle; corner < triangle + 3; ++corner) {
+          GLuint vertex = assigned[mesh.indices[corner]];
+          if (vertex == UNASSIGNED || vertex < base) {
+            ++missing;
+          }
+        }
+        if (result.sources.size() + missing - base > index_codec::SHORT_RANGE) {
+          // the window may have been filled by the previous range, which leaves nothing to draw here
+          if (triangle > first) {
+            result.parts.push_back(model::submesh{first, triangle - first, base});
+          }
+          first = triangle;
+          base = result.sources.size();
+        }
+        for (std::size_t corner = triangle; corner < triangle + 3; ++corner) {
+          GLuint& vertex = assigned[mesh.indices[corner]];
+          if (vertex == UNASSIGNED || vertex < base) {
+            vertex = GLuint(result.sources.size());
+            result.sources.push_back(mesh.indices[corner]);
+          }
+          result.indices[corner] = vertex;
+        }
+      }
+      if (first < end) {
+        result.parts.push_back(model::submesh{first, end - first, base});
+      }
+    }
+    return result;
+  }
+}
+
+namespace index_codec {
+
+void narrow(model& mesh) {
+  if (mesh.file) {
+    throw std::invalid_argument("index_codec: model refers to a mapped file");
+  }
+  if (mesh.index_type != GL_UNSIGNED_INT) {
+    throw std::invalid_argument("index_codec: indices are narrowed already");
+  }
+  std::vector<model::submesh> parts = mesh.submeshes;
+  if (mesh.vertex_num > SHORT_RANGE) {
+    if (parts.empty()) {
+      parts.push_back(model::submesh{0, mesh.indices.size(), 0});
+    }
+    vertex_windows windows = split_windows(mesh, parts);
+    // the copied vertices have to cost less than the halved indices save
+    std::size_t copies = windows.sources.size() - mesh.vertex_num;
+    if (copies * std::size_t(mesh.vertex_bytes) >= mesh.indices.size() * sizeof(GLushort)) {
+      return;
+    }
+    std::size_t vertex_floats = std::size_t(mesh.vertex_bytes) / sizeof(GLfloat);
+    std::vector<GLfloat> data(windows.sources.size() * vertex_floats);
+    for (std::size_t vertex = 0; vertex < windows.sources.size(); ++vertex) {
+      std::copy_n(mesh.data.begin() + std::ptrdiff_t(windows.sources[vertex] * vertex_floats), vertex_floats,
+                  data.begin() + std::ptrdiff_t(vertex * vertex_floats));
+    }
+    mesh.data = std::move(data);
+    mesh.vertex_num = windows.sources.size();
+    mesh.indices = std::move(windows.indices);
+    parts = std::move(windows.parts);
+  }
+
+  std::vector<GLushort> narrowed(mesh.indices.size());
+  for (std::size_t i = 0; i < mesh.indices.size(); ++i) {
+    narrowed[i] = GLushort(mesh.indices[i]);
+  }
+  for (model::submesh const& part : parts) {
+    for (std::size_t i = part.first_index; i < part.first_index + part.index_count; ++i) {
+      narrowed[i] = GLushort(mesh.indices[i] - part.base_vertex);
+    }
+  }
+  mesh.indices.assign((narrowed.size() + 1) / 2, 0);
+  std::memcpy(mesh.indices.data(), narrowed.data(), narrowed.size() * sizeof(GLushort));
+  mesh.index_type = GL_UNSIGNED_SHORT;
+  // a single part only stays for its base vertex
+  if (parts.size() == 1 && parts.front().base_vertex == 0) {
+    parts.clear();
+  }
+  mesh.submeshes = parts;
+}
+
+void encode(GLuint const* values, std::size_t count, std::vector<std::uint8_t>& stream) {
+  std::size_t codes_begin = stream.size();
+  stream.resize(codes_begin + (count + 1) / 2, 0);
+  vertex_fifo fifo;
+  GLuint previous = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    GLuint value = values[i];
+    std::size_t age = fifo.find(value);
+    std::uint8_t code = CODE_ESCAPE;
+    if (value == fifo.next()) {
+      code = CODE_NEXT;
+      fifo.add(value);
+    }
+    else if (age < FIFO_SIZE) {
+      code = std::uint8_t(1 + age);
+    }
+    else {
+      write_varint(zigzag(value, previous), stream);
+      fifo.add(value);
+    }
+    stream[codes_begin + i / 2] |= std::uint8_t(code << (i % 2 * 4));
+    previous = value;
+  }
+}
+
+std::size_t decode(std::uint8_t const* stream, std::size_t size, GLuint* values, std::size_t count) {
+  std::size_t code_bytes = (count + 1) / 2;
+  if (size < code_bytes) {
+    throw std::runtime_error("index_codec: truncated stream");
+  }
+  std::size_t read = code_bytes;
+  vertex_fifo fifo;
+  GLuint previous = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::uint8_t code = std::uint8_t(stream[i / 2] >> (i % 2 * 4) & 0xf);
+    GLuint value;
+    if (code == CODE_NEXT) {
+      value = fifo.next();
+      fifo.add(value);
+    }
+    else if (code != CODE_ESCAPE) {
+      value = fifo.at(code - 1u);
+    }
+    else {
+      std::uint32_t delta = 0;
+      for (int shift = 0; ; shift += 7) {
+        if (read >= size || shift > 28) {
+          throw std::runtime_error("index_codec: truncated stream");
+        }
+        std::uint8_t byte = stream[read++];
+        delta |= std::uint32_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+          break;
+        }
+      }
+      value = unzigzag(delta, previous);
+      fifo.add(value);
+    }
+    values[i] = value;
+    previous = value;
+  }
+  return read;
+}
+
+}
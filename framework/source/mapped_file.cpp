@@ -0,0 +1,135 @@
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mapped_file::mapped_file()
+ :data_{nullptr}
+ ,size_{0}
+#ifdef _WIN32
+ ,file_handle_{nullptr}
+ ,mapping_handle_{nullptr}
+#endif
+{}
+
+mapped_file::mapped_file(std::string const& path)
+ :mapped_file{}
+{
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("mapped_file: could not open " + path);
+  }
+  LARGE_INTEGER file_size;
+  GetFileSizeEx(file, &file_size);
+  file_handle_ = file;
+  size_ = std::size_t(file_size.QuadPart);
+  // empty files can not be mapped
+  if (size_ == 0) {
+    return;
+  }
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    close();
+    throw std::runtime_error("mapped_file: could not map " + path);
+  }
+  mapping_handle_ = mapping;
+  data_ = static_cast<std::uint8_t const*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+  int file = ::open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error("mapped_file: could not open " + path);
+  }
+  struct stat file_stat;
+  if (fstat(file, &file_stat) != 0) {
+    ::close(file);
+    throw std::runtime_error("mapped_file: could not stat " + path);
+  }
+  size_ = std::size_t(file_stat.st_size);
+  // empty files can not be mapped
+  if (size_ == 0) {
+    ::close(file);
+    return;
+  }
+  void* ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+  // mapping stays valid after closing the descriptor
+  ::close(file);
+  if (ptr == MAP_FAILED) {
+    size_ = 0;
+    throw std::runtime_error("mapped_file: could not map " + path);
+  }
+  data_ = static_cast<std::uint8_t const*>(ptr);
+#endif
+  if (!data_) {
+    close();
+    throw std::runtime_error("mapped_file: could not map " + path);
+  }
+}
+
+mapped_file::~mapped_file() {
+  close();
+}
+
+mapped_file::mapped_file(mapped_file&& other)
+ :mapped_file{}
+{
+  *this = std::move(other);
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) {
+  if (this != &other) {
+    close();
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+#ifdef _WIN32
+    std::swap(file_handle_, other.file_handle_);
+    std::swap(mapping_handle_, other.mapping_handle_);
+#endif
+  }
+  return *this;
+}
+
+std::uint8_t const* mapped_file::data() const {
+  return data_;
+}
+
+std::size_t mapped_file::size() const {
+  return size_;
+}
+
+bool mapped_file::is_open() const {
+  return data_ != nullptr;
+}
+
+void mapped_file::close() {
+#ifdef _WIN32
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_handle_) {
+    CloseHandle(mapping_handle_);
+  }
+  if (file_handle_) {
+    CloseHandle(file_handle_);
+  }
+  file_handle_ = nullptr;
+  mapping_handle_ = nullptr;
+#else
+  if (data_) {
+    munmap(const_cast<std::uint8_t*>(data_), size_);
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+}
@@ -0,0 +1,337 @@
+#include "mesh_cache.hpp"
+
+#include "index_codec.hpp"
+
+#include <glbinding/gl/enum.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace {
+  // 2: optimized triangle and vertex order
+  // 3: quantized vertex formats
+  // 4: 16 bit and compressed indices, base vertices
+  // 5: normal generation settings
+  // 6: levels of detail
+  // 7: meshlets
+  // 8: bounds of parsed obj files taken from all three position components
+  const std::uint32_t FILE_VERSION = 8;
+  // vertices and indices start on cache lines
+  const std::size_t DATA_ALIGNMENT = 64;
+
+  std::size_t align(std::size_t offset, std::size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+
+  // layout of the model's attributes
+  std::vector<mesh_cache::attribute_info> layout_of(model const& layout) {
+    std::vector<mesh_cache::attribute_info> attributes;
+    for (auto const& supported_attribute : model::VERTEX_ATTRIBS) {
+      auto format = layout.formats.find(supported_attribute.flag);
+      if (format != layout.formats.end()) {
+        attributes.push_back(mesh_cache::attribute_info{std::uint32_t(format->second.flag),
+                                                        std::uint32_t(format->second.components),
+                                                        std::uint32_t(format->second.type),
+                                                        format->second.normalized ? 1u : 0u,
+                                                        std::uint32_t(reinterpret_cast<std::uintptr_t>(layout.offsets.at(format->first)))});
+      }
+    }
+    return attributes;
+  }
+
+  // draw ranges in index order, the codec restarts at each of them
+  std::vector<model::submesh> ranges_of(std::vector<model::submesh> const& submeshes, std::size_t index_count) {
+    std::vector<model::submesh> ranges = submeshes;
+    if (ranges.empty()) {
+      ranges.push_back(model::submesh{0, index_count, 0});
+    }
+    std::size_t covered = 0;
+    for (model::submesh const& range : ranges) {
+      if (range.first_index != covered) {
+        throw std::runtime_error("mesh_cache: submeshes do not cover the indices in order");
+      }
+      covered += range.index_count;
+    }
+    if (covered != index_count) {
+      throw std::runtime_error("mesh_cache: submeshes do not cover the indices in order");
+    }
+    return ranges;
+  }
+
+  std::vector<std::uint8_t> encode_indices(model const& built) {
+    std::vector<std::uint8_t> stream;
+    std::vector<GLuint> values;
+    for (model::submesh const& range : ranges_of(built.submeshes, built.index_count())) {
+      values.resize(range.index_count);
+      for (std::size_t i = 0; i < range.index_count; ++i) {
+        values[i] = built.index(range.first_index + i);
+      }
+      index_codec::encode(values.data(), values.size(), stream);
+    }
+    return stream;
+  }
+
+  // decoded indices in the storage of model::indices
+  std::vector<GLuint> decode_indices(std::uint8_t const* stream, std::size_t size, std::size_t index_count, GLenum index_type,
+                                     std::vector<model::submesh> const& submeshes) {
+    std::vector<GLuint> values(index_count);
+    std::size_t read = 0;
+    for (model::submesh const& range : ranges_of(submeshes, index_count)) {
+      read += index_codec::decode(stream + read, size - read, values.data() + range.first_index, range.index_count);
+    }
+    if (index_type == GL_UNSIGNED_INT) {
+      return values;
+    }
+    std::vector<GLushort> narrowed(index_count);
+    for (std::size_t i = 0; i < index_count; ++i) {
+      if (values[i] >= index_codec::SHORT_RANGE) {
+        throw std::runtime_error("mesh_cache: damaged indices");
+      }
+      narrowed[i] = GLushort(values[i]);
+    }
+    std::vector<GLuint> packed((index_count + 1) / 2, 0);
+    std::memcpy(packed.data(), narrowed.data(), narrowed.size() * sizeof(GLushort));
+    return packed;
+  }
+
+  // attribute formats of a stored layout, the order and the offsets are checked against the model built from them
+  std::vector<model::attribute> formats_of(mesh_cache::attribute_info const* attributes, std::size_t count) {
+    std::vector<model::attribute> formats;
+    for (std::size_t i = 0; i < count; ++i) {
+      mesh_cache::attribute_info const& stored = attributes[i];
+      GLenum type = GLenum(stored.type);
+      GLsizei size = 0;
+      if (type == GL_FLOAT || type == GL_INT_2_10_10_10_REV) {
+        size = 4;
+      }
+      else if (type == GL_UNSIGNED_SHORT) {
+        size = 2;
+      }
+      auto supported = std::find_if(model::VERTEX_ATTRIBS.begin(), model::VERTEX_ATTRIBS.end(),
+                                    [&stored](model::attribute const& attribute) {
+                                      return std::uint32_t(attribute.flag) == stored.flag;
+                                    });
+      if (supported == model::VERTEX_ATTRIBS.end() || size == 0 || stored.components < 1 || stored.components > 4
+          || stored.normalized > 1) {
+        throw std::runtime_error("mesh_cache: unsupported vertex layout");
+      }
+      formats.push_back(model::attribute{supported->flag, size, GLsizei(stored.components), type,
+                                         stored.normalized != 0});
+    }
+    return formats;
+  }
+}
+
+namespace mesh_cache {
+
+source_info source_of(std::string const& file_name, std::uint32_t import_attributes, std::uint32_t packed_formats,
+                      std::uint32_t index_codec, float crease_angle, bool angle_weighted, std::uint32_t lod_levels) {
+  struct stat file_stat;
+  if (stat(file_name.c_str(), &file_stat) != 0) {
+    throw std::runtime_error("mesh_cache: could not find " + file_name);
+  }
+  return source_info{std::uint64_t(file_stat.st_size), std::int64_t(file_stat.st_mtime), import_attributes, packed_formats, index_codec,
+                     crease_angle, angle_weighted ? 1u : 0u, lod_levels};
+}
+
+model load(std::string const& cached, source_info const& source) {
+  std::shared_ptr<mapped_file> file = std::make_shared<mapped_file>(cached);
+  std::uint8_t const* bytes = file->data();
+  if (file->size() < sizeof(file_header)) {
+    throw std::runtime_error("mesh_cache: truncated file");
+  }
+  file_header const* header = reinterpret_cast<file_header const*>(bytes);
+  GLenum index_type = GLenum(header->index_type);
+  if (std::memcmp(header->magic, "MESH", 4) != 0 || header->version != FILE_VERSION
+      || (index_type != GL_UNSIGNED_INT && index_type != GL_UNSIGNED_SHORT)
+      || (header->index_codec != index_codec::NONE && header->index_codec != index_codec::VERTEX_FIFO)) {
+    throw std::runtime_error("mesh_cache: invalid header");
+  }
+  if (header->source_size != source.size || header->source_time != source.time
+      || header->import_attributes != source.import_attributes || header->packed_formats != source.packed_formats
+      || header->index_codec != source.index_codec || header->crease_angle != source.crease_angle
+      || header->angle_weighted != source.angle_weighted || header->lod_levels != source.lod_levels) {
+    throw std::runtime_error("mesh_cache: outdated cache");
+  }
+  std::size_t index_size = index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+  std::size_t tables_end = sizeof(file_header) + header->attribute_count * sizeof(attribute_info)
+                         + header->submesh_count * sizeof(submesh_info) + header->lod_count * sizeof(lod_info)
+                         + header->meshlet_count * sizeof(meshlet_info);
+  if (file->size() < tables_end || header->vertex_offset < tables_end || header->index_offset < header->vertex_offset
+      || header->vertex_offset + header->vertex_count * header->vertex_bytes > header->index_offset
+      || header->index_offset + header->index_bytes > file->size()
+      || (header->index_codec == index_codec::NONE && header->index_bytes != header->index_count * index_size)) {
+    throw std::runtime_error("mesh_cache: data outside of file");
+  }
+
+  attribute_info const* attributes = reinterpret_cast<attribute_info const*>(bytes + sizeof(file_header));
+  submesh_info const* submeshes = reinterpret_cast<submesh_info const*>(attributes + header->attribute_count);
+  std::vector<model::submesh> parts;
+  for (std::size_t i = 0; i < header->submesh_count; ++i) {
+    if (submeshes[i].first_index + submeshes[i].index_count > header->index_count
+        || submeshes[i].base_vertex >= std::max(header->vertex_count, std::uint64_t(1))) {
+      throw std::runtime_error("mesh_cache: submesh outside of indices");
+    }
+    parts.push_back(model::submesh{std::size_t(submeshes[i].first_index), std::size_t(submeshes[i].index_count),
+                                   std::size_t(submeshes[i].base_vertex)});
+  }
+  lod_info const* lods = reinterpret_cast<lod_info const*>(submeshes + header->submesh_count);
+  std::vector<model::lod> levels;
+  for (std::size_t i = 0; i < header->lod_count; ++i) {
+    if (lods[i].first_index + lods[i].index_count > header->index_count) {
+      throw std::runtime_error("mesh_cache: level of detail outside of indices");
+    }
+    levels.push_back(model::lod{std::size_t(lods[i].first_index), std::size_t(lods[i].index_count), lods[i].error});
+  }
+  meshlet_info const* meshlets = reinterpret_cast<meshlet_info const*>(lods + header->lod_count);
+  std::vector<model::meshlet> clusters;
+  for (std::size_t i = 0; i < header->meshlet_count; ++i) {
+    if (meshlets[i].first_index + meshlets[i].index_count > header->index_count) {
+      throw std::runtime_error("mesh_cache: meshlet outside of indices");
+    }
+    clusters.push_back(model::meshlet{std::size_t(meshlets[i].first_index), std::size_t(meshlets[i].index_count),
+                                      glm::fvec4{meshlets[i].sphere[0], meshlets[i].sphere[1], meshlets[i].sphere[2], meshlets[i].sphere[3]},
+                                      glm::fvec4{meshlets[i].cone[0], meshlets[i].cone[1], meshlets[i].cone[2], meshlets[i].cone[3]}});
+  }
+
+  // compressed indices are decoded into the model, the vertices stay mapped
+  bool compressed = header->index_codec != index_codec::NONE;
+  model result{file, bytes + header->vertex_offset, std::size_t(header->vertex_count),
+               compressed ? nullptr : bytes + header->index_offset, std::size_t(header->index_count), index_type,
+               formats_of(attributes, header->attribute_count)};
+  if (compressed) {
+    result.indices = decode_indices(bytes + header->index_offset, std::size_t(header->index_bytes),
+                                    std::size_t(header->index_count), index_type, parts);
+  }
+  // caches written with another vertex layout are rebuilt
+  std::vector<attribute_info> expected = layout_of(result);
+  if (std::uint32_t(result.vertex_bytes) != header->vertex_bytes || expected.size() != header->attribute_count
+      || std::memcmp(expected.data(), attributes, expected.size() * sizeof(attribute_info)) != 0) {
+    throw std::runtime_error("mesh_cache: different vertex layout");
+  }
+
+  result.submeshes = std::move(parts);
+  result.lods = std::move(levels);
+  result.meshlets = std::move(clusters);
+  result.bounds_min = glm::fvec3{header->bounds_min[0], header->bounds_min[1], header->bounds_min[2]};
+  result.bounds_max = glm::fvec3{header->bounds_max[0], header->bounds_max[1], header->bounds_max[2]};
+  result.position_offset = glm::fvec3{header->position_offset[0], header->position_offset[1], header->position_offset[2]};
+  result.position_scale = glm::fvec3{header->position_scale[0], header->position_scale[1], header->position_scale[2]};
+  result.texcoord_offset = glm::fvec2{header->texcoord_offset[0], header->texcoord_offset[1]};
+  result.texcoord_scale = glm::fvec2{header->texcoord_scale[0], header->texcoord_scale[1]};
+  return result;
+}
+
+model store(std::string const& cached, model&& built, source_info const& source) {
+  std::vector<attribute_info> attributes = layout_of(built);
+  std::vector<submesh_info> submeshes;
+  for (model::submesh const& submesh : built.submeshes) {
+    submeshes.push_back(submesh_info{submesh.first_index, submesh.index_count, submesh.base_vertex});
+  }
+  std::vector<lod_info> lods;
+  for (model::lod const& lod : built.lods) {
+    lods.push_back(lod_info{lod.first_index, lod.index_count, lod.error, 0});
+  }
+  std::vector<meshlet_info> meshlets;
+  for (model::meshlet const& meshlet : built.meshlets) {
+    meshlets.push_back(meshlet_info{meshlet.first_index, meshlet.index_count,
+                                    {meshlet.sphere.x, meshlet.sphere.y, meshlet.sphere.z, meshlet.sphere.w},
+                                    {meshlet.cone.x, meshlet.cone.y, meshlet.cone.z, meshlet.cone.w}});
+  }
+  model::attrib_flag_t contained = 0;
+  for (attribute_info const& attribute : attributes) {
+    contained |= model::attrib_flag_t(attribute.flag);
+  }
+
+  file_header header{};
+  std::memcpy(header.magic, "MESH", 4);
+  header.version = FILE_VERSION;
+  header.source_size = source.size;
+  header.source_time = source.time;
+  header.import_attributes = source.import_attributes;
+  header.packed_formats = source.packed_formats;
+  header.crease_angle = source.crease_angle;
+  header.angle_weighted = source.angle_weighted;
+  header.lod_levels = source.lod_levels;
+  header.attributes = std::uint32_t(contained);
+  header.attribute_count = std::uint32_t(attributes.size());
+  header.submesh_count = std::uint32_t(submeshes.size());
+  header.lod_count = std::uint32_t(lods.size());
+  header.meshlet_count = std::uint32_t(meshlets.size());
+  header.vertex_bytes = std::uint32_t(built.vertex_bytes);
+  header.index_type = std::uint32_t(built.index_type);
+  header.index_codec = source.index_codec;
+  header.vertex_count = built.vertex_num;
+  header.index_count = built.index_count();
+  for (int i = 0; i < 3; ++i) {
+    header.bounds_min[i] = built.bounds_min[i];
+    header.bounds_max[i] = built.bounds_max[i];
+    header.position_offset[i] = built.position_offset[i];
+    header.position_scale[i] = built.position_scale[i];
+  }
+  for (int i = 0; i < 2; ++i) {
+    header.texcoord_offset[i] = built.texcoord_offset[i];
+    header.texcoord_scale[i] = built.texcoord_scale[i];
+  }
+  std::size_t tables_end = sizeof(file_header) + attributes.size() * sizeof(attribute_info) + submeshes.size() * sizeof(submesh_info)
+                         + lods.size() * sizeof(lod_info) + meshlets.size() * sizeof(meshlet_info);
+  header.vertex_offset = align(tables_end, DATA_ALIGNMENT);
+  header.index_offset = align(std::size_t(header.vertex_offset) + built.vertex_data_bytes(), DATA_ALIGNMENT);
+  std::vector<std::uint8_t> encoded;
+  if (source.index_codec == index_codec::VERTEX_FIFO) {
+    encoded = encode_indices(built);
+  }
+  header.index_bytes = source.index_codec == index_codec::NONE ? built.index_data_bytes() : encoded.size();
+
+  // write to temporary file first to never leave a truncated cache behind
+  std::string temp_path = cached + ".tmp";
+  bool written = false;
+  {
+    std::ofstream cache_file(temp_path, std::ios::binary | std::ios::trunc);
+    const char padding[DATA_ALIGNMENT] = {};
+    cache_file.write(reinterpret_cast<char const*>(&header), sizeof(file_header));
+    cache_file.write(reinterpret_cast<char const*>(attributes.data()), std::streamsize(attributes.size() * sizeof(attribute_info)));
+    cache_file.write(reinterpret_cast<char const*>(submeshes.data()), std::streamsize(submeshes.size() * sizeof(submesh_info)));
+    cache_file.write(reinterpret_cast<char const*>(lods.data()), std::streamsize(lods.size() * sizeof(lod_info)));
+    cache_file.write(reinterpret_cast<char const*>(meshlets.data()), std::streamsize(meshlets.size() * sizeof(meshlet_info)));
+    cache_file.write(padding, std::streamsize(std::size_t(header.vertex_offset) - tables_end));
+    cache_file.write(static_cast<char const*>(built.vertex_data()), std::streamsize(built.vertex_data_bytes()));
+    cache_file.write(padding, std::streamsize(std::size_t(header.index_offset - header.vertex_offset) - built.vertex_data_bytes()));
+    if (source.index_codec == index_codec::NONE) {
+      cache_file.write(static_cast<char const*>(built.index_data()), std::streamsize(built.index_data_bytes()));
+    }
+    else {
+      cache_file.write(reinterpret_cast<char const*>(encoded.data()), std::streamsize(encoded.size()));
+    }
+    written = bool(cache_file);
+  }
+  std::remove(cached.c_str());
+  if (written && std::rename(temp_path.c_str(), cached.c_str()) == 0) {
+    // the mapping replaces the vectors, which are freed on return
+    try {
+      return load(cached, source);
+    }
+    catch (std::runtime_error&) {
+      // could not be mapped again, keep the data in memory below
+    }
+  }
+  else {
+    std::remove(temp_path.c_str());
+    std::cerr << "mesh_cache: could not write " << cached << ", using uncached model" << std::endl;
+  }
+  return std::move(built);
+}
+
+std::string cache_path(std::string const& file_name) {
+  return file_name + ".mesh";
+}
+
+}
@@ -0,0 +1,328 @@
+#include "mesh_optimizer.hpp"
+
+#include "thread_pool.hpp"
+
+#include <glbinding/gl/enum.h>
+
+// use floats and med precision operations
+#include <glm/gtc/type_precision.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+  // marks a vertex without triangles left and an unassigned vertex
+  const GLuint NONE = 0xffffffffu;
+
+  // fifo cache emulated with insertion times, a vertex is cached while fewer than cache_size vertices were inserted after it
+  class vertex_cache {
+   public:
+    vertex_cache(std::size_t vertex_count, std::size_t cache_size)
+     :stamps_(vertex_count, 0)
+     ,time_{cache_size + 1}
+     ,size_{cache_size}
+    {}
+
+    // returns true if the vertex had to be transformed
+    bool access(GLuint vertex) {
+      if (time_ - stamps_[vertex] > size_) {
+        stamps_[vertex] = time_++;
+        return true;
+      }
+      return false;
+    }
+
+    // time since the vertex was inserted
+    std::size_t age(GLuint vertex) const {
+      return time_ - stamps_[vertex];
+    }
+
+    void clear() {
+      time_ += size_ + 1;
+    }
+
+   private:
+    std::vector<std::size_t> stamps_;
+    std::size_t time_;
+    std::size_t size_;
+  };
+
+  // next vertex with triangles left, first from the vertices emitted most recently, then in index order
+  GLuint skip_dead_end(std::vector<GLuint>& dead_end, std::vector<std::uint32_t> const& live, std::size_t& cursor) {
+    while (!dead_end.empty()) {
+      GLuint vertex = dead_end.back();
+      dead_end.pop_back();
+      if (live[vertex] > 0) {
+        return vertex;
+      }
+    }
+    for (; cursor < live.size(); ++cursor) {
+      if (live[cursor] > 0) {
+        return GLuint(cursor);
+      }
+    }
+    return NONE;
+  }
+
+  glm::fvec3 position(float const* positions, std::size_t stride, GLuint vertex) {
+    float const* p = positions + std::size_t(vertex) * stride;
+    return glm::fvec3{p[0], p[1], p[2]};
+  }
+}
+
+namespace mesh_optimizer {
+
+cache_statistics analyze_vertex_cache(GLuint const* indices, std::size_t index_count, std::size_t vertex_count,
+                                      std::size_t cache_size) {
+  vertex_cache cache{vertex_count, cache_size};
+  std::vector<char> referenced(vertex_count, 0);
+  std::size_t transformed = 0;
+  std::size_t used = 0;
+  for (std::size_t i = 0; i < index_count; ++i) {
+    transformed += cache.access(indices[i]) ? 1 : 0;
+    used += referenced[indices[i]] ? 0 : 1;
+    referenced[indices[i]] = 1;
+  }
+  std::size_t triangles = index_count / 3;
+  return cache_statistics{triangles ? float(transformed) / float(triangles) : 0.0f,
+                          used ? float(transformed) / float(used) : 0.0f};
+}
+
+std::vector<std::size_t> optimize_vertex_cache(GLuint* indices, std::size_t index_count, std::size_t vertex_count,
+                                               std::size_t cache_size) {
+  std::size_t triangle_count = index_count / 3;
+  // triangles around each vertex in compressed rows
+  std::vector<std::uint32_t> first_triangle(vertex_count + 1, 0);
+  for (std::size_t i = 0; i < triangle_count * 3; ++i) {
+    ++first_triangle[indices[i] + 1];
+  }
+  for (std::size_t i = 0; i < vertex_count; ++i) {
+    first_triangle[i + 1] += first_triangle[i];
+  }
+  std::vector<std::uint32_t> adjacency(triangle_count * 3);
+  std::vector<std::uint32_t> filled(first_triangle.begin(), first_triangle.end() - 1);
+  for (std::size_t i = 0; i < triangle_count * 3; ++i) {
+    adjacency[filled[indices[i]]++] = std::uint32_t(i / 3);
+  }
+  // triangles not emitted yet per vertex
+  std::vector<std::uint32_t> live(vertex_count);
+  for (std::size_t i = 0; i < vertex_count; ++i) {
+    live[i] = first_triangle[i + 1] - first_triangle[i];
+  }
+
+  vertex_cache cache{vertex_count, cache_size};
+  std::vector<char> emitted(triangle_count, 0);
+  std::vector<GLuint> dead_end;
+  std::vector<GLuint> candidates;
+  std::vector<GLuint> output(triangle_count * 3);
+  std::vector<std::size_t> clusters;
+  std::size_t written = 0;
+  std::size_t cursor = 0;
+  GLuint fanning = skip_dead_end(dead_end, live, cursor);
+  if (fanning != NONE) {
+    clusters.push_back(0);
+  }
+  while (fanning != NONE) {
+    // emit all remaining triangles around the fanning vertex
+    candidates.clear();
+    for (std::uint32_t i = first_triangle[fanning]; i < first_triangle[fanning + 1]; ++i) {
+      std::uint32_t triangle = adjacency[i];
+      if (emitted[triangle]) {
+        continue;
+      }
+      emitted[triangle] = 1;
+      for (std::size_t corner = 0; corner < 3; ++corner) {
+        GLuint vertex = indices[triangle * 3 + corner];
+        output[written++] = vertex;
+        dead_end.push_back(vertex);
+        candidates.push_back(vertex);
+        --live[vertex];
+        cache.access(vertex);
+      }
+    }
+
+    // continue with the candidate staying in the cache the longest while its triangles are emitted
+    GLuint next = NONE;
+    std::size_t best_priority = 0;
+    for (GLuint vertex : candidates) {
+      if (live[vertex] == 0) {
+        continue;
+      }
+      std::size_t priority = 1;
+      if (cache.age(vertex) + 2 * live[vertex] <= cache_size) {
+        priority = cache.age(vertex) + 1;
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        next = vertex;
+      }
+    }
+    if (next == NONE) {
+      next = skip_dead_end(dead_end, live, cursor);
+      if (next != NONE) {
+        clusters.push_back(written / 3);
+      }
+    }
+    fanning = next;
+  }
+
+  std::copy(output.begin(), output.end(), indices);
+  return clusters;
+}
+
+void optimize_overdraw(GLuint* indices, std::size_t index_count, float const* positions, std::size_t stride,
+                       std::vector<std::size_t> const& clusters, float threshold, std::size_t cache_size) {
+  std::size_t triangle_count = index_count / 3;
+  if (triangle_count == 0) {
+    return;
+  }
+  std::size_t vertex_count = std::size_t(*std::max_element(indices, indices + triangle_count * 3)) + 1;
+
+  // split each cluster where the misses so far are close to the rate of the whole cluster
+  vertex_cache cache{vertex_count, cache_size};
+  std::vector<std::size_t> starts;
+  for (std::size_t c = 0; c < clusters.size(); ++c) {
+    std::size_t begin = clusters[c];
+    std::size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+    std::size_t cluster_misses = 0;
+    cache.clear();
+    for (std::size_t i = begin * 3; i < end * 3; ++i) {
+      cluster_misses += cache.access(indices[i]) ? 1 : 0;
+    }
+    float limit = threshold * float(cluster_misses) / float(end - begin);
+
+    starts.push_back(begin);
+    std::size_t start = begin;
+    std::size_t misses = 0;
+    cache.clear();
+    for (std::size_t triangle = begin; triangle + 1 < end; ++triangle) {
+      for (std::size_t corner = 0; corner < 3; ++corner) {
+        misses += cache.access(indices[triangle * 3 + corner]) ? 1 : 0;
+      }
+      if (float(misses) <= limit * float(triangle + 1 - start)) {
+        start = triangle + 1;
+        starts.push_back(start);
+        misses = 0;
+        cache.clear();
+      }
+    }
+  }
+  starts.push_back(triangle_count);
+
+  // area weighted centers and normals of the clusters and the mesh
+  std::size_t cluster_count = starts.size() - 1;
+  std::vector<glm::fvec3> centers(cluster_count, glm::fvec3{0.0f});
+  std::vector<glm::fvec3> normals(cluster_count, glm::fvec3{0.0f});
+  glm::fvec3 mesh_center{0.0f};
+  float mesh_area = 0.0f;
+  for (std::size_t c = 0; c < cluster_count; ++c) {
+    float cluster_area = 0.0f;
+    for (std::size_t triangle = starts[c]; triangle < starts[c + 1]; ++triangle) {
+      glm::fvec3 a = position(positions, stride, indices[triangle * 3]);
+      glm::fvec3 b = position(positions, stride, indices[triangle * 3 + 1]);
+      glm::fvec3 d = position(positions, stride, indices[triangle * 3 + 2]);
+      glm::fvec3 normal = glm::cross(b - a, d - a);
+      float area = glm::length(normal);
+      centers[c] += (a + b + d) * (area / 3.0f);
+      normals[c] += normal;
+      cluster_area += area;
+    }
+    mesh_center += centers[c];
+    mesh_area += cluster_area;
+    centers[c] = cluster_area > 0.0f ? centers[c] / cluster_area : centers[c];
+  }
+  mesh_center = mesh_area > 0.0f ? mesh_center / mesh_area : mesh_center;
+
+  std::vector<float> outwards(cluster_count);
+  for (std::size_t c = 0; c < cluster_count; ++c) {
+    float length = glm::length(normals[c]);
+    outwards[c] = length > 0.0f ? glm::dot(centers[c] - mesh_center, normals[c] / length) : 0.0f;
+  }
+  std::vector<std::size_t> order(cluster_count);
+  for (std::size_t c = 0; c < cluster_count; ++c) {
+    order[c] = c;
+  }
+  std::stable_sort(order.begin(), order.end(), [&outwards](std::size_t a, std::size_t b) {
+    return outwards[a] > outwards[b];
+  });
+
+  std::vector<GLuint> sorted;
+  sorted.reserve(triangle_count * 3);
+  for (std::size_t c : order) {
+    sorted.insert(sorted.end(), indices + starts[c] * 3, indices + starts[c + 1] * 3);
+  }
+  std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+void optimize_vertex_fetch(model& mesh) {
+  if (mesh.file) {
+    throw std::invalid_argument("mesh_optimizer: model refers to a mapped file");
+  }
+  std::vector<GLuint> remap(mesh.vertex_num, NONE);
+  GLuint next = 0;
+  for (GLuint& index : mesh.indices) {
+    if (remap[index] == NONE) {
+      remap[index] = next++;
+    }
+    index = remap[index];
+  }
+  // unreferenced vertices keep their order behind the referenced ones
+  for (GLuint& target : remap) {
+    if (target == NONE) {
+      target = next++;
+    }
+  }
+
+  std::size_t stride = std::size_t(mesh.vertex_bytes) / sizeof(GLfloat);
+  std::vector<GLfloat> reordered(mesh.data.size());
+  thread_pool::shared().parallel_for(0, mesh.vertex_num, std::size_t(1) << 14, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t vertex = begin; vertex < end; ++vertex) {
+      std::memcpy(&reordered[remap[vertex] * stride], &mesh.data[vertex * stride], stride * sizeof(GLfloat));
+    }
+  });
+  mesh.data.swap(reordered);
+}
+
+void optimize(model& mesh) {
+  if (mesh.file) {
+    throw std::invalid_argument("mesh_optimizer: model refers to a mapped file");
+  }
+  if (mesh.formats.at(model::POSITION).type != GL_FLOAT) {
+    throw std::invalid_argument("mesh_optimizer: positions are quantized");
+  }
+  if (mesh.index_type != GL_UNSIGNED_INT) {
+    throw std::invalid_argument("mesh_optimizer: indices are narrowed");
+  }
+  std::vector<model::submesh> ranges = mesh.submeshes;
+  if (ranges.empty()) {
+    ranges.push_back(model::submesh{0, mesh.indices.size(), 0});
+  }
+  std::size_t stride = std::size_t(mesh.vertex_bytes) / sizeof(GLfloat);
+  // triangles never move between submeshes, so these are optimized in parallel
+  thread_pool::shared().parallel_for(0, ranges.size(), 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      GLuint* indices = mesh.indices.data() + ranges[i].first_index;
+      std::size_t count = ranges[i].index_count;
+      if (count < 3) {
+        continue;
+      }
+      // the vertices of a submesh are mostly contiguous, working on their range keeps the tables small
+      GLuint first = *std::min_element(indices, indices + count);
+      GLuint last = *std::max_element(indices, indices + count);
+      for (std::size_t j = 0; j < count; ++j) {
+        indices[j] -= first;
+      }
+      std::vector<std::size_t> clusters = optimize_vertex_cache(indices, count, std::size_t(last - first) + 1);
+      optimize_overdraw(indices, count, mesh.data.data() + std::size_t(first) * stride, stride, clusters);
+      for (std::size_t j = 0; j < count; ++j) {
+        indices[j] += first;
+      }
+    }
+  });
+  optimize_vertex_fetch(mesh);
+}
+
+}
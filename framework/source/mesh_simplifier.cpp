@@ -0,0 +1,567 @@
+#include "mesh_simplifier.hpp"
+
+#include <glbinding/gl/enum.h>
+
+// use floats and med precision operations
+#include <glm/gtc/type_precision.hpp>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+  // marks a vertex without open edges in a direction
+  const GLuint NONE = 0xffffffffu;
+  // marks a vertex with several open edges in a direction
+  const GLuint SEVERAL = 0xfffffffeu;
+  // triangles around a collapse may turn by up to 75 degrees
+  const float FLIP_COS = 0.25f;
+  // and keep this fraction of their area, collinear corners would leave slivers
+  const float MIN_AREA_RATIO = 1.0e-3f;
+  // planes through open edges keep borders and seams in place, relative to the planes of the triangles
+  const double BORDER_WEIGHT = 10.0;
+  // cost of joining opposite normals relative to the squared length of the collapsed edge
+  const float NORMAL_WEIGHT = 1.0f;
+
+  // how a vertex may move: onto any neighbour, along the open edges of a border, along a seam together
+  // with the other vertex at its position, or not at all
+  enum vertex_kind : std::uint8_t {
+    KIND_MANIFOLD,
+    KIND_BORDER,
+    KIND_SEAM,
+    KIND_LOCKED
+  };
+
+  // weighted sum of squared distances to planes as symmetric matrix, vector and constant
+  struct quadric {
+    double a00, a11, a22, a01, a02, a12;
+    double b0, b1, b2;
+    double c;
+    double weight;
+  };
+
+  // plane through the point with the unit normal
+  quadric plane_quadric(glm::dvec3 const& normal, glm::dvec3 const& point, double weight) {
+    double d = -glm::dot(normal, point);
+    return quadric{weight * normal.x * normal.x, weight * normal.y * normal.y, weight * normal.z * normal.z,
+                   weight * normal.x * normal.y, weight * normal.x * normal.z, weight * normal.y * normal.z,
+                   weight * normal.x * d, weight * normal.y * d, weight * normal.z * d,
+                   weight * d * d, weight};
+  }
+
+  void accumulate(quadric& sum, quadric const& addend) {
+    sum.a00 += addend.a00;
+    sum.a11 += addend.a11;
+    sum.a22 += addend.a22;
+    sum.a01 += addend.a01;
+    sum.a02 += addend.a02;
+    sum.a12 += addend.a12;
+    sum.b0 += addend.b0;
+    sum.b1 += addend.b1;
+    sum.b2 += addend.b2;
+    sum.c += addend.c;
+    sum.weight += addend.weight;
+  }
+
+  // mean squared distance of the point to the planes
+  double evaluate(quadric const& q, glm::fvec3 const& point) {
+    double x = point.x;
+    double y = point.y;
+    double z = point.z;
+    double sum = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+               + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+    return q.weight > 0.0 ? std::max(sum / q.weight, 0.0) : 0.0;
+  }
+
+  struct collapse {
+    GLuint from;
+    GLuint to;
+    float cost;
+  };
+
+  // positions relative to the bounding sphere and the topology of the triangles left, rebuilt every pass
+  class simplifier {
+   public:
+    explicit simplifier(model const& mesh)
+     :positions_(mesh.vertex_num)
+     ,normals_{}
+     ,remap_(mesh.vertex_num)
+     ,wedge_(mesh.vertex_num)
+     ,offsets_{}
+     ,triangles_{}
+     ,open_out_{}
+     ,open_in_{}
+     ,kinds_{}
+     ,quadrics_{}
+    {
+      std::size_t stride = std::size_t(mesh.vertex_bytes) / sizeof(GLfloat);
+      glm::fvec3 min{0.0f};
+      glm::fvec3 max{0.0f};
+      for (std::size_t v = 0; v < mesh.vertex_num; ++v) {
+        positions_[v] = glm::fvec3{mesh.data[v * stride], mesh.data[v * stride + 1], mesh.data[v * stride + 2]};
+        min = v == 0 ? positions_[v] : glm::min(min, positions_[v]);
+        max = v == 0 ? positions_[v] : glm::max(max, positions_[v]);
+      }
+      glm::fvec3 center = (min + max) * 0.5f;
+      float radius = glm::length(max - min) * 0.5f;
+      float inverse_radius = radius > 0.0f ? 1.0f / radius : 1.0f;
+      for (glm::fvec3& position : positions_) {
+        position = (position - center) * inverse_radius;
+      }
+      auto normal = mesh.formats.find(model::NORMAL.flag);
+      if (normal != mesh.formats.end() && normal->second.type == GL_FLOAT) {
+        std::size_t offset = std::size_t(reinterpret_cast<std::uintptr_t>(mesh.offsets.at(model::NORMAL.flag))) / sizeof(GLfloat);
+        normals_.resize(mesh.vertex_num);
+        for (std::size_t v = 0; v < mesh.vertex_num; ++v) {
+          float const* values = &mesh.data[v * stride + offset];
+          normals_[v] = glm::fvec3{values[0], values[1], values[2]};
+          float length = glm::length(normals_[v]);
+          normals_[v] = length > 0.0f ? normals_[v] / length : normals_[v];
+        }
+      }
+
+      // vertices at the same position differ in texture coordinates or normals, they form a ring through wedge_
+      // and share the quadric of the first one
+      std::vector<GLuint> order(mesh.vertex_num);
+      for (std::size_t v = 0; v < order.size(); ++v) {
+        order[v] = GLuint(v);
+      }
+      std::vector<glm::fvec3> const& positions = positions_;
+      std::sort(order.begin(), order.end(), [&positions](GLuint a, GLuint b) {
+        glm::fvec3 const& p = positions[a];
+        glm::fvec3 const& q = positions[b];
+        if (p.x != q.x) {
+          return p.x < q.x;
+        }
+        if (p.y != q.y) {
+          return p.y < q.y;
+        }
+        if (p.z != q.z) {
+          return p.z < q.z;
+        }
+        return a < b;
+      });
+      for (std::size_t first = 0; first < order.size(); ) {
+        std::size_t last = first + 1;
+        while (last < order.size() && positions_[order[last]] == positions_[order[first]]) {
+          ++last;
+        }
+        for (std::size_t i = first; i < last; ++i) {
+          remap_[order[i]] = order[first];
+          wedge_[order[i]] = order[i + 1 < last ? i + 1 : first];
+        }
+        first = last;
+      }
+    }
+
+    // collapse edges in passes until the target or the error is reached, the triangles are compacted in place
+    float simplify(std::vector<GLuint>& indices, std::vector<std::uint32_t>& groups, std::size_t target_index_count,
+                   float target_error) {
+      std::size_t vertex_count = positions_.size();
+      double error_limit = double(target_error) * double(target_error);
+      double largest = 0.0;
+      build_topology(indices, groups);
+      build_quadrics(indices);
+      std::vector<GLuint> collapse_remap(vertex_count);
+      std::vector<std::uint8_t> moved(vertex_count);
+      std::vector<collapse> candidates;
+      while (indices.size() > target_index_count) {
+        candidates.clear();
+        for (std::size_t corner = 0; corner < indices.size(); ++corner) {
+          GLuint a = indices[corner];
+          GLuint b = indices[corner - corner % 3 + (corner + 1) % 3];
+          // inner edges are seen from both triangles, open edges only once
+          if (remap_[a] == remap_[b] || (remap_[a] > remap_[b] && open_out_[a] != b)) {
+            continue;
+          }
+          float forward = cost(a, b);
+          float backward = cost(b, a);
+          if (forward < backward) {
+            candidates.push_back(collapse{a, b, forward});
+          }
+          else if (backward < HUGE_VALF) {
+            candidates.push_back(collapse{b, a, backward});
+          }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](collapse const& x, collapse const& y) {
+          return x.cost < y.cost || (x.cost == y.cost && (x.from < y.from || (x.from == y.from && x.to < y.to)));
+        });
+
+        for (std::size_t v = 0; v < vertex_count; ++v) {
+          collapse_remap[v] = GLuint(v);
+        }
+        std::fill(moved.begin(), moved.end(), std::uint8_t(0));
+        std::size_t triangle_count = indices.size() / 3;
+        std::size_t target_triangles = target_index_count / 3;
+        std::size_t collapsed = 0;
+        for (collapse const& candidate : candidates) {
+          if (triangle_count <= target_triangles || double(candidate.cost) > error_limit) {
+            break;
+          }
+          // every position moves or receives at most once per pass, the costs of the others stay valid
+          if (moved[remap_[candidate.from]] || moved[remap_[candidate.to]]) {
+            continue;
+          }
+          std::size_t removed = 0;
+          if (flips(candidate.from, candidate.to, collapse_remap, indices, removed)) {
+            continue;
+          }
+          GLuint v = candidate.from;
+          do {
+            if (!triangles_of(v).empty()) {
+              collapse_remap[v] = v == candidate.from ? candidate.to : partner(v, candidate.to);
+            }
+            v = wedge_[v];
+          } while (v != candidate.from);
+          accumulate(quadrics_[remap_[candidate.to]], quadrics_[remap_[candidate.from]]);
+          moved[remap_[candidate.from]] = 1;
+          moved[remap_[candidate.to]] = 1;
+          largest = std::max(largest, double(candidate.cost));
+          triangle_count -= std::min(removed, triangle_count);
+          ++collapsed;
+        }
+        if (collapsed == 0) {
+          break;
+        }
+
+        std::size_t kept = 0;
+        for (std::size_t triangle = 0; triangle < indices.size() / 3; ++triangle) {
+          GLuint a = collapse_remap[indices[triangle * 3]];
+          GLuint b = collapse_remap[indices[triangle * 3 + 1]];
+          GLuint c = collapse_remap[indices[triangle * 3 + 2]];
+          if (remap_[a] == remap_[b] || remap_[b] == remap_[c] || remap_[c] == remap_[a]) {
+            continue;
+          }
+          indices[kept * 3] = a;
+          indices[kept * 3 + 1] = b;
+          indices[kept * 3 + 2] = c;
+          groups[kept] = groups[triangle];
+          ++kept;
+        }
+        indices.resize(kept * 3);
+        groups.resize(kept);
+        build_topology(indices, groups);
+      }
+      return float(std::sqrt(largest));
+    }
+
+   private:
+    struct triangle_range {
+      std::uint32_t const* first;
+      std::uint32_t const* last;
+
+      bool empty() const {
+        return first == last;
+      }
+    };
+
+    triangle_range triangles_of(GLuint vertex) const {
+      return triangle_range{triangles_.data() + offsets_[vertex], triangles_.data() + offsets_[vertex + 1]};
+    }
+
+    // the triangles of each vertex, the open edges and the kinds
+    void build_topology(std::vector<GLuint> const& indices, std::vector<std::uint32_t> const& groups) {
+      std::size_t vertex_count = positions_.size();
+      offsets_.assign(vertex_count + 1, 0);
+      for (GLuint vertex : indices) {
+        ++offsets_[vertex + 1];
+      }
+      for (std::size_t v = 0; v < vertex_count; ++v) {
+        offsets_[v + 1] += offsets_[v];
+      }
+      triangles_.resize(indices.size());
+      std::vector<std::uint32_t> next(offsets_.begin(), offsets_.end() - 1);
+      for (std::size_t corner = 0; corner < indices.size(); ++corner) {
+        triangles_[next[indices[corner]]++] = std::uint32_t(corner / 3);
+      }
+
+      open_out_.assign(vertex_count, NONE);
+      open_in_.assign(vertex_count, NONE);
+      for (std::size_t corner = 0; corner < indices.size(); ++corner) {
+        GLuint a = indices[corner];
+        GLuint b = indices[corner - corner % 3 + (corner + 1) % 3];
+        if (has_edge(b, a, indices)) {
+          continue;
+        }
+        open_out_[a] = open_out_[a] == NONE ? b : SEVERAL;
+        open_in_[b] = open_in_[b] == NONE ? a : SEVERAL;
+      }
+
+      // positions shared by triangles of different submeshes keep the submeshes closed
+      std::vector<std::uint32_t> position_groups(vertex_count, NONE);
+      std::vector<std::uint8_t> position_locked(vertex_count, 0);
+      for (std::size_t corner = 0; corner < indices.size(); ++corner) {
+        std::uint32_t& group = position_groups[remap_[indices[corner]]];
+        if (group != NONE && group != groups[corner / 3]) {
+          position_locked[remap_[indices[corner]]] = 1;
+        }
+        group = groups[corner / 3];
+      }
+
+      kinds_.assign(vertex_count, KIND_LOCKED);
+      for (std::size_t v = 0; v < vertex_count; ++v) {
+        if (triangles_of(GLuint(v)).empty() || position_locked[remap_[v]]) {
+          continue;
+        }
+        // other vertex at the position that still has triangles
+        GLuint other = NONE;
+        std::size_t copies = 1;
+        for (GLuint w = wedge_[v]; w != v; w = wedge_[w]) {
+          if (!triangles_of(w).empty()) {
+            other = w;
+            ++copies;
+          }
+        }
+        bool single_out = open_out_[v] < SEVERAL;
+        bool single_in = open_in_[v] < SEVERAL;
+        if (copies == 1 && open_out_[v] == NONE && open_in_[v] == NONE) {
+          kinds_[v] = KIND_MANIFOLD;
+        }
+        else if (copies == 1 && single_out && single_in) {
+          kinds_[v] = KIND_BORDER;
+        }
+        else if (copies == 2 && single_out && single_in && open_out_[other] < SEVERAL && open_in_[other] < SEVERAL
+                 && remap_[open_out_[v]] == remap_[open_in_[other]] && remap_[open_in_[v]] == remap_[open_out_[other]]) {
+          kinds_[v] = KIND_SEAM;
+        }
+      }
+    }
+
+    bool has_edge(GLuint a, GLuint b, std::vector<GLuint> const& indices) const {
+      triangle_range range = triangles_of(a);
+      for (std::uint32_t const* triangle = range.first; triangle != range.last; ++triangle) {
+        for (std::size_t k = 0; k < 3; ++k) {
+          if (indices[*triangle * 3 + k] == a && indices[*triangle * 3 + (k + 1) % 3] == b) {
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+
+    // planes of the triangles weighted by their area, planes through the open edges perpendicular to their triangle
+    void build_quadrics(std::vector<GLuint> const& indices) {
+      quadrics_.assign(positions_.size(), quadric{0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0});
+      for (std::size_t triangle = 0; triangle < indices.size() / 3; ++triangle) {
+        glm::dvec3 corners[3];
+        for (std::size_t k = 0; k < 3; ++k) {
+          corners[k] = glm::dvec3{positions_[indices[triangle * 3 + k]]};
+        }
+        glm::dvec3 normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+        double length = glm::length(normal);
+        if (length == 0.0) {
+          continue;
+        }
+        normal /= length;
+        quadric face = plane_quadric(normal, corners[0], length * 0.5);
+        for (std::size_t k = 0; k < 3; ++k) {
+          accumulate(quadrics_[remap_[indices[triangle * 3 + k]]], face);
+        }
+        for (std::size_t k = 0; k < 3; ++k) {
+          GLuint a = indices[triangle * 3 + k];
+          GLuint b = indices[triangle * 3 + (k + 1) % 3];
+          if (has_edge(b, a, indices)) {
+            continue;
+          }
+          glm::dvec3 edge = corners[(k + 1) % 3] - corners[k];
+          glm::dvec3 border_normal = glm::cross(edge, normal);
+          double edge_length = glm::length(border_normal);
+          if (edge_length == 0.0) {
+            continue;
+          }
+          quadric border = plane_quadric(border_normal / edge_length, corners[k], edge_length * edge_length * BORDER_WEIGHT);
+          accumulate(quadrics_[remap_[a]], border);
+          accumulate(quadrics_[remap_[b]], border);
+        }
+      }
+    }
+
+    // vertex at the position of to that the other vertex at the position of a seam vertex moves onto
+    GLuint partner(GLuint vertex, GLuint to) const {
+      if (open_out_[vertex] < SEVERAL && remap_[open_out_[vertex]] == remap_[to]) {
+        return open_out_[vertex];
+      }
+      if (open_in_[vertex] < SEVERAL && remap_[open_in_[vertex]] == remap_[to]) {
+        return open_in_[vertex];
+      }
+      return NONE;
+    }
+
+    // squared error of moving from onto to, HUGE_VALF if the kind of from does not allow it
+    float cost(GLuint from, GLuint to) const {
+      switch (kinds_[from]) {
+      case KIND_MANIFOLD:
+        break;
+      case KIND_BORDER:
+        if (to != open_out_[from] && to != open_in_[from]) {
+          return HUGE_VALF;
+        }
+        break;
+      case KIND_SEAM:
+        if (to != open_out_[from] && to != open_in_[from]) {
+          return HUGE_VALF;
+        }
+        for (GLuint w = wedge_[from]; w != from; w = wedge_[w]) {
+          if (!triangles_of(w).empty() && partner(w, to) == NONE) {
+            return HUGE_VALF;
+          }
+        }
+        break;
+      default:
+        return HUGE_VALF;
+      }
+      double error = evaluate(quadrics_[remap_[from]], positions_[to]);
+      if (!normals_.empty()) {
+        glm::fvec3 edge = positions_[to] - positions_[from];
+        error += double(NORMAL_WEIGHT * (1.0f - glm::dot(normals_[from], normals_[to])) * glm::dot(edge, edge));
+      }
+      return float(error);
+    }
+
+    // true if a triangle around from would turn too far or collapse to a sliver, removed receives the triangles collapsing to lines
+    bool flips(GLuint from, GLuint to, std::vector<GLuint> const& collapse_remap, std::vector<GLuint> const& indices,
+               std::size_t& removed) const {
+      GLuint v = from;
+      do {
+        triangle_range range = triangles_of(v);
+        for (std::uint32_t const* triangle = range.first; triangle != range.last; ++triangle) {
+          GLuint corners[3];
+          for (std::size_t k = 0; k < 3; ++k) {
+            corners[k] = collapse_remap[indices[*triangle * 3 + k]];
+          }
+          glm::fvec3 before = glm::cross(positions_[corners[1]] - positions_[corners[0]], positions_[corners[2]] - positions_[corners[0]]);
+          for (std::size_t k = 0; k < 3; ++k) {
+            if (corners[k] == v) {
+              corners[k] = v == from ? to : partner(v, to);
+            }
+          }
+          // triangles along the edge
+          if (remap_[corners[0]] == remap_[corners[1]] || remap_[corners[1]] == remap_[corners[2]]
+              || remap_[corners[2]] == remap_[corners[0]]) {
+            ++removed;
+            continue;
+          }
+          glm::fvec3 after = glm::cross(positions_[corners[1]] - positions_[corners[0]], positions_[corners[2]] - positions_[corners[0]]);
+          float before_length = glm::length(before);
+          float after_length = glm::length(after);
+          if (before_length > 0.0f && (glm::dot(before, after) <= FLIP_COS * before_length * after_length
+                                       || after_length <= MIN_AREA_RATIO * before_length)) {
+            return true;
+          }
+        }
+        v = wedge_[v];
+      } while (v != from);
+      return false;
+    }
+
+    std::vector<glm::fvec3> positions_;
+    // unit normals, empty without float normals
+    std::vector<glm::fvec3> normals_;
+    // first vertex at the same position and the next one in the ring of vertices at it
+    std::vector<GLuint> remap_;
+    std::vector<GLuint> wedge_;
+    // triangles of vertex v are triangles_[offsets_[v]] to triangles_[offsets_[v + 1]]
+    std::vector<std::uint32_t> offsets_;
+    std::vector<std::uint32_t> triangles_;
+    // other end of the single open edge leaving or entering a vertex, NONE or SEVERAL
+    std::vector<GLuint> open_out_;
+    std::vector<GLuint> open_in_;
+    std::vector<std::uint8_t> kinds_;
+    // one per position, at its first vertex
+    std::vector<quadric> quadrics_;
+  };
+
+  void check(model const& mesh) {
+    if (mesh.file) {
+      throw std::invalid_argument("mesh_simplifier: model refers to a mapped file");
+    }
+    if (mesh.formats.at(model::POSITION.flag).type != GL_FLOAT) {
+      throw std::invalid_argument("mesh_simplifier: positions are quantized");
+    }
+    if (mesh.index_type != GL_UNSIGNED_INT) {
+      throw std::invalid_argument("mesh_simplifier: indices are narrowed");
+    }
+  }
+
+  // submesh of every triangle, consecutive submeshes of the whole index range otherwise
+  std::vector<std::uint32_t> groups_of(model const& mesh) {
+    std::vector<std::uint32_t> groups(mesh.indices.size() / 3, 0);
+    for (std::size_t part = 0; part < mesh.submeshes.size(); ++part) {
+      std::size_t first = mesh.submeshes[part].first_index / 3;
+      std::size_t last = std::min((mesh.submeshes[part].first_index + mesh.submeshes[part].index_count) / 3, groups.size());
+      std::fill(groups.begin() + std::ptrdiff_t(std::min(first, last)), groups.begin() + std::ptrdiff_t(last), std::uint32_t(part));
+    }
+    return groups;
+  }
+}
+
+namespace mesh_simplifier {
+
+std::vector<GLuint> simplify(model const& mesh, std::size_t target_index_count, float target_error, float* error) {
+  check(mesh);
+  std::vector<GLuint> indices{mesh.indices.begin(), mesh.indices.begin() + std::ptrdiff_t(mesh.indices.size() / 3 * 3)};
+  std::vector<std::uint32_t> groups = groups_of(mesh);
+  float result = simplifier{mesh}.simplify(indices, groups, target_index_count, target_error);
+  if (error != nullptr) {
+    *error = result;
+  }
+  return indices;
+}
+
+void generate_lods(model& mesh, std::size_t levels, float max_error) {
+  check(mesh);
+  if (!mesh.lods.empty()) {
+    throw std::invalid_argument("mesh_simplifier: model has levels of detail already");
+  }
+  if (levels == 0 || mesh.indices.empty()) {
+    return;
+  }
+  std::vector<GLuint> full{mesh.indices.begin(), mesh.indices.begin() + std::ptrdiff_t(mesh.indices.size() / 3 * 3)};
+  std::vector<std::uint32_t> full_groups = groups_of(mesh);
+  std::size_t group_count = std::max(mesh.submeshes.size(), std::size_t(1));
+  simplifier reducer{mesh};
+
+  std::vector<model::lod> lods{model::lod{0, mesh.indices.size(), 0.0f}};
+  std::vector<model::submesh> parts = mesh.submeshes;
+  if (parts.empty()) {
+    parts.push_back(model::submesh{0, mesh.indices.size(), 0});
+  }
+  std::vector<GLuint> indices = std::move(full);
+  std::vector<std::uint32_t> groups = std::move(full_groups);
+  float error = 0.0f;
+  for (std::size_t level = 1; level <= levels; ++level) {
+    // each level continues from the previous one, the errors add up to a bound of the distance to the full detail
+    std::size_t previous = indices.size();
+    error += reducer.simplify(indices, groups, previous / 6 * 3, max_error - error);
+    if (indices.empty() || float(indices.size()) > float(previous) * MIN_LOD_REDUCTION) {
+      break;
+    }
+    // the triangles of a level are ordered by submesh, each becomes a submesh of the level
+    std::size_t first = mesh.indices.size();
+    for (std::uint32_t group = 0; group < group_count; ++group) {
+      std::size_t part_first = mesh.indices.size();
+      for (std::size_t triangle = 0; triangle < groups.size(); ++triangle) {
+        if (groups[triangle] == group) {
+          mesh.indices.insert(mesh.indices.end(), indices.begin() + std::ptrdiff_t(triangle * 3),
+                              indices.begin() + std::ptrdiff_t(triangle * 3 + 3));
+        }
+      }
+      if (mesh.indices.size() > part_first) {
+        parts.push_back(model::submesh{part_first, mesh.indices.size() - part_first, 0});
+      }
+    }
+    lods.push_back(model::lod{first, mesh.indices.size() - first, error});
+  }
+  if (lods.size() == 1) {
+    return;
+  }
+  mesh.index_num = mesh.indices.size();
+  mesh.submeshes = std::move(parts);
+  mesh.lods = std::move(lods);
+}
+
+}
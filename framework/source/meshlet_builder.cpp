@@ -0,0 +1,307 @@
+#include "meshlet_builder.hpp"
+
+#include "mesh_optimizer.hpp"
+
+#include <glbinding/gl/enum.h>
+
+// use floats and med precision operations
+#include <glm/gtc/type_precision.hpp>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+  // marks a vertex outside the current meshlet
+  const std::uint32_t NONE = 0xffffffffu;
+  // normals spreading further than about 84 degrees from the axis leave no camera position to cull from
+  const float MIN_CONE_DOT = 0.1f;
+  const float UNORM16_MAX = 65535.0f;
+  // triangles in index order searched for the next one where a meshlet's surface ends
+  const std::size_t LOOKAHEAD = 256;
+
+  // model space positions of all vertices, quantized ones mapped back through position_offset and position_scale
+  std::vector<glm::fvec3> positions_of(model const& mesh) {
+    model::attribute const& format = mesh.formats.at(model::POSITION.flag);
+    std::size_t offset = std::size_t(reinterpret_cast<std::uintptr_t>(mesh.offsets.at(model::POSITION.flag)));
+    std::uint8_t const* vertices = static_cast<std::uint8_t const*>(mesh.vertex_data());
+    std::vector<glm::fvec3> positions(mesh.vertex_num);
+    for (std::size_t i = 0; i < mesh.vertex_num; ++i) {
+      std::uint8_t const* position = vertices + i * std::size_t(mesh.vertex_bytes) + offset;
+      if (format.type == GL_FLOAT) {
+        float unpacked[3];
+        std::memcpy(unpacked, position, sizeof(unpacked));
+        positions[i] = glm::fvec3{unpacked[0], unpacked[1], unpacked[2]};
+      }
+      else {
+        GLushort packed[3];
+        std::memcpy(packed, position, sizeof(packed));
+        glm::fvec3 normalized{float(packed[0]) / UNORM16_MAX, float(packed[1]) / UNORM16_MAX, float(packed[2]) / UNORM16_MAX};
+        positions[i] = mesh.position_offset + mesh.position_scale * normalized;
+      }
+    }
+    return positions;
+  }
+
+  // index positions no meshlet reaches across, the borders of submeshes and levels of detail in order
+  std::vector<std::size_t> boundaries_of(model const& mesh) {
+    std::vector<std::size_t> boundaries{0, mesh.index_count()};
+    for (model::submesh const& part : mesh.submeshes) {
+      boundaries.push_back(part.first_index);
+      boundaries.push_back(part.first_index + part.index_count);
+    }
+    for (model::lod const& level : mesh.lods) {
+      boundaries.push_back(level.first_index);
+      boundaries.push_back(level.first_index + level.index_count);
+    }
+    std::sort(boundaries.begin(), boundaries.end());
+    boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+    return boundaries;
+  }
+
+  // sphere around the vertices and cone around the unit normals of the triangles, degenerate ones have none
+  model::meshlet bound(std::size_t first_index, std::size_t index_count, std::vector<GLuint> const& vertices,
+                       std::vector<glm::fvec3> const& normals, std::vector<glm::fvec3> const& positions) {
+    glm::fvec3 min = positions[vertices.front()];
+    glm::fvec3 max = min;
+    for (GLuint vertex : vertices) {
+      min = glm::min(min, positions[vertex]);
+      max = glm::max(max, positions[vertex]);
+    }
+    glm::fvec3 center = (min + max) * 0.5f;
+    float radius = 0.0f;
+    for (GLuint vertex : vertices) {
+      radius = std::max(radius, glm::length(positions[vertex] - center));
+    }
+
+    glm::fvec3 sum{0.0f};
+    for (glm::fvec3 const& normal : normals) {
+      sum += normal;
+    }
+    float length = glm::length(sum);
+    glm::fvec3 axis = length > 0.0f ? sum / length : glm::fvec3{0.0f, 0.0f, 1.0f};
+    float min_dot = length > 0.0f ? 1.0f : -1.0f;
+    for (glm::fvec3 const& normal : normals) {
+      min_dot = std::min(min_dot, glm::dot(normal, axis));
+    }
+    // sine of the largest angle to the axis, the view direction has to stay that far from perpendicular
+    float cutoff = min_dot <= MIN_CONE_DOT ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+    return model::meshlet{first_index, index_count, glm::fvec4{center, radius}, glm::fvec4{axis, cutoff}};
+  }
+}
+
+namespace meshlet_builder {
+
+std::vector<model::meshlet> build(model& mesh, std::size_t max_vertices, std::size_t max_triangles) {
+  if (max_vertices < 3 || max_triangles == 0) {
+    throw std::invalid_argument("meshlet_builder: a meshlet needs room for a triangle");
+  }
+  if (mesh.file) {
+    throw std::invalid_argument("meshlet_builder: model refers to a mapped file");
+  }
+  std::vector<model::meshlet> meshlets;
+  std::size_t triangle_count = mesh.index_count() / 3;
+  if (triangle_count == 0) {
+    return meshlets;
+  }
+  std::vector<glm::fvec3> positions = positions_of(mesh);
+  std::vector<GLuint> indices = mesh.vertex_indices();
+  std::vector<std::size_t> boundaries = boundaries_of(mesh);
+  std::size_t split_triangles = std::size_t(float(max_triangles) * CONE_SPLIT_FILL);
+
+  std::vector<glm::fvec3> normals(triangle_count);
+  for (std::size_t triangle = 0; triangle < triangle_count; ++triangle) {
+    GLuint const* corners = &indices[triangle * 3];
+    glm::fvec3 normal = glm::cross(positions[corners[1]] - positions[corners[0]], positions[corners[2]] - positions[corners[0]]);
+    float length = glm::length(normal);
+    normals[triangle] = length > 0.0f ? normal / length : normal;
+  }
+  // triangles around each vertex, as offsets into one list
+  std::vector<std::size_t> adjacency_offsets(mesh.vertex_num + 1, 0);
+  for (GLuint vertex : indices) {
+    ++adjacency_offsets[vertex + 1];
+  }
+  for (std::size_t vertex = 0; vertex < mesh.vertex_num; ++vertex) {
+    adjacency_offsets[vertex + 1] += adjacency_offsets[vertex];
+  }
+  std::vector<std::uint32_t> adjacency(indices.size());
+  std::vector<std::size_t> filled(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+  for (std::size_t i = 0; i < indices.size(); ++i) {
+    adjacency[filled[indices[i]]++] = std::uint32_t(i / 3);
+  }
+
+  // meshlet each vertex was last added to and its position in the meshlet's vertices,
+  // and meshlet each triangle was last offered to as candidate
+  std::vector<std::uint32_t> owner(mesh.vertex_num, NONE);
+  std::vector<GLuint> local_of(mesh.vertex_num, 0);
+  std::vector<std::uint32_t> offered(triangle_count, NONE);
+  std::vector<bool> emitted(triangle_count, false);
+  std::uint32_t current = 0;
+  // triangles in meshlet order, and per meshlet its vertices, unit normals and their sum
+  std::vector<std::uint32_t> order;
+  order.reserve(triangle_count);
+  // stored indices in meshlet order and those of a meshlet numbered by its vertices
+  std::vector<GLuint> stored;
+  stored.reserve(triangle_count * 3);
+  std::vector<GLuint> local;
+  std::vector<GLuint> vertices;
+  std::vector<glm::fvec3> cone_normals;
+  std::vector<std::uint32_t> candidates;
+  glm::fvec3 normal_sum{0.0f};
+  // box around the vertices of the meshlet
+  glm::fvec3 min{std::numeric_limits<float>::max()};
+  glm::fvec3 max{-std::numeric_limits<float>::max()};
+
+  auto new_vertices = [&](std::size_t triangle) {
+    GLuint const* corners = &indices[triangle * 3];
+    std::size_t added = 0;
+    for (std::size_t k = 0; k < 3; ++k) {
+      bool repeated = (k > 0 && corners[k] == corners[0]) || (k > 1 && corners[k] == corners[1]);
+      added += owner[corners[k]] != current && !repeated ? 1 : 0;
+    }
+    return added;
+  };
+  // whether the triangle fits and keeps the cone of a meshlet holding some triangles below 90 degrees
+  auto accepts = [&](std::size_t triangle, std::size_t triangles) {
+    bool turns = triangles >= split_triangles && glm::dot(normals[triangle], normal_sum) < 0.0f;
+    return vertices.size() + new_vertices(triangle) <= max_vertices && !turns;
+  };
+  auto add = [&](std::size_t triangle, std::size_t first, std::size_t last) {
+    emitted[triangle] = true;
+    order.push_back(std::uint32_t(triangle));
+    for (std::size_t k = 0; k < 3; ++k) {
+      GLuint corner = indices[triangle * 3 + k];
+      if (owner[corner] == current) {
+        continue;
+      }
+      owner[corner] = current;
+      local_of[corner] = GLuint(vertices.size());
+      vertices.push_back(corner);
+      min = glm::min(min, positions[corner]);
+      max = glm::max(max, positions[corner]);
+      for (std::size_t j = adjacency_offsets[corner]; j < adjacency_offsets[corner + 1]; ++j) {
+        std::uint32_t neighbour = adjacency[j];
+        if (!emitted[neighbour] && offered[neighbour] != current && neighbour >= first && neighbour < last) {
+          offered[neighbour] = current;
+          candidates.push_back(neighbour);
+        }
+      }
+    }
+    if (glm::dot(normals[triangle], normals[triangle]) > 0.0f) {
+      cone_normals.push_back(normals[triangle]);
+      normal_sum += normals[triangle];
+    }
+  };
+
+  for (std::size_t segment = 0; segment + 1 < boundaries.size(); ++segment) {
+    std::size_t first = boundaries[segment] / 3;
+    std::size_t last = boundaries[segment + 1] / 3;
+    std::size_t seed = first;
+    while (true) {
+      while (seed < last && emitted[seed]) {
+        ++seed;
+      }
+      if (seed == last) {
+        break;
+      }
+      std::size_t first_index = order.size() * 3;
+      add(seed, first, last);
+      std::size_t triangles = 1;
+      while (triangles < max_triangles) {
+        // grow along the surface, preferring triangles without new vertices and facing like the meshlet
+        glm::fvec3 axis = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : glm::fvec3{0.0f};
+        std::size_t best = NONE;
+        float best_score = 0.0f;
+        std::size_t kept = 0;
+        for (std::uint32_t candidate : candidates) {
+          if (emitted[candidate]) {
+            continue;
+          }
+          candidates[kept++] = candidate;
+          if (!accepts(candidate, triangles)) {
+            continue;
+          }
+          float score = float(new_vertices(candidate)) + CONE_WEIGHT * (1.0f - glm::dot(normals[candidate], axis));
+          if (best == NONE || score < best_score) {
+            best = candidate;
+            best_score = score;
+          }
+        }
+        candidates.resize(kept);
+        // where the surface ends continue with a triangle among the next ones in index order, which mesh_optimizer
+        // placed nearby, facing like the meshlet and close to its center
+        while (best == NONE && seed < last && emitted[seed]) {
+          ++seed;
+        }
+        if (best == NONE) {
+          glm::fvec3 center = (min + max) * 0.5f;
+          float extent = std::max(glm::length(max - min), std::numeric_limits<float>::min());
+          std::size_t end = std::min(last, seed + LOOKAHEAD);
+          for (std::size_t candidate = seed; candidate < end; ++candidate) {
+            if (emitted[candidate] || !accepts(candidate, triangles)) {
+              continue;
+            }
+            GLuint const* corners = &indices[candidate * 3];
+            glm::fvec3 centroid = (positions[corners[0]] + positions[corners[1]] + positions[corners[2]]) / 3.0f;
+            float score = glm::length(centroid - center) / extent + CONE_WEIGHT * (1.0f - glm::dot(normals[candidate], axis));
+            if (best == NONE || score < best_score) {
+              best = candidate;
+              best_score = score;
+            }
+          }
+        }
+        if (best == NONE) {
+          break;
+        }
+        add(best, first, last);
+        ++triangles;
+      }
+      meshlets.push_back(bound(first_index, triangles * 3, vertices, cone_normals, positions));
+
+      // the growth order leaves the vertex cache behind, the triangles inside the meshlet are reordered for it;
+      // all lie in one submesh, so the stored values differ from the vertices by the same base vertex
+      std::size_t first_triangle = first_index / 3;
+      local.clear();
+      for (std::size_t i = first_triangle; i < order.size(); ++i) {
+        for (std::size_t k = 0; k < 3; ++k) {
+          local.push_back(local_of[indices[std::size_t(order[i]) * 3 + k]]);
+        }
+      }
+      mesh_optimizer::optimize_vertex_cache(local.data(), local.size(), vertices.size());
+      std::size_t first_corner = std::size_t(order[first_triangle]) * 3;
+      GLuint base_vertex = indices[first_corner] - mesh.index(first_corner);
+      for (GLuint vertex : local) {
+        stored.push_back(vertices[vertex] - base_vertex);
+      }
+      ++current;
+      vertices.clear();
+      cone_normals.clear();
+      candidates.clear();
+      normal_sum = glm::fvec3{0.0f};
+      min = glm::fvec3{std::numeric_limits<float>::max()};
+      max = glm::fvec3{-std::numeric_limits<float>::max()};
+    }
+  }
+
+  // the triangles in meshlet order replace the stored ones
+  if (mesh.index_type == GL_UNSIGNED_SHORT) {
+    std::vector<GLushort> narrowed(stored.begin(), stored.end());
+    std::memcpy(mesh.indices.data(), narrowed.data(), narrowed.size() * sizeof(GLushort));
+  }
+  else {
+    std::copy(stored.begin(), stored.end(), mesh.indices.begin());
+  }
+  return meshlets;
+}
+
+void generate_meshlets(model& mesh) {
+  mesh.meshlets = build(mesh);
+}
+
+}
@@ -0,0 +1,304 @@
+#include "mipmap.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+  // rgba texel in floating point, aligned for sse loads
+  struct alignas(16) texel {
+    float c[4];
+  };
+
+  // contributions of the source texels to each destination texel along one axis
+  struct axis_taps {
+    std::size_t count;
+    // weights, count per destination texel
+    std::vector<float> weights;
+    // source indices clamped to the edge, count per destination texel
+    std::vector<std::size_t> indices;
+  };
+
+  // rows processed per parallel task
+  const std::size_t ROW_GRAIN = 16;
+  // kaiser window shape and radius in destination texels
+  const double KAISER_ALPHA = 4.0;
+  const double KAISER_RADIUS = 2.0;
+  const std::size_t SRGB_TABLE_SIZE = 16384;
+
+  std::size_t channel_count(GLenum channels) {
+    if (channels == GL_RED) {
+      return 1;
+    }
+    else if (channels == GL_RG) {
+      return 2;
+    }
+    else if (channels == GL_RGB) {
+      return 3;
+    }
+    else if (channels == GL_RGBA) {
+      return 4;
+    }
+    throw std::invalid_argument("mipmap: unsupported channel format");
+  }
+
+  // zeroth order modified bessel function of the first kind
+  double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+    }
+    return sum;
+  }
+
+  double kaiser_sinc(double t) {
+    if (std::fabs(t) >= KAISER_RADIUS) {
+      return 0.0;
+    }
+    double pi_t = 3.14159265358979323846 * t;
+    double sinc = t == 0.0 ? 1.0 : std::sin(pi_t) / pi_t;
+    double ratio = t / KAISER_RADIUS;
+    return sinc * bessel_i0(KAISER_ALPHA * std::sqrt(1.0 - ratio * ratio)) / bessel_i0(KAISER_ALPHA);
+  }
+
+  axis_taps compute_taps(std::size_t source_size, std::size_t target_size, mipmap::filter kind) {
+    double scale = double(source_size) / double(target_size);
+    double radius = kind == mipmap::filter::box ? scale * 0.5 : KAISER_RADIUS * scale;
+
+    axis_taps taps{};
+    taps.count = std::size_t(std::ceil(radius * 2.0)) + 1;
+    taps.weights.resize(target_size * taps.count);
+    taps.indices.resize(target_size * taps.count);
+
+    for (std::size_t target = 0; target < target_size; ++target) {
+      double center = (double(target) + 0.5) * scale;
+      long first = long(std::floor(center - radius));
+      double sum = 0.0;
+      for (std::size_t tap = 0; tap < taps.count; ++tap) {
+        long source = first + long(tap);
+        double weight = 0.0;
+        if (kind == mipmap::filter::box) {
+          // coverage of the source texel by the destination footprint
+          double begin = std::max(double(source), center - radius);
+          double end = std::min(double(source + 1), center + radius);
+          weight = std::max(end - begin, 0.0);
+        }
+        else {
+          weight = kaiser_sinc((double(source) + 0.5 - center) / scale);
+        }
+        taps.weights[target * taps.count + tap] = float(weight);
+        taps.indices[target * taps.count + tap] = std::size_t(std::min(std::max(source, 0l), long(source_size) - 1));
+        sum += weight;
+      }
+      for (std::size_t tap = 0; tap < taps.count; ++tap) {
+        taps.weights[target * taps.count + tap] = float(taps.weights[target * taps.count + tap] / sum);
+      }
+    }
+    return taps;
+  }
+
+  // weighted sum of texels, one texel per sse register
+  inline texel accumulate(texel const* const* sources, float const* weights, std::size_t count) {
+#ifdef MIPMAP_SSE2
+    __m128 sum = _mm_setzero_ps();
+    for (std::size_t i = 0; i < count; ++i) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(sources[i]->c), _mm_set1_ps(weights[i])));
+    }
+    texel result;
+    _mm_store_ps(result.c, sum);
+    return result;
+#else
+    texel result{{0.0f, 0.0f, 0.0f, 0.0f}};
+    for (std::size_t i = 0; i < count; ++i) {
+      for (std::size_t c = 0; c < 4; ++c) {
+        result.c[c] += sources[i]->c[c] * weights[i];
+      }
+    }
+    return result;
+#endif
+  }
+
+  float srgb_to_linear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+  }
+
+  float linear_to_srgb(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+  }
+
+  // lookup tables for decoding bytes and encoding linear values
+  struct srgb_tables {
+    srgb_tables()
+     :decode(256)
+     ,encode(SRGB_TABLE_SIZE)
+    {
+      for (std::size_t i = 0; i < decode.size(); ++i) {
+        decode[i] = srgb_to_linear(float(i) / 255.0f);
+      }
+      for (std::size_t i = 0; i < encode.size(); ++i) {
+        float value = linear_to_srgb(float(i) / float(SRGB_TABLE_SIZE - 1));
+        encode[i] = std::uint8_t(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+      }
+    }
+
+    std::vector<float> decode;
+    std::vector<std::uint8_t> encode;
+  };
+
+  srgb_tables const& tables() {
+    static const srgb_tables instance{};
+    return instance;
+  }
+
+  std::uint8_t quantize(float value) {
+    return std::uint8_t(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+  }
+
+  // expand to floating point rgba in the space texels are averaged in
+  std::vector<texel> to_texels(pixel_data const& image, std::size_t components, mipmap::color_space space) {
+    std::vector<texel> texels(image.width * image.height);
+    std::vector<float> const& decode = tables().decode;
+    thread_pool::shared().parallel_for(0, image.height, ROW_GRAIN, [&](std::size_t row_begin, std::size_t row_end) {
+      for (std::size_t i = row_begin * image.width; i < row_end * image.width; ++i) {
+        std::uint8_t const* source = &image.pixels[i * components];
+        texel& target = texels[i];
+        target.c[0] = target.c[1] = target.c[2] = 0.0f;
+        target.c[3] = 1.0f;
+        for (std::size_t c = 0; c < components; ++c) {
+          float value = float(source[c]) / 255.0f;
+          if (c < 3 && space == mipmap::color_space::srgb) {
+            value = decode[source[c]];
+          }
+          else if (c < 3 && space == mipmap::color_space::normal) {
+            value = value * 2.0f - 1.0f;
+          }
+          target.c[c] = value;
+        }
+      }
+    });
+    return texels;
+  }
+
+  void renormalize(std::vector<texel>& texels) {
+    for (texel& t : texels) {
+      float length = std::sqrt(t.c[0] * t.c[0] + t.c[1] * t.c[1] + t.c[2] * t.c[2]);
+      if (length > 1e-6f) {
+        t.c[0] /= length;
+        t.c[1] /= length;
+        t.c[2] /= length;
+      }
+    }
+  }
+
+  pixel_data to_pixels(std::vector<texel> const& texels, std::size_t width, std::size_t height,
+                       pixel_data const& format, std::size_t components, mipmap::color_space space) {
+    std::vector<std::uint8_t> pixels(width * height * components);
+    std::vector<std::uint8_t> const& encode = tables().encode;
+    thread_pool::shared().parallel_for(0, height, ROW_GRAIN, [&](std::size_t row_begin, std::size_t row_end) {
+      for (std::size_t i = row_begin * width; i < row_end * width; ++i) {
+        texel const& source = texels[i];
+        for (std::size_t c = 0; c < components; ++c) {
+          float value = source.c[c];
+          std::uint8_t result = 0;
+          if (c < 3 && space == mipmap::color_space::srgb) {
+            float position = std::min(std::max(value, 0.0f), 1.0f) * float(SRGB_TABLE_SIZE - 1);
+            result = encode[std::size_t(position + 0.5f)];
+          }
+          else if (c < 3 && space == mipmap::color_space::normal) {
+            result = quantize(value * 0.5f + 0.5f);
+          }
+          else {
+            result = quantize(value);
+          }
+          pixels[i * components + c] = result;
+        }
+      }
+    });
+    return pixel_data{std::move(pixels), format.channels, format.channel_type, width, height};
+  }
+
+  // separable resampling, first along rows into a temporary image, then along columns
+  std::vector<texel> downsample(std::vector<texel> const& source, std::size_t width, std::size_t height,
+                                std::size_t target_width, std::size_t target_height, mipmap::filter kind) {
+    axis_taps horizontal = compute_taps(width, target_width, kind);
+    axis_taps vertical = compute_taps(height, target_height, kind);
+    thread_pool& pool = thread_pool::shared();
+
+    std::vector<texel> rows(target_width * height);
+    pool.parallel_for(0, height, ROW_GRAIN, [&](std::size_t row_begin, std::size_t row_end) {
+      std::vector<texel const*> sources(horizontal.count);
+      for (std::size_t y = row_begin; y < row_end; ++y) {
+        texel const* row = &source[y * width];
+        for (std::size_t x = 0; x < target_width; ++x) {
+          for (std::size_t tap = 0; tap < horizontal.count; ++tap) {
+            sources[tap] = row + horizontal.indices[x * horizontal.count + tap];
+          }
+          rows[y * target_width + x] = accumulate(sources.data(), &horizontal.weights[x * horizontal.count], horizontal.count);
+        }
+      }
+    });
+
+    std::vector<texel> result(target_width * target_height);
+    pool.parallel_for(0, target_height, ROW_GRAIN, [&](std::size_t row_begin, std::size_t row_end) {
+      std::vector<texel const*> sources(vertical.count);
+      for (std::size_t y = row_begin; y < row_end; ++y) {
+        for (std::size_t x = 0; x < target_width; ++x) {
+          for (std::size_t tap = 0; tap < vertical.count; ++tap) {
+            sources[tap] = &rows[vertical.indices[y * vertical.count + tap] * target_width + x];
+          }
+          result[y * target_width + x] = accumulate(sources.data(), &vertical.weights[y * vertical.count], vertical.count);
+        }
+      }
+    });
+    return result;
+  }
+}
+
+namespace mipmap {
+
+std::size_t level_count(std::size_t width, std::size_t height) {
+  std::size_t levels = 1;
+  for (std::size_t size = std::max(width, height); size > 1; size /= 2) {
+    ++levels;
+  }
+  return levels;
+}
+
+std::vector<pixel_data> generate(pixel_data const& base, color_space space, filter kind) {
+  if (base.channel_type != GL_UNSIGNED_BYTE) {
+    throw std::invalid_argument("mipmap: only 8 bit channels are supported");
+  }
+  std::size_t components = channel_count(base.channels);
+
+  // each level is filtered from the unquantized previous one
+  std::vector<pixel_data> levels{};
+  std::size_t count = level_count(base.width, base.height);
+  levels.reserve(count - 1);
+  std::vector<texel> texels = to_texels(base, components, space);
+  std::size_t width = base.width;
+  std::size_t height = base.height;
+  for (std::size_t level = 1; level < count; ++level) {
+    std::size_t target_width = std::max(width / 2, std::size_t(1));
+    std::size_t target_height = std::max(height / 2, std::size_t(1));
+    texels = downsample(texels, width, height, target_width, target_height, kind);
+    if (space == color_space::normal) {
+      renormalize(texels);
+    }
+    levels.push_back(to_pixels(texels, target_width, target_height, base, components, space));
+    width = target_width;
+    height = target_height;
+  }
+  return levels;
+}
+
+}
@@ -3,13 +3,16 @@
 #include <glbinding/gl/enum.h>
 
 #include <cstdint>
+#include <cstring>
+#include <utility>
 
 std::vector<model::attribute> const model::VERTEX_ATTRIBS
  = {  
     /*POSITION*/{ 1 << 0, sizeof(float), 3, GL_FLOAT},
     /*NORMAL*/{   1 << 1, sizeof(float), 3, GL_FLOAT},
     /*TEXCOORD*/{ 1 << 2, sizeof(float), 2, GL_FLOAT},
-    /*TANGENT*/{  1 << 3, sizeof(float), 3, GL_FLOAT},
+    // handedness of the frame in w, the bitangent is w * cross(normal, tangent)
+    /*TANGENT*/{  1 << 3, sizeof(float), 4, GL_FLOAT},
     /*BITANGENT*/{1 << 4, sizeof(float), 3, GL_FLOAT}
  };
 
@@ -20,35 +23,141 @@ model::attribute const& model::TANGENT = model::VERTEX_ATTRIBS[3];
 model::attribute const& model::BITANGENT = model::VERTEX_ATTRIBS[4];
 model::attribute const  model::INDEX{1 << 5, sizeof(unsigned),  1, GL_UNSIGNED_INT};
 
+namespace {
+  // the float formats of the contained attributes
+  std::vector<model::attribute> float_formats(model::attrib_flag_t contained_attributes) {
+    std::vector<model::attribute> formats;
+    for (auto const& supported_attribute : model::VERTEX_ATTRIBS) {
+      if (supported_attribute.flag & contained_attributes) {
+        formats.push_back(supported_attribute);
+      }
+    }
+    return formats;
+  }
+}
+
+GLsizei model::attribute::bytes() const {
+  return type == GL_INT_2_10_10_10_REV ? size : size * components;
+}
+
 model::model()
  :data{}
  ,indices{}
+ ,index_type{GL_UNSIGNED_INT}
  ,offsets{}
+ ,formats{}
  ,vertex_bytes{0}
  ,vertex_num{0}
+ ,index_num{0}
+ ,submeshes{}
+ ,lods{}
+ ,meshlets{}
+ ,bounds_min{0.0f}
+ ,bounds_max{0.0f}
+ ,position_offset{0.0f}
+ ,position_scale{1.0f}
+ ,texcoord_offset{0.0f}
+ ,texcoord_scale{1.0f}
+ ,file{}
+ ,file_vertices{nullptr}
+ ,file_indices{nullptr}
 {}
 
 model::model(std::vector<GLfloat> const& databuff, attrib_flag_t contained_attributes, std::vector<GLuint> const& trianglebuff)
- :data(databuff)
- ,indices(trianglebuff)
+ :model(std::vector<GLfloat>(databuff), contained_attributes, std::vector<GLuint>(trianglebuff))
+{}
+
+model::model(std::vector<GLfloat>&& databuff, attrib_flag_t contained_attributes, std::vector<GLuint>&& trianglebuff)
+ :model(std::move(databuff), float_formats(contained_attributes), std::move(trianglebuff))
+{}
+
+model::model(std::vector<GLfloat>&& databuff, std::vector<attribute> const& attribs, std::vector<GLuint>&& trianglebuff)
+ :data(std::move(databuff))
+ ,indices(std::move(trianglebuff))
+ ,index_type{GL_UNSIGNED_INT}
  ,offsets{}
+ ,formats{}
  ,vertex_bytes{0}
  ,vertex_num{0}
+ ,index_num{indices.size()}
+ ,submeshes{}
+ ,lods{}
+ ,meshlets{}
+ ,bounds_min{0.0f}
+ ,bounds_max{0.0f}
+ ,position_offset{0.0f}
+ ,position_scale{1.0f}
+ ,texcoord_offset{0.0f}
+ ,texcoord_scale{1.0f}
+ ,file{}
+ ,file_vertices{nullptr}
+ ,file_indices{nullptr}
 {
-  // number of components per vertex
-  std::size_t component_num = 0;
-
-  for (auto const& supported_attribute : model::VERTEX_ATTRIBS) {
-    // check if buffer contains attribute
-    if (supported_attribute.flag & contained_attributes) {
-      // write offset, explicit cast to prevent narrowing warning
-      offsets.insert(std::pair<attrib_flag_t, GLvoid*>{supported_attribute, (GLvoid*)uintptr_t(vertex_bytes)});
-      // move offset pointer forward
-      vertex_bytes += supported_attribute.size * supported_attribute.components;
-      // increase number of components
-      component_num += supported_attribute.components;
-    }
+  for (auto const& contained_attribute : attribs) {
+    // write offset, explicit cast to prevent narrowing warning
+    offsets.insert(std::pair<attrib_flag_t, GLvoid*>{contained_attribute, (GLvoid*)uintptr_t(vertex_bytes)});
+    formats.insert(std::pair<attrib_flag_t, attribute>{contained_attribute, contained_attribute});
+    // move offset pointer forward
+    vertex_bytes += contained_attribute.bytes();
   }
   // set number of vertice sin buffer
-  vertex_num = data.size() / component_num;
-}
\ No newline at end of file
+  if (vertex_bytes > 0) {
+    vertex_num = data.size() * sizeof(GLfloat) / std::size_t(vertex_bytes);
+  }
+}
+
+model::model(std::shared_ptr<mapped_file const> const& mapping, GLvoid const* vertices, std::size_t vertex_count,
+             GLvoid const* indices_begin, std::size_t index_count, GLenum indices_type, std::vector<attribute> const& attribs)
+ :model(std::vector<GLfloat>{}, attribs, std::vector<GLuint>{})
+{
+  file = mapping;
+  file_vertices = vertices;
+  file_indices = indices_begin;
+  vertex_num = vertex_count;
+  index_num = index_count;
+  index_type = indices_type;
+}
+
+GLvoid const* model::vertex_data() const {
+  return file ? file_vertices : data.data();
+}
+
+std::size_t model::vertex_data_bytes() const {
+  return vertex_num * std::size_t(vertex_bytes);
+}
+
+GLvoid const* model::index_data() const {
+  return file_indices ? file_indices : indices.data();
+}
+
+std::size_t model::index_data_bytes() const {
+  return index_num * (index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+}
+
+std::size_t model::index_count() const {
+  return index_num;
+}
+
+GLuint model::index(std::size_t i) const {
+  if (index_type == GL_UNSIGNED_SHORT) {
+    GLushort value;
+    std::memcpy(&value, static_cast<std::uint8_t const*>(index_data()) + i * sizeof(GLushort), sizeof(GLushort));
+    return value;
+  }
+  GLuint value;
+  std::memcpy(&value, static_cast<std::uint8_t const*>(index_data()) + i * sizeof(GLuint), sizeof(GLuint));
+  return value;
+}
+
+std::vector<GLuint> model::vertex_indices() const {
+  std::vector<GLuint> vertices(index_num);
+  for (std::size_t i = 0; i < index_num; ++i) {
+    vertices[i] = index(i);
+  }
+  for (submesh const& part : submeshes) {
+    for (std::size_t i = part.first_index; i < part.first_index + part.index_count; ++i) {
+      vertices[i] += GLuint(part.base_vertex);
+    }
+  }
+  return vertices;
+}
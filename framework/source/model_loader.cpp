@@ -1,171 +1,1017 @@
 #include "model_loader.hpp"
 
+#include "mapped_file.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "meshlet_builder.hpp"
+#include "thread_pool.hpp"
+
+#include <glbinding/gl/enum.h>
+
 // use floats and med precision operations
 #include <glm/gtc/type_precision.hpp>
 #include <glm/geometric.hpp>
-
+#include <glm/common.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+  // files are cut into chunks of at least this size at line ends, smaller files are parsed in one piece
+  const std::size_t MIN_CHUNK_BYTES = std::size_t(1) << 20;
+  // chunks per thread, evens out chunks with more faces than others
+  const std::size_t CHUNKS_PER_THREAD = 4;
+  // vertices gathered into the interleaved buffer per task
+  const std::size_t GATHER_GRAIN = 1 << 14;
+  // corners counted and distributed per task when building the corners of each vertex
+  const std::size_t ADJACENCY_GRAIN = 1 << 16;
+  // consecutive vertices whose corners one task sorts
+  const std::size_t BUCKET_VERTICES = 1 << 12;
+  // marks a missing attribute index and an empty hash table slot
+  const std::uint32_t NONE = 0xffffffffu;
+
+  // exactly representable powers of ten, products with them are correctly rounded
+  const double POWERS_OF_TEN[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const int MAX_EXACT_POWER = 22;
+  const std::uint64_t MAX_EXACT_MANTISSA = std::uint64_t(1) << 53;
+
+  // zero-based indices of the attributes of a triangle corner across the whole file
+  struct corner {
+    std::uint32_t position;
+    std::uint32_t texcoord;
+    std::uint32_t normal;
+  };
+
+  bool operator==(corner const& a, corner const& b) {
+    return a.position == b.position && a.texcoord == b.texcoord && a.normal == b.normal;
+  }
 
-namespace model_loader {
+  struct element_count {
+    std::size_t positions;
+    std::size_t texcoords;
+    std::size_t normals;
+  };
+
+  // line-aligned part of the file
+  struct chunk {
+    char const* begin;
+    char const* end;
+    // elements in the chunk and in the chunks before it
+    element_count count;
+    element_count first;
+    // three corners per triangle
+    std::vector<corner> corners;
+    // number of corners before each object, group or material statement
+    std::vector<std::size_t> groups;
+  };
+
+  // attribute arrays of the whole file, each chunk writes its elements behind those of the earlier chunks
+  struct elements {
+    element_count total;
+    std::vector<float> positions;
+    std::vector<float> texcoords;
+    std::vector<float> normals;
+    // whether corners keep these indices, attributes which are not imported do not split vertices
+    bool use_texcoords;
+    bool use_normals;
+  };
+
+  bool is_space(char c) {
+    return c == ' ' || c == '\t';
+  }
+
+  bool is_digit(char c) {
+    return unsigned(c - '0') < 10u;
+  }
+
+  char const* skip_space(char const* p, char const* end) {
+    while (p < end && is_space(*p)) {
+      ++p;
+    }
+    return p;
+  }
 
-void generate_normals(tinyobj::mesh_t& model);
+  // end of the line starting at p, without its newline
+  char const* line_end(char const* p, char const* end) {
+    void const* newline = std::memchr(p, '\n', std::size_t(end - p));
+    return newline ? static_cast<char const*>(newline) : end;
+  }
 
-std::vector<glm::fvec3> generate_tangents(tinyobj::mesh_t const& model);
+  // start of the next line
+  char const* next_line(char const* line_end, char const* end) {
+    return line_end == end ? end : line_end + 1;
+  }
 
-model obj(std::string const& name, model::attrib_flag_t import_attribs){
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
+  // no more elements on this line
+  bool at_line_end(char const* p, char const* end) {
+    return p == end || *p == '\r' || *p == '#';
+  }
 
-  std::string err = tinyobj::LoadObj(shapes, materials, name.c_str());
+  // keyword at the start of a line, followed by whitespace
+  bool starts_with(char const* p, char const* end, char const* keyword, std::size_t length) {
+    return std::size_t(end - p) > length && std::memcmp(p, keyword, length) == 0 && is_space(p[length]);
+  }
 
-  if (!err.empty()) {
-    if (err[0] == 'W' && err[1] == 'A' && err[2] == 'R') {
-      std::cerr << "tinyobjloader: " << err << std::endl;    
+  // values like inf and nan, rare enough to go through the library
+  char const* parse_special(char const* p, char const* end, float& value) {
+    char token[32];
+    std::size_t length = 0;
+    while (p + length < end && length + 1 < sizeof(token) && !is_space(p[length]) && p[length] != '\r') {
+      token[length] = p[length];
+      ++length;
     }
-    else {
-      throw std::logic_error("tinyobjloader: " + err);    
+    token[length] = '\0';
+    char* parsed = nullptr;
+    value = std::strtof(token, &parsed);
+    if (parsed == token) {
+      throw std::runtime_error("model_loader: invalid number '" + std::string(token) + "'");
     }
+    return p + (parsed - token);
   }
 
-  model::attrib_flag_t attributes{model::POSITION | import_attribs};
+  // decimal number [sign]digits[.digits][(e|E)[sign]digits], the result is correctly rounded to double
+  // when the significant digits fit into its mantissa, digits beyond the 19th are too small for a float
+  char const* parse_float(char const* p, char const* end, float& value) {
+    char const* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative = *p == '-';
+      ++p;
+    }
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any_digit = false;
+    for (; p < end && is_digit(*p); ++p) {
+      any_digit = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + std::uint64_t(*p - '0');
+        digits += mantissa != 0 ? 1 : 0;
+      }
+      else {
+        ++exponent;
+      }
+    }
+    if (p < end && *p == '.') {
+      for (++p; p < end && is_digit(*p); ++p) {
+        any_digit = true;
+        if (digits < 19) {
+          mantissa = mantissa * 10 + std::uint64_t(*p - '0');
+          digits += mantissa != 0 ? 1 : 0;
+          --exponent;
+        }
+      }
+    }
+    if (!any_digit) {
+      return parse_special(start, end, value);
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+      char const* q = p + 1;
+      bool negative_exponent = false;
+      if (q < end && (*q == '-' || *q == '+')) {
+        negative_exponent = *q == '-';
+        ++q;
+      }
+      if (q < end && is_digit(*q)) {
+        int power = 0;
+        for (; q < end && is_digit(*q); ++q) {
+          // saturates far outside of the float range
+          power = std::min(power * 10 + (*q - '0'), 100000);
+        }
+        exponent += negative_exponent ? -power : power;
+        p = q;
+      }
+    }
+
+    double result = double(mantissa);
+    if (mantissa != 0 && exponent != 0) {
+      if (exponent >= -MAX_EXACT_POWER && exponent <= MAX_EXACT_POWER && mantissa <= MAX_EXACT_MANTISSA) {
+        result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+      }
+      else {
+        result *= std::pow(10.0, double(exponent));
+      }
+    }
+    value = float(negative ? -result : result);
+    return p;
+  }
+
+  // parse count floats separated by whitespace
+  char const* parse_floats(char const* p, char const* end, float* values, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      p = skip_space(p, end);
+      if (at_line_end(p, end)) {
+        throw std::runtime_error("model_loader: element with too few components");
+      }
+      p = parse_float(p, end, values[i]);
+    }
+    return p;
+  }
 
-  std::vector<float> vertex_data;
-  std::vector<unsigned> triangles;
+  // returns p unchanged if there is no number
+  char const* parse_index(char const* p, char const* end, long long& value) {
+    char const* start = p;
+    bool negative = p < end && *p == '-';
+    if (negative) {
+      ++p;
+    }
+    long long result = 0;
+    char const* digits = p;
+    for (; p < end && is_digit(*p); ++p) {
+      // saturates far outside of the index range
+      result = std::min(result * 10 + (*p - '0'), 1ll << 40);
+    }
+    if (p == digits) {
+      return start;
+    }
+    value = negative ? -result : result;
+    return p;
+  }
 
-  unsigned vertex_offset = 0;
+  // positive indices count from the first element of the file, negative ones back from the last one read
+  std::uint32_t resolve(long long index, std::size_t read, std::size_t total) {
+    long long resolved = index > 0 ? index - 1 : static_cast<long long>(read) + index;
+    if (index == 0 || resolved < 0 || resolved >= static_cast<long long>(total)) {
+      throw std::runtime_error("model_loader: face refers to missing element " + std::to_string(index));
+    }
+    return std::uint32_t(resolved);
+  }
 
-  for (auto& shape : shapes) {
-    tinyobj::mesh_t& curr_mesh = shape.mesh;
-    // prevent MSVC warning due to Win BOOL implementation
-    bool has_normals = (import_attribs & model::NORMAL) != 0;
-    if(has_normals) {
-      // generate normals if necessary
-      if (curr_mesh.normals.empty()) {
-        generate_normals(curr_mesh);
+  // first pass, the number of elements before each chunk places the chunk's elements and resolves its relative indices
+  element_count count_elements(char const* p, char const* end) {
+    element_count count{0, 0, 0};
+    while (p < end) {
+      p = skip_space(p, end);
+      if (starts_with(p, end, "v", 1)) {
+        ++count.positions;
       }
+      else if (starts_with(p, end, "vt", 2)) {
+        ++count.texcoords;
+      }
+      else if (starts_with(p, end, "vn", 2)) {
+        ++count.normals;
+      }
+      p = next_line(line_end(p, end), end);
     }
+    return count;
+  }
 
-    bool has_uvs = (import_attribs & model::TEXCOORD) != 0;
-    if(has_uvs) {
-      if (curr_mesh.texcoords.empty()) {
-        has_uvs = false;
-        attributes ^= model::TEXCOORD;
-        std::cerr << "Shape has no texcoords" << std::endl;
+  // second pass, faces are split into triangle fans, all other statements are ignored
+  void parse_chunk(chunk& part, elements& file) {
+    element_count read = part.first;
+    std::vector<corner> polygon;
+    char const* p = part.begin;
+    while (p < part.end) {
+      p = skip_space(p, part.end);
+      char const* end = line_end(p, part.end);
+      if (starts_with(p, end, "v", 1)) {
+        // vertex colors after the position are ignored
+        parse_floats(p + 1, end, &file.positions[read.positions * 3], 3);
+        ++read.positions;
+      }
+      else if (starts_with(p, end, "vt", 2)) {
+        // v and w are optional
+        float* texcoord = &file.texcoords[read.texcoords * 2];
+        char const* q = parse_floats(p + 2, end, texcoord, 1);
+        q = skip_space(q, end);
+        texcoord[1] = 0.0f;
+        if (!at_line_end(q, end)) {
+          parse_float(q, end, texcoord[1]);
+        }
+        ++read.texcoords;
+      }
+      else if (starts_with(p, end, "vn", 2)) {
+        parse_floats(p + 2, end, &file.normals[read.normals * 3], 3);
+        ++read.normals;
       }
+      else if (starts_with(p, end, "f", 1)) {
+        polygon.clear();
+        char const* q = skip_space(p + 1, end);
+        // corners in the forms v, v/vt, v//vn and v/vt/vn
+        while (!at_line_end(q, end)) {
+          corner current{NONE, NONE, NONE};
+          long long index = 0;
+          char const* next = parse_index(q, end, index);
+          if (next == q) {
+            throw std::runtime_error("model_loader: invalid face '" + std::string(p, end) + "'");
+          }
+          current.position = resolve(index, read.positions, file.total.positions);
+          q = next;
+          if (q < end && *q == '/') {
+            ++q;
+            next = parse_index(q, end, index);
+            if (next != q) {
+              std::uint32_t texcoord = resolve(index, read.texcoords, file.total.texcoords);
+              current.texcoord = file.use_texcoords ? texcoord : NONE;
+              q = next;
+            }
+            if (q < end && *q == '/') {
+              ++q;
+              next = parse_index(q, end, index);
+              if (next == q) {
+                throw std::runtime_error("model_loader: invalid face '" + std::string(p, end) + "'");
+              }
+              std::uint32_t normal = resolve(index, read.normals, file.total.normals);
+              current.normal = file.use_normals ? normal : NONE;
+              q = next;
+            }
+          }
+          polygon.push_back(current);
+          q = skip_space(q, end);
+        }
+        for (std::size_t i = 2; i < polygon.size(); ++i) {
+          part.corners.push_back(polygon[0]);
+          part.corners.push_back(polygon[i - 1]);
+          part.corners.push_back(polygon[i]);
+        }
+      }
+      else if (starts_with(p, end, "o", 1) || starts_with(p, end, "g", 1) || starts_with(p, end, "usemtl", 6)) {
+        part.groups.push_back(part.corners.size());
+      }
+      p = next_line(end, part.end);
     }
+  }
 
-    bool has_tangents = import_attribs & model::TANGENT;
-    std::vector<glm::fvec3> tangents;
-    if (has_tangents) {
-      if (!has_uvs) {
-        has_tangents = false;
-        attributes ^= model::TANGENT;
-        std::cerr << "Shape has no texcoords" << std::endl;
+  std::vector<chunk> split_chunks(char const* begin, char const* end) {
+    std::size_t size = std::size_t(end - begin);
+    std::size_t count = std::max(std::min(size / MIN_CHUNK_BYTES, thread_pool::shared().size() * CHUNKS_PER_THREAD),
+                                 std::size_t(1));
+    std::size_t chunk_bytes = size / count;
+    std::vector<chunk> chunks;
+    for (char const* p = begin; p < end;) {
+      char const* cut = std::size_t(end - p) > chunk_bytes ? next_line(line_end(p + chunk_bytes, end), end) : end;
+      chunks.push_back(chunk{p, cut, element_count{0, 0, 0}, element_count{0, 0, 0}, {}, {}});
+      p = cut;
+    }
+    return chunks;
+  }
+
+  // index ranges between the group statements, none if all triangles are in one group
+  std::vector<model::submesh> collect_submeshes(std::vector<chunk> const& chunks) {
+    std::vector<std::size_t> starts{0};
+    std::size_t corners_before = 0;
+    for (chunk const& part : chunks) {
+      for (std::size_t group : part.groups) {
+        starts.push_back(corners_before + group);
       }
-      else {
-        tangents = generate_tangents(curr_mesh);
+      corners_before += part.corners.size();
+    }
+    starts.push_back(corners_before);
+    std::vector<model::submesh> submeshes;
+    for (std::size_t i = 0; i + 1 < starts.size(); ++i) {
+      // groups without faces are left out
+      if (starts[i + 1] > starts[i]) {
+        submeshes.push_back(model::submesh{starts[i], starts[i + 1] - starts[i], 0});
+      }
+    }
+    if (submeshes.size() == 1) {
+      submeshes.clear();
+    }
+    return submeshes;
+  }
+
+  std::size_t hash(corner const& key) {
+    std::uint64_t mixed = std::uint64_t(key.position) * 0x9e3779b97f4a7c15ull
+                        ^ std::uint64_t(key.texcoord) * 0xc2b2ae3d27d4eb4full
+                        ^ std::uint64_t(key.normal) * 0x165667b19e3779f9ull;
+    return std::size_t(mixed ^ (mixed >> 29));
+  }
+
+  // open addressing table with linear probing, the slots store vertex indices and the keys are looked up in the
+  // vertex list, so a slot takes four bytes
+  class vertex_table {
+   public:
+    explicit vertex_table(std::size_t expected)
+     :slots_{}
+     ,mask_{0}
+    {
+      std::size_t capacity = 16;
+      while (capacity < expected * 2) {
+        capacity *= 2;
+      }
+      slots_.assign(capacity, NONE);
+      mask_ = capacity - 1;
+    }
+
+    // index of the vertex with these attributes, appended to the vertices if it is new
+    std::uint32_t insert(corner const& key, std::vector<corner>& vertices) {
+      std::size_t slot = hash(key) & mask_;
+      while (slots_[slot] != NONE) {
+        if (vertices[slots_[slot]] == key) {
+          return slots_[slot];
+        }
+        slot = (slot + 1) & mask_;
+      }
+      if (vertices.size() >= NONE) {
+        throw std::runtime_error("model_loader: too many vertices");
+      }
+      std::uint32_t index = std::uint32_t(vertices.size());
+      slots_[slot] = index;
+      vertices.push_back(key);
+      // at most half full keeps probe sequences short
+      if (vertices.size() * 2 > slots_.size()) {
+        grow(vertices);
+      }
+      return index;
+    }
+
+   private:
+    void grow(std::vector<corner> const& vertices) {
+      slots_.assign(slots_.size() * 2, NONE);
+      mask_ = slots_.size() - 1;
+      for (std::size_t i = 0; i < vertices.size(); ++i) {
+        std::size_t slot = hash(vertices[i]) & mask_;
+        while (slots_[slot] != NONE) {
+          slot = (slot + 1) & mask_;
+        }
+        slots_[slot] = std::uint32_t(i);
       }
     }
 
-    // push back vertex attributes
-    for (unsigned i = 0; i < curr_mesh.positions.size() / 3; ++i) {
-      vertex_data.push_back(curr_mesh.positions[i * 3]);
-      vertex_data.push_back(curr_mesh.positions[i * 3 + 1]);
-      vertex_data.push_back(curr_mesh.positions[i * 3 + 2]);
+    std::vector<std::uint32_t> slots_;
+    std::size_t mask_;
+  };
 
-      if (has_normals) {
-        vertex_data.push_back(curr_mesh.normals[i * 3]);
-        vertex_data.push_back(curr_mesh.normals[i * 3 + 1]);
-        vertex_data.push_back(curr_mesh.normals[i * 3 + 2]);
+  // merge corners with equal attributes in order of their first use
+  std::vector<corner> merge_vertices(std::vector<chunk>& chunks, elements const& file, std::vector<GLuint>& indices) {
+    std::size_t corner_count = 0;
+    for (chunk const& part : chunks) {
+      corner_count += part.corners.size();
+    }
+    indices.resize(corner_count);
+    std::vector<corner> vertices;
+    vertices.reserve(file.total.positions);
+    GLuint* index = indices.data();
+    if (!file.use_texcoords && !file.use_normals) {
+      // positions only, the position index itself is the key
+      std::vector<std::uint32_t> remap(file.total.positions, NONE);
+      for (chunk& part : chunks) {
+        for (corner const& key : part.corners) {
+          std::uint32_t& vertex = remap[key.position];
+          if (vertex == NONE) {
+            vertex = std::uint32_t(vertices.size());
+            vertices.push_back(key);
+          }
+          *index++ = vertex;
+        }
+        std::vector<corner>().swap(part.corners);
       }
+    }
+    else {
+      vertex_table table{file.total.positions};
+      for (chunk& part : chunks) {
+        for (corner const& key : part.corners) {
+          *index++ = table.insert(key, vertices);
+        }
+        std::vector<corner>().swap(part.corners);
+      }
+    }
+    return vertices;
+  }
 
-      if (has_uvs) {
-        vertex_data.push_back(curr_mesh.texcoords[i * 2]);
-        vertex_data.push_back(curr_mesh.texcoords[i * 2 + 1]);
+  // corners of every vertex, the corners of vertex v are corners[offsets[v]] to corners[offsets[v + 1]]
+  struct vertex_corners {
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> corners;
+  };
+
+  // counting sort in two parallel passes with the ascending corner order of a serial one: the corners are
+  // distributed into buckets of consecutive vertices first, then each bucket is sorted in place by one task
+  vertex_corners corners_of(std::vector<GLuint> const& indices, std::size_t vertex_count) {
+    thread_pool& pool = thread_pool::shared();
+    std::size_t bucket_count = (vertex_count + BUCKET_VERTICES - 1) / BUCKET_VERTICES;
+    std::size_t task_count = (indices.size() + ADJACENCY_GRAIN - 1) / ADJACENCY_GRAIN;
+    // corners of each task in each bucket, then where the task writes its first corner of the bucket
+    std::vector<std::uint32_t> task_buckets(task_count * bucket_count, 0);
+    pool.parallel_for(0, indices.size(), ADJACENCY_GRAIN, [&](std::size_t first, std::size_t last) {
+      std::uint32_t* counts = &task_buckets[first / ADJACENCY_GRAIN * bucket_count];
+      for (std::size_t i = first; i < last; ++i) {
+        ++counts[indices[i] / BUCKET_VERTICES];
+      }
+    });
+    std::vector<std::uint32_t> bucket_offsets(bucket_count + 1, 0);
+    std::uint32_t position = 0;
+    for (std::size_t bucket = 0; bucket < bucket_count; ++bucket) {
+      bucket_offsets[bucket] = position;
+      for (std::size_t task = 0; task < task_count; ++task) {
+        std::uint32_t count = task_buckets[task * bucket_count + bucket];
+        task_buckets[task * bucket_count + bucket] = position;
+        position += count;
       }
+    }
+    bucket_offsets[bucket_count] = position;
+    vertex_corners result{std::vector<std::uint32_t>(vertex_count + 1, 0), std::vector<std::uint32_t>(indices.size())};
+    pool.parallel_for(0, indices.size(), ADJACENCY_GRAIN, [&](std::size_t first, std::size_t last) {
+      std::uint32_t* positions = &task_buckets[first / ADJACENCY_GRAIN * bucket_count];
+      for (std::size_t i = first; i < last; ++i) {
+        result.corners[positions[indices[i] / BUCKET_VERTICES]++] = std::uint32_t(i);
+      }
+    });
+
+    pool.parallel_for(0, bucket_count, 1, [&](std::size_t first, std::size_t last) {
+      std::vector<std::uint32_t> next(BUCKET_VERTICES);
+      std::vector<std::uint32_t> bucketed;
+      for (std::size_t bucket = first; bucket < last; ++bucket) {
+        std::size_t first_vertex = bucket * BUCKET_VERTICES;
+        std::size_t last_vertex = std::min(first_vertex + BUCKET_VERTICES, vertex_count);
+        bucketed.assign(result.corners.begin() + bucket_offsets[bucket], result.corners.begin() + bucket_offsets[bucket + 1]);
+        // each bucket only writes the ends of its own vertices, the start of its first vertex is the bucket offset
+        for (std::uint32_t corner : bucketed) {
+          ++result.offsets[indices[corner] + 1];
+        }
+        std::uint32_t end = bucket_offsets[bucket];
+        for (std::size_t v = first_vertex; v < last_vertex; ++v) {
+          next[v - first_vertex] = end;
+          end += result.offsets[v + 1];
+          result.offsets[v + 1] = end;
+        }
+        for (std::uint32_t corner : bucketed) {
+          result.corners[next[indices[corner] - first_vertex]++] = corner;
+        }
+      }
+    });
+    return result;
+  }
+
+  // zero vectors stay zero
+  glm::fvec3 unit(glm::fvec3 const& direction) {
+    float length = glm::length(direction);
+    return length > 0.0f ? direction / length : direction;
+  }
+
+  // unit direction without its part along the unit normal, zero if nothing remains
+  glm::fvec3 tangential(glm::fvec3 const& direction, glm::fvec3 const& normal) {
+    return unit(direction - normal * glm::dot(normal, direction));
+  }
+
+  // face normals of a mesh, twice the face area long, and for angle weighting the angle at every corner
+  struct face_normals {
+    std::vector<glm::fvec3> normals;
+    std::vector<float> angles;
 
-      if (has_tangents) {
-        vertex_data.push_back(tangents[i].x);
-        vertex_data.push_back(tangents[i].y);
-        vertex_data.push_back(tangents[i].z);
+    // contribution of the face of a corner to its vertex normal
+    glm::fvec3 weighted(std::size_t corner) const {
+      return angles.empty() ? normals[corner / 3] : angles[corner] * unit(normals[corner / 3]);
+    }
+  };
+
+  // one normal per group of corners at a vertex whose faces are summed alike, corners of faces meeting at more than
+  // the crease angle sum different faces, group 0 stays with the vertex and the others are copied
+  class normal_groups {
+   public:
+    explicit normal_groups(float crease_angle)
+     :cos_crease_{std::cos(glm::radians(crease_angle))}
+     ,faces_{}
+     ,weighted_{}
+     ,groups_{}
+     ,normals_{}
+    {}
+
+    // group the corners of the vertex, the group of its i-th corner is group(i)
+    void build(std::size_t vertex, vertex_corners const& adjacency, face_normals const& faces) {
+      faces_.clear();
+      weighted_.clear();
+      groups_.clear();
+      normals_.clear();
+      for (std::uint32_t c = adjacency.offsets[vertex]; c < adjacency.offsets[vertex + 1]; ++c) {
+        faces_.push_back(unit(faces.normals[adjacency.corners[c] / 3]));
+        weighted_.push_back(faces.weighted(adjacency.corners[c]));
+      }
+      for (std::size_t i = 0; i < faces_.size(); ++i) {
+        // degenerate faces take the normal of the first group instead of splitting the vertex
+        if (faces_[i] == glm::fvec3{0.0f}) {
+          groups_.push_back(0);
+          continue;
+        }
+        glm::fvec3 sum{0.0f};
+        for (std::size_t j = 0; j < faces_.size(); ++j) {
+          if (glm::dot(faces_[i], faces_[j]) >= cos_crease_) {
+            sum += weighted_[j];
+          }
+        }
+        sum = unit(sum);
+        std::size_t group = std::size_t(std::find(normals_.begin(), normals_.end(), sum) - normals_.begin());
+        if (group == normals_.size()) {
+          normals_.push_back(sum);
+        }
+        groups_.push_back(std::uint32_t(group));
+      }
+      if (normals_.empty()) {
+        normals_.push_back(glm::fvec3{0.0f});
+      }
+    }
+
+    std::size_t group_count() const {
+      return normals_.size();
+    }
+
+    std::uint32_t group(std::size_t corner) const {
+      return groups_[corner];
+    }
+
+    glm::fvec3 const& normal(std::size_t group) const {
+      return normals_[group];
+    }
+
+   private:
+    float cos_crease_;
+    // unit normals of the faces of the corners
+    std::vector<glm::fvec3> faces_;
+    // their weighted contributions
+    std::vector<glm::fvec3> weighted_;
+    std::vector<std::uint32_t> groups_;
+    std::vector<glm::fvec3> normals_;
+  };
+
+  // weighted sum of the normals of the faces around each vertex, gathered per vertex from its corners so that no
+  // two tasks write to the same vertex; vertices with corners at creases are copied, so data and indices may grow
+  void generate_normals(std::vector<float>& data, std::size_t stride, std::size_t normal_offset, std::vector<GLuint>& indices,
+                        model_loader::normal_options const& options) {
+    thread_pool& pool = thread_pool::shared();
+    std::size_t vertex_count = data.size() / stride;
+    std::size_t triangle_count = indices.size() / 3;
+
+    // on a single thread the corner table costs more than the gather saves, area weighted sums without creases
+    // are scattered into the vertices instead
+    if (options.crease_angle >= 180.0f && !options.angle_weighted && pool.size() <= 1) {
+      std::vector<glm::fvec3> sums(vertex_count, glm::fvec3{0.0f});
+      for (std::size_t t = 0; t < triangle_count; ++t) {
+        float const* v0 = &data[indices[t * 3] * stride];
+        float const* v1 = &data[indices[t * 3 + 1] * stride];
+        float const* v2 = &data[indices[t * 3 + 2] * stride];
+        glm::fvec3 normal = glm::cross(glm::fvec3{v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]},
+                                       glm::fvec3{v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]});
+        for (std::size_t i = 0; i < 3; ++i) {
+          sums[indices[t * 3 + i]] += normal;
+        }
+      }
+      for (std::size_t v = 0; v < vertex_count; ++v) {
+        glm::fvec3 normal = unit(sums[v]);
+        std::memcpy(&data[v * stride + normal_offset], &normal, 3 * sizeof(float));
+      }
+      return;
+    }
+
+    face_normals faces{std::vector<glm::fvec3>(triangle_count), std::vector<float>{}};
+    if (options.angle_weighted) {
+      faces.angles.resize(indices.size());
+    }
+    pool.parallel_for(0, triangle_count, GATHER_GRAIN, [&](std::size_t first, std::size_t last) {
+      for (std::size_t t = first; t < last; ++t) {
+        glm::fvec3 corners[3];
+        for (std::size_t i = 0; i < 3; ++i) {
+          float const* vertex = &data[indices[t * 3 + i] * stride];
+          corners[i] = glm::fvec3{vertex[0], vertex[1], vertex[2]};
+        }
+        faces.normals[t] = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+        if (options.angle_weighted) {
+          for (std::size_t i = 0; i < 3; ++i) {
+            glm::fvec3 edge_next = unit(corners[(i + 1) % 3] - corners[i]);
+            glm::fvec3 edge_previous = unit(corners[(i + 2) % 3] - corners[i]);
+            faces.angles[t * 3 + i] = std::acos(glm::clamp(glm::dot(edge_next, edge_previous), -1.0f, 1.0f));
+          }
+        }
       }
+    });
+
+    vertex_corners adjacency = corners_of(indices, vertex_count);
+    if (options.crease_angle >= 180.0f) {
+      pool.parallel_for(0, vertex_count, GATHER_GRAIN, [&](std::size_t first, std::size_t last) {
+        for (std::size_t v = first; v < last; ++v) {
+          glm::fvec3 sum{0.0f};
+          for (std::uint32_t c = adjacency.offsets[v]; c < adjacency.offsets[v + 1]; ++c) {
+            sum += faces.weighted(adjacency.corners[c]);
+          }
+          // vertices of degenerate triangles only keep a zero normal
+          sum = unit(sum);
+          std::memcpy(&data[v * stride + normal_offset], &sum, 3 * sizeof(float));
+        }
+      });
+      return;
     }
 
-    // add triangles
-    for (unsigned i = 0; i < curr_mesh.indices.size(); ++i) {
-      triangles.push_back(vertex_offset + curr_mesh.indices[i]);
+    // groups are built once: the group of each corner and the group normals are kept in slots parallel to the
+    // corners of the vertex, a vertex has at most one group per corner
+    std::vector<std::uint32_t> corner_groups(adjacency.corners.size());
+    std::vector<glm::fvec3> group_normals(adjacency.corners.size());
+    // copies of each vertex, then the first copy
+    std::vector<std::uint32_t> copies(vertex_count);
+    pool.parallel_for(0, vertex_count, GATHER_GRAIN, [&](std::size_t first, std::size_t last) {
+      normal_groups groups{options.crease_angle};
+      for (std::size_t v = first; v < last; ++v) {
+        groups.build(v, adjacency, faces);
+        std::memcpy(&data[v * stride + normal_offset], &groups.normal(0), 3 * sizeof(float));
+        std::uint32_t slots = adjacency.offsets[v];
+        for (std::uint32_t c = slots; c < adjacency.offsets[v + 1]; ++c) {
+          corner_groups[c] = groups.group(c - slots);
+        }
+        for (std::size_t group = 1; group < groups.group_count(); ++group) {
+          group_normals[slots + group] = groups.normal(group);
+        }
+        copies[v] = std::uint32_t(groups.group_count() - 1);
+      }
+    });
+    std::size_t copy_count = 0;
+    for (std::size_t v = 0; v < vertex_count; ++v) {
+      std::size_t count = copies[v];
+      copies[v] = std::uint32_t(vertex_count + copy_count);
+      copy_count += count;
+    }
+    if (vertex_count + copy_count >= NONE) {
+      throw std::runtime_error("model_loader: too many vertices");
     }
 
-    vertex_offset += unsigned(curr_mesh.positions.size() / 3);
+    data.resize((vertex_count + copy_count) * stride);
+    pool.parallel_for(0, vertex_count, GATHER_GRAIN, [&](std::size_t first, std::size_t last) {
+      for (std::size_t v = first; v < last; ++v) {
+        std::uint32_t slots = adjacency.offsets[v];
+        std::size_t group_count = std::size_t(v + 1 < vertex_count ? copies[v + 1] : vertex_count + copy_count) - copies[v] + 1;
+        for (std::size_t group = 1; group < group_count; ++group) {
+          std::size_t copy = copies[v] + group - 1;
+          std::copy_n(&data[v * stride], stride, &data[copy * stride]);
+          std::memcpy(&data[copy * stride + normal_offset], &group_normals[slots + group], 3 * sizeof(float));
+        }
+        for (std::uint32_t c = slots; c < adjacency.offsets[v + 1]; ++c) {
+          if (corner_groups[c] > 0) {
+            indices[adjacency.corners[c]] = std::uint32_t(copies[v] + corner_groups[c] - 1);
+          }
+        }
+      }
+    });
   }
 
-  return model{vertex_data, attributes, triangles};
+  // tangents with the handedness in w following MikkTSpace, so normal maps baked by other tools read back unchanged:
+  // the texture u direction of each triangle is projected into the tangent plane of each corner's normal, weighted
+  // by the corner angle and summed per vertex; triangles with mirrored texture coordinates are summed separately,
+  // vertices used by both are copied for the mirrored triangles, so data and indices may grow
+  std::vector<glm::fvec4> generate_tangents(std::vector<float>& data, std::size_t stride, std::size_t texcoord_offset,
+                                            std::vector<GLuint>& indices) {
+    thread_pool& pool = thread_pool::shared();
+    std::size_t vertex_count = data.size() / stride;
+    std::size_t triangle_count = indices.size() / 3;
+
+    // u direction and orientation of each triangle, zero for triangles without texture or surface area
+    std::vector<glm::fvec3> face_tangents(triangle_count);
+    std::vector<std::uint8_t> mirrored(triangle_count);
+    pool.parallel_for(0, triangle_count, GATHER_GRAIN, [&](std::size_t first, std::size_t last) {
+      for (std::size_t t = first; t < last; ++t) {
+        float const* v0 = &data[indices[t * 3] * stride];
+        float const* v1 = &data[indices[t * 3 + 1] * stride];
+        float const* v2 = &data[indices[t * 3 + 2] * stride];
+        glm::fvec3 d1{v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]};
+        glm::fvec3 d2{v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]};
+        glm::fvec2 st1{v1[texcoord_offset] - v0[texcoord_offset], v1[texcoord_offset + 1] - v0[texcoord_offset + 1]};
+        glm::fvec2 st2{v2[texcoord_offset] - v0[texcoord_offset], v2[texcoord_offset + 1] - v0[texcoord_offset + 1]};
+        float signed_area = st1.x * st2.y - st1.y * st2.x;
+        glm::fvec3 direction = d1 * st2.y - d2 * st1.y;
+        float length = glm::length(direction);
+        mirrored[t] = signed_area < 0.0f;
+        face_tangents[t] = signed_area != 0.0f && length > 0.0f ? direction / (signed_area < 0.0f ? -length : length) : glm::fvec3{0.0f};
+      }
+    });
+
+    // sums of both orientations per vertex, the corners of each vertex are visited by one task only
+    vertex_corners adjacency = corners_of(indices, vertex_count);
+    std::vector<glm::fvec3> sums(vertex_count * 2, glm::fvec3{0.0f});
+    std::vector<std::uint8_t> orientations(vertex_count, 0);
+    pool.parallel_for(0, vertex_count, GATHER_GRAIN, [&](std::size_t first, std::size_t last) {
+      for (std::size_t v = first; v < last; ++v) {
+        float const* vertex = &data[v * stride];
+        glm::fvec3 position{vertex[0], vertex[1], vertex[2]};
+        glm::fvec3 normal = unit(glm::fvec3{vertex[3], vertex[4], vertex[5]});
+        for (std::uint32_t c = adjacency.offsets[v]; c < adjacency.offsets[v + 1]; ++c) {
+          std::size_t corner = adjacency.corners[c];
+          std::size_t triangle = corner / 3;
+          if (face_tangents[triangle] == glm::fvec3{0.0f}) {
+            continue;
+          }
+          float const* previous = &data[indices[triangle * 3 + (corner + 2) % 3] * stride];
+          float const* next = &data[indices[triangle * 3 + (corner + 1) % 3] * stride];
+          glm::fvec3 edge_previous = tangential(glm::fvec3{previous[0], previous[1], previous[2]} - position, normal);
+          glm::fvec3 edge_next = tangential(glm::fvec3{next[0], next[1], next[2]} - position, normal);
+          float angle = std::acos(glm::clamp(glm::dot(edge_previous, edge_next), -1.0f, 1.0f));
+          sums[v * 2 + mirrored[triangle]] += angle * tangential(face_tangents[triangle], normal);
+          orientations[v] |= std::uint8_t(1 << mirrored[triangle]);
+        }
+      }
+    });
+
+    // vertices used by both orientations get a copy for the mirrored triangles
+    std::vector<std::uint32_t> copies(vertex_count, NONE);
+    std::size_t copy_count = 0;
+    for (std::size_t v = 0; v < vertex_count; ++v) {
+      if (orientations[v] == 3) {
+        copies[v] = std::uint32_t(vertex_count + copy_count++);
+      }
+    }
+    if (vertex_count + copy_count >= NONE) {
+      throw std::runtime_error("model_loader: too many vertices");
+    }
+    data.resize((vertex_count + copy_count) * stride);
+    std::vector<glm::fvec4> tangents(vertex_count + copy_count);
+    pool.parallel_for(0, vertex_count, GATHER_GRAIN, [&](std::size_t first, std::size_t last) {
+      for (std::size_t v = first; v < last; ++v) {
+        float const* vertex = &data[v * stride];
+        glm::fvec3 normal = unit(glm::fvec3{vertex[3], vertex[4], vertex[5]});
+        for (std::uint8_t orientation = 0; orientation < 2; ++orientation) {
+          glm::fvec3 tangent = unit(sums[v * 2 + orientation]);
+          if (tangent == glm::fvec3{0.0f}) {
+            // untextured or degenerate surroundings, any direction in the tangent plane
+            tangent = tangential(std::abs(normal.x) < 0.9f ? glm::fvec3{1.0f, 0.0f, 0.0f} : glm::fvec3{0.0f, 1.0f, 0.0f}, normal);
+          }
+          glm::fvec4 frame{tangent, orientation ? -1.0f : 1.0f};
+          if (orientation == 1 && copies[v] != NONE) {
+            std::copy_n(vertex, stride, &data[copies[v] * stride]);
+            tangents[copies[v]] = frame;
+            for (std::uint32_t c = adjacency.offsets[v]; c < adjacency.offsets[v + 1]; ++c) {
+              if (mirrored[adjacency.corners[c] / 3]) {
+                indices[adjacency.corners[c]] = copies[v];
+              }
+            }
+          }
+          else if (orientation == 0 ? orientations[v] != 2 : orientations[v] == 2) {
+            tangents[v] = frame;
+          }
+        }
+      }
+    });
+    return tangents;
+  }
 }
 
-void generate_normals(tinyobj::mesh_t& model) {
-  std::vector<glm::fvec3> positions(model.positions.size() / 3);
+namespace model_loader {
+
+model parse_obj(std::string const& name, model::attrib_flag_t import_attribs, normal_options const& normals){
+  mapped_file source{name};
+  char const* begin = reinterpret_cast<char const*>(source.data());
+  char const* end = begin + source.size();
+  std::vector<chunk> chunks = split_chunks(begin, end);
+  thread_pool& pool = thread_pool::shared();
 
-  for (unsigned i = 0; i < model.positions.size(); i+=3) {
-    positions[i / 3] = glm::fvec3{model.positions[i], model.positions[i + 1], model.positions[i + 2]};
+  pool.parallel_for(0, chunks.size(), 1, [&chunks](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i) {
+      chunks[i].count = count_elements(chunks[i].begin, chunks[i].end);
+    }
+  });
+  elements file{element_count{0, 0, 0}, {}, {}, {}, false, false};
+  for (chunk& part : chunks) {
+    part.first = file.total;
+    file.total.positions += part.count.positions;
+    file.total.texcoords += part.count.texcoords;
+    file.total.normals += part.count.normals;
+  }
+  if (file.total.positions >= NONE || file.total.texcoords >= NONE || file.total.normals >= NONE) {
+    throw std::runtime_error("model_loader: too many elements in " + name);
   }
 
-  std::vector<glm::fvec3> normals(model.positions.size() / 3, glm::fvec3{0.0f});
-  for (unsigned i = 0; i < model.indices.size(); i+=3) {
-    glm::fvec3 normal = glm::cross(positions[model.indices[i+1]] - positions[model.indices[i]], positions[model.indices[i+2]] - positions[model.indices[i]]);
+  model::attrib_flag_t attributes{model::POSITION | import_attribs};
 
-    normals[model.indices[i]] += normal;
-    normals[model.indices[i+1]] += normal;
-    normals[model.indices[i+2]] += normal;
+  // prevent MSVC warning due to Win BOOL implementation
+  bool has_normals = (import_attribs & model::NORMAL) != 0;
+  // generate normals if necessary
+  bool generated_normals = has_normals && file.total.normals == 0;
+  file.use_normals = has_normals && !generated_normals;
+
+  bool has_uvs = (import_attribs & model::TEXCOORD) != 0;
+  if (has_uvs) {
+    if (file.total.texcoords == 0) {
+      has_uvs = false;
+      attributes ^= model::TEXCOORD;
+      std::cerr << "Shape has no texcoords" << std::endl;
+    }
+  }
+  file.use_texcoords = has_uvs;
+
+  bool has_tangents = (import_attribs & model::TANGENT) != 0;
+  bool has_bitangents = (import_attribs & model::BITANGENT) != 0;
+  if (has_tangents || has_bitangents) {
+    // the frame follows the texture coordinates and lies in the tangent plane of the normal
+    if (!has_uvs || !has_normals) {
+      has_tangents = false;
+      has_bitangents = false;
+      attributes &= ~(model::TANGENT | model::BITANGENT);
+      std::cerr << "Shape needs normals and texcoords for tangents" << std::endl;
+    }
   }
 
-  model.normals.reserve(model.positions.size());
-  for (unsigned i = 0; i < normals.size(); ++i) {
-    glm::fvec3 normal = glm::normalize(normals[i]);
-    model.normals[i * 3] = normal[0];
-    model.normals[i * 3 + 1] = normal[1];
-    model.normals[i * 3 + 2] = normal[2];
+  file.positions.resize(file.total.positions * 3);
+  file.texcoords.resize(file.total.texcoords * 2);
+  file.normals.resize(file.total.normals * 3);
+  pool.parallel_for(0, chunks.size(), 1, [&chunks, &file](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i) {
+      parse_chunk(chunks[i], file);
+    }
+  });
+
+  std::vector<model::submesh> submeshes = collect_submeshes(chunks);
+  std::vector<GLuint> triangles;
+  std::vector<corner> vertices = merge_vertices(chunks, file, triangles);
+
+  // interleave vertex attributes
+  std::size_t normal_offset = 3;
+  std::size_t texcoord_offset = normal_offset + (has_normals ? 3 : 0);
+  std::size_t tangent_offset = texcoord_offset + (has_uvs ? 2 : 0);
+  std::size_t bitangent_offset = tangent_offset + (has_tangents ? 4 : 0);
+  std::size_t stride = bitangent_offset + (has_bitangents ? 3 : 0);
+  std::vector<float> vertex_data(vertices.size() * stride, 0.0f);
+  // bounds of the vertices gathered by each task
+  std::vector<glm::fvec3> task_min((vertices.size() + GATHER_GRAIN - 1) / GATHER_GRAIN);
+  std::vector<glm::fvec3> task_max(task_min.size());
+  pool.parallel_for(0, vertices.size(), GATHER_GRAIN, [&](std::size_t first, std::size_t last) {
+    float const* first_position = &file.positions[vertices[first].position * std::size_t(3)];
+    glm::fvec3 bounds_min{first_position[0], first_position[1], first_position[2]};
+    glm::fvec3 bounds_max{bounds_min};
+    for (std::size_t i = first; i < last; ++i) {
+      corner const& indices = vertices[i];
+      float* vertex = &vertex_data[i * stride];
+      std::memcpy(vertex, &file.positions[indices.position * std::size_t(3)], 3 * sizeof(float));
+      glm::fvec3 position{vertex[0], vertex[1], vertex[2]};
+      bounds_min = glm::min(bounds_min, position);
+      bounds_max = glm::max(bounds_max, position);
+      // corners without the attribute keep zeros
+      if (file.use_normals && indices.normal != NONE) {
+        std::memcpy(vertex + normal_offset, &file.normals[indices.normal * std::size_t(3)], 3 * sizeof(float));
+      }
+      if (has_uvs && indices.texcoord != NONE) {
+        std::memcpy(vertex + texcoord_offset, &file.texcoords[indices.texcoord * std::size_t(2)], 2 * sizeof(float));
+      }
+    }
+    task_min[first / GATHER_GRAIN] = bounds_min;
+    task_max[first / GATHER_GRAIN] = bounds_max;
+  });
+
+  if (generated_normals) {
+    ::generate_normals(vertex_data, stride, normal_offset, triangles, normals);
+  }
+  if (has_tangents || has_bitangents) {
+    std::vector<glm::fvec4> tangents = generate_tangents(vertex_data, stride, texcoord_offset, triangles);
+    pool.parallel_for(0, tangents.size(), GATHER_GRAIN, [&](std::size_t first, std::size_t last) {
+      for (std::size_t i = first; i < last; ++i) {
+        float* vertex = &vertex_data[i * stride];
+        if (has_tangents) {
+          std::memcpy(vertex + tangent_offset, &tangents[i], 4 * sizeof(float));
+        }
+        if (has_bitangents) {
+          glm::fvec3 bitangent = tangents[i].w * glm::cross(glm::fvec3{vertex[3], vertex[4], vertex[5]}, glm::fvec3{tangents[i]});
+          std::memcpy(vertex + bitangent_offset, &bitangent, 3 * sizeof(float));
+        }
+      }
+    });
+  }
+
+  model result{std::move(vertex_data), attributes, std::move(triangles)};
+  result.submeshes = std::move(submeshes);
+  for (std::size_t i = 0; i < task_min.size(); ++i) {
+    result.bounds_min = i == 0 ? task_min[i] : glm::min(result.bounds_min, task_min[i]);
+    result.bounds_max = i == 0 ? task_max[i] : glm::max(result.bounds_max, task_max[i]);
   }
+  return result;
 }
 
-std::vector<glm::fvec3> generate_tangents(tinyobj::mesh_t const& model) {
-  // containers for vertex attributes
-  std::vector<glm::fvec3> positions(model.positions.size() / 3);
-  std::vector<glm::fvec3> normals(model.positions.size() / 3);
-  std::vector<glm::fvec2> texcoords(model.positions.size() / 3);
-  std::vector<glm::fvec3> tangents(model.positions.size() / 3, glm::fvec3{0.0f});
-
-  // get vertex positions and texture coordinates from mesh_t
-  for (unsigned i = 0; i < model.positions.size(); i+=3) {
-    positions[i / 3] = glm::fvec3{model.positions[i],
-                                 model.positions[i + 1],
-                                 model.positions[i + 2]};
-    normals[i / 3] = glm::fvec3{model.normals[i],
-                                 model.normals[i + 1],
-                                 model.normals[i + 2]};
-  }
-  for (unsigned i = 0; i < model.texcoords.size(); i+=2) {
-    texcoords[i / 2] = glm::fvec2{model.texcoords[i], model.texcoords[i + 1]};
-  }
-
-  // calculate tangent for triangles
-  for (unsigned i = 0; i < model.indices.size() / 3; i++) {
-    // indices of vertices of this triangle
-    // unsigned indices[3] = {model.indices[i * 3],
-    //                        model.indices[i * 3 + 1],
-    //                        model.indices[i * 3 + 2]};
-    // access an attribute of xth vert with vector access "attribute[indices[x]]"
-    
-    // calculate tangent for the triangle and add it to the accumulation tangents of the adjacent vertices
-    // see generate_normals() for similar workflow 
-  }
-  // normalize and orthogonalize accumulated vertex tangents
-  for (unsigned i = 0; i < tangents.size(); ++i) {
-    // implement orthogonalization and normalization here
-  }
-
-  throw std::logic_error("Tangent creation not implemented yet");
-
-  return tangents;
+model obj(std::string const& name, model::attrib_flag_t import_attribs, vertex_quantizer::format_flag_t packed_formats,
+          std::uint32_t codec, normal_options const& normals, std::size_t lod_levels){
+  mesh_cache::source_info source = mesh_cache::source_of(name, std::uint32_t(import_attribs), packed_formats, codec,
+                                                         normals.crease_angle, normals.angle_weighted, std::uint32_t(lod_levels));
+  std::string cached = mesh_cache::cache_path(name);
+  try {
+    return mesh_cache::load(cached, source);
+  }
+  catch (std::runtime_error&) {
+    // cache missing, outdated or damaged, parse the file below
+  }
+  model parsed = parse_obj(name, import_attribs, normals);
+  mesh_simplifier::generate_lods(parsed, lod_levels);
+  mesh_optimizer::optimize(parsed);
+  model packed = vertex_quantizer::quantize(std::move(parsed), packed_formats);
+  index_codec::narrow(packed);
+  meshlet_builder::generate_meshlets(packed);
+  return mesh_cache::store(cached, std::move(packed), source);
+}
+
+void generate_normals(model& mesh, normal_options const& normals) {
+  if (mesh.file) {
+    throw std::invalid_argument("model_loader: model refers to a mapped file");
+  }
+  auto normal = mesh.formats.find(model::NORMAL.flag);
+  if (normal == mesh.formats.end() || normal->second.type != GL_FLOAT || mesh.formats.at(model::POSITION.flag).type != GL_FLOAT) {
+    throw std::invalid_argument("model_loader: model has no float normals");
+  }
+  if (mesh.index_type != GL_UNSIGNED_INT) {
+    throw std::invalid_argument("model_loader: indices are narrowed");
+  }
+  std::size_t stride = std::size_t(mesh.vertex_bytes) / sizeof(float);
+  std::size_t normal_offset = std::size_t(reinterpret_cast<std::uintptr_t>(mesh.offsets.at(model::NORMAL.flag))) / sizeof(float);
+  ::generate_normals(mesh.data, stride, normal_offset, mesh.indices, normals);
+  mesh.vertex_num = mesh.data.size() / stride;
 }
 
-}
\ No newline at end of file
+}
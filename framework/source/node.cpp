@@ -1,4 +1,5 @@
 #include "node.hpp"
+#include "sim_clock.hpp"
 
 // Constructors
 Node::Node(std::string const& name, Node* parent, std::list<Node*> const& children, glm::fmat4 const& local_transform,
@@ -138,7 +139,7 @@ void Node::render(std::map<std::string, shader_program> const* shaders, glm::fma
 
   // Transformations:
   // Create translation matrix with rotation
-  glm::fmat4 rotation_matrix = glm::rotate(glm::fmat4{}, float(glfwGetTime() * animation_), glm::fvec3{ 0.0f, 1.0f, 0.0f });
+  glm::fmat4 rotation_matrix = glm::rotate(glm::fmat4{}, float(sim_clock::time() * animation_), glm::fvec3{ 0.0f, 1.0f, 0.0f });
   // Add local transform
   glm::fmat4 new_local_transform = rotation_matrix * get_local_transform();
   // Inherit local transform of parent and add own local transform to it
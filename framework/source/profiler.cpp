@@ -0,0 +1,281 @@
+#include "profiler.hpp"
+
+#include "utils.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+//dont load gl bindings from glfw
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  // finished section, gpu events start at the cpu time the pass was submitted
+  struct event {
+    const char* name;
+    long long begin_us;
+    long long duration_us;
+    std::size_t frame;
+    bool gpu;
+  };
+
+  // gpu query waiting for its result
+  struct pending_query {
+    const char* name;
+    GLuint query;
+    long long begin_us;
+    std::size_t frame;
+  };
+
+  // queries of one frame, reused every second frame
+  struct frame_slot {
+    std::vector<GLuint> queries;
+    std::vector<pending_query> pending;
+  };
+
+  // accumulated times or counted values since the last summary
+  struct section {
+    const char* name;
+    double cpu_ms;
+    double gpu_ms;
+    double value;
+    bool counter;
+  };
+
+  bool is_enabled = false;
+  bool has_timer_query = false;
+  bool gpu_active = false;
+  clock_type::time_point origin{};
+
+  std::size_t frame_index = 0;
+  long long frame_begin_us = 0;
+  frame_slot slots[2];
+  double last_gpu_ms = -1.0;
+
+  std::vector<section> sections{};
+  std::size_t summary_frames = 0;
+  std::size_t summary_gpu_frames = 0;
+
+  std::string trace_path{};
+  std::size_t trace_frames = 1000;
+  std::vector<event> trace{};
+
+  long long now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - origin).count();
+  }
+
+  section& find_section(const char* name) {
+    for (section& s : sections) {
+      if (s.name == name || std::strcmp(s.name, name) == 0) {
+        return s;
+      }
+    }
+    sections.push_back(section{name, 0.0, 0.0, 0.0, false});
+    return sections.back();
+  }
+
+  void record(const char* name, long long begin_us, long long duration_us, std::size_t frame, bool gpu) {
+    if (!trace_path.empty() && frame < trace_frames) {
+      trace.push_back(event{name, begin_us, duration_us, frame, gpu});
+    }
+  }
+
+  // read the results of a slot, a frame with a query whose result is not there yet is dropped as a whole
+  // instead of waited for, so the gpu means only cover frames with all of their time
+  void collect(frame_slot& slot) {
+    if (slot.pending.empty()) {
+      return;
+    }
+    for (pending_query const& pending : slot.pending) {
+      GLuint available = 0;
+      glGetQueryObjectuiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (available == 0) {
+        slot.pending.clear();
+        return;
+      }
+    }
+    double frame_gpu_ms = 0.0;
+    for (pending_query const& pending : slot.pending) {
+      GLuint64 elapsed_ns = 0;
+      glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &elapsed_ns);
+      double elapsed_ms = double(elapsed_ns) / 1.0e6;
+      frame_gpu_ms += elapsed_ms;
+      find_section(pending.name).gpu_ms += elapsed_ms;
+      record(pending.name, pending.begin_us, (long long)(elapsed_ns / 1000), pending.frame, true);
+    }
+    last_gpu_ms = frame_gpu_ms;
+    ++summary_gpu_frames;
+    slot.pending.clear();
+  }
+}
+
+namespace profiler {
+
+scope::scope(const char* name, bool gpu)
+ :name_{nullptr}
+ ,begin_us_{0}
+ ,gpu_{false}
+{
+  if (!is_enabled) {
+    return;
+  }
+  name_ = name;
+  begin_us_ = now_us();
+  // time elapsed queries can not be nested
+  gpu_ = gpu && has_timer_query && !gpu_active;
+  if (gpu_) {
+    frame_slot& slot = slots[frame_index % 2];
+    if (slot.queries.size() <= slot.pending.size()) {
+      GLuint query = 0;
+      glGenQueries(1, &query);
+      slot.queries.push_back(query);
+    }
+    GLuint query = slot.queries[slot.pending.size()];
+    slot.pending.push_back(pending_query{name, query, begin_us_, frame_index});
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    gpu_active = true;
+  }
+}
+
+scope::~scope() {
+  if (!name_) {
+    return;
+  }
+  if (gpu_) {
+    glEndQuery(GL_TIME_ELAPSED);
+    gpu_active = false;
+  }
+  long long duration_us = now_us() - begin_us_;
+  find_section(name_).cpu_ms += double(duration_us) / 1000.0;
+  record(name_, begin_us_, duration_us, frame_index, false);
+}
+
+void initialize(int argc, char* argv[]) {
+  trace_path = utils::read_option(argc, argv, "trace");
+  trace_frames = std::size_t(std::stoul(utils::read_option(argc, argv, "trace-frames", "1000")));
+  is_enabled = utils::has_option(argc, argv, "profile") || !trace_path.empty();
+  if (!is_enabled) {
+    return;
+  }
+
+  origin = clock_type::now();
+  has_timer_query = glfwExtensionSupported("GL_ARB_timer_query") != 0;
+  if (!has_timer_query) {
+    std::cerr << "Timer queries not supported, profiling cpu times only" << std::endl;
+  }
+}
+
+bool enabled() {
+  return is_enabled;
+}
+
+void begin_frame() {
+  if (!is_enabled) {
+    return;
+  }
+  // the queries of this slot were issued two frames ago and are usually finished
+  collect(slots[frame_index % 2]);
+  frame_begin_us = now_us();
+}
+
+void end_frame() {
+  if (!is_enabled) {
+    return;
+  }
+  long long duration_us = now_us() - frame_begin_us;
+  find_section("frame").cpu_ms += double(duration_us) / 1000.0;
+  record("frame", frame_begin_us, duration_us, frame_index, false);
+  ++summary_frames;
+  ++frame_index;
+}
+
+double last_gpu_frame_ms() {
+  return last_gpu_ms;
+}
+
+void count(const char* name, double value) {
+  if (!is_enabled) {
+    return;
+  }
+  section& s = find_section(name);
+  s.counter = true;
+  s.value += value;
+}
+
+void print_summary(std::ostream& os) {
+  if (summary_frames == 0) {
+    return;
+  }
+  os << "Profile of " << summary_frames << " frames, mean per frame:\n";
+  for (section& s : sections) {
+    if (s.counter) {
+      os << "  " << std::left << std::setw(16) << s.name << std::right << std::fixed << std::setprecision(0)
+         << " " << std::setw(12) << s.value / double(summary_frames) << "\n";
+      s.value = 0.0;
+      continue;
+    }
+    os << "  " << std::left << std::setw(16) << s.name << std::right << std::fixed << std::setprecision(3)
+       << " cpu " << std::setw(8) << s.cpu_ms / double(summary_frames) << " ms";
+    if (has_timer_query && s.gpu_ms > 0.0 && summary_gpu_frames > 0) {
+      os << "  gpu " << std::setw(8) << s.gpu_ms / double(summary_gpu_frames) << " ms";
+    }
+    os << "\n";
+    s.cpu_ms = 0.0;
+    s.gpu_ms = 0.0;
+  }
+  os.unsetf(std::ios_base::floatfield);
+  os << std::flush;
+  summary_frames = 0;
+  summary_gpu_frames = 0;
+}
+
+void write_trace(std::string const& path) {
+  std::ofstream file{path};
+  if (!file) {
+    throw std::runtime_error("could not write trace to " + path);
+  }
+  file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+       << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"cpu\"}},\n"
+       << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"gpu\"}}";
+  for (event const& e : trace) {
+    file << ",\n{\"name\": \"" << e.name << "\", \"cat\": \"" << (e.gpu ? "gpu" : "cpu")
+         << "\", \"ph\": \"X\", \"ts\": " << e.begin_us << ", \"dur\": " << e.duration_us
+         << ", \"pid\": 1, \"tid\": " << (e.gpu ? 2 : 1) << ", \"args\": {\"frame\": " << e.frame << "}}";
+  }
+  file << "\n]}\n";
+  std::cout << "Wrote " << trace.size() << " trace events to " << path << std::endl;
+}
+
+void shutdown() {
+  if (!is_enabled) {
+    return;
+  }
+  // pick up the results of the last two frames, older slot first
+  glFinish();
+  collect(slots[frame_index % 2]);
+  collect(slots[(frame_index + 1) % 2]);
+
+  if (!trace_path.empty()) {
+    write_trace(trace_path);
+  }
+  for (frame_slot& slot : slots) {
+    if (!slot.queries.empty()) {
+      glDeleteQueries(GLsizei(slot.queries.size()), slot.queries.data());
+    }
+    slot.queries.clear();
+  }
+  is_enabled = false;
+}
+
+}
@@ -0,0 +1,372 @@
+#include "qoi.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QOI_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+  const std::uint8_t OP_INDEX = 0x00;
+  const std::uint8_t OP_DIFF = 0x40;
+  const std::uint8_t OP_LUMA = 0x80;
+  const std::uint8_t OP_RUN = 0xc0;
+  const std::uint8_t OP_RGB = 0xfe;
+  const std::uint8_t OP_RGBA = 0xff;
+  const std::uint8_t OP_MASK = 0xc0;
+  // longest run of one op, 63 and 64 would collide with rgb and rgba
+  const std::size_t MAX_RUN = 62;
+
+  const std::size_t HEADER_SIZE = 14;
+  const std::uint8_t END_MARKER[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+  // band table behind the end marker: offset of each band, rows per band, band count and this magic
+  const char BAND_MAGIC[4] = {'Q', 'B', 'N', 'D'};
+  // pixels per band, spreads even small textures over a few threads while the fresh state per band costs little
+  const std::size_t BAND_PIXELS = std::size_t(1) << 16;
+  // limit of the format against sizes overflowing the decoded buffer
+  const std::size_t MAX_PIXELS = 400000000;
+
+  struct rgba {
+    std::uint8_t r;
+    std::uint8_t g;
+    std::uint8_t b;
+    std::uint8_t a;
+  };
+
+  bool operator==(rgba const& x, rgba const& y) {
+    return x.r == y.r && x.g == y.g && x.b == y.b && x.a == y.a;
+  }
+
+  std::size_t hash(rgba const& p) {
+    return (std::size_t(p.r) * 3 + std::size_t(p.g) * 5 + std::size_t(p.b) * 7 + std::size_t(p.a) * 11) % 64;
+  }
+
+  // integers in the file are big endian
+  std::uint32_t read_u32(std::uint8_t const* data) {
+    return std::uint32_t(data[0]) << 24 | std::uint32_t(data[1]) << 16 | std::uint32_t(data[2]) << 8 | std::uint32_t(data[3]);
+  }
+
+  void write_u32(std::vector<std::uint8_t>& out, std::uint32_t value) {
+    out.push_back(std::uint8_t(value >> 24));
+    out.push_back(std::uint8_t(value >> 16));
+    out.push_back(std::uint8_t(value >> 8));
+    out.push_back(std::uint8_t(value));
+  }
+
+  // difference of two channels wrapped to -128..127
+  int wrapped(std::uint8_t to, std::uint8_t from) {
+    return int(std::int8_t(std::uint8_t(to - from)));
+  }
+
+  std::uint8_t add(std::uint8_t value, int delta) {
+    return std::uint8_t(int(value) + delta);
+  }
+
+  // write a run of equal pixels, sse2 stores whole vectors of the repeated pixel
+  void fill(std::uint8_t* target, rgba const& px, std::size_t count, std::size_t channels) {
+#ifdef QOI_SSE2
+    if (channels == 4 && count >= 4) {
+      std::int32_t value = 0;
+      std::memcpy(&value, &px, 4);
+      __m128i pattern = _mm_set1_epi32(value);
+      for (; count >= 4; count -= 4, target += 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target), pattern);
+      }
+    }
+    else if (channels == 3 && count >= 16) {
+      // 16 rgb pixels fill three vectors exactly
+      std::uint8_t bytes[48];
+      for (std::size_t i = 0; i < 16; ++i) {
+        std::memcpy(bytes + i * 3, &px, 3);
+      }
+      __m128i first = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bytes));
+      __m128i second = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bytes + 16));
+      __m128i third = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bytes + 32));
+      for (; count >= 16; count -= 16, target += 48) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target), first);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + 16), second);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(target + 32), third);
+      }
+    }
+#endif
+    for (; count > 0; --count, target += channels) {
+      std::memcpy(target, &px, channels);
+    }
+  }
+
+  // decode the rows of one band starting from the initial state of the format, rows are stored bottom-up,
+  // the channel count is a template argument so that pixel stores compile to single moves
+  template<std::size_t channels>
+  void decode_band(std::uint8_t const* begin, std::uint8_t const* end, qoi::info const& header,
+                   std::size_t first_row, std::size_t rows, std::uint8_t* target) {
+    std::size_t row_bytes = header.width * channels;
+    rgba index[64];
+    std::memset(index, 0, sizeof(index));
+    rgba px{0, 0, 0, 255};
+    std::size_t run = 0;
+    std::uint8_t const* p = begin;
+
+    for (std::size_t row = first_row; row < first_row + rows; ++row) {
+      std::uint8_t* out = target + (header.height - 1 - row) * row_bytes;
+      std::size_t x = 0;
+      while (x < header.width) {
+        if (run > 0) {
+          std::size_t count = std::min(run, header.width - x);
+          fill(out + x * channels, px, count, channels);
+          x += count;
+          run -= count;
+          continue;
+        }
+        // longest op has five bytes, only the last ops of a band need the exact check
+        if (end - p < 5) {
+          if (p >= end || std::size_t(end - p) < (*p == OP_RGBA ? 5u : *p == OP_RGB ? 4u : (*p & OP_MASK) == OP_LUMA ? 2u : 1u)) {
+            throw std::runtime_error("qoi: truncated data");
+          }
+        }
+        std::uint8_t b1 = *p++;
+        if (b1 == OP_RGB) {
+          px.r = p[0];
+          px.g = p[1];
+          px.b = p[2];
+          p += 3;
+        }
+        else if (b1 == OP_RGBA) {
+          px.r = p[0];
+          px.g = p[1];
+          px.b = p[2];
+          px.a = p[3];
+          p += 4;
+        }
+        else if ((b1 & OP_MASK) == OP_INDEX) {
+          px = index[b1];
+        }
+        else if ((b1 & OP_MASK) == OP_DIFF) {
+          px.r = add(px.r, ((b1 >> 4) & 0x03) - 2);
+          px.g = add(px.g, ((b1 >> 2) & 0x03) - 2);
+          px.b = add(px.b, (b1 & 0x03) - 2);
+        }
+        else if ((b1 & OP_MASK) == OP_LUMA) {
+          std::uint8_t b2 = *p++;
+          int vg = (b1 & 0x3f) - 32;
+          px.r = add(px.r, vg - 8 + ((b2 >> 4) & 0x0f));
+          px.g = add(px.g, vg);
+          px.b = add(px.b, vg - 8 + (b2 & 0x0f));
+        }
+        else {
+          run = std::size_t(b1 & 0x3f) + 1;
+        }
+        index[hash(px)] = px;
+        if (run == 0) {
+          std::memcpy(out + x * channels, &px, channels);
+          ++x;
+        }
+      }
+    }
+  }
+
+  // encode rows of the image so that the band decodes from the initial state: the first pixel is stored in full
+  // and the index only refers to pixels of the band, so a serial decoder reading across bands gets the same result
+  std::vector<std::uint8_t> encode_band(pixel_data const& image, std::size_t first_row, std::size_t rows) {
+    std::size_t channels = image.channels == GL_RGBA ? 4 : 3;
+    std::vector<std::uint8_t> out;
+    out.reserve(rows * image.width * (channels + 1) / 2);
+    rgba index[64];
+    std::memset(index, 0, sizeof(index));
+    bool valid[64] = {};
+    rgba prev{0, 0, 0, 255};
+    bool first = true;
+    std::size_t run = 0;
+
+    for (std::size_t row = first_row; row < first_row + rows; ++row) {
+      // files store rows top-down
+      std::uint8_t const* source = image.pixels.data() + (image.height - 1 - row) * image.width * channels;
+      for (std::size_t x = 0; x < image.width; ++x, source += channels) {
+        rgba px{source[0], source[1], source[2], channels == 4 ? source[3] : std::uint8_t(255)};
+        if (!first && px == prev) {
+          if (++run == MAX_RUN) {
+            out.push_back(std::uint8_t(OP_RUN | (run - 1)));
+            run = 0;
+          }
+          continue;
+        }
+        if (run > 0) {
+          out.push_back(std::uint8_t(OP_RUN | (run - 1)));
+          run = 0;
+        }
+
+        std::size_t slot = hash(px);
+        if (valid[slot] && index[slot] == px) {
+          out.push_back(std::uint8_t(OP_INDEX | slot));
+        }
+        else {
+          index[slot] = px;
+          valid[slot] = true;
+          int vr = wrapped(px.r, prev.r);
+          int vg = wrapped(px.g, prev.g);
+          int vb = wrapped(px.b, prev.b);
+          int vg_r = vr - vg;
+          int vg_b = vb - vg;
+          if (!first && px.a == prev.a && vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1) {
+            out.push_back(std::uint8_t(OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2)));
+          }
+          else if (!first && px.a == prev.a && vg >= -32 && vg <= 31 && vg_r >= -8 && vg_r <= 7 && vg_b >= -8 && vg_b <= 7) {
+            out.push_back(std::uint8_t(OP_LUMA | (vg + 32)));
+            out.push_back(std::uint8_t((vg_r + 8) << 4 | (vg_b + 8)));
+          }
+          // rgb images are opaque, so the alpha the decoder keeps is always right
+          else if (channels == 3 || (!first && px.a == prev.a)) {
+            out.push_back(OP_RGB);
+            out.push_back(px.r);
+            out.push_back(px.g);
+            out.push_back(px.b);
+          }
+          else {
+            out.push_back(OP_RGBA);
+            out.push_back(px.r);
+            out.push_back(px.g);
+            out.push_back(px.b);
+            out.push_back(px.a);
+          }
+        }
+        prev = px;
+        first = false;
+      }
+    }
+    if (run > 0) {
+      out.push_back(std::uint8_t(OP_RUN | (run - 1)));
+    }
+    return out;
+  }
+
+  // band ranges in the file, a single band for files of other encoders
+  struct band_table {
+    std::size_t rows;
+    std::vector<std::size_t> offsets;
+    std::size_t end;
+  };
+
+  band_table read_bands(std::uint8_t const* data, std::size_t size, qoi::info const& header) {
+    if (size < HEADER_SIZE + sizeof(END_MARKER)) {
+      throw std::runtime_error("qoi: truncated data");
+    }
+    std::size_t table_size = 0;
+    std::size_t count = 0;
+    std::size_t rows = 0;
+    if (size >= HEADER_SIZE + sizeof(END_MARKER) + 12 && std::memcmp(data + size - 4, BAND_MAGIC, 4) == 0) {
+      count = read_u32(data + size - 8);
+      rows = read_u32(data + size - 12);
+      table_size = 12 + 4 * count;
+      if (count == 0 || rows == 0 || table_size > size - HEADER_SIZE - sizeof(END_MARKER)
+          || (count - 1) * rows >= header.height || count * rows < header.height) {
+        throw std::runtime_error("qoi: invalid band table");
+      }
+    }
+    std::size_t end = size - table_size - sizeof(END_MARKER);
+    // other decoders stop at the image size, so only the marker of files with band table is checked
+    if (table_size > 0 && std::memcmp(data + end, END_MARKER, sizeof(END_MARKER)) != 0) {
+      throw std::runtime_error("qoi: missing end marker");
+    }
+
+    band_table bands{header.height, std::vector<std::size_t>(1, HEADER_SIZE), end};
+    if (table_size > 0) {
+      bands.rows = rows;
+      bands.offsets.resize(count);
+      std::uint8_t const* table = data + end + sizeof(END_MARKER);
+      for (std::size_t i = 0; i < count; ++i) {
+        bands.offsets[i] = read_u32(table + 4 * i);
+        if (bands.offsets[i] < (i == 0 ? HEADER_SIZE : bands.offsets[i - 1]) || bands.offsets[i] > end) {
+          throw std::runtime_error("qoi: invalid band table");
+        }
+      }
+    }
+    return bands;
+  }
+}
+
+namespace qoi {
+
+info read_info(std::uint8_t const* data, std::size_t size) {
+  if (size < HEADER_SIZE || std::memcmp(data, "qoif", 4) != 0) {
+    throw std::runtime_error("qoi: no qoi image");
+  }
+  info header{read_u32(data + 4), read_u32(data + 8), data[12], data[13] != 0};
+  if (header.width == 0 || header.height == 0 || header.height > MAX_PIXELS / header.width
+      || (header.channels != 3 && header.channels != 4) || data[13] > 1) {
+    throw std::runtime_error("qoi: invalid header");
+  }
+  return header;
+}
+
+pixel_data decode(std::uint8_t const* data, std::size_t size) {
+  info header = read_info(data, size);
+  std::vector<std::uint8_t> pixels(header.width * header.height * header.channels);
+  std::uint8_t* target = pixels.data();
+  band_table bands = read_bands(data, size, header);
+  thread_pool::shared().parallel_for(0, bands.offsets.size(), 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      std::size_t first_row = i * bands.rows;
+      std::size_t band_end = i + 1 < bands.offsets.size() ? bands.offsets[i + 1] : bands.end;
+      std::size_t rows = std::min(bands.rows, header.height - first_row);
+      if (header.channels == 4) {
+        decode_band<4>(data + bands.offsets[i], data + band_end, header, first_row, rows, target);
+      }
+      else {
+        decode_band<3>(data + bands.offsets[i], data + band_end, header, first_row, rows, target);
+      }
+    }
+  });
+  return pixel_data{std::move(pixels), header.channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, header.width, header.height};
+}
+
+std::vector<std::uint8_t> encode(pixel_data const& image, bool linear) {
+  if ((image.channels != GL_RGB && image.channels != GL_RGBA) || image.channel_type != GL_UNSIGNED_BYTE) {
+    throw std::invalid_argument("qoi: only 8 bit rgb and rgba images can be encoded");
+  }
+  if (image.width == 0 || image.height == 0 || image.height > MAX_PIXELS / image.width) {
+    throw std::invalid_argument("qoi: invalid image size");
+  }
+  std::size_t band_rows = std::max(BAND_PIXELS / image.width, std::size_t(1));
+  std::size_t count = (image.height + band_rows - 1) / band_rows;
+  std::vector<std::vector<std::uint8_t>> bands(count);
+  thread_pool::shared().parallel_for(0, count, 1, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      bands[i] = encode_band(image, i * band_rows, std::min(band_rows, image.height - i * band_rows));
+    }
+  });
+
+  std::size_t size = HEADER_SIZE + sizeof(END_MARKER) + 12 + 4 * count;
+  for (std::vector<std::uint8_t> const& band : bands) {
+    size += band.size();
+  }
+  if (size > 0xffffffffu) {
+    throw std::invalid_argument("qoi: encoded image exceeds 4 GiB");
+  }
+
+  std::vector<std::uint8_t> out;
+  out.reserve(size);
+  out.insert(out.end(), {'q', 'o', 'i', 'f'});
+  write_u32(out, std::uint32_t(image.width));
+  write_u32(out, std::uint32_t(image.height));
+  out.push_back(image.channels == GL_RGBA ? 4 : 3);
+  out.push_back(linear ? 1 : 0);
+  std::vector<std::uint32_t> offsets;
+  for (std::vector<std::uint8_t> const& band : bands) {
+    offsets.push_back(std::uint32_t(out.size()));
+    out.insert(out.end(), band.begin(), band.end());
+  }
+  out.insert(out.end(), std::begin(END_MARKER), std::end(END_MARKER));
+  for (std::uint32_t offset : offsets) {
+    write_u32(out, offset);
+  }
+  write_u32(out, std::uint32_t(band_rows));
+  write_u32(out, std::uint32_t(count));
+  out.insert(out.end(), std::begin(BAND_MAGIC), std::end(BAND_MAGIC));
+  return out;
+}
+
+}
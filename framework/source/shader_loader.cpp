@@ -9,6 +9,7 @@
 // use gl definitions from glbinding 
 using namespace gl;
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -20,13 +21,34 @@ static std::string file_name(std::string const& file_path) {
   return file_path.substr(file_path.find_last_of("/\\") + 1);
 }
 
+// the version directive has to stay first, line numbers in the log keep referring to the file
+static void insert_defines(std::string& source, std::vector<std::string> const& defines) {
+  if (defines.empty()) {
+    return;
+  }
+  std::size_t position = 0;
+  std::size_t version = source.find("#version");
+  if (version != std::string::npos) {
+    position = source.find('\n', version);
+    position = position == std::string::npos ? source.size() : position + 1;
+  }
+  std::size_t line = std::size_t(std::count(source.begin(), source.begin() + std::ptrdiff_t(position), '\n')) + 1;
+  std::string directives{};
+  for (auto const& define : defines) {
+    directives += "#define " + define + "\n";
+  }
+  directives += "#line " + std::to_string(line) + "\n";
+  source.insert(position, directives);
+}
+
 namespace shader_loader {
 
-GLuint shader(std::string const& file_path, GLenum shader_type) {
+GLuint shader(std::string const& file_path, GLenum shader_type, std::vector<std::string> const& defines) {
   GLuint shader = 0;
   shader = glCreateShader(shader_type);
 
   std::string shader_source{utils::read_file(file_path)};
+  insert_defines(shader_source, defines);
   // glshadersource expects array of c-strings
   const char* shader_chars = shader_source.c_str();
   glShaderSource(shader, 1, &shader_chars, 0);
@@ -55,13 +77,13 @@ GLuint shader(std::string const& file_path, GLenum shader_type) {
   return shader;
 }
 
-unsigned program(std::map<GLenum, std::string> const& stages) {
+unsigned program(std::map<GLenum, std::string> const& stages, std::vector<std::string> const& defines) {
   unsigned program = glCreateProgram();
 
   std::vector<GLuint> shaders{};
   // load and compile vert and frag shader
   for (auto const& stage : stages) {
-    GLuint shader_handle = shader(stage.second, stage.first);
+    GLuint shader_handle = shader(stage.second, stage.first, defines);
     shaders.push_back(shader_handle);
     // attach the shader to program
     glAttachShader(program, shader_handle);
@@ -0,0 +1,45 @@
+#include "sim_clock.hpp"
+
+#include <chrono>
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  clock_type::time_point last_tick = clock_type::now();
+  double current_time = 0.0;
+  double current_delta = 0.0;
+  bool fixed_step = false;
+}
+
+namespace sim_clock {
+
+void tick() {
+  clock_type::time_point now = clock_type::now();
+  current_delta = std::chrono::duration<double>(now - last_tick).count();
+  current_time += current_delta;
+  last_tick = now;
+}
+
+void step(double seconds) {
+  fixed_step = true;
+  current_delta = seconds;
+  current_time += seconds;
+}
+
+double time() {
+  return current_time;
+}
+
+double delta() {
+  return current_delta;
+}
+
+bool is_fixed_step() {
+  return fixed_step;
+}
+
+void set_fixed_step(bool fixed) {
+  fixed_step = fixed;
+}
+
+}
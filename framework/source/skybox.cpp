@@ -0,0 +1,64 @@
+#include "skybox.hpp"
+
+#include "texture_streamer.hpp"
+#include "utils.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace skybox {
+
+settings::settings()
+ :face_size{0}
+ ,half_resolution{false}
+ ,compress{true}
+{}
+
+void read_settings(int argc, char* argv[]) {
+  settings& config = default_settings();
+  config.face_size = std::size_t(std::stoul(utils::read_option(argc, argv, "skybox-size", "0")));
+  config.half_resolution = utils::has_option(argc, argv, "skybox-half");
+  config.compress = utils::read_option(argc, argv, "skybox-compress", "on") != "off";
+}
+
+settings& default_settings() {
+  static settings config{};
+  return config;
+}
+
+std::size_t face_size(unsigned viewport_height, glm::fmat4 const& projection) {
+  settings const& config = default_settings();
+  // a face spans two units of tangent space, the viewport height spans 2 / projection[1][1]
+  std::size_t size = config.face_size;
+  if (size == 0) {
+    size = std::size_t(std::ceil(double(viewport_height) * double(projection[1][1])));
+  }
+  if (config.half_resolution) {
+    size = (size + 1) / 2;
+  }
+  return std::max(size, std::size_t(1));
+}
+
+void load(texture_streamer& streamer, texture_object& texture, std::string const& side, std::string const& cap,
+          std::size_t face_size) {
+  texture.target = GL_TEXTURE_CUBE_MAP;
+  // the prefiltered levels blend across face edges instead of clamping at each face
+  glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+  bool compression = streamer.compression();
+  streamer.set_compression(compression && default_settings().compress);
+  streamer.load(texture, GL_TEXTURE_CUBE_MAP_POSITIVE_X, side, mipmap::color_space::srgb, face_size);
+  streamer.load(texture, GL_TEXTURE_CUBE_MAP_NEGATIVE_X, side, mipmap::color_space::srgb, face_size);
+  streamer.load(texture, GL_TEXTURE_CUBE_MAP_POSITIVE_Z, side, mipmap::color_space::srgb, face_size);
+  streamer.load(texture, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, cap, mipmap::color_space::srgb, face_size);
+  streamer.load(texture, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, cap, mipmap::color_space::srgb, face_size);
+  streamer.load(texture, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, cap, mipmap::color_space::srgb, face_size);
+  streamer.set_compression(compression);
+}
+
+}
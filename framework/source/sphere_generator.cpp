@@ -0,0 +1,366 @@
+#include "sphere_generator.hpp"
+
+#include "index_codec.hpp"
+
+#include <glbinding/gl/enum.h>
+
+// use floats and med precision operations
+#include <glm/gtc/type_precision.hpp>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+  const float PI = 3.14159265358979f;
+  // marks a vertex without a copy yet
+  const GLuint NONE = 0xffffffffu;
+  // texture coordinates this close to 1 wrap to 0, so vertices on the seam start on the near side
+  const float SEAM_EPSILON = 1.0e-6f;
+  // the icosahedron stands on a vertex at each pole, with two rings of 5 vertices in between
+  const GLuint NORTH = 0;
+  const GLuint SOUTH = 11;
+  // vertices closer to the axis take their tangent from the longitude of their texture coordinate
+  const float POLE_RADIUS = 1.0e-4f;
+  // free slot of the edge table, no edge connects a vertex to itself
+  const std::uint64_t EMPTY_EDGE = 0;
+
+  // positions and texture coordinates of a sphere, the remaining attributes follow from them
+  struct sphere_mesh {
+    std::vector<glm::fvec3> positions;
+    std::vector<glm::fvec2> texcoords;
+    std::vector<GLuint> indices;
+  };
+
+  float wrap_longitude(glm::fvec3 const& position) {
+    float u = std::atan2(position.x, position.z) / (2.0f * PI);
+    u = u < 0.0f ? u + 1.0f : u;
+    return u > 1.0f - SEAM_EPSILON ? 0.0f : u;
+  }
+
+  float latitude(glm::fvec3 const& position) {
+    return 0.5f + std::asin(glm::clamp(position.y, -1.0f, 1.0f)) / PI;
+  }
+
+  sphere_mesh uv_mesh(std::size_t slices, std::size_t stacks) {
+    std::vector<float> sines(slices + 1);
+    std::vector<float> cosines(slices + 1);
+    for (std::size_t i = 0; i <= slices; ++i) {
+      // the last column repeats the first one at u = 1 with the same position
+      float longitude = 2.0f * PI * float(i % slices) / float(slices);
+      sines[i] = std::sin(longitude);
+      cosines[i] = std::cos(longitude);
+    }
+
+    sphere_mesh mesh;
+    std::size_t ring_vertices = slices + 1;
+    mesh.positions.reserve(2 * slices + (stacks - 1) * ring_vertices);
+    mesh.texcoords.reserve(mesh.positions.capacity());
+    // a pole vertex per slice in its middle, rows of the parallels from north to south
+    for (std::size_t i = 0; i < slices; ++i) {
+      mesh.positions.push_back(glm::fvec3{0.0f, 1.0f, 0.0f});
+      mesh.texcoords.push_back(glm::fvec2{(float(i) + 0.5f) / float(slices), 1.0f});
+    }
+    for (std::size_t row = 1; row < stacks; ++row) {
+      float polar = PI * float(row) / float(stacks);
+      float ring_radius = std::sin(polar);
+      float height = std::cos(polar);
+      for (std::size_t i = 0; i <= slices; ++i) {
+        mesh.positions.push_back(glm::fvec3{ring_radius * sines[i], height, ring_radius * cosines[i]});
+        mesh.texcoords.push_back(glm::fvec2{float(i) / float(slices), 1.0f - float(row) / float(stacks)});
+      }
+    }
+    for (std::size_t i = 0; i < slices; ++i) {
+      mesh.positions.push_back(glm::fvec3{0.0f, -1.0f, 0.0f});
+      mesh.texcoords.push_back(glm::fvec2{(float(i) + 0.5f) / float(slices), 0.0f});
+    }
+
+    // counterclockwise seen from outside, u grows to the right and v upwards
+    mesh.indices.reserve(6 * slices * (stacks - 1));
+    GLuint first_row = GLuint(slices);
+    GLuint south = GLuint(slices + (stacks - 1) * ring_vertices);
+    for (GLuint i = 0; i < GLuint(slices); ++i) {
+      mesh.indices.insert(mesh.indices.end(), {i, first_row + i, first_row + i + 1});
+    }
+    for (std::size_t row = 1; row + 1 < stacks; ++row) {
+      GLuint upper = GLuint(slices + (row - 1) * ring_vertices);
+      GLuint lower = GLuint(upper + ring_vertices);
+      for (GLuint i = 0; i < GLuint(slices); ++i) {
+        mesh.indices.insert(mesh.indices.end(), {upper + i, lower + i, upper + i + 1,
+                                                 upper + i + 1, lower + i, lower + i + 1});
+      }
+    }
+    GLuint last_row = GLuint(south - ring_vertices);
+    for (GLuint i = 0; i < GLuint(slices); ++i) {
+      mesh.indices.insert(mesh.indices.end(), {last_row + i, south + i, last_row + i + 1});
+    }
+    return mesh;
+  }
+
+  // positions of the subdivided icosahedron and its triangles after each subdivision, the coarser triangles
+  // only use the first positions
+  void subdivided_icosahedron(std::size_t subdivisions, std::vector<glm::fvec3>& positions,
+                              std::vector<std::vector<GLuint>>& levels) {
+    float ring_height = 1.0f / std::sqrt(5.0f);
+    float ring_radius = 2.0f / std::sqrt(5.0f);
+    positions = {glm::fvec3{0.0f, 1.0f, 0.0f}};
+    for (std::size_t ring = 0; ring < 2; ++ring) {
+      for (std::size_t k = 0; k < 5; ++k) {
+        // the lower ring is turned by half a step
+        float longitude = 2.0f * PI * (float(k) + 0.5f * float(ring)) / 5.0f;
+        positions.push_back(glm::fvec3{ring_radius * std::sin(longitude), ring == 0 ? ring_height : -ring_height,
+                                       ring_radius * std::cos(longitude)});
+      }
+    }
+    positions.push_back(glm::fvec3{0.0f, -1.0f, 0.0f});
+    levels.assign(1, std::vector<GLuint>{});
+    for (GLuint k = 0; k < 5; ++k) {
+      GLuint upper = 1 + k;
+      GLuint upper_next = 1 + (k + 1) % 5;
+      GLuint lower = 6 + k;
+      GLuint lower_next = 6 + (k + 1) % 5;
+      levels.front().insert(levels.front().end(), {NORTH, upper, upper_next,
+                                                   upper, lower, upper_next,
+                                                   upper_next, lower, lower_next,
+                                                   lower, SOUTH, lower_next});
+    }
+
+    // each triangle becomes 4, edges shared by two triangles get one midpoint found in an open addressing table
+    std::vector<std::uint64_t> edges;
+    std::vector<GLuint> midpoints;
+    for (std::size_t level = 0; level < subdivisions; ++level) {
+      std::vector<GLuint> const& indices = levels.back();
+      std::size_t capacity = 1;
+      while (capacity < indices.size()) {
+        capacity *= 2;
+      }
+      edges.assign(capacity, EMPTY_EDGE);
+      midpoints.resize(capacity);
+      positions.reserve(positions.size() + indices.size() / 2);
+      auto midpoint = [&positions, &edges, &midpoints, capacity](GLuint a, GLuint b) {
+        std::uint64_t key = std::uint64_t(std::min(a, b)) << 32 | std::max(a, b);
+        std::size_t slot = std::size_t((key * 0x9e3779b97f4a7c15ull) >> 32) & (capacity - 1);
+        while (edges[slot] != EMPTY_EDGE && edges[slot] != key) {
+          slot = (slot + 1) & (capacity - 1);
+        }
+        if (edges[slot] == EMPTY_EDGE) {
+          edges[slot] = key;
+          midpoints[slot] = GLuint(positions.size());
+          positions.push_back(glm::normalize(positions[a] + positions[b]));
+        }
+        return midpoints[slot];
+      };
+      std::vector<GLuint> subdivided(indices.size() * 4);
+      for (std::size_t i = 0; i < indices.size(); i += 3) {
+        GLuint a = indices[i];
+        GLuint b = indices[i + 1];
+        GLuint c = indices[i + 2];
+        GLuint ab = midpoint(a, b);
+        GLuint bc = midpoint(b, c);
+        GLuint ca = midpoint(c, a);
+        GLuint corners[12] = {a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca};
+        std::copy_n(corners, 12, subdivided.begin() + std::ptrdiff_t(4 * i));
+      }
+      levels.push_back(std::move(subdivided));
+    }
+  }
+
+  // vertices of the triangles with the texture coordinates of the positions, copied at the seam and the poles
+  sphere_mesh unwrap(std::vector<glm::fvec3> const& positions, std::vector<glm::fvec2> const& texcoords,
+                     std::vector<GLuint> const& triangles) {
+    // copies of the vertices with u and with u + 1, the second for triangles crossing the seam
+    std::vector<GLuint> copies(2 * positions.size(), NONE);
+    sphere_mesh mesh;
+    mesh.positions.reserve(positions.size() + positions.size() / 16);
+    mesh.texcoords.reserve(mesh.positions.capacity());
+    mesh.indices.resize(triangles.size());
+    for (std::size_t i = 0; i < triangles.size(); i += 3) {
+      float u[3] = {texcoords[triangles[i]].x, texcoords[triangles[i + 1]].x, texcoords[triangles[i + 2]].x};
+      // the poles take the longitude of the triangle and do not count towards its span
+      std::size_t pole = 3;
+      for (std::size_t corner = 0; corner < 3; ++corner) {
+        pole = triangles[i + corner] == NORTH || triangles[i + corner] == SOUTH ? corner : pole;
+      }
+      float low = 1.0f;
+      float high = 0.0f;
+      for (std::size_t corner = 0; corner < 3; ++corner) {
+        low = corner == pole ? low : std::min(low, u[corner]);
+        high = corner == pole ? high : std::max(high, u[corner]);
+      }
+      bool crosses_seam = high - low > 0.5f;
+      float pole_u = 0.0f;
+      for (std::size_t corner = 0; corner < 3; ++corner) {
+        if (corner != pole && crosses_seam && u[corner] < 0.5f) {
+          u[corner] += 1.0f;
+        }
+        pole_u += corner == pole ? 0.0f : 0.5f * u[corner];
+      }
+
+      for (std::size_t corner = 0; corner < 3; ++corner) {
+        GLuint source = triangles[i + corner];
+        if (corner == pole) {
+          mesh.indices[i + corner] = GLuint(mesh.positions.size());
+          mesh.positions.push_back(positions[source]);
+          mesh.texcoords.push_back(glm::fvec2{pole_u, texcoords[source].y});
+          continue;
+        }
+        GLuint& copy = copies[2 * source + (u[corner] > texcoords[source].x ? 1 : 0)];
+        if (copy == NONE) {
+          copy = GLuint(mesh.positions.size());
+          mesh.positions.push_back(positions[source]);
+          mesh.texcoords.push_back(glm::fvec2{u[corner], texcoords[source].y});
+        }
+        mesh.indices[i + corner] = copy;
+      }
+    }
+    return mesh;
+  }
+
+  // largest distance between the triangles and the unit sphere, at least the distance of their planes to it
+  float surface_error(sphere_mesh const& mesh) {
+    float nearest = 1.0f;
+    for (std::size_t i = 0; i < mesh.indices.size(); i += 3) {
+      glm::fvec3 const& a = mesh.positions[mesh.indices[i]];
+      glm::fvec3 normal = glm::cross(mesh.positions[mesh.indices[i + 1]] - a, mesh.positions[mesh.indices[i + 2]] - a);
+      float length = glm::length(normal);
+      if (length > 0.0f) {
+        nearest = std::min(nearest, glm::dot(normal, a) / length);
+      }
+    }
+    return 1.0f - nearest;
+  }
+
+  // interleave the levels into one model in the attribute order of model::VERTEX_ATTRIBS
+  model build(std::vector<sphere_mesh> const& levels, model::attrib_flag_t attributes) {
+    attributes |= model::POSITION;
+    std::size_t vertex_count = 0;
+    std::size_t index_count = 0;
+    for (sphere_mesh const& level : levels) {
+      vertex_count += level.positions.size();
+      index_count += level.indices.size();
+    }
+    std::size_t stride = 0;
+    for (model::attribute const& supported : model::VERTEX_ATTRIBS) {
+      stride += supported.flag & attributes ? std::size_t(supported.components) : 0;
+    }
+
+    std::vector<GLfloat> data(vertex_count * stride);
+    std::vector<GLuint> indices(index_count);
+    std::vector<model::submesh> parts;
+    std::vector<model::lod> lods;
+    // errors are relative to the radius of the bounding sphere around the bounds like those of mesh_simplifier,
+    // the half diagonal of the cube around the unit sphere
+    glm::fvec3 bounds_min{-1.0f};
+    glm::fvec3 bounds_max{1.0f};
+    float bounding_radius = glm::length(bounds_max - bounds_min) * 0.5f;
+    float full_error = surface_error(levels.front());
+    GLuint first_vertex = 0;
+    std::size_t first_index = 0;
+    for (sphere_mesh const& level : levels) {
+      for (std::size_t i = 0; i < level.positions.size(); ++i) {
+        glm::fvec3 const& position = level.positions[i];
+        glm::fvec2 const& texcoord = level.texcoords[i];
+        // the tangent points east along the parallel, at the poles towards the longitude of the texture coordinate,
+        // the bitangent points north, so the handedness is always positive
+        float ring_radius = std::sqrt(position.x * position.x + position.z * position.z);
+        float longitude = 2.0f * PI * texcoord.x;
+        glm::fvec3 tangent = ring_radius > POLE_RADIUS ? glm::fvec3{position.z, 0.0f, -position.x} / ring_radius
+                                                       : glm::fvec3{std::cos(longitude), 0.0f, -std::sin(longitude)};
+        GLfloat* vertex = &data[(first_vertex + i) * stride];
+        vertex = std::copy_n(&position.x, 3, vertex);
+        if (attributes & model::NORMAL) {
+          vertex = std::copy_n(&position.x, 3, vertex);
+        }
+        if (attributes & model::TEXCOORD) {
+          vertex = std::copy_n(&texcoord.x, 2, vertex);
+        }
+        if (attributes & model::TANGENT) {
+          vertex = std::copy_n(&tangent.x, 3, vertex);
+          *vertex++ = 1.0f;
+        }
+        if (attributes & model::BITANGENT) {
+          glm::fvec3 bitangent = glm::cross(position, tangent);
+          vertex = std::copy_n(&bitangent.x, 3, vertex);
+        }
+      }
+      for (std::size_t i = 0; i < level.indices.size(); ++i) {
+        indices[first_index + i] = first_vertex + level.indices[i];
+      }
+      parts.push_back(model::submesh{first_index, level.indices.size(), 0});
+      float error = first_index == 0 ? 0.0f : std::max(surface_error(level) - full_error, 0.0f) / bounding_radius;
+      lods.push_back(model::lod{first_index, level.indices.size(), error});
+      first_vertex += GLuint(level.positions.size());
+      first_index += level.indices.size();
+    }
+
+    model result{std::move(data), attributes, std::move(indices)};
+    result.bounds_min = bounds_min;
+    result.bounds_max = bounds_max;
+    if (levels.size() > 1) {
+      result.submeshes = std::move(parts);
+      result.lods = std::move(lods);
+    }
+    index_codec::narrow(result);
+    return result;
+  }
+
+  void check_uv(std::size_t slices, std::size_t stacks) {
+    if (slices < 3 || stacks < 2) {
+      throw std::invalid_argument("sphere_generator: a uv sphere needs at least 3 slices and 2 stacks");
+    }
+  }
+
+  void check_ico(std::size_t subdivisions) {
+    if (subdivisions > sphere_generator::MAX_SUBDIVISIONS) {
+      throw std::invalid_argument("sphere_generator: more than " + std::to_string(sphere_generator::MAX_SUBDIVISIONS)
+                                  + " subdivisions");
+    }
+  }
+}
+
+namespace sphere_generator {
+
+model uv_sphere(std::size_t slices, std::size_t stacks, model::attrib_flag_t attributes) {
+  check_uv(slices, stacks);
+  return build({uv_mesh(slices, stacks)}, attributes);
+}
+
+model ico_sphere(std::size_t subdivisions, model::attrib_flag_t attributes) {
+  return ico_sphere_lods(subdivisions, 0, attributes);
+}
+
+model uv_sphere_lods(std::size_t slices, std::size_t stacks, std::size_t levels, model::attrib_flag_t attributes) {
+  check_uv(slices, stacks);
+  std::vector<sphere_mesh> meshes{uv_mesh(slices, stacks)};
+  for (std::size_t level = 0; level < levels && slices / 2 >= MIN_SLICES && stacks / 2 >= MIN_STACKS; ++level) {
+    slices /= 2;
+    stacks /= 2;
+    meshes.push_back(uv_mesh(slices, stacks));
+  }
+  return build(meshes, attributes);
+}
+
+model ico_sphere_lods(std::size_t subdivisions, std::size_t levels, model::attrib_flag_t attributes) {
+  check_ico(subdivisions);
+  // the levels are subdivided once from the coarsest, the texture coordinates of the shared positions computed once
+  std::vector<glm::fvec3> positions;
+  std::vector<std::vector<GLuint>> subdivided;
+  subdivided_icosahedron(subdivisions, positions, subdivided);
+  std::vector<glm::fvec2> texcoords(positions.size());
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    texcoords[i] = glm::fvec2{wrap_longitude(positions[i]), latitude(positions[i])};
+  }
+  std::vector<sphere_mesh> meshes;
+  for (std::size_t level = 0; level <= std::min(levels, subdivisions); ++level) {
+    meshes.push_back(unwrap(positions, texcoords, subdivided[subdivisions - level]));
+  }
+  return build(meshes, attributes);
+}
+
+}
@@ -0,0 +1,545 @@
+#include "star_catalog.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace {
+
+using star_catalog::star;
+
+const std::uint32_t CACHE_VERSION = 1;
+const std::uint32_t GRID_RESOLUTION = 16;
+const std::size_t CHUNK_BYTES = std::size_t(1) << 22;
+
+// accepted column names, compared lowercase
+const char* const RA_NAMES[] = {"ra", "radeg", "ra_deg", "_raj2000", "raj2000", "ra_icrs", "raicrs", "rightascension"};
+const char* const DEC_NAMES[] = {"dec", "de", "dedeg", "dec_deg", "_dej2000", "dej2000", "de_icrs", "deicrs", "declination"};
+const char* const MAG_NAMES[] = {"mag", "vmag", "hpmag", "phot_g_mean_mag", "gmag", "magnitude"};
+const char* const BV_NAMES[] = {"bv", "b-v", "b_v", "ci", "colorindex"};
+const char* const BPRP_NAMES[] = {"bp_rp", "bp-rp", "bprp"};
+
+struct source_info {
+  std::uint64_t size;
+  std::int64_t time;
+};
+
+bool stat_file(std::string const& path, source_info& info) {
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) != 0) {
+    return false;
+  }
+  info.size = std::uint64_t(file_stat.st_size);
+  info.time = std::int64_t(file_stat.st_mtime);
+  return true;
+}
+
+template<std::size_t N>
+bool matches(std::string const& name, const char* const (&names)[N]) {
+  for (std::size_t i = 0; i < N; ++i) {
+    if (name == names[i]) return true;
+  }
+  return false;
+}
+
+// parse decimal float with optional exponent, returns nan for empty or malformed fields
+float parse_float(char const* begin, char const* end) {
+  while (begin < end && (*begin == ' ' || *begin == '"')) ++begin;
+
+  bool negative = false;
+  if (begin < end && (*begin == '-' || *begin == '+')) {
+    negative = *begin == '-';
+    ++begin;
+  }
+
+  double value = 0.0;
+  bool has_digits = false;
+  while (begin < end && *begin >= '0' && *begin <= '9') {
+    value = value * 10.0 + double(*begin - '0');
+    has_digits = true;
+    ++begin;
+  }
+  if (begin < end && *begin == '.') {
+    ++begin;
+    double scale = 0.1;
+    while (begin < end && *begin >= '0' && *begin <= '9') {
+      value += double(*begin - '0') * scale;
+      scale *= 0.1;
+      has_digits = true;
+      ++begin;
+    }
+  }
+  if (!has_digits) {
+    return std::numeric_limits<float>::quiet_NaN();
+  }
+  if (begin < end && (*begin == 'e' || *begin == 'E')) {
+    ++begin;
+    bool negative_exp = false;
+    if (begin < end && (*begin == '-' || *begin == '+')) {
+      negative_exp = *begin == '-';
+      ++begin;
+    }
+    int exponent = 0;
+    while (begin < end && *begin >= '0' && *begin <= '9') {
+      exponent = exponent * 10 + (*begin - '0');
+      ++begin;
+    }
+    value *= std::pow(10.0, negative_exp ? -exponent : exponent);
+  }
+  return float(negative ? -value : value);
+}
+
+// octahedral mapping of a unit vector to [0,1]^2
+void encode_octahedral(float x, float y, float z, float& u, float& v) {
+  float inv_l1 = 1.0f / (std::fabs(x) + std::fabs(y) + std::fabs(z));
+  x *= inv_l1;
+  y *= inv_l1;
+  z *= inv_l1;
+  if (z < 0.0f) {
+    float folded_x = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    float folded_y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = folded_x;
+    y = folded_y;
+  }
+  u = x * 0.5f + 0.5f;
+  v = y * 0.5f + 0.5f;
+}
+
+std::uint16_t quantize_unorm16(float value) {
+  return std::uint16_t(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+std::uint8_t quantize_unorm8(float value) {
+  return std::uint8_t(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// approximate star color from the B-V color index
+void color_from_bv(float bv, std::uint8_t* color) {
+  if (std::isnan(bv)) {
+    color[0] = color[1] = color[2] = 255;
+    return;
+  }
+  bv = std::min(std::max(bv, -0.4f), 2.0f);
+  // Ballesteros' formula for the effective temperature
+  float kelvin = 4600.0f * (1.0f / (0.92f * bv + 1.7f) + 1.0f / (0.92f * bv + 0.62f));
+  // blackbody color fit by Tanner Helland
+  float t = kelvin / 100.0f;
+  float r = t <= 66.0f ? 255.0f : 329.698727f * std::pow(t - 60.0f, -0.1332047592f);
+  float g = t <= 66.0f ? 99.4708025861f * std::log(t) - 161.1195681661f
+                       : 288.1221695283f * std::pow(t - 60.0f, -0.0755148492f);
+  float b = t >= 66.0f ? 255.0f : (t <= 19.0f ? 0.0f : 138.5177312231f * std::log(t - 10.0f) - 305.0447927307f);
+  float max_channel = std::max(std::max(r, g), std::max(b, 1.0f));
+  color[0] = quantize_unorm8(r / max_channel);
+  color[1] = quantize_unorm8(g / max_channel);
+  color[2] = quantize_unorm8(b / max_channel);
+}
+
+// streaming csv reader, collects stars and their unquantized magnitudes
+class csv_parser {
+ public:
+  csv_parser()
+   :delimiter_{','}
+   ,has_header_{false}
+   ,ra_column_{-1}
+   ,dec_column_{-1}
+   ,mag_column_{-1}
+   ,color_column_{-1}
+   ,color_is_bprp_{false}
+   ,skipped_{0}
+  {}
+
+  void parse_line(char const* begin, char const* end) {
+    // strip line endings and skip comments or empty lines
+    while (end > begin && (end[-1] == '\r' || end[-1] == '\n')) --end;
+    if (begin == end || *begin == '#') return;
+
+    if (!has_header_) {
+      parse_header(begin, end);
+      return;
+    }
+
+    float ra = std::numeric_limits<float>::quiet_NaN();
+    float dec = ra;
+    float mag = ra;
+    float color = ra;
+    int column = 0;
+    char const* field = begin;
+    while (field <= end) {
+      char const* field_end = static_cast<char const*>(std::memchr(field, delimiter_, std::size_t(end - field)));
+      if (!field_end) field_end = end;
+
+      if (column == ra_column_) ra = parse_float(field, field_end);
+      else if (column == dec_column_) dec = parse_float(field, field_end);
+      else if (column == mag_column_) mag = parse_float(field, field_end);
+      else if (column == color_column_) color = parse_float(field, field_end);
+
+      field = field_end + 1;
+      ++column;
+    }
+
+    if (std::isnan(ra) || std::isnan(dec) || std::isnan(mag)) {
+      ++skipped_;
+      return;
+    }
+
+    const float deg_to_rad = 0.01745329251994f;
+    float ra_rad = ra * deg_to_rad;
+    float dec_rad = dec * deg_to_rad;
+    // equatorial coordinates with the celestial north pole pointing up
+    float x = std::cos(dec_rad) * std::cos(ra_rad);
+    float y = std::sin(dec_rad);
+    float z = -std::cos(dec_rad) * std::sin(ra_rad);
+
+    star new_star;
+    float u = 0.0f;
+    float v = 0.0f;
+    encode_octahedral(x, y, z, u, v);
+    new_star.direction[0] = quantize_unorm16(u);
+    new_star.direction[1] = quantize_unorm16(v);
+    // rough conversion of Gaia BP-RP to Johnson B-V
+    if (color_is_bprp_ && !std::isnan(color)) {
+      color = 0.8f * color - 0.1f;
+    }
+    color_from_bv(color, new_star.color);
+    new_star.magnitude = 0;
+
+    stars.push_back(new_star);
+    magnitudes.push_back(mag);
+  }
+
+  std::size_t skipped() const {
+    return skipped_;
+  }
+
+  std::vector<star> stars;
+  std::vector<float> magnitudes;
+
+ private:
+  void parse_header(char const* begin, char const* end) {
+    // the most frequent candidate is the delimiter
+    const char candidates[] = {',', ';', '\t', '|'};
+    std::size_t best_count = 0;
+    for (char candidate : candidates) {
+      std::size_t count = std::size_t(std::count(begin, end, candidate));
+      if (count > best_count) {
+        best_count = count;
+        delimiter_ = candidate;
+      }
+    }
+
+    int column = 0;
+    char const* field = begin;
+    while (field <= end) {
+      char const* field_end = static_cast<char const*>(std::memchr(field, delimiter_, std::size_t(end - field)));
+      if (!field_end) field_end = end;
+
+      std::string name;
+      for (char const* c = field; c < field_end; ++c) {
+        if (*c != ' ' && *c != '"') name.push_back(char(std::tolower(*c)));
+      }
+      if (ra_column_ < 0 && matches(name, RA_NAMES)) ra_column_ = column;
+      else if (dec_column_ < 0 && matches(name, DEC_NAMES)) dec_column_ = column;
+      else if (mag_column_ < 0 && matches(name, MAG_NAMES)) mag_column_ = column;
+      else if (color_column_ < 0 && matches(name, BV_NAMES)) color_column_ = column;
+      else if (color_column_ < 0 && matches(name, BPRP_NAMES)) {
+        color_column_ = column;
+        color_is_bprp_ = true;
+      }
+
+      field = field_end + 1;
+      ++column;
+    }
+
+    if (ra_column_ < 0 || dec_column_ < 0 || mag_column_ < 0) {
+      throw std::invalid_argument("star_catalog: csv header needs ra, dec and magnitude columns");
+    }
+    has_header_ = true;
+  }
+
+  char delimiter_;
+  bool has_header_;
+  int ra_column_;
+  int dec_column_;
+  int mag_column_;
+  int color_column_;
+  bool color_is_bprp_;
+  std::size_t skipped_;
+};
+
+std::size_t cell_of(star const& s) {
+  std::size_t x = std::min(std::size_t(s.direction[0]) * GRID_RESOLUTION / 65536u, std::size_t(GRID_RESOLUTION - 1));
+  std::size_t y = std::min(std::size_t(s.direction[1]) * GRID_RESOLUTION / 65536u, std::size_t(GRID_RESOLUTION - 1));
+  return y * GRID_RESOLUTION + x;
+}
+
+bool cache_is_valid(mapped_file const& file, source_info const* source) {
+  if (file.size() < sizeof(star_catalog::cache_header)) return false;
+  star_catalog::cache_header const* header = reinterpret_cast<star_catalog::cache_header const*>(file.data());
+  if (std::memcmp(header->magic, "STAR", 4) != 0 || header->version != CACHE_VERSION) return false;
+
+  std::size_t cells = std::size_t(header->grid_resolution) * header->grid_resolution;
+  std::size_t expected = sizeof(star_catalog::cache_header) + (cells + 1) * sizeof(std::uint32_t)
+                       + std::size_t(header->star_count) * sizeof(star_catalog::star);
+  if (file.size() != expected) return false;
+  // without source the cache is used as is
+  if (source) {
+    return header->source_size == source->size && header->source_time == source->time;
+  }
+  return true;
+}
+
+}
+
+namespace star_catalog {
+
+///////////////////////////// catalog ///////////////////////////////////////////
+catalog::catalog()
+ :file_{}
+ ,header_{nullptr}
+ ,cells_{nullptr}
+ ,stars_{nullptr}
+{}
+
+catalog::catalog(mapped_file&& file)
+ :file_{std::move(file)}
+ ,header_{reinterpret_cast<cache_header const*>(file_.data())}
+ ,cells_{reinterpret_cast<std::uint32_t const*>(file_.data() + sizeof(cache_header))}
+ ,stars_{nullptr}
+{
+  stars_ = reinterpret_cast<star const*>(cells_ + cell_count() + 1);
+}
+
+bool catalog::empty() const {
+  return header_ == nullptr || header_->star_count == 0;
+}
+
+std::size_t catalog::size() const {
+  return header_ ? header_->star_count : 0;
+}
+
+star const* catalog::stars() const {
+  return stars_;
+}
+
+std::size_t catalog::byte_size() const {
+  return size() * sizeof(star);
+}
+
+std::size_t catalog::cell_count() const {
+  return header_ ? std::size_t(header_->grid_resolution) * header_->grid_resolution : 0;
+}
+
+std::uint32_t catalog::cell_begin(std::size_t cell) const {
+  return cells_[cell];
+}
+
+std::uint32_t catalog::count_brighter(std::size_t cell, float magnitude) const {
+  float range = header_->magnitude_max - header_->magnitude_min;
+  float normalized = range > 0.0f ? (magnitude - header_->magnitude_min) / range : 1.0f;
+  if (normalized < 0.0f) return 0;
+  // rounded like the stored magnitudes, so every star up to the limit falls into its step
+  unsigned limit = unsigned(std::min(normalized, 1.0f) * 255.0f + 0.5f);
+  // stars inside a cell are sorted by brightness
+  star const* begin = stars_ + cells_[cell];
+  star const* end = stars_ + cells_[cell + 1];
+  star const* last = std::upper_bound(begin, end, limit, [](unsigned value, star const& s) {
+    return value < s.magnitude;
+  });
+  return std::uint32_t(last - begin);
+}
+
+float catalog::magnitude_min() const {
+  return header_ ? header_->magnitude_min : 0.0f;
+}
+
+float catalog::magnitude_max() const {
+  return header_ ? header_->magnitude_max : 0.0f;
+}
+
+///////////////////////////// loading ///////////////////////////////////////////
+std::string cache_path(std::string const& csv_path) {
+  return csv_path + ".bin";
+}
+
+catalog load(std::string const& csv_path) {
+  std::string cached = cache_path(csv_path);
+  source_info source;
+  bool has_source = stat_file(csv_path, source);
+
+  mapped_file file{};
+  try {
+    file = mapped_file{cached};
+  }
+  catch (std::runtime_error&) {
+    // cache missing, build it below
+  }
+
+  if (!cache_is_valid(file, has_source ? &source : nullptr)) {
+    if (!has_source) {
+      return catalog{};
+    }
+    file.close();
+    build_cache(csv_path, cached);
+    file = mapped_file{cached};
+  }
+
+  return catalog{std::move(file)};
+}
+
+void build_cache(std::string const& csv_path, std::string const& cache_path) {
+  source_info source;
+  if (!stat_file(csv_path, source)) {
+    throw std::invalid_argument("star_catalog: could not open " + csv_path);
+  }
+  std::FILE* csv_file = std::fopen(csv_path.c_str(), "rb");
+  if (!csv_file) {
+    throw std::invalid_argument("star_catalog: could not open " + csv_path);
+  }
+
+  // read in large chunks and parse complete lines, carry the incomplete rest over
+  csv_parser parser{};
+  // rough row size estimate to avoid repeated reallocation
+  parser.stars.reserve(std::size_t(source.size / 48));
+  parser.magnitudes.reserve(std::size_t(source.size / 48));
+  std::vector<char> buffer(CHUNK_BYTES);
+  std::size_t carry = 0;
+  while (true) {
+    std::size_t read = std::fread(buffer.data() + carry, 1, buffer.size() - carry, csv_file);
+    char const* line = buffer.data();
+    char const* stop = buffer.data() + carry + read;
+    while (true) {
+      char const* line_end = static_cast<char const*>(std::memchr(line, '\n', std::size_t(stop - line)));
+      if (!line_end) break;
+      parser.parse_line(line, line_end);
+      line = line_end + 1;
+    }
+    carry = std::size_t(stop - line);
+    if (read == 0) {
+      // last line without line break
+      if (carry > 0) parser.parse_line(line, stop);
+      break;
+    }
+    std::memmove(buffer.data(), line, carry);
+    // line longer than the buffer
+    if (carry == buffer.size()) buffer.resize(buffer.size() * 2);
+  }
+  std::fclose(csv_file);
+
+  // quantize magnitudes relative to the catalog range
+  float mag_min = std::numeric_limits<float>::max();
+  float mag_max = std::numeric_limits<float>::lowest();
+  for (float mag : parser.magnitudes) {
+    mag_min = std::min(mag_min, mag);
+    mag_max = std::max(mag_max, mag);
+  }
+  if (parser.stars.empty()) {
+    mag_min = 0.0f;
+    mag_max = 0.0f;
+  }
+  float mag_scale = mag_max > mag_min ? 255.0f / (mag_max - mag_min) : 0.0f;
+  for (std::size_t i = 0; i < parser.stars.size(); ++i) {
+    parser.stars[i].magnitude = std::uint8_t(std::min((parser.magnitudes[i] - mag_min) * mag_scale + 0.5f, 255.0f));
+  }
+
+  // counting sort by cell and magnitude
+  const std::size_t cells = GRID_RESOLUTION * GRID_RESOLUTION;
+  std::vector<std::uint32_t> key_offsets(cells * 256 + 1, 0);
+  for (star const& s : parser.stars) {
+    ++key_offsets[cell_of(s) * 256 + s.magnitude + 1];
+  }
+  for (std::size_t i = 1; i < key_offsets.size(); ++i) {
+    key_offsets[i] += key_offsets[i - 1];
+  }
+  std::vector<std::uint32_t> cell_offsets(cells + 1);
+  for (std::size_t cell = 0; cell <= cells; ++cell) {
+    cell_offsets[cell] = key_offsets[cell * 256];
+  }
+  std::vector<star> sorted(parser.stars.size());
+  for (star const& s : parser.stars) {
+    sorted[key_offsets[cell_of(s) * 256 + s.magnitude]++] = s;
+  }
+
+  cache_header header;
+  std::memcpy(header.magic, "STAR", 4);
+  header.version = CACHE_VERSION;
+  header.star_count = std::uint32_t(sorted.size());
+  header.grid_resolution = GRID_RESOLUTION;
+  header.magnitude_min = mag_min;
+  header.magnitude_max = mag_max;
+  header.source_size = source.size;
+  header.source_time = source.time;
+
+  // write to temporary file first to never leave a truncated cache behind
+  std::string temp_path = cache_path + ".tmp";
+  {
+    std::ofstream cache_file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!cache_file) {
+      throw std::runtime_error("star_catalog: could not write " + temp_path);
+    }
+    cache_file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    cache_file.write(reinterpret_cast<char const*>(cell_offsets.data()), std::streamsize(cell_offsets.size() * sizeof(std::uint32_t)));
+    cache_file.write(reinterpret_cast<char const*>(sorted.data()), std::streamsize(sorted.size() * sizeof(star)));
+    if (!cache_file) {
+      throw std::runtime_error("star_catalog: could not write " + temp_path);
+    }
+  }
+  std::remove(cache_path.c_str());
+  if (std::rename(temp_path.c_str(), cache_path.c_str()) != 0) {
+    throw std::runtime_error("star_catalog: could not write " + cache_path);
+  }
+  // reported once per conversion, later runs map the cache
+  if (parser.skipped() > 0) {
+    std::cout << "star_catalog: skipped " << parser.skipped() << " malformed rows of " << csv_path << std::endl;
+  }
+}
+
+///////////////////////////// magnitude_limiter /////////////////////////////////
+magnitude_limiter::magnitude_limiter()
+ :min_{0.0f}
+ ,max_{0.0f}
+ ,limit_{0.0f}
+ ,budget_ms_{1000.0f / 60.0f}
+ ,average_ms_{0.0f}
+{}
+
+void magnitude_limiter::set_range(float magnitude_min, float magnitude_max) {
+  min_ = magnitude_min;
+  max_ = magnitude_max;
+  // start with the full catalog
+  limit_ = magnitude_max;
+}
+
+void magnitude_limiter::set_budget(float frame_ms) {
+  budget_ms_ = frame_ms;
+}
+
+float magnitude_limiter::update(float frame_ms) {
+  // smooth out single slow frames
+  average_ms_ = average_ms_ * 0.9f + frame_ms * 0.1f;
+  // drop faint stars quickly when over budget, add them back slowly
+  float range = max_ - min_;
+  if (average_ms_ > budget_ms_ * 1.05f) {
+    limit_ -= range * 0.01f;
+  }
+  else if (average_ms_ < budget_ms_ * 0.85f) {
+    limit_ += range * 0.002f;
+  }
+  // always keep the brightest stars
+  limit_ = std::min(std::max(limit_, min_ + range * 0.25f), max_);
+  return limit_;
+}
+
+float magnitude_limiter::limit() const {
+  return limit_;
+}
+
+}
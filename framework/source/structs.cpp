@@ -0,0 +1,69 @@
+#include "structs.hpp"
+
+#include <algorithm>
+
+namespace {
+  // Fraction of the allowed error a coarser level has to stay below
+  const float LOD_HYSTERESIS = 0.75f;
+}
+
+void model_object::draw_elements(std::size_t level) const {
+  if (!levels.empty()) {
+    level_of_detail const& detail = levels[std::min(level, levels.size() - 1)];
+    if (range_counts.empty()) {
+      glDrawElements(draw_mode, detail.num_elements, index_type, detail.offset);
+    }
+    else {
+      glMultiDrawElementsBaseVertex(draw_mode, range_counts.data() + detail.first_range, index_type,
+                                    range_offsets.data() + detail.first_range, GLsizei(detail.range_count),
+                                    range_base_vertices.data() + detail.first_range);
+    }
+    return;
+  }
+  if (range_counts.empty()) {
+    glDrawElements(draw_mode, num_elements, index_type, nullptr);
+  }
+  else {
+    // All parts in one call, core since OpenGL 3.2
+    glMultiDrawElementsBaseVertex(draw_mode, range_counts.data(), index_type, range_offsets.data(),
+                                  GLsizei(range_counts.size()), range_base_vertices.data());
+  }
+}
+
+void model_object::draw_clusters(cluster_draw const& draw) const {
+  if (draw.indirect_count > 0) {
+    // Commands of culled clusters have a count of 0, core since OpenGL 4.3
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draw.indirect_BO);
+    glMultiDrawElementsIndirect(draw_mode, index_type, reinterpret_cast<GLvoid const*>(draw.indirect_offset),
+                                draw.indirect_count, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  }
+  else if (!draw.counts.empty()) {
+    glMultiDrawElementsBaseVertex(draw_mode, draw.counts.data(), index_type, draw.offsets.data(),
+                                  GLsizei(draw.counts.size()), draw.base_vertices.data());
+  }
+}
+
+void model_object::cluster_range(std::size_t level, std::size_t& first, std::size_t& count) const {
+  if (levels.empty()) {
+    first = 0;
+    count = clusters.size();
+    return;
+  }
+  level_of_detail const& detail = levels[std::min(level, levels.size() - 1)];
+  first = detail.first_cluster;
+  count = detail.cluster_count;
+}
+
+std::size_t model_object::select_level(float screen_radius, std::size_t current, float pixel_error) const {
+  std::size_t level = 0;
+  // The errors grow with the levels
+  for (std::size_t i = 1; i < levels.size(); ++i) {
+    float allowed = i > current ? pixel_error * LOD_HYSTERESIS : pixel_error;
+    if (levels[i].error * screen_radius > allowed) {
+      break;
+    }
+    level = i;
+  }
+  return level;
+}
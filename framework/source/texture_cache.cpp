@@ -0,0 +1,314 @@
+#include "texture_cache.hpp"
+
+#include "block_compression.hpp"
+#include "texture_loader.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+  const std::uint32_t CACHE_VERSION = 4;
+  // level data starts at multiples of this for aligned copies
+  const std::size_t LEVEL_ALIGNMENT = 16;
+
+  std::size_t align(std::size_t offset) {
+    return (offset + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT * LEVEL_ALIGNMENT;
+  }
+}
+
+namespace texture_cache {
+
+///////////////////////////// image /////////////////////////////////////////////
+image::image()
+ :buffer_{}
+ ,header_{nullptr}
+ ,levels_{nullptr}
+ ,bytes_{nullptr}
+ ,size_{0}
+{}
+
+image::image(image_buffer&& buffer)
+ :image{}
+{
+  buffer_ = std::move(buffer);
+  attach(buffer_.data(), buffer_.size());
+}
+
+image::image(mapped_file&& file)
+ :image{image_buffer{std::move(file)}}
+{}
+
+image::image(std::vector<std::uint8_t>&& memory)
+ :image{image_buffer{std::move(memory)}}
+{}
+
+void image::attach(std::uint8_t const* bytes, std::size_t size) {
+  if (size < sizeof(cache_header)) {
+    throw std::runtime_error("texture_cache: truncated file");
+  }
+  cache_header const* header = reinterpret_cast<cache_header const*>(bytes);
+  if (std::memcmp(header->magic, "TEXC", 4) != 0 || header->version != CACHE_VERSION || header->level_count == 0) {
+    throw std::runtime_error("texture_cache: invalid header");
+  }
+  std::size_t table_end = sizeof(cache_header) + header->level_count * sizeof(level_info);
+  if (size < table_end) {
+    throw std::runtime_error("texture_cache: truncated level table");
+  }
+  level_info const* levels = reinterpret_cast<level_info const*>(bytes + sizeof(cache_header));
+  for (std::size_t i = 0; i < header->level_count; ++i) {
+    if (levels[i].offset < table_end || levels[i].offset + levels[i].size > size) {
+      throw std::runtime_error("texture_cache: level outside of file");
+    }
+  }
+  header_ = header;
+  levels_ = levels;
+  bytes_ = bytes;
+  size_ = size;
+}
+
+bool image::empty() const {
+  return header_ == nullptr;
+}
+
+cache_header const& image::header() const {
+  return *header_;
+}
+
+std::size_t image::level_count() const {
+  return header_ ? header_->level_count : 0;
+}
+
+level_info const& image::level(std::size_t index) const {
+  return levels_[index];
+}
+
+std::uint8_t const* image::level_data(std::size_t index) const {
+  return bytes_ + levels_[index].offset;
+}
+
+std::uint8_t const* image::data() const {
+  return header_ ? level_data(0) : nullptr;
+}
+
+std::size_t image::data_size() const {
+  return header_ ? size_ - std::size_t(levels_[0].offset) : 0;
+}
+
+///////////////////////////// loading ///////////////////////////////////////////
+std::string cache_path(std::string const& file_name) {
+  return file_name + ".tex";
+}
+
+std::uint64_t hash(std::uint8_t const* data, std::size_t size) {
+  // murmur64a style mixing of 8 byte words
+  const std::uint64_t multiplier = 0xc6a4a7935bd1e995ull;
+  std::uint64_t value = 0x9e3779b97f4a7c15ull ^ (size * multiplier);
+  std::size_t words = size / 8;
+  for (std::size_t i = 0; i < words; ++i) {
+    std::uint64_t word;
+    std::memcpy(&word, data + i * 8, 8);
+    word *= multiplier;
+    word ^= word >> 47;
+    word *= multiplier;
+    value ^= word;
+    value *= multiplier;
+  }
+  for (std::size_t i = words * 8; i < size; ++i) {
+    value ^= std::uint64_t(data[i]) << (8 * (i % 8));
+  }
+  value *= multiplier;
+  value ^= value >> 47;
+  return value;
+}
+
+image load(std::string const& file_name, mipmap::color_space space, bool compress) {
+  std::uint64_t source_hash = 0;
+  std::uint64_t source_size = 0;
+  {
+    mapped_file source{file_name};
+    source_hash = hash(source.data(), source.size());
+    source_size = source.size();
+  }
+
+  std::string cached = cache_path(file_name);
+  try {
+    image result{mapped_file{cached}};
+    if (result.header().source_hash == source_hash && result.header().source_size == source_size
+        && result.header().color_space == std::uint32_t(space) && (result.header().compressed != 0) == compress) {
+      return result;
+    }
+  }
+  catch (std::runtime_error&) {
+    // cache missing or damaged, rebuild it below
+  }
+  return store(cached, build(file_name, space, compress, source_hash, source_size));
+}
+
+image load_packed(std::string const& name, std::vector<packed_channel> const& channels, bool compress) {
+  // the hash covers the content of all sources and which of their channels go where
+  std::vector<std::uint64_t> recipe;
+  std::uint64_t source_size = 0;
+  for (packed_channel const& channel : channels) {
+    std::uint64_t source_hash = 0;
+    if (!channel.file_name.empty()) {
+      mapped_file source{channel.file_name};
+      source_hash = hash(source.data(), source.size());
+      source_size += source.size();
+    }
+    recipe.insert(recipe.end(), {source_hash, std::uint64_t(channel.space), std::uint64_t(channel.channel)});
+  }
+  std::uint64_t source_hash = hash(reinterpret_cast<std::uint8_t const*>(recipe.data()), recipe.size() * sizeof(std::uint64_t));
+
+  std::string cached = cache_path(name);
+  try {
+    image result{mapped_file{cached}};
+    if (result.header().source_hash == source_hash && result.header().source_size == source_size
+        && (result.header().compressed != 0) == compress) {
+      return result;
+    }
+  }
+  catch (std::runtime_error&) {
+    // cache missing or damaged, rebuild it below
+  }
+  return store(cached, build_packed(channels, compress, source_hash, source_size));
+}
+
+image store(std::string const& cached, contents&& built) {
+  // write to temporary file first to never leave a truncated cache behind
+  std::string temp_path = cached + ".tmp";
+  bool written = false;
+  {
+    std::ofstream cache_file(temp_path, std::ios::binary | std::ios::trunc);
+    cache_file.write(reinterpret_cast<char const*>(&built.header), sizeof(cache_header));
+    cache_file.write(reinterpret_cast<char const*>(built.levels.data()), std::streamsize(built.levels.size() * sizeof(level_info)));
+    std::size_t position = sizeof(cache_header) + built.levels.size() * sizeof(level_info);
+    const char padding[LEVEL_ALIGNMENT] = {};
+    for (std::size_t i = 0; i < built.mips.size(); ++i) {
+      cache_file.write(padding, std::streamsize(std::size_t(built.levels[i].offset) - position));
+      cache_file.write(reinterpret_cast<char const*>(built.mips[i].pixels.data()), std::streamsize(built.mips[i].pixels.size()));
+      position = std::size_t(built.levels[i].offset + built.levels[i].size);
+    }
+    written = bool(cache_file);
+  }
+  std::remove(cached.c_str());
+  if (written && std::rename(temp_path.c_str(), cached.c_str()) == 0) {
+    // the mapping replaces the level buffers, which are freed on return
+    try {
+      return image{mapped_file{cached}};
+    }
+    catch (std::runtime_error&) {
+      // could not be mapped again, keep the data in memory below
+    }
+  }
+  else {
+    std::remove(temp_path.c_str());
+    std::cerr << "texture_cache: could not write " << cached << ", using uncached texture" << std::endl;
+  }
+
+  level_info const& last = built.levels.back();
+  std::vector<std::uint8_t> memory(std::size_t(last.offset + last.size), 0);
+  std::memcpy(memory.data(), &built.header, sizeof(cache_header));
+  std::memcpy(memory.data() + sizeof(cache_header), built.levels.data(), built.levels.size() * sizeof(level_info));
+  for (std::size_t i = 0; i < built.mips.size(); ++i) {
+    std::memcpy(memory.data() + built.levels[i].offset, built.mips[i].pixels.data(), built.mips[i].pixels.size());
+  }
+  return image{std::move(memory)};
+}
+
+contents build(std::string const& file_name, mipmap::color_space space, bool compress,
+               std::uint64_t source_hash, std::uint64_t source_size) {
+  std::vector<pixel_data> mips = texture_loader::file_mipmapped(file_name, space);
+  block_compression::format block_format = block_compression::choose_format(mips.front());
+  return assemble(std::move(mips), compress, block_format, std::uint32_t(space), source_hash, source_size);
+}
+
+contents build_packed(std::vector<packed_channel> const& channels, bool compress,
+                      std::uint64_t source_hash, std::uint64_t source_size) {
+  if (channels.empty() || channels.size() > 4) {
+    throw std::invalid_argument("texture_cache: packed textures need one to four channels");
+  }
+  // every source is filtered in its own color space before packing, files used for several channels once
+  std::vector<std::string> files;
+  std::vector<std::vector<pixel_data>> sources;
+  for (packed_channel const& channel : channels) {
+    if (!channel.file_name.empty() && std::find(files.begin(), files.end(), channel.file_name) == files.end()) {
+      files.push_back(channel.file_name);
+      sources.push_back(texture_loader::file_mipmapped(channel.file_name, channel.space));
+    }
+  }
+  if (sources.empty()) {
+    throw std::invalid_argument("texture_cache: packed texture without source");
+  }
+
+  std::vector<pixel_data> mips;
+  for (std::size_t level = 0; level < sources.front().size(); ++level) {
+    std::vector<texture_loader::channel_source> level_sources;
+    for (packed_channel const& channel : channels) {
+      texture_loader::channel_source source{nullptr, channel.channel};
+      if (!channel.file_name.empty()) {
+        std::vector<pixel_data> const& source_mips = sources[std::size_t(std::find(files.begin(), files.end(), channel.file_name) - files.begin())];
+        if (source_mips.size() != sources.front().size()) {
+          throw std::invalid_argument("texture_cache: packed images differ in size");
+        }
+        source.image = &source_mips[level];
+      }
+      level_sources.push_back(source);
+    }
+    mips.push_back(texture_loader::pack(level_sources));
+  }
+  // channels hold unrelated data, so the block format only depends on their number
+  return assemble(std::move(mips), compress, block_compression::format_for(channels.size()), std::uint32_t(mipmap::color_space::linear),
+                  source_hash, source_size);
+}
+
+contents assemble(std::vector<pixel_data>&& mips, bool compress, block_compression::format block_format,
+                  std::uint32_t space, std::uint64_t source_hash, std::uint64_t source_size) {
+  pixel_data const& base = mips.front();
+  // uncompressed levels keep the channel count of the source instead of padding to rgba
+  GLenum internal_format = texture_loader::sized_format(texture_loader::channel_count(base.channels));
+  if (compress) {
+    // levels are replaced by their blocks, filtering happened on the full precision texels
+    internal_format = block_compression::internal_format(block_format);
+    for (pixel_data& level : mips) {
+      level.pixels = block_compression::encode(level, block_format);
+    }
+  }
+
+  std::size_t level_count = mips.size();
+  std::vector<level_info> levels(level_count);
+  std::size_t offset = align(sizeof(cache_header) + level_count * sizeof(level_info));
+  for (std::size_t i = 0; i < level_count; ++i) {
+    pixel_data const& level = mips[i];
+    levels[i].width = std::uint32_t(level.width);
+    levels[i].height = std::uint32_t(level.height);
+    levels[i].offset = offset;
+    levels[i].size = level.pixels.size();
+    offset = align(offset + level.pixels.size());
+  }
+
+  cache_header header{};
+  std::memcpy(header.magic, "TEXC", 4);
+  header.version = CACHE_VERSION;
+  header.source_hash = source_hash;
+  header.source_size = source_size;
+  header.width = std::uint32_t(base.width);
+  header.height = std::uint32_t(base.height);
+  header.level_count = std::uint32_t(level_count);
+  header.internal_format = std::uint32_t(internal_format);
+  header.format = std::uint32_t(base.channels);
+  header.type = std::uint32_t(base.channel_type);
+  header.compressed = compress ? 1 : 0;
+  header.color_space = space;
+
+  return contents{header, std::move(levels), std::move(mips)};
+}
+
+}
@@ -1,5 +1,8 @@
 #include "texture_loader.hpp"
 
+#include "mapped_file.hpp"
+#include "qoi.hpp"
+
 // request supported types
 #define STBI_ONLY_JPEG
 #define STBI_ONLY_PNG
@@ -11,54 +14,190 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
  
+#include <algorithm>
+#include <cctype>
 #include <cstdint> 
 #include <cstring> 
+#include <iterator>
+#include <mutex>
 #include <stdexcept> 
+#include <utility>
+
+namespace {
+  bool has_extension(std::string const& file_name, std::string const& extension) {
+    if (file_name.size() < extension.size()) {
+      return false;
+    }
+    return std::equal(extension.begin(), extension.end(), file_name.end() - std::ptrdiff_t(extension.size()), [](char a, char b) {
+      return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    });
+  }
+}
 
 namespace texture_loader {
 pixel_data file(std::string const& file_name) {
-  // match to opengl representation
-  stbi_set_flip_vertically_on_load(true);
+  // qoi decodes in parallel bands and flips the rows while decoding
+  if (has_extension(file_name, ".qoi")) {
+    mapped_file encoded{file_name};
+    return qoi::decode(encoded.data(), encoded.size());
+  }
+
+  // match to opengl representation, the flag is global in stb_image so set it only once for concurrent loads
+  static std::once_flag flip_flag;
+  std::call_once(flip_flag, []() { stbi_set_flip_vertically_on_load(true); });
 
   uint8_t* data_ptr;
   int width = 0;
   int height = 0;
   int format = STBI_default;
-  data_ptr = stbi_load(file_name.c_str(), &width, &height, &format, STBI_rgb_alpha);
+  data_ptr = stbi_load(file_name.c_str(), &width, &height, &format, STBI_default);
 
   if(!data_ptr) {
     throw std::logic_error(std::string{"stb_image: "} + stbi_failure_reason());
   }
 
-  // determine format of image data, internal format should be sized
-  GLenum pixel_format = GL_NONE;
-  std::size_t num_components = 0;
-  if (format == STBI_grey) {
-    pixel_format = GL_RED;
-    num_components = 1;
+  // keep the channel count stored in the file instead of expanding everything to rgba
+  if (format < STBI_grey || format > STBI_rgb_alpha) {
+    stbi_image_free(data_ptr);
+    throw std::logic_error("stb_image: misinterpreted data, incorrect format");
   }
-  else if (format == STBI_grey_alpha) {
-    pixel_format = GL_RG;
-    num_components = 2;
+  std::size_t num_components = std::size_t(format);
+  GLenum pixel_format = channel_format(num_components);
+
+  // hand on the decoder memory instead of copying it, stb_image frees it once the image is dropped
+  std::size_t size = std::size_t(width) * std::size_t(height) * num_components;
+  image_buffer texture_data{data_ptr, size, [data_ptr]() { stbi_image_free(data_ptr); }};
+
+  return pixel_data{std::move(texture_data), pixel_format, GL_UNSIGNED_BYTE, std::size_t(width), std::size_t(height)};
+}
+
+std::vector<pixel_data> file_mipmapped(std::string const& file_name, mipmap::color_space space) {
+  pixel_data base = file(file_name);
+  std::size_t components = channel_count(base.channels);
+  if (space == mipmap::color_space::srgb && components < 3) {
+    // color maps are read as rgb, grey and grey alpha images are expanded
+    base = convert(std::move(base), components == 1 ? GL_RGB : GL_RGBA);
   }
-  else if (format == STBI_rgb) {
-    pixel_format = GL_RGB;
-    num_components = 3;
+  else if (space == mipmap::color_space::linear && components >= 3 && is_grey(base)) {
+    base = convert(std::move(base), GL_RED);
   }
-  else if (format == STBI_rgb_alpha) {
-    pixel_format = GL_RGBA;
-    num_components = 4;
+
+  std::vector<pixel_data> levels;
+  levels.push_back(std::move(base));
+  std::vector<pixel_data> mips = mipmap::generate(levels.front(), space);
+  levels.insert(levels.end(), std::make_move_iterator(mips.begin()), std::make_move_iterator(mips.end()));
+
+  // normals are renormalized with all three components, only x and y are stored
+  if (space == mipmap::color_space::normal && components >= 3) {
+    for (pixel_data& level : levels) {
+      level = convert(std::move(level), GL_RG);
+    }
   }
-  else {
-    throw std::logic_error("stb_image: misinterpreted data, incorrect format");
+  return levels;
+}
+
+std::size_t channel_count(GLenum channels) {
+  if (channels == GL_RED) {
+    return 1;
+  }
+  else if (channels == GL_RG) {
+    return 2;
+  }
+  else if (channels == GL_RGB) {
+    return 3;
+  }
+  else if (channels == GL_RGBA) {
+    return 4;
+  }
+  throw std::invalid_argument("texture_loader: unsupported channel format");
+}
+
+GLenum channel_format(std::size_t count) {
+  static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+  if (count < 1 || count > 4) {
+    throw std::invalid_argument("texture_loader: unsupported channel count");
+  }
+  return formats[count - 1];
+}
+
+GLenum sized_format(std::size_t count) {
+  static const GLenum formats[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+  if (count < 1 || count > 4) {
+    throw std::invalid_argument("texture_loader: unsupported channel count");
+  }
+  return formats[count - 1];
+}
+
+pixel_data convert(pixel_data image, GLenum channels) {
+  std::size_t from = channel_count(image.channels);
+  std::size_t to = channel_count(channels);
+  if (from == to) {
+    return image;
   }
 
-  std::vector<uint8_t> texture_data(width * height * num_components);
-  // copy data to vector
-  std::memcpy(&texture_data[0], data_ptr, texture_data.size());
-  stbi_image_free(data_ptr);
+  std::size_t count = image.width * image.height;
+  std::vector<uint8_t> converted(count * to);
+  for (std::size_t i = 0; i < count; ++i) {
+    uint8_t const* source = &image.pixels[i * from];
+    uint8_t rgba[4] = {source[0], source[0], source[0], 255};
+    if (from == 2) {
+      rgba[3] = source[1];
+    }
+    else if (from >= 3) {
+      rgba[1] = source[1];
+      rgba[2] = source[2];
+      if (from == 4) {
+        rgba[3] = source[3];
+      }
+    }
+    std::memcpy(&converted[i * to], rgba, to);
+  }
+  return pixel_data{std::move(converted), channels, image.channel_type, image.width, image.height};
+}
+
+bool is_grey(pixel_data const& image) {
+  std::size_t components = channel_count(image.channels);
+  for (std::size_t i = 0; i < image.width * image.height; ++i) {
+    uint8_t const* texel = &image.pixels[i * components];
+    if ((components >= 3 && (texel[0] != texel[1] || texel[0] != texel[2]))
+        || ((components == 2 || components == 4) && texel[components - 1] != 255)) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  return pixel_data{texture_data, pixel_format, GL_UNSIGNED_BYTE, std::size_t(width), std::size_t(height)};
+pixel_data pack(std::vector<channel_source> const& sources) {
+  pixel_data const* reference = nullptr;
+  for (channel_source const& source : sources) {
+    if (source.image) {
+      if (reference && (source.image->width != reference->width || source.image->height != reference->height)) {
+        throw std::invalid_argument("texture_loader: packed images differ in size");
+      }
+      if (source.channel >= channel_count(source.image->channels)) {
+        throw std::invalid_argument("texture_loader: packed channel does not exist");
+      }
+      reference = source.image;
+    }
+  }
+  if (!reference) {
+    throw std::invalid_argument("texture_loader: nothing to pack");
+  }
+
+  std::size_t components = sources.size();
+  std::size_t count = reference->width * reference->height;
+  std::vector<uint8_t> packed(count * components, 0);
+  for (std::size_t c = 0; c < components; ++c) {
+    channel_source const& source = sources[c];
+    if (!source.image) {
+      continue;
+    }
+    std::size_t stride = channel_count(source.image->channels);
+    for (std::size_t i = 0; i < count; ++i) {
+      packed[i * components + c] = source.image->pixels[i * stride + source.channel];
+    }
+  }
+  return pixel_data{std::move(packed), channel_format(components), GL_UNSIGNED_BYTE, reference->width, reference->height};
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "texture_residency.hpp"
+
+#include "utils.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+//dont load gl bindings from glfw
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+texture_residency::settings::settings()
+ :budget{0}
+ ,loads_per_update{1}
+ ,upload_bytes{std::size_t(16) * 1024 * 1024}
+ ,min_size{256}
+ ,evict_delay{120}
+{}
+
+void texture_residency::read_settings(int argc, char* argv[]) {
+  settings& config = default_settings();
+  config.budget = std::size_t(std::stod(utils::read_option(argc, argv, "texture-budget", "0")) * 1024.0 * 1024.0);
+  config.loads_per_update = unsigned(std::stoul(utils::read_option(argc, argv, "texture-loads", "1")));
+  config.upload_bytes = std::size_t(std::stod(utils::read_option(argc, argv, "texture-upload", "16")) * 1024.0 * 1024.0);
+}
+
+texture_residency::settings& texture_residency::default_settings() {
+  static settings config{};
+  return config;
+}
+
+texture_residency::texture_residency()
+ :texture_residency{default_settings()}
+{}
+
+texture_residency::texture_residency(settings const& config)
+ :settings_{config}
+ ,entries_{}
+ ,update_{0}
+ ,resident_bytes_{0}
+ ,has_texture_storage_{glfwExtensionSupported("GL_ARB_texture_storage") != 0}
+{}
+
+texture_residency::~texture_residency() {
+  for (entry& e : entries_) {
+    glDeleteTextures(1, &e.texture->handle);
+    e.texture->handle = 0;
+  }
+}
+
+void texture_residency::add(texture_object& texture, std::shared_ptr<texture_cache::image> const& image) {
+  if (texture.target != GL_TEXTURE_2D) {
+    throw std::invalid_argument("texture_residency: only 2d textures can be managed");
+  }
+  if (contains(texture)) {
+    throw std::logic_error("texture_residency: texture is already managed");
+  }
+  std::size_t level_count = image->level_count();
+  entries_.push_back(entry{&texture, image, level_count, level_count, update_, update_});
+  allocate(entries_.back(), base_level(entries_.back()));
+}
+
+bool texture_residency::contains(texture_object const& texture) const {
+  return std::any_of(entries_.begin(), entries_.end(), [&texture](entry const& e) { return e.texture == &texture; });
+}
+
+void texture_residency::request(texture_object const& texture, float screen_pixels) {
+  for (entry& e : entries_) {
+    if (e.texture != &texture) {
+      continue;
+    }
+    // one texel per pixel, the level is rounded down so magnification is avoided
+    float texels_per_pixel = float(e.image->header().width) / std::max(screen_pixels, 1.0f);
+    std::size_t level = texels_per_pixel > 1.0f ? std::size_t(std::log2(texels_per_pixel)) : 0;
+    e.wanted = std::min(e.wanted, level);
+    return;
+  }
+}
+
+void texture_residency::update() {
+  ++update_;
+
+  // levels needed by the requests, detail no longer needed is kept for a while
+  std::vector<std::size_t> targets(entries_.size());
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < entries_.size(); ++i) {
+    entry& e = entries_[i];
+    std::size_t base = base_level(e);
+    std::size_t target = base;
+    if (e.wanted < e.image->level_count()) {
+      e.last_used = update_;
+      target = std::min(e.wanted, base);
+    }
+    if (target <= e.resident) {
+      e.last_needed = update_;
+    }
+    else if (update_ - e.last_needed < settings_.evict_delay) {
+      target = e.resident;
+    }
+    e.wanted = e.image->level_count();
+    targets[i] = target;
+    total += bytes(e, target);
+  }
+
+  if (settings_.budget > 0 && total > settings_.budget) {
+    // drop detail of the least recently used textures first
+    std::vector<std::size_t> order(entries_.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+      return entries_[a].last_used < entries_[b].last_used;
+    });
+    for (std::size_t i : order) {
+      entry const& e = entries_[i];
+      while (total > settings_.budget && e.last_used != update_ && targets[i] < base_level(e)) {
+        total -= bytes(e, targets[i]) - bytes(e, targets[i] + 1);
+        ++targets[i];
+      }
+    }
+    // then take a level from whichever visible texture uses the most memory
+    while (total > settings_.budget) {
+      std::size_t largest = entries_.size();
+      for (std::size_t i = 0; i < entries_.size(); ++i) {
+        if (targets[i] < base_level(entries_[i])
+            && (largest == entries_.size() || bytes(entries_[i], targets[i]) > bytes(entries_[largest], targets[largest]))) {
+          largest = i;
+        }
+      }
+      if (largest == entries_.size()) {
+        break;
+      }
+      total -= bytes(entries_[largest], targets[largest]) - bytes(entries_[largest], targets[largest] + 1);
+      ++targets[largest];
+    }
+  }
+
+  // evictions are applied at once, loads for the textures missing the most levels first
+  std::vector<std::size_t> loads;
+  for (std::size_t i = 0; i < entries_.size(); ++i) {
+    if (targets[i] > entries_[i].resident) {
+      allocate(entries_[i], targets[i]);
+    }
+    else if (targets[i] < entries_[i].resident) {
+      loads.push_back(i);
+    }
+  }
+  std::sort(loads.begin(), loads.end(), [this, &targets](std::size_t a, std::size_t b) {
+    return entries_[a].resident - targets[a] > entries_[b].resident - targets[b];
+  });
+  // a load reuploads all levels of the texture, so a large one steps towards its target within the byte limit
+  std::size_t uploaded = 0;
+  std::size_t loaded = 0;
+  for (std::size_t i = 0; i < loads.size() && loaded < settings_.loads_per_update; ++i) {
+    entry& e = entries_[loads[i]];
+    std::size_t level = targets[loads[i]];
+    if (settings_.upload_bytes > 0) {
+      while (level + 1 < e.resident && uploaded + bytes(e, level) > settings_.upload_bytes) {
+        ++level;
+      }
+      if (uploaded > 0 && uploaded + bytes(e, level) > settings_.upload_bytes) {
+        continue;
+      }
+    }
+    allocate(e, level);
+    uploaded += bytes(e, level);
+    ++loaded;
+  }
+}
+
+std::size_t texture_residency::resident_bytes() const {
+  return resident_bytes_;
+}
+
+texture_residency::settings const& texture_residency::get_settings() const {
+  return settings_;
+}
+
+std::size_t texture_residency::bytes(entry const& e, std::size_t level) const {
+  std::size_t sum = 0;
+  for (std::size_t i = level; i < e.image->level_count(); ++i) {
+    sum += std::size_t(e.image->level(i).size);
+  }
+  return sum;
+}
+
+std::size_t texture_residency::base_level(entry const& e) const {
+  std::size_t level = 0;
+  while (level + 1 < e.image->level_count()
+         && std::max(e.image->level(level).width, e.image->level(level).height) > settings_.min_size) {
+    ++level;
+  }
+  return level;
+}
+
+void texture_residency::allocate(entry& e, std::size_t level) {
+  texture_cache::image const& image = *e.image;
+  texture_cache::cache_header const& header = image.header();
+  GLenum internal_format = GLenum(header.internal_format);
+  GLsizei levels = GLsizei(image.level_count() - level);
+
+  GLuint handle = 0;
+  glGenTextures(1, &handle);
+  glBindTexture(GL_TEXTURE_2D, handle);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+  if (has_texture_storage_) {
+    glTexStorage2D(GL_TEXTURE_2D, levels, internal_format, GLsizei(image.level(level).width), GLsizei(image.level(level).height));
+  }
+
+  // the levels are read straight from the cache mapping
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (std::size_t source = level; source < image.level_count(); ++source) {
+    texture_cache::level_info const& info = image.level(source);
+    GLint target_level = GLint(source - level);
+    if (header.compressed != 0) {
+      if (has_texture_storage_) {
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, target_level, 0, 0, GLsizei(info.width), GLsizei(info.height),
+                                  internal_format, GLsizei(info.size), image.level_data(source));
+      }
+      else {
+        glCompressedTexImage2D(GL_TEXTURE_2D, target_level, internal_format, GLsizei(info.width), GLsizei(info.height), 0,
+                               GLsizei(info.size), image.level_data(source));
+      }
+    }
+    else if (has_texture_storage_) {
+      glTexSubImage2D(GL_TEXTURE_2D, target_level, 0, 0, GLsizei(info.width), GLsizei(info.height),
+                      GLenum(header.format), GLenum(header.type), image.level_data(source));
+    }
+    else {
+      glTexImage2D(GL_TEXTURE_2D, target_level, GLint(internal_format), GLsizei(info.width), GLsizei(info.height), 0,
+                   GLenum(header.format), GLenum(header.type), image.level_data(source));
+    }
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  // nodes keep pointing to the texture object, only its handle is replaced
+  if (e.texture->handle != 0) {
+    glDeleteTextures(1, &e.texture->handle);
+  }
+  e.texture->handle = handle;
+
+  if (e.resident < image.level_count()) {
+    resident_bytes_ -= bytes(e, e.resident);
+  }
+  resident_bytes_ += bytes(e, level);
+  e.resident = level;
+}
@@ -0,0 +1,275 @@
+#include "texture_streamer.hpp"
+
+#include "texture_residency.hpp"
+#include "thread_pool.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+//dont load gl bindings from glfw
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+  // smallest level with at least detail_size texels per side, the base level if it is smaller
+  std::size_t first_level(texture_cache::image const& image, std::size_t detail_size) {
+    std::size_t first = 0;
+    while (detail_size > 0 && first + 1 < image.level_count()
+           && std::min(image.level(first + 1).width, image.level(first + 1).height) >= detail_size) {
+      ++first;
+    }
+    return first;
+  }
+
+  // bytes of the levels from first on, they are stored back to back up to the end of the data
+  std::size_t level_bytes(texture_cache::image const& image, std::size_t first) {
+    return image.data_size() - std::size_t(image.level(first).offset - image.level(0).offset);
+  }
+
+  // layer of the image in glCopyImageSubData, cube map faces are layers of the cube map
+  GLint image_layer(texture_object const& texture, GLenum image_target) {
+    return texture.target == GL_TEXTURE_CUBE_MAP ? GLint(unsigned(image_target) - unsigned(GL_TEXTURE_CUBE_MAP_POSITIVE_X)) : 0;
+  }
+}
+
+texture_streamer::texture_streamer(thread_pool& pool, std::size_t ring_size)
+ :pool_(pool)
+ ,jobs_{}
+ ,ring_(std::max(ring_size, std::size_t(1)), slot{0, 0, nullptr})
+ ,next_slot_{0}
+ ,has_texture_storage_{glfwExtensionSupported("GL_ARB_texture_storage") != 0}
+ ,has_copy_image_{glfwExtensionSupported("GL_ARB_copy_image") != 0}
+ ,compress_{glfwExtensionSupported("GL_EXT_texture_compression_s3tc") != 0}
+ ,residency_{nullptr}
+ ,allocated_{}
+ ,texture_memory_{0}
+{
+  for (slot& s : ring_) {
+    glGenBuffers(1, &s.buffer);
+  }
+}
+
+texture_streamer::~texture_streamer() {
+  for (slot& s : ring_) {
+    if (s.fence) {
+      glDeleteSync(s.fence);
+    }
+    glDeleteBuffers(1, &s.buffer);
+  }
+}
+
+void texture_streamer::load(texture_object& texture, GLenum image_target, std::string const& file_name,
+                            mipmap::color_space space, std::size_t detail_size) {
+  bool compress = compress_;
+  enqueue(texture, image_target, file_name, detail_size, [file_name, space, compress]() {
+    return texture_cache::load(file_name, space, compress);
+  });
+}
+
+void texture_streamer::load_packed(texture_object& texture, std::string const& name,
+                                   std::vector<texture_cache::packed_channel> const& channels) {
+  bool compress = compress_;
+  enqueue(texture, texture.target, name, 0, [name, channels, compress]() {
+    return texture_cache::load_packed(name, channels, compress);
+  });
+}
+
+void texture_streamer::enqueue(texture_object& texture, GLenum image_target, std::string const& name, std::size_t detail_size,
+                               std::function<texture_cache::image()> loader) {
+  if (texture.handle == 0) {
+    glGenTextures(1, &texture.handle);
+  }
+
+  for (job& pending : jobs_) {
+    if (pending.file_name == name) {
+      pending.destinations.push_back(destination{&texture, image_target, detail_size});
+      return;
+    }
+  }
+  jobs_.push_back(job{name, pool_.submit(std::move(loader)), {}});
+  jobs_.back().destinations.push_back(destination{&texture, image_target, detail_size});
+}
+
+void texture_streamer::flush() {
+  while (!jobs_.empty()) {
+    // take whichever load finished first, block on the oldest if none is done yet
+    std::vector<job>::iterator finished = std::find_if(jobs_.begin(), jobs_.end(), [](job const& pending) {
+      return pending.image.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    });
+    if (finished == jobs_.end()) {
+      finished = jobs_.begin();
+    }
+    // rethrows loading errors, the image is shared with the residency manager
+    std::shared_ptr<texture_cache::image> image = std::make_shared<texture_cache::image>(finished->image.get());
+    if (residency_) {
+      std::vector<destination>& destinations = finished->destinations;
+      for (destination const& target : destinations) {
+        if (target.texture->target == GL_TEXTURE_2D) {
+          residency_->add(*target.texture, image);
+        }
+      }
+      destinations.erase(std::remove_if(destinations.begin(), destinations.end(), [](destination const& target) {
+        return target.texture->target == GL_TEXTURE_2D;
+      }), destinations.end());
+    }
+    if (!finished->destinations.empty()) {
+      upload(*finished, *image);
+    }
+    jobs_.erase(finished);
+  }
+}
+
+void texture_streamer::set_compression(bool enabled) {
+  compress_ = enabled;
+}
+
+bool texture_streamer::compression() const {
+  return compress_;
+}
+
+void texture_streamer::set_residency(texture_residency* residency) {
+  residency_ = residency;
+}
+
+std::size_t texture_streamer::texture_memory() const {
+  return texture_memory_;
+}
+
+void texture_streamer::upload(job& finished, texture_cache::image const& image) {
+  // levels finer than all destinations need are never touched, so their pages are not read from the cache
+  std::size_t staged_level = image.level_count() - 1;
+  for (destination const& target : finished.destinations) {
+    staged_level = std::min(staged_level, first_level(image, target.detail_size));
+  }
+  std::size_t base_offset = std::size_t(image.level(staged_level).offset);
+  std::size_t size = level_bytes(image, staged_level);
+  slot& s = ring_[next_slot_];
+  next_slot_ = (next_slot_ + 1) % ring_.size();
+
+  // the buffer may only be rewritten once the gpu has copied the previous image out of it
+  if (s.fence) {
+    glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+    glDeleteSync(s.fence);
+    s.fence = nullptr;
+  }
+
+  // all needed levels are copied at once, straight from the cache mapping
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.buffer);
+  if (s.capacity < size) {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(size), nullptr, GL_STREAM_DRAW);
+    s.capacity = size;
+  }
+  void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(size),
+                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+  // without a mapping the levels are read from client memory instead, which waits for the driver to copy them
+  bool staged = mapped != nullptr;
+  if (staged) {
+    std::memcpy(mapped, image.level_data(staged_level), size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  }
+  else {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  texture_cache::cache_header const& header = image.header();
+  GLenum internal_format = GLenum(header.internal_format);
+  GLenum format = GLenum(header.format);
+  GLenum type = GLenum(header.type);
+
+  // all destinations copy from the same staging memory
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (std::size_t i = 0; i < finished.destinations.size(); ++i) {
+    destination const& target = finished.destinations[i];
+    std::size_t first = first_level(image, target.detail_size);
+    allocate(*target.texture, image, first);
+    texture_memory_ += level_bytes(image, first);
+
+    // another face or texture already holds the same levels, copy them without going through the pixel buffer again
+    std::vector<destination>::const_iterator uploaded = finished.destinations.cbegin() + std::ptrdiff_t(i);
+    std::vector<destination>::const_iterator source = std::find_if(finished.destinations.cbegin(), uploaded,
+      [&image, first](destination const& earlier) { return first_level(image, earlier.detail_size) == first; });
+    if (has_copy_image_ && source != uploaded) {
+      for (std::size_t level = first; level < image.level_count(); ++level) {
+        texture_cache::level_info const& info = image.level(level);
+        glCopyImageSubData(source->texture->handle, source->texture->target, GLint(level - first), 0, 0,
+                           image_layer(*source->texture, source->image_target),
+                           target.texture->handle, target.texture->target, GLint(level - first), 0, 0,
+                           image_layer(*target.texture, target.image_target), GLsizei(info.width), GLsizei(info.height), 1);
+      }
+      continue;
+    }
+
+    for (std::size_t level = first; level < image.level_count(); ++level) {
+      texture_cache::level_info const& info = image.level(level);
+      // offsets into the bound pixel buffer return without waiting for the copy
+      void const* pixels = staged ? reinterpret_cast<void const*>(std::size_t(info.offset) - base_offset)
+                                  : image.level_data(level);
+      if (header.compressed != 0) {
+        glCompressedTexSubImage2D(target.image_target, GLint(level - first), 0, 0, GLsizei(info.width), GLsizei(info.height),
+                                  internal_format, GLsizei(info.size), pixels);
+      }
+      else {
+        glTexSubImage2D(target.image_target, GLint(level - first), 0, 0, GLsizei(info.width), GLsizei(info.height),
+                        format, type, pixels);
+      }
+    }
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  if (staged) {
+    s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_UNUSED_BIT);
+  }
+
+  // client memory uploads elsewhere must not source from the buffer
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void texture_streamer::allocate(texture_object const& texture, texture_cache::image const& image, std::size_t first_level) {
+  glBindTexture(texture.target, texture.handle);
+  if (std::find(allocated_.begin(), allocated_.end(), texture.handle) != allocated_.end()) {
+    return;
+  }
+  allocated_.push_back(texture.handle);
+
+  texture_cache::cache_header const& header = image.header();
+  GLsizei levels = GLsizei(image.level_count() - first_level);
+  texture_cache::level_info const& base = image.level(first_level);
+  // trilinear filtering over the full chain
+  glTexParameteri(texture.target, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(texture.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(texture.target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+  if (has_texture_storage_) {
+    // immutable storage for all levels and faces in one call
+    glTexStorage2D(texture.target, levels, GLenum(header.internal_format), GLsizei(base.width), GLsizei(base.height));
+    return;
+  }
+  // mutable fallback, every level of every face has to be specified
+  std::vector<GLenum> images{texture.target};
+  if (texture.target == GL_TEXTURE_CUBE_MAP) {
+    images = {GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_X, GL_TEXTURE_CUBE_MAP_POSITIVE_Y,
+              GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, GL_TEXTURE_CUBE_MAP_POSITIVE_Z, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z};
+  }
+  // no pixel buffer may be bound while allocating without data
+  GLint unpack_buffer = 0;
+  glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack_buffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  for (GLenum face : images) {
+    for (std::size_t level = first_level; level < image.level_count(); ++level) {
+      texture_cache::level_info const& info = image.level(level);
+      if (header.compressed != 0) {
+        glCompressedTexImage2D(face, GLint(level - first_level), GLenum(header.internal_format), GLsizei(info.width), GLsizei(info.height), 0,
+                               GLsizei(info.size), nullptr);
+      }
+      else {
+        glTexImage2D(face, GLint(level - first_level), GLint(header.internal_format), GLsizei(info.width), GLsizei(info.height), 0,
+                     GLenum(header.format), GLenum(header.type), nullptr);
+      }
+    }
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GLuint(unpack_buffer));
+}
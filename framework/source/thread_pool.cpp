@@ -0,0 +1,118 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+thread_pool::thread_pool(std::size_t threads)
+ :workers_{}
+ ,tasks_{}
+ ,mutex_{}
+ ,condition_{}
+ ,stopping_{false}
+{
+  if (threads == 0) {
+    threads = std::max(std::size_t(std::thread::hardware_concurrency()), std::size_t(1));
+  }
+  for (std::size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back([this]() { work(); });
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+std::size_t thread_pool::size() const {
+  return workers_.size();
+}
+
+void thread_pool::work() {
+  while (true) {
+    std::function<void()> task{};
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+void thread_pool::parallel_for(std::size_t begin, std::size_t end, std::size_t grain,
+                               std::function<void(std::size_t, std::size_t)> const& body) {
+  if (begin >= end) {
+    return;
+  }
+  grain = std::max(grain, std::size_t(1));
+  std::size_t chunks = (end - begin + grain - 1) / grain;
+  if (chunks == 1) {
+    body(begin, end);
+    return;
+  }
+
+  // helpers may start after all chunks are taken, so the state outlives this call
+  struct shared_state {
+    std::atomic<std::size_t> next;
+    std::size_t done;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable finished;
+  };
+  auto state = std::make_shared<shared_state>();
+  state->next = 0;
+  state->done = 0;
+
+  auto run_chunks = [state, begin, end, grain, chunks, &body]() {
+    std::size_t chunk = 0;
+    while ((chunk = state->next.fetch_add(1)) < chunks) {
+      std::size_t chunk_begin = begin + chunk * grain;
+      try {
+        body(chunk_begin, std::min(chunk_begin + grain, end));
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock{state->mutex};
+        if (!state->error) {
+          state->error = std::current_exception();
+        }
+      }
+      std::lock_guard<std::mutex> lock{state->mutex};
+      if (++state->done == chunks) {
+        state->finished.notify_all();
+      }
+    }
+  };
+
+  // the body reference stays valid, helpers only call it for chunks taken before all are done
+  std::size_t helpers = std::min(size(), chunks - 1);
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (std::size_t i = 0; i < helpers; ++i) {
+      tasks_.push_back(run_chunks);
+    }
+  }
+  condition_.notify_all();
+
+  run_chunks();
+  std::unique_lock<std::mutex> lock{state->mutex};
+  state->finished.wait(lock, [&state, chunks]() { return state->done == chunks; });
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+}
+
+thread_pool& thread_pool::shared() {
+  static thread_pool pool{};
+  return pool;
+}
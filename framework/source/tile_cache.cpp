@@ -0,0 +1,526 @@
+#include "tile_cache.hpp"
+
+#include "thread_pool.hpp"
+#include "utils.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+//dont load gl bindings from glfw
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace {
+  // readbacks in flight, the feedback of a pass is analysed a few frames later without stalling
+  const std::size_t READBACK_COUNT = 3;
+  // offsets of the feedback projection within a feedback texel, cycled to cover all viewport pixels it stands for
+  const unsigned JITTER_GRID = 4;
+
+  GLenum texture_unit(GLint unit) {
+    return GLenum(unsigned(GL_TEXTURE0) + unsigned(unit));
+  }
+}
+
+tile_cache::settings::settings()
+ :cache_tiles{32}
+ ,uploads_per_update{16}
+ ,feedback_divisor{8}
+{}
+
+void tile_cache::read_settings(int argc, char* argv[]) {
+  settings& config = default_settings();
+  config.cache_tiles = unsigned(std::stoul(utils::read_option(argc, argv, "vt-cache", "32")));
+  config.uploads_per_update = unsigned(std::stoul(utils::read_option(argc, argv, "vt-uploads", "16")));
+}
+
+tile_cache::settings& tile_cache::default_settings() {
+  static settings config{};
+  return config;
+}
+
+tile_cache::tile_cache(thread_pool& pool)
+ :tile_cache{pool, default_settings()}
+{}
+
+tile_cache::tile_cache(thread_pool& pool, settings const& config)
+ :pool_(pool)
+ ,settings_{config}
+ ,textures_{}
+ ,slots_{}
+ ,loads_{}
+ ,physical_{0}
+ ,internal_format_{GL_NONE}
+ ,format_{GL_NONE}
+ ,type_{GL_NONE}
+ ,compressed_{false}
+ ,padded_size_{0}
+ ,tile_bytes_{0}
+ ,cache_tiles_{0}
+ ,has_texture_storage_{glfwExtensionSupported("GL_ARB_texture_storage") != 0}
+ ,viewport_{1, 1}
+ ,feedback_size_{1, 1}
+ ,framebuffer_{0}
+ ,feedback_buffer_{0}
+ ,depth_buffer_{0}
+ ,readbacks_{}
+ ,next_readback_{0}
+ ,previous_framebuffer_{0}
+ ,previous_viewport_{0, 0, 0, 0}
+ ,pass_{0}
+ ,frame_{0}
+{
+  if (settings_.cache_tiles == 0 || settings_.feedback_divisor == 0) {
+    throw std::invalid_argument("tile_cache: cache tiles and feedback divisor must not be zero");
+  }
+}
+
+tile_cache::~tile_cache() {
+  // loads read from the mappings, which are closed with the textures
+  for (load& pending : loads_) {
+    pending.texels.wait();
+  }
+  for (texture_entry& texture : textures_) {
+    glDeleteTextures(1, &texture.indirection);
+  }
+  glDeleteTextures(1, &physical_);
+  for (readback& r : readbacks_) {
+    if (r.fence) {
+      glDeleteSync(r.fence);
+    }
+    glDeleteBuffers(1, &r.buffer);
+  }
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteRenderbuffers(1, &feedback_buffer_);
+  glDeleteRenderbuffers(1, &depth_buffer_);
+}
+
+std::size_t tile_cache::add(std::string const& file_name, mipmap::color_space space, bool compress) {
+  virtual_texture::tiled_image image = virtual_texture::load(file_name, space, compress);
+  virtual_texture::file_header const& header = image.header();
+  if (physical_ == 0) {
+    allocate(header);
+  }
+  else if (GLenum(header.internal_format) != internal_format_) {
+    throw std::invalid_argument("tile_cache: format of " + file_name + " differs from the cached tiles");
+  }
+
+  std::size_t tiles = image.tile_count();
+  texture_entry texture{std::move(image), 0, std::vector<std::int32_t>(tiles, -1), std::vector<std::uint32_t>(tiles, 0),
+                        std::vector<std::uint32_t>(tiles, 0), std::vector<std::uint32_t>(tiles, 0),
+                        std::vector<bool>(tiles, false), true};
+  textures_.push_back(std::move(texture));
+  std::size_t id = textures_.size();
+  texture_entry& added = textures_.back();
+
+  // one texel per tile holding slot x, slot y and level of the resident tile, read with texelFetch
+  // tile counts of odd sized levels are not halved exactly, so each level gets a layer of the base size
+  virtual_texture::level_info const& base = added.image.level(0);
+  glGenTextures(1, &added.indirection);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, added.indirection);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GLint(GL_RGBA8UI), GLsizei(base.tiles_x), GLsizei(base.tiles_y),
+               GLsizei(added.image.level_count()), 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+
+  // the coarsest level is the fallback for every tile
+  std::size_t coarsest = added.image.level_count() - 1;
+  for (std::size_t tile = added.image.tile_index(coarsest, 0, 0); tile < tiles; ++tile) {
+    std::int32_t slot_index = find_slot();
+    if (slot_index < 0 || slots_[std::size_t(slot_index)].texture != 0) {
+      throw std::runtime_error("tile_cache: cache too small for the coarsest level of " + file_name);
+    }
+    upload(id, tile, slot_index, added.image.tile_data(tile));
+    slots_[std::size_t(slot_index)].pinned = true;
+  }
+  rebuild_indirection(added);
+  return id;
+}
+
+bool tile_cache::empty() const {
+  return textures_.empty();
+}
+
+void tile_cache::resize(unsigned width, unsigned height) {
+  viewport_ = glm::uvec2{std::max(width, 1u), std::max(height, 1u)};
+  glm::uvec2 size{std::max(viewport_.x / settings_.feedback_divisor, 1u), std::max(viewport_.y / settings_.feedback_divisor, 1u)};
+  if (size != feedback_size_ || framebuffer_ == 0) {
+    feedback_size_ = size;
+    allocate_feedback();
+  }
+}
+
+void tile_cache::begin_feedback() {
+  if (framebuffer_ == 0) {
+    allocate_feedback();
+  }
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer_);
+  glGetIntegerv(GL_VIEWPORT, previous_viewport_);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glViewport(0, 0, GLsizei(feedback_size_.x), GLsizei(feedback_size_.y));
+  // texture id 0 marks texels without virtual texture
+  const GLuint clear_value[4] = {0, 0, 0, 0};
+  glClearBufferuiv(GL_COLOR, 0, clear_value);
+  glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void tile_cache::end_feedback() {
+  readback& target = readbacks_[next_readback_];
+  if (target.fence) {
+    // not analysed in time, the newer pass replaces it
+    glDeleteSync(target.fence);
+  }
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, target.buffer);
+  glReadPixels(0, 0, GLsizei(feedback_size_.x), GLsizei(feedback_size_.y), GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  target.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, GL_UNUSED_BIT);
+  target.width = feedback_size_.x;
+  target.height = feedback_size_.y;
+  next_readback_ = (next_readback_ + 1) % readbacks_.size();
+  ++frame_;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previous_framebuffer_));
+  glViewport(previous_viewport_[0], previous_viewport_[1], previous_viewport_[2], previous_viewport_[3]);
+}
+
+glm::vec2 tile_cache::feedback_jitter() const {
+  unsigned index = frame_ % (JITTER_GRID * JITTER_GRID);
+  glm::vec2 offset{(float(index % JITTER_GRID) + 0.5f) / float(JITTER_GRID) - 0.5f,
+                   (float(index / JITTER_GRID) + 0.5f) / float(JITTER_GRID) - 0.5f};
+  // one feedback texel spans two divided by its size in normalized device coordinates
+  return offset * 2.0f / glm::vec2{feedback_size_};
+}
+
+void tile_cache::update() {
+  // fences signal in order, only the newest finished feedback is analysed as older ones are outdated
+  readback* finished = nullptr;
+  for (std::size_t i = 0; i < readbacks_.size(); ++i) {
+    readback& r = readbacks_[(next_readback_ + i) % readbacks_.size()];
+    if (!r.fence) {
+      continue;
+    }
+    GLenum status = glClientWaitSync(r.fence, GL_NONE_BIT, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      break;
+    }
+    glDeleteSync(r.fence);
+    r.fence = nullptr;
+    finished = &r;
+  }
+  std::vector<request> requests;
+  if (finished) {
+    std::size_t count = std::size_t(finished->width) * finished->height;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, finished->buffer);
+    void const* texels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(count * 4 * sizeof(std::uint16_t)), GL_MAP_READ_BIT);
+    if (texels) {
+      requests = analyse(static_cast<std::uint16_t const*>(texels), count);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  }
+
+  // coarse tiles first, they replace the blurriest fallbacks, then by screen coverage
+  std::sort(requests.begin(), requests.end(), [](request const& a, request const& b) {
+    return a.level != b.level ? a.level > b.level : a.hits > b.hits;
+  });
+  std::size_t max_loads = 2 * std::size_t(settings_.uploads_per_update);
+  for (request const& r : requests) {
+    if (loads_.size() >= max_loads) {
+      break;
+    }
+    texture_entry& texture = entry(r.texture);
+    if (texture.slots[r.tile] >= 0 || texture.loading[r.tile]) {
+      continue;
+    }
+    texture.loading[r.tile] = true;
+    // reading the tile pages it in from disk off the render thread
+    std::uint8_t const* data = texture.image.tile_data(r.tile);
+    std::size_t bytes = tile_bytes_;
+    loads_.push_back(load{r.texture, r.tile, pool_.submit([data, bytes]() {
+      return std::vector<std::uint8_t>(data, data + bytes);
+    })});
+  }
+
+  // upload finished loads in the order they were started
+  std::size_t uploads = 0;
+  for (auto it = loads_.begin(); it != loads_.end() && uploads < settings_.uploads_per_update;) {
+    if (it->texels.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      ++it;
+      continue;
+    }
+    std::vector<std::uint8_t> texels = it->texels.get();
+    entry(it->texture).loading[it->tile] = false;
+    // without a slot that was not seen in the last pass the tile is dropped and requested again later
+    std::int32_t slot_index = find_slot();
+    if (slot_index >= 0) {
+      upload(it->texture, it->tile, slot_index, texels.data());
+      ++uploads;
+    }
+    it = loads_.erase(it);
+  }
+
+  for (texture_entry& texture : textures_) {
+    if (texture.dirty) {
+      rebuild_indirection(texture);
+    }
+  }
+}
+
+void tile_cache::bind(std::size_t id, shader_program const& shader, GLint indirection_unit, GLint physical_unit) const {
+  texture_entry const& texture = entry(id);
+  virtual_texture::file_header const& header = texture.image.header();
+  glActiveTexture(texture_unit(indirection_unit));
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture.indirection);
+  glUniform1i(shader.u_locs.at("TextureIndirection"), indirection_unit);
+  glActiveTexture(texture_unit(physical_unit));
+  glBindTexture(GL_TEXTURE_2D, physical_);
+  glUniform1i(shader.u_locs.at("TexturePhysical"), physical_unit);
+  glUniform2f(shader.u_locs.at("VirtualSize"), float(header.width), float(header.height));
+  glUniform1f(shader.u_locs.at("VirtualTileSize"), float(header.tile_size));
+  glUniform1f(shader.u_locs.at("VirtualTileBorder"), float(header.tile_border));
+  glUniform1i(shader.u_locs.at("VirtualLevels"), GLint(header.level_count));
+}
+
+void tile_cache::bind_feedback(std::size_t id, shader_program const& shader) const {
+  virtual_texture::file_header const& header = entry(id).image.header();
+  glUniform1i(shader.u_locs.at("VirtualId"), GLint(id));
+  glUniform2f(shader.u_locs.at("VirtualSize"), float(header.width), float(header.height));
+  glUniform1f(shader.u_locs.at("VirtualTileSize"), float(header.tile_size));
+  glUniform1i(shader.u_locs.at("VirtualLevels"), GLint(header.level_count));
+  // derivatives are larger by the divisor in the low resolution pass
+  glUniform1f(shader.u_locs.at("FeedbackBias"), -std::log2(float(viewport_.y) / float(feedback_size_.y)));
+}
+
+std::size_t tile_cache::resident_tiles() const {
+  return std::size_t(std::count_if(slots_.begin(), slots_.end(), [](slot const& s) { return s.texture != 0; }));
+}
+
+std::size_t tile_cache::capacity() const {
+  return slots_.size();
+}
+
+std::size_t tile_cache::texture_memory() const {
+  std::size_t bytes = slots_.size() * tile_bytes_;
+  for (texture_entry const& texture : textures_) {
+    virtual_texture::level_info const& base = texture.image.level(0);
+    bytes += std::size_t(base.tiles_x) * base.tiles_y * texture.image.level_count() * 4;
+  }
+  return bytes;
+}
+
+tile_cache::texture_entry& tile_cache::entry(std::size_t id) {
+  return textures_.at(id - 1);
+}
+
+tile_cache::texture_entry const& tile_cache::entry(std::size_t id) const {
+  return textures_.at(id - 1);
+}
+
+void tile_cache::allocate(virtual_texture::file_header const& header) {
+  internal_format_ = GLenum(header.internal_format);
+  format_ = GLenum(header.format);
+  type_ = GLenum(header.type);
+  compressed_ = header.compressed != 0;
+  padded_size_ = header.tile_size + 2 * header.tile_border;
+  tile_bytes_ = std::size_t(header.tile_bytes);
+
+  // slot coordinates are stored in 8 bit indirection texels
+  GLint max_size = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+  cache_tiles_ = std::min({settings_.cache_tiles, unsigned(std::size_t(max_size) / padded_size_), 256u});
+  slots_.assign(std::size_t(cache_tiles_) * cache_tiles_, slot{0, 0, false});
+
+  // single level, tiles are filtered bilinearly inside their borders
+  GLsizei size = GLsizei(cache_tiles_ * padded_size_);
+  glGenTextures(1, &physical_);
+  glBindTexture(GL_TEXTURE_2D, physical_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  if (has_texture_storage_) {
+    glTexStorage2D(GL_TEXTURE_2D, 1, internal_format_, size, size);
+  }
+  else if (compressed_) {
+    glCompressedTexImage2D(GL_TEXTURE_2D, 0, internal_format_, size, size, 0, GLsizei(slots_.size() * tile_bytes_), nullptr);
+  }
+  else {
+    glTexImage2D(GL_TEXTURE_2D, 0, GLint(internal_format_), size, size, 0, format_, type_, nullptr);
+  }
+}
+
+void tile_cache::allocate_feedback() {
+  if (framebuffer_ == 0) {
+    glGenFramebuffers(1, &framebuffer_);
+    glGenRenderbuffers(1, &feedback_buffer_);
+    glGenRenderbuffers(1, &depth_buffer_);
+    readbacks_.assign(READBACK_COUNT, readback{0, nullptr, 0, 0});
+    for (readback& r : readbacks_) {
+      glGenBuffers(1, &r.buffer);
+    }
+  }
+  GLsizei width = GLsizei(feedback_size_.x);
+  GLsizei height = GLsizei(feedback_size_.y);
+
+  // tile x, tile y, level and texture id per texel
+  glBindRenderbuffer(GL_RENDERBUFFER, feedback_buffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA16UI, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  GLint previous = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, feedback_buffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+  bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previous));
+  if (!complete) {
+    throw std::runtime_error("tile_cache: feedback framebuffer incomplete");
+  }
+
+  // pending reads have the old size and are dropped
+  for (readback& r : readbacks_) {
+    if (r.fence) {
+      glDeleteSync(r.fence);
+      r.fence = nullptr;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, r.buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(std::size_t(width) * std::size_t(height) * 4 * sizeof(std::uint16_t)), nullptr, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+std::vector<tile_cache::request> tile_cache::analyse(std::uint16_t const* texels, std::size_t count) {
+  ++pass_;
+  std::vector<request> requests;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::uint16_t const* texel = texels + i * 4;
+    std::size_t id = texel[3];
+    if (id == 0 || id > textures_.size()) {
+      continue;
+    }
+    texture_entry& texture = entry(id);
+    std::size_t level = texel[2];
+    if (level >= texture.image.level_count()
+        || texel[0] >= texture.image.level(level).tiles_x || texel[1] >= texture.image.level(level).tiles_y) {
+      continue;
+    }
+    std::size_t tile = texture.image.tile_index(level, texel[0], texel[1]);
+    if (texture.request_pass[tile] != pass_) {
+      texture.request_pass[tile] = pass_;
+      texture.hits[tile] = 0;
+      requests.push_back(request{id, tile, level, 0});
+    }
+    ++texture.hits[tile];
+  }
+
+  // coarser tiles are the fallback of the seen ones, so they are kept and requested as well
+  std::size_t seen = requests.size();
+  for (std::size_t i = 0; i < seen; ++i) {
+    texture_entry& texture = entry(requests[i].texture);
+    requests[i].hits = texture.hits[requests[i].tile];
+    std::size_t tile = requests[i].tile;
+    while (texture.last_seen[tile] != pass_) {
+      texture.last_seen[tile] = pass_;
+      if (texture.request_pass[tile] != pass_) {
+        texture.request_pass[tile] = pass_;
+        requests.push_back(request{requests[i].texture, tile, texture.image.tile_level(tile), requests[i].hits});
+      }
+      tile = texture.image.parent(tile);
+    }
+  }
+  return requests;
+}
+
+std::int32_t tile_cache::find_slot() const {
+  std::int32_t best = -1;
+  std::uint32_t best_seen = pass_;
+  for (std::size_t i = 0; i < slots_.size(); ++i) {
+    slot const& s = slots_[i];
+    if (s.pinned) {
+      continue;
+    }
+    if (s.texture == 0) {
+      return std::int32_t(i);
+    }
+    std::uint32_t seen = entry(s.texture).last_seen[s.tile];
+    if (seen < best_seen) {
+      best = std::int32_t(i);
+      best_seen = seen;
+    }
+  }
+  return best;
+}
+
+void tile_cache::upload(std::size_t texture, std::size_t tile, std::int32_t slot_index, std::uint8_t const* texels) {
+  slot& target = slots_[std::size_t(slot_index)];
+  if (target.texture != 0) {
+    texture_entry& evicted = entry(target.texture);
+    evicted.slots[target.tile] = -1;
+    evicted.dirty = true;
+  }
+  target.texture = texture;
+  target.tile = tile;
+  texture_entry& owner = entry(texture);
+  owner.slots[tile] = slot_index;
+  owner.dirty = true;
+
+  GLint x = GLint(std::size_t(slot_index) % cache_tiles_ * padded_size_);
+  GLint y = GLint(std::size_t(slot_index) / cache_tiles_ * padded_size_);
+  GLsizei size = GLsizei(padded_size_);
+  glBindTexture(GL_TEXTURE_2D, physical_);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (compressed_) {
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, size, size, internal_format_, GLsizei(tile_bytes_), texels);
+  }
+  else {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, size, size, format_, type_, texels);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void tile_cache::rebuild_indirection(texture_entry& texture) {
+  virtual_texture::tiled_image const& image = texture.image;
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture.indirection);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  // from coarse to fine, tiles without slot take the entry of the tile covering their center
+  std::vector<std::uint8_t> coarser;
+  for (std::size_t level = image.level_count(); level-- > 0;) {
+    virtual_texture::level_info const& info = image.level(level);
+    std::vector<std::uint8_t> entries(std::size_t(info.tiles_x) * info.tiles_y * 4);
+    for (std::size_t y = 0; y < info.tiles_y; ++y) {
+      for (std::size_t x = 0; x < info.tiles_x; ++x) {
+        std::uint8_t* target = &entries[(y * info.tiles_x + x) * 4];
+        std::int32_t slot_index = texture.slots[image.tile_index(level, x, y)];
+        if (slot_index >= 0) {
+          target[0] = std::uint8_t(std::size_t(slot_index) % cache_tiles_);
+          target[1] = std::uint8_t(std::size_t(slot_index) / cache_tiles_);
+          target[2] = std::uint8_t(level);
+          target[3] = 255;
+        }
+        else {
+          std::size_t parent = image.parent(image.tile_index(level, x, y)) - std::size_t(image.level(level + 1).first_tile);
+          std::copy_n(&coarser[parent * 4], 4, target);
+        }
+      }
+    }
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, GLint(level), GLsizei(info.tiles_x), GLsizei(info.tiles_y), 1,
+                    GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries.data());
+    coarser = std::move(entries);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  texture.dirty = false;
+}
@@ -12,6 +12,15 @@ using namespace gl;
 
 #include <iostream>
 #include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 #include <fstream>
 
 namespace utils {
@@ -119,12 +128,15 @@ std::string read_file(std::string const& name) {
 
 std::string read_resource_path(int argc, char* argv[]) {
   std::string resource_path{};
-  //first argument is resource path
-  if (argc > 1) {
-    resource_path = argv[1];
+  //first argument that is no option is resource path
+  for (int i = 1; i < argc; ++i) {
+    if (std::string{argv[i]}.compare(0, 2, "--") != 0) {
+      resource_path = argv[i];
+      break;
+    }
   }
   // no resource path specified, use default
-  else {
+  if (resource_path.empty()) {
     std::string exe_path{argv[0]};
     resource_path = exe_path.substr(0, exe_path.find_last_of("/\\"));
     resource_path += "/../../resources/";
@@ -133,6 +145,49 @@ std::string read_resource_path(int argc, char* argv[]) {
   return resource_path;
 }
 
+std::string read_option(int argc, char* argv[], std::string const& name, std::string const& fallback) {
+  std::string prefix{"--" + name + "="};
+  for (int i = 1; i < argc; ++i) {
+    std::string argument{argv[i]};
+    if (argument.compare(0, prefix.size(), prefix) == 0) {
+      return argument.substr(prefix.size());
+    }
+  }
+  return fallback;
+}
+
+bool has_option(int argc, char* argv[], std::string const& name) {
+  std::string flag{"--" + name};
+  for (int i = 1; i < argc; ++i) {
+    std::string argument{argv[i]};
+    if (argument == flag || argument.compare(0, flag.size() + 1, flag + "=") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::size_t peak_memory() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters{};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    return std::size_t(counters.PeakWorkingSetSize);
+  }
+  return 0;
+#else
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  // bytes on macOS, kilobytes elsewhere
+  return std::size_t(usage.ru_maxrss);
+#else
+  return std::size_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
 glm::fmat4 calculate_projection_matrix(float aspect) {
   // float aspect = float(width) / float(height);
   // base fov does not change
@@ -0,0 +1,306 @@
+#include "vertex_quantizer.hpp"
+
+#include "thread_pool.hpp"
+
+#include <glbinding/gl/enum.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+  const float UNORM16_MAX = 65535.0f;
+  const float SNORM10_MAX = 511.0f;
+  // vertices per parallel task
+  const std::size_t QUANTIZE_GRAIN = std::size_t(1) << 14;
+
+  // largest possible packed value size
+  const std::size_t MAX_PACKED_BYTES = 4 * sizeof(GLushort);
+
+  // maps the values of positions or texture coordinates onto [0, 1]
+  struct value_range {
+    glm::fvec3 offset;
+    glm::fvec3 scale;
+    glm::fvec3 inverse_scale;
+  };
+
+  value_range range_of(glm::fvec3 const& min, glm::fvec3 const& max) {
+    value_range range{min, max - min, glm::fvec3{0.0f}};
+    for (int i = 0; i < 3; ++i) {
+      range.inverse_scale[i] = range.scale[i] > 0.0f ? 1.0f / range.scale[i] : 0.0f;
+    }
+    return range;
+  }
+
+  vertex_quantizer::format_flag_t required_flag(model::attribute const& attribute) {
+    if (attribute.flag == model::POSITION.flag) {
+      return vertex_quantizer::PACKED_POSITION;
+    }
+    if (attribute.flag == model::TEXCOORD.flag) {
+      return vertex_quantizer::PACKED_TEXCOORD;
+    }
+    return vertex_quantizer::PACKED_NORMAL;
+  }
+
+  model::attribute packed_format(model::attribute const& attribute) {
+    if (attribute.flag == model::POSITION.flag) {
+      // the fourth component keeps the following attributes 4 byte aligned
+      return model::attribute{attribute.flag, sizeof(GLushort), 4, GL_UNSIGNED_SHORT, true};
+    }
+    if (attribute.flag == model::TEXCOORD.flag) {
+      return model::attribute{attribute.flag, sizeof(GLushort), 2, GL_UNSIGNED_SHORT, true};
+    }
+    return model::attribute{attribute.flag, sizeof(GLuint), 4, GL_INT_2_10_10_10_REV, true};
+  }
+
+  GLushort unorm16(float value) {
+    return GLushort(std::lround(glm::clamp(value, 0.0f, 1.0f) * UNORM16_MAX));
+  }
+
+  GLuint snorm10(float value) {
+    // two's complement in the lowest 10 bits
+    return GLuint(std::lround(glm::clamp(value, -1.0f, 1.0f) * SNORM10_MAX)) & 0x3ffu;
+  }
+
+  float snorm10_value(GLuint packed, int shift) {
+    int value = int((packed >> shift & 0x3ffu) ^ 0x200u) - 0x200;
+    return std::max(float(value) / SNORM10_MAX, -1.0f);
+  }
+
+  // positions and texture coordinates are stored relative to their range,
+  // directions as unit vectors since the shaders normalize them
+  void pack(model::attribute const& format, float const* value, std::uint8_t* target, value_range const& range) {
+    if (format.type == GL_FLOAT) {
+      std::memcpy(target, value, std::size_t(format.bytes()));
+    }
+    else if (format.flag == model::POSITION.flag) {
+      GLushort components[4];
+      for (int i = 0; i < 3; ++i) {
+        components[i] = unorm16((value[i] - range.offset[i]) * range.inverse_scale[i]);
+      }
+      components[3] = GLushort(UNORM16_MAX);
+      std::memcpy(target, components, sizeof(components));
+    }
+    else if (format.flag == model::TEXCOORD.flag) {
+      GLushort components[2];
+      for (int i = 0; i < 2; ++i) {
+        components[i] = unorm16((value[i] - range.offset[i]) * range.inverse_scale[i]);
+      }
+      std::memcpy(target, components, sizeof(components));
+    }
+    else {
+      glm::fvec3 direction{value[0], value[1], value[2]};
+      float length = glm::length(direction);
+      direction = length > 0.0f ? direction / length : direction;
+      GLuint packed = snorm10(direction.x) | snorm10(direction.y) << 10 | snorm10(direction.z) << 20;
+      // the handedness of tangents in the 2 bit w component, 1 or -1 in two's complement
+      if (format.flag == model::TANGENT.flag) {
+        packed |= (value[3] < 0.0f ? 0x3u : 0x1u) << 30;
+      }
+      std::memcpy(target, &packed, sizeof(packed));
+    }
+  }
+
+  // error of the value the gpu reads back, distance for positions and texture coordinates, 1 - cosine for directions,
+  // signed values are read with the conversion of gl 4.2, the tolerance also covers (2c + 1) / 1023 of older versions
+  float packed_error(model::attribute const& format, float const* value, value_range const& range) {
+    std::uint8_t packed[MAX_PACKED_BYTES];
+    pack(format, value, packed, range);
+    if (format.flag == model::POSITION.flag) {
+      GLushort components[4];
+      std::memcpy(components, packed, sizeof(components));
+      glm::fvec3 read{float(components[0]), float(components[1]), float(components[2])};
+      return glm::distance(range.offset + read / UNORM16_MAX * range.scale, glm::fvec3{value[0], value[1], value[2]});
+    }
+    if (format.flag == model::TEXCOORD.flag) {
+      GLushort components[2];
+      std::memcpy(components, packed, sizeof(components));
+      float error = 0.0f;
+      for (int i = 0; i < 2; ++i) {
+        error = std::max(error, std::abs(range.offset[i] + float(components[i]) / UNORM16_MAX * range.scale[i] - value[i]));
+      }
+      return error;
+    }
+    glm::fvec3 direction{value[0], value[1], value[2]};
+    if (glm::length(direction) == 0.0f) {
+      return 0.0f;
+    }
+    GLuint components;
+    std::memcpy(&components, packed, sizeof(components));
+    glm::fvec3 read{snorm10_value(components, 0), snorm10_value(components, 10), snorm10_value(components, 20)};
+    if (glm::length(read) == 0.0f) {
+      return 1.0f;
+    }
+    return 1.0f - glm::dot(glm::normalize(read), glm::normalize(direction));
+  }
+
+  float tolerance(model::attribute const& attribute, float diagonal) {
+    if (attribute.flag == model::POSITION.flag) {
+      return vertex_quantizer::POSITION_TOLERANCE * diagonal;
+    }
+    if (attribute.flag == model::TEXCOORD.flag) {
+      return vertex_quantizer::TEXCOORD_TOLERANCE;
+    }
+    return 1.0f - std::cos(glm::radians(vertex_quantizer::DIRECTION_TOLERANCE));
+  }
+
+  // formats of the model in the order of its vertices
+  std::vector<model::attribute> float_formats(model const& mesh) {
+    if (mesh.file) {
+      throw std::invalid_argument("vertex_quantizer: model refers to a mapped file");
+    }
+    std::vector<model::attribute> formats;
+    for (auto const& supported_attribute : model::VERTEX_ATTRIBS) {
+      auto format = mesh.formats.find(supported_attribute.flag);
+      if (format != mesh.formats.end()) {
+        if (format->second.type != GL_FLOAT) {
+          throw std::invalid_argument("vertex_quantizer: model is quantized already");
+        }
+        formats.push_back(format->second);
+      }
+    }
+    return formats;
+  }
+
+  std::size_t float_offset(model const& mesh, model::attribute const& attribute) {
+    return std::size_t(reinterpret_cast<std::uintptr_t>(mesh.offsets.at(attribute.flag))) / sizeof(GLfloat);
+  }
+
+  // ranges the attribute values are packed into, the bounds for positions
+  value_range range_of(model const& mesh, model::attribute const& attribute) {
+    if (attribute.flag == model::POSITION.flag) {
+      return range_of(mesh.bounds_min, mesh.bounds_max);
+    }
+    if (attribute.flag != model::TEXCOORD.flag || mesh.vertex_num == 0) {
+      return range_of(glm::fvec3{0.0f}, glm::fvec3{1.0f});
+    }
+    std::size_t stride = std::size_t(mesh.vertex_bytes) / sizeof(GLfloat);
+    float const* texcoords = mesh.data.data() + float_offset(mesh, attribute);
+    std::size_t task_count = (mesh.vertex_num + QUANTIZE_GRAIN - 1) / QUANTIZE_GRAIN;
+    std::vector<glm::fvec3> task_min(task_count);
+    std::vector<glm::fvec3> task_max(task_count);
+    thread_pool::shared().parallel_for(0, mesh.vertex_num, QUANTIZE_GRAIN, [&](std::size_t first, std::size_t last) {
+      glm::fvec3 min{texcoords[first * stride], texcoords[first * stride + 1], 0.0f};
+      glm::fvec3 max{min};
+      for (std::size_t i = first; i < last; ++i) {
+        glm::fvec3 texcoord{texcoords[i * stride], texcoords[i * stride + 1], 0.0f};
+        min = glm::min(min, texcoord);
+        max = glm::max(max, texcoord);
+      }
+      task_min[first / QUANTIZE_GRAIN] = min;
+      task_max[first / QUANTIZE_GRAIN] = max;
+    });
+    for (std::size_t task = 1; task < task_count; ++task) {
+      task_min[0] = glm::min(task_min[0], task_min[task]);
+      task_max[0] = glm::max(task_max[0], task_max[task]);
+    }
+    return range_of(task_min[0], task_max[0]);
+  }
+}
+
+namespace vertex_quantizer {
+
+std::vector<model::attribute> choose_formats(model const& mesh, format_flag_t allowed) {
+  std::vector<model::attribute> formats = float_formats(mesh);
+  std::vector<value_range> ranges;
+  for (model::attribute const& format : formats) {
+    ranges.push_back(range_of(mesh, format));
+  }
+  std::size_t stride = std::size_t(mesh.vertex_bytes) / sizeof(GLfloat);
+
+  // largest error per attribute of each task, positions outside the bounds show up as errors
+  std::size_t task_count = (mesh.vertex_num + QUANTIZE_GRAIN - 1) / QUANTIZE_GRAIN;
+  std::vector<float> task_errors(task_count * formats.size(), 0.0f);
+  thread_pool::shared().parallel_for(0, mesh.vertex_num, QUANTIZE_GRAIN, [&](std::size_t first, std::size_t last) {
+    float* errors = &task_errors[first / QUANTIZE_GRAIN * formats.size()];
+    for (std::size_t a = 0; a < formats.size(); ++a) {
+      if (!(allowed & required_flag(formats[a]))) {
+        continue;
+      }
+      model::attribute packed = packed_format(formats[a]);
+      float const* value = mesh.data.data() + float_offset(mesh, formats[a]);
+      for (std::size_t i = first; i < last; ++i) {
+        errors[a] = std::max(errors[a], packed_error(packed, value + i * stride, ranges[a]));
+      }
+    }
+  });
+
+  float diagonal = glm::length(mesh.bounds_max - mesh.bounds_min);
+  for (std::size_t a = 0; a < formats.size(); ++a) {
+    if (!(allowed & required_flag(formats[a]))) {
+      continue;
+    }
+    float error = 0.0f;
+    for (std::size_t task = 0; task < task_count; ++task) {
+      error = std::max(error, task_errors[task * formats.size() + a]);
+    }
+    if (error <= tolerance(formats[a], diagonal)) {
+      formats[a] = packed_format(formats[a]);
+    }
+  }
+  return formats;
+}
+
+model quantize(model&& mesh, format_flag_t allowed) {
+  std::vector<model::attribute> sources = float_formats(mesh);
+  std::vector<model::attribute> formats = choose_formats(mesh, allowed);
+  bool packed = std::any_of(formats.begin(), formats.end(), [](model::attribute const& format) {
+    return format.type != GL_FLOAT;
+  });
+  if (!packed) {
+    return std::move(mesh);
+  }
+
+  std::vector<std::size_t> source_offsets;
+  std::vector<std::size_t> target_offsets;
+  std::vector<value_range> ranges;
+  std::size_t packed_bytes = 0;
+  for (std::size_t a = 0; a < formats.size(); ++a) {
+    source_offsets.push_back(float_offset(mesh, sources[a]));
+    target_offsets.push_back(packed_bytes);
+    ranges.push_back(range_of(mesh, sources[a]));
+    packed_bytes += std::size_t(formats[a].bytes());
+  }
+  std::size_t stride = std::size_t(mesh.vertex_bytes) / sizeof(GLfloat);
+
+  // all formats are multiples of 4 bytes, so the packed vertices fill whole floats
+  std::vector<GLfloat> words(mesh.vertex_num * packed_bytes / sizeof(GLfloat));
+  std::uint8_t* target = reinterpret_cast<std::uint8_t*>(words.data());
+  thread_pool::shared().parallel_for(0, mesh.vertex_num, QUANTIZE_GRAIN, [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i) {
+      for (std::size_t a = 0; a < formats.size(); ++a) {
+        pack(formats[a], &mesh.data[i * stride + source_offsets[a]], target + i * packed_bytes + target_offsets[a], ranges[a]);
+      }
+    }
+  });
+
+  model result{std::move(words), formats, std::move(mesh.indices)};
+  result.index_type = mesh.index_type;
+  result.index_num = mesh.index_num;
+  result.submeshes = std::move(mesh.submeshes);
+  result.lods = std::move(mesh.lods);
+  result.meshlets = std::move(mesh.meshlets);
+  result.bounds_min = mesh.bounds_min;
+  result.bounds_max = mesh.bounds_max;
+  for (std::size_t a = 0; a < formats.size(); ++a) {
+    if (formats[a].type == GL_FLOAT) {
+      continue;
+    }
+    if (formats[a].flag == model::POSITION.flag) {
+      result.position_offset = ranges[a].offset;
+      result.position_scale = ranges[a].scale;
+    }
+    else if (formats[a].flag == model::TEXCOORD.flag) {
+      result.texcoord_offset = glm::fvec2{ranges[a].offset};
+      result.texcoord_scale = glm::fvec2{ranges[a].scale};
+    }
+  }
+  return result;
+}
+
+}
@@ -0,0 +1,257 @@
+#include "virtual_texture.hpp"
+
+#include "block_compression.hpp"
+#include "texture_cache.hpp"
+#include "texture_loader.hpp"
+#include "thread_pool.hpp"
+
+#include <glbinding/gl/gl.h>
+// use gl definitions from glbinding
+using namespace gl;
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+  const std::uint32_t FILE_VERSION = 1;
+  // tiles start at multiples of this for aligned copies
+  const std::size_t TILE_ALIGNMENT = 16;
+  // the first tile starts on a page so reading the coarse levels does not touch the header pages
+  const std::size_t PAGE_SIZE = 4096;
+
+  std::size_t align(std::size_t offset, std::size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+
+  // copy a tile with its border, columns wrap around like longitudes and rows are clamped at the poles
+  pixel_data extract_tile(pixel_data const& level, std::size_t tile_x, std::size_t tile_y) {
+    std::size_t channels = texture_loader::channel_count(level.channels);
+    std::size_t padded = virtual_texture::TILE_SIZE + 2 * virtual_texture::TILE_BORDER;
+    std::size_t left = tile_x * virtual_texture::TILE_SIZE + level.width - virtual_texture::TILE_BORDER;
+    std::vector<std::uint8_t> texels(padded * padded * channels);
+    for (std::size_t row = 0; row < padded; ++row) {
+      std::size_t source_row = std::size_t(std::min(std::max(
+        long(tile_y * virtual_texture::TILE_SIZE + row) - long(virtual_texture::TILE_BORDER), 0l), long(level.height) - 1));
+      std::uint8_t const* source = &level.pixels[source_row * level.width * channels];
+      std::uint8_t* target = texels.data() + row * padded * channels;
+      for (std::size_t column = 0; column < padded; ++column) {
+        std::memcpy(target + column * channels, source + (left + column) % level.width * channels, channels);
+      }
+    }
+    return pixel_data{std::move(texels), level.channels, level.channel_type, padded, padded};
+  }
+}
+
+namespace virtual_texture {
+
+///////////////////////////// tiled_image ///////////////////////////////////////
+tiled_image::tiled_image()
+ :file_{}
+ ,header_{nullptr}
+ ,levels_{nullptr}
+{}
+
+tiled_image::tiled_image(mapped_file&& file)
+ :file_{std::move(file)}
+ ,header_{nullptr}
+ ,levels_{nullptr}
+{
+  if (file_.size() < sizeof(file_header)) {
+    throw std::runtime_error("virtual_texture: truncated file");
+  }
+  file_header const* header = reinterpret_cast<file_header const*>(file_.data());
+  if (std::memcmp(header->magic, "VTEX", 4) != 0 || header->version != FILE_VERSION || header->level_count == 0
+      || header->tile_size != TILE_SIZE || header->tile_border != TILE_BORDER) {
+    throw std::runtime_error("virtual_texture: invalid header");
+  }
+  std::size_t table_end = sizeof(file_header) + header->level_count * sizeof(level_info);
+  if (file_.size() < table_end || header->data_offset < table_end) {
+    throw std::runtime_error("virtual_texture: truncated level table");
+  }
+  level_info const* levels = reinterpret_cast<level_info const*>(file_.data() + sizeof(file_header));
+  level_info const& last = levels[header->level_count - 1];
+  std::uint64_t tiles = last.first_tile + std::uint64_t(last.tiles_x) * last.tiles_y;
+  if (header->data_offset + tiles * header->tile_stride > file_.size()) {
+    throw std::runtime_error("virtual_texture: tiles outside of file");
+  }
+  header_ = header;
+  levels_ = levels;
+}
+
+bool tiled_image::empty() const {
+  return header_ == nullptr;
+}
+
+file_header const& tiled_image::header() const {
+  return *header_;
+}
+
+std::size_t tiled_image::level_count() const {
+  return header_ ? header_->level_count : 0;
+}
+
+level_info const& tiled_image::level(std::size_t index) const {
+  return levels_[index];
+}
+
+std::size_t tiled_image::tile_count() const {
+  if (!header_) {
+    return 0;
+  }
+  level_info const& last = levels_[header_->level_count - 1];
+  return std::size_t(last.first_tile) + std::size_t(last.tiles_x) * last.tiles_y;
+}
+
+std::size_t tiled_image::padded_size() const {
+  return header_ ? header_->tile_size + 2 * header_->tile_border : 0;
+}
+
+std::size_t tiled_image::tile_index(std::size_t level, std::size_t x, std::size_t y) const {
+  return std::size_t(levels_[level].first_tile) + y * levels_[level].tiles_x + x;
+}
+
+std::size_t tiled_image::tile_level(std::size_t index) const {
+  std::size_t level = 0;
+  while (level + 1 < level_count() && index >= levels_[level + 1].first_tile) {
+    ++level;
+  }
+  return level;
+}
+
+std::size_t tiled_image::parent(std::size_t index) const {
+  std::size_t level = tile_level(index);
+  if (level + 1 == level_count()) {
+    return index;
+  }
+  level_info const& fine = levels_[level];
+  level_info const& coarse = levels_[level + 1];
+  std::size_t offset = index - std::size_t(fine.first_tile);
+  // odd sizes round down, so the tiles of both levels do not line up exactly
+  double x = (double(offset % fine.tiles_x) + 0.5) * double(coarse.width) / double(fine.width);
+  double y = (double(offset / fine.tiles_x) + 0.5) * double(coarse.height) / double(fine.height);
+  return tile_index(level + 1, std::min(std::size_t(x), std::size_t(coarse.tiles_x) - 1),
+                    std::min(std::size_t(y), std::size_t(coarse.tiles_y) - 1));
+}
+
+std::uint8_t const* tiled_image::tile_data(std::size_t index) const {
+  return file_.data() + header_->data_offset + index * header_->tile_stride;
+}
+
+///////////////////////////// loading ///////////////////////////////////////////
+std::string tiled_path(std::string const& file_name) {
+  return file_name + ".vtex";
+}
+
+tiled_image load(std::string const& file_name, mipmap::color_space space, bool compress) {
+  std::uint64_t source_hash = 0;
+  std::uint64_t source_size = 0;
+  {
+    mapped_file source{file_name};
+    source_hash = texture_cache::hash(source.data(), source.size());
+    source_size = source.size();
+  }
+
+  std::string tiled = tiled_path(file_name);
+  try {
+    tiled_image result{mapped_file{tiled}};
+    if (result.header().source_hash == source_hash && result.header().source_size == source_size
+        && result.header().color_space == std::uint32_t(space) && (result.header().compressed != 0) == compress) {
+      return result;
+    }
+  }
+  catch (std::runtime_error&) {
+    // tiled file missing or damaged, rebuild it below
+  }
+  build(file_name, tiled, space, compress, source_hash, source_size);
+  return tiled_image{mapped_file{tiled}};
+}
+
+void build(std::string const& file_name, std::string const& tiled, mipmap::color_space space, bool compress,
+           std::uint64_t source_hash, std::uint64_t source_size) {
+  std::vector<pixel_data> mips = texture_loader::file_mipmapped(file_name, space);
+  pixel_data const& base = mips.front();
+  // levels smaller than a tile are left out, the single tile of the coarsest level stays resident instead
+  std::size_t level_count = 1;
+  while (level_count < mips.size() && std::max(mips[level_count - 1].width, mips[level_count - 1].height) > TILE_SIZE) {
+    ++level_count;
+  }
+
+  std::size_t channels = texture_loader::channel_count(base.channels);
+  std::size_t padded = TILE_SIZE + 2 * TILE_BORDER;
+  block_compression::format block_format = block_compression::choose_format(base);
+  std::size_t tile_bytes = compress ? block_compression::compressed_size(block_format, padded, padded) : padded * padded * channels;
+
+  std::vector<level_info> levels(level_count);
+  std::uint64_t first_tile = 0;
+  for (std::size_t i = 0; i < level_count; ++i) {
+    levels[i].width = std::uint32_t(mips[i].width);
+    levels[i].height = std::uint32_t(mips[i].height);
+    levels[i].tiles_x = std::uint32_t((mips[i].width + TILE_SIZE - 1) / TILE_SIZE);
+    levels[i].tiles_y = std::uint32_t((mips[i].height + TILE_SIZE - 1) / TILE_SIZE);
+    levels[i].first_tile = first_tile;
+    first_tile += std::uint64_t(levels[i].tiles_x) * levels[i].tiles_y;
+  }
+
+  file_header header{};
+  std::memcpy(header.magic, "VTEX", 4);
+  header.version = FILE_VERSION;
+  header.source_hash = source_hash;
+  header.source_size = source_size;
+  header.width = std::uint32_t(base.width);
+  header.height = std::uint32_t(base.height);
+  header.level_count = std::uint32_t(level_count);
+  header.tile_size = std::uint32_t(TILE_SIZE);
+  header.tile_border = std::uint32_t(TILE_BORDER);
+  header.internal_format = std::uint32_t(compress ? block_compression::internal_format(block_format) : texture_loader::sized_format(channels));
+  header.format = std::uint32_t(base.channels);
+  header.type = std::uint32_t(base.channel_type);
+  header.compressed = compress ? 1 : 0;
+  header.color_space = std::uint32_t(space);
+  header.tile_bytes = tile_bytes;
+  header.tile_stride = align(tile_bytes, TILE_ALIGNMENT);
+  header.data_offset = align(sizeof(file_header) + level_count * sizeof(level_info), PAGE_SIZE);
+
+  // write to temporary file first to never leave a truncated file behind
+  std::string temp_path = tiled + ".tmp";
+  bool written = false;
+  {
+    std::ofstream tiled_file(temp_path, std::ios::binary | std::ios::trunc);
+    tiled_file.write(reinterpret_cast<char const*>(&header), sizeof(file_header));
+    tiled_file.write(reinterpret_cast<char const*>(levels.data()), std::streamsize(level_count * sizeof(level_info)));
+    std::vector<char> padding(std::size_t(header.data_offset) - sizeof(file_header) - level_count * sizeof(level_info), 0);
+    tiled_file.write(padding.data(), std::streamsize(padding.size()));
+
+    // one row of tiles is cut and compressed in parallel at a time
+    std::size_t stride = std::size_t(header.tile_stride);
+    for (std::size_t i = 0; i < level_count && tiled_file; ++i) {
+      std::vector<std::uint8_t> row(levels[i].tiles_x * stride, 0);
+      for (std::size_t y = 0; y < levels[i].tiles_y; ++y) {
+        thread_pool::shared().parallel_for(0, levels[i].tiles_x, 1, [&](std::size_t begin, std::size_t end) {
+          for (std::size_t x = begin; x < end; ++x) {
+            pixel_data tile = extract_tile(mips[i], x, y);
+            if (compress) {
+              std::vector<std::uint8_t> blocks = block_compression::encode(tile, block_format);
+              std::memcpy(row.data() + x * stride, blocks.data(), blocks.size());
+            }
+            else {
+              std::memcpy(row.data() + x * stride, tile.pixels.data(), tile.pixels.size());
+            }
+          }
+        });
+        tiled_file.write(reinterpret_cast<char const*>(row.data()), std::streamsize(row.size()));
+      }
+    }
+    written = bool(tiled_file);
+  }
+  std::remove(tiled.c_str());
+  if (!written || std::rename(temp_path.c_str(), tiled.c_str()) != 0) {
+    std::remove(temp_path.c_str());
+    throw std::runtime_error("virtual_texture: could not write " + tiled);
+  }
+}
+
+}
@@ -17,10 +17,13 @@
 
 #include "utils.hpp"
 #include "shader_loader.hpp"
+#include "frame_recorder.hpp"
 
 #include <cstdlib>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 #include <glbinding/Version.h>
 // use gl definitions from glbinding 
@@ -55,7 +58,7 @@ bool isCore()
     return (value & static_cast<unsigned int>(GL_CONTEXT_CORE_PROFILE_BIT)) > 0;
 }
 
-GLFWwindow* initialize(glm::uvec2 const& resolution, unsigned ver_major, unsigned ver_minor) {
+GLFWwindow* initialize(glm::uvec2 const& resolution, unsigned ver_major, unsigned ver_minor, bool visible) {
 
   glfwSetErrorCallback(glsl_error);
 
@@ -68,6 +71,8 @@ GLFWwindow* initialize(glm::uvec2 const& resolution, unsigned ver_major, unsigne
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, ver_minor);
   // enable deug support
   glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
+  // headless runs render offscreen and never show the window
+  glfwWindowHint(GLFW_VISIBLE, visible);
 
   //MacOS requires forward compat core profile
   #ifdef __APPLE__
@@ -90,8 +95,7 @@ GLFWwindow* initialize(glm::uvec2 const& resolution, unsigned ver_major, unsigne
 
   // use the windows context
   glfwMakeContextCurrent(window);
-  // disable vsync
-  glfwSwapInterval(0);
+  // swap interval is set by the frame scheduler
   // initialize glindings in this context
   glbinding::Binding::initialize();
 
@@ -139,20 +143,23 @@ void set_callback_object(GLFWwindow* window, Application* app) {
 }
 
 
-// calculate fps and show in m_window title
-void show_fps(GLFWwindow* window) {
-    // variables for fps computation
+// show frame statistics in m_window title
+void show_fps(GLFWwindow* window, frame_recorder const& recorder) {
+  // the recorder measures every frame, the title only needs refreshing once a second
   static double m_last_second_time;
-  static unsigned m_frames_per_second;
 
-  ++m_frames_per_second;
   double current_time = glfwGetTime();
   if (current_time - m_last_second_time >= 1.0) {
-    std::string title{"OpenGL Framework - "};
-    title += std::to_string(m_frames_per_second) + " fps";
-
-    glfwSetWindowTitle(window, title.c_str());
-    m_frames_per_second = 0;
+    frame_recorder::summary stats = recorder.get_period_summary();
+    std::ostringstream title{};
+    title << std::fixed << std::setprecision(1) << "OpenGL Framework - "
+          << (stats.mean_ms > 0.0 ? 1000.0 / stats.mean_ms : 0.0) << " fps, p99 " << stats.p99_ms
+          << " ms, max " << stats.max_ms << " ms, " << stats.hitches << " hitches";
+    if (stats.cpu_bound + stats.gpu_bound > 0) {
+      title << ", " << (stats.gpu_bound > stats.cpu_bound ? "gpu" : "cpu") << " bound";
+    }
+
+    glfwSetWindowTitle(window, title.str().c_str());
     m_last_second_time = current_time;
   }
 }
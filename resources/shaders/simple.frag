@@ -4,6 +4,9 @@
 in vec3 pass_Normal;
 in vec3 pass_Pos;
 in vec2 pass_TexCoord;
+#ifdef TANGENT_FRAME
+in vec4 pass_Tangent;
+#endif
 
 // Uniforms
 // (vectors need a constant size, so I just set it to 128 even though probably
@@ -23,13 +26,31 @@ uniform sampler2D TextureSpecular;
 uniform bool TextureSpecularIsSet;
 uniform sampler2D TextureNormal;
 uniform bool TextureNormalIsSet;
+// Normal texture packs specular in red, normal X in alpha and Y in green
+uniform bool TextureNormalPacked;
+// Color is read from the tile cache of a virtual texture instead of TextureColor
+uniform bool TextureColorIsVirtual;
+// Slot x, slot y and level of the finest resident tile covering each tile, one layer per level
+uniform usampler2DArray TextureIndirection;
+// Resident tiles with borders
+uniform sampler2D TexturePhysical;
+uniform vec2 VirtualSize;
+uniform float VirtualTileSize;
+uniform float VirtualTileBorder;
+uniform int VirtualLevels;
 
 // Out variables
 out vec4 out_Color;
 
 
-vec3 perturbNormal(vec3 vertex_pos, vec3 surf_norm)
+vec3 perturbNormal(vec3 vertex_pos, vec3 surf_norm, vec2 texel_xy)
 {
+#ifdef TANGENT_FRAME
+  // Interpolated tangent frame of the vertices (MikkTSpace), the bitangent follows from the handedness
+  vec3 N = normalize(surf_norm);
+  vec3 S = normalize(pass_Tangent.xyz);
+  vec3 T = (pass_Tangent.w < 0.0 ? -1.0 : 1.0) * cross(N, S);
+#else
   // Calculate some derivatives
   vec3 q0 = dFdx(vertex_pos.xyz);
   vec3 q1 = dFdy(vertex_pos.xyz);
@@ -40,9 +61,12 @@ vec3 perturbNormal(vec3 vertex_pos, vec3 surf_norm)
   vec3 S = normalize(q0 * st1.t - q1 * st0.t);
   vec3 T = normalize(-q0 * st1.s + q1 * st0.s);
   vec3 N = normalize(surf_norm);
+#endif
 
-  // Convert normal texture from color space [0,1]*3 into a usable vector [-1,1]*3
-  vec3 mapN = texture(TextureNormal, pass_TexCoord).xyz * 2.0 - 1.0;
+  // Convert normal texture from color space [0,1]*2 into a usable vector [-1,1]*2,
+  // Z is reconstructed because two channel (BC5) normal maps only store X and Y
+  vec2 mapXY = texel_xy * 2.0 - 1.0;
+  vec3 mapN = vec3(mapXY, sqrt(max(1.0 - dot(mapXY, mapXY), 0.0)));
   float normalScale = 7.0f;
   mapN.xy = normalScale * mapN.xy ;
   mat3 tsn = mat3(S, T, N);
@@ -51,13 +75,47 @@ vec3 perturbNormal(vec3 vertex_pos, vec3 surf_norm)
 }
 
 
+vec4 sampleVirtual(vec2 uv)
+{
+  // Mip level from the texel footprint of the pixel, the same way the feedback pass chooses it
+  vec2 texel = uv * VirtualSize;
+  float footprint = max(length(dFdx(texel)), length(dFdy(texel)));
+  int level = clamp(int(floor(log2(max(footprint, 1.0)))), 0, VirtualLevels - 1);
+
+  // Look up the tile, it points to a coarser tile if it is not resident yet; tiles of odd sized levels do not
+  // line up exactly, so the lookup is repeated at the coarser level until the entry belongs to the tile itself
+  uvec4 entry;
+  vec2 tile_pos;
+  for (int i = 0; i < VirtualLevels; ++i)
+  {
+    vec2 level_size = max(floor(VirtualSize / exp2(float(level))), vec2(1.0));
+    vec2 tiles = ceil(level_size / VirtualTileSize);
+    tile_pos = clamp(uv * level_size / VirtualTileSize, vec2(0.0), tiles - 0.001);
+    entry = texelFetch(TextureIndirection, ivec3(ivec2(tile_pos), level), 0);
+    if (int(entry.z) == level)
+    {
+      break;
+    }
+    level = int(entry.z);
+  }
+
+  // Position inside the resident tile, then inside its slot of the tile cache (skipping the border)
+  vec2 inside = fract(tile_pos);
+  float padded = VirtualTileSize + 2.0 * VirtualTileBorder;
+  vec2 physical = (vec2(entry.xy) * padded + VirtualTileBorder + inside * VirtualTileSize) / vec2(textureSize(TexturePhysical, 0));
+  return textureLod(TexturePhysical, physical, 0.0);
+}
+
+
 void main()
 {
   vec3 normal = pass_Normal;
-  // Apply normal texture if given
+  // Apply normal texture if given, one fetch also yields the specular value of packed textures
+  vec4 normal_texel = vec4(0.0);
   if (TextureNormalIsSet)
   {
-    normal = perturbNormal(pass_Pos, pass_Normal);
+    normal_texel = texture(TextureNormal, pass_TexCoord);
+    normal = perturbNormal(pass_Pos, pass_Normal, TextureNormalPacked ? normal_texel.ag : normal_texel.xy);
   }
 
   // ########### AMBIENT: ###########################################
@@ -111,9 +169,11 @@ void main()
   }
   
   // ########### TEXTURE: ###########################################
-  diffuse *= texture(TextureColor, pass_TexCoord).xyz;
-  ambient *= texture(TextureColor, pass_TexCoord).xyz;
-  specular *= texture(TextureSpecular, pass_TexCoord).xyz;
+  vec3 color = TextureColorIsVirtual ? sampleVirtual(pass_TexCoord).xyz : texture(TextureColor, pass_TexCoord).xyz;
+  diffuse *= color;
+  ambient *= color;
+  // Specular maps are grey, single channel (R8/BC4) textures only store red
+  specular *= TextureNormalPacked ? normal_texel.r : texture(TextureSpecular, pass_TexCoord).r;
 
 
   // ########### FINAL COLOR: #######################################
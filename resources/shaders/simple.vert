@@ -5,17 +5,26 @@
 layout(location = 0) in vec3 in_Position;
 layout(location = 1) in vec3 in_Normal;
 layout(location = 2) in vec2 in_TexCoord;
+#ifdef TANGENT_FRAME
+// Tangent with the handedness of the frame in w
+layout(location = 3) in vec4 in_Tangent;
+#endif
 
 // Matrix Uniforms as specified with glUniformMatrix4fv
 uniform mat4 ModelMatrix;
 uniform mat4 ViewMatrix;
 uniform mat4 ProjectionMatrix;
 uniform mat4 NormalMatrix;
+// Offset (xy) and scale (zw) of quantized texture coordinates
+uniform vec4 TexCoordTransform;
 
 // Out variables
 out vec3 pass_Normal;
 out vec3 pass_Pos;
 out vec2 pass_TexCoord;
+#ifdef TANGENT_FRAME
+out vec4 pass_Tangent;
+#endif
 
 void main(void)
 {
@@ -23,9 +32,13 @@ void main(void)
   pass_Pos = (ModelMatrix * vec4(in_Position, 1.0f)).xyz;
   gl_Position = ProjectionMatrix * ViewMatrix * vec4(pass_Pos, 1.0);
   pass_Normal = (NormalMatrix * vec4(in_Normal, 0.0f)).xyz;
+#ifdef TANGENT_FRAME
+  // The normal matrix only differs from the model matrix in scale for the evenly scaled objects
+  pass_Tangent = vec4((NormalMatrix * vec4(in_Tangent.xyz, 0.0f)).xyz, in_Tangent.w);
+#endif
 
-  // Pass texture coordinates
-  pass_TexCoord = in_TexCoord;
+  // Pass texture coordinates in their original range
+  pass_TexCoord = TexCoordTransform.xy + in_TexCoord * TexCoordTransform.zw;
 }
 
 
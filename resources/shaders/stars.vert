@@ -0,0 +1,41 @@
+#version 150
+#extension GL_ARB_explicit_attrib_location : require
+
+// Vertex attributes of VAO (normalized integers from the star catalog cache)
+layout(location = 0) in vec2 in_Direction;
+layout(location = 1) in vec4 in_ColorMagnitude;
+
+// Matrix Uniforms as specified with glUniformMatrix4fv
+uniform mat4 ViewMatrix;
+uniform mat4 ProjectionMatrix;
+// Radius of the sky sphere
+uniform float Distance;
+// Current magnitude cutoff, normalized to the catalog range
+uniform float MagnitudeLimit;
+
+// Out variables
+out vec3 pass_Color;
+
+// Unfold octahedral mapped unit vector
+vec3 decodeOctahedral(vec2 encoded)
+{
+  vec2 f = encoded * 2.0 - 1.0;
+  vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+  if (n.z < 0.0)
+  {
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    n.xy = (1.0 - abs(n.yx)) * signs;
+  }
+  return normalize(n);
+}
+
+void main(void)
+{
+  vec3 position = decodeOctahedral(in_Direction) * Distance;
+  gl_Position = ProjectionMatrix * ViewMatrix * vec4(position, 1.0);
+
+  // Brightness relative to the faintest drawn star (0 = brightest)
+  float faintness = clamp(in_ColorMagnitude.a / max(MagnitudeLimit, 0.001), 0.0, 1.0);
+  gl_PointSize = mix(3.0, 1.0, faintness);
+  pass_Color = in_ColorMagnitude.rgb * mix(1.0, 0.25, faintness);
+}
@@ -10,6 +10,8 @@ uniform mat4 ModelMatrix;
 uniform mat4 ViewMatrix;
 uniform mat4 ProjectionMatrix;
 uniform mat4 NormalMatrix;
+// Offset (xy) and scale (zw) of quantized texture coordinates
+uniform vec4 TexCoordTransform;
 
 // Out variables
 out vec3 pass_Normal;
@@ -23,6 +25,6 @@ void main(void)
   gl_Position = ProjectionMatrix * ViewMatrix * vec4(pass_Pos, 1.0);
   pass_Normal = (NormalMatrix * vec4(in_Normal, 0.0f)).xyz;
   
-  // Pass texture coordinates
-  pass_TexCoord = in_TexCoord;
+  // Pass texture coordinates in their original range
+  pass_TexCoord = TexCoordTransform.xy + in_TexCoord * TexCoordTransform.zw;
 }
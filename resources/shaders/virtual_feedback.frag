@@ -0,0 +1,39 @@
+#version 150
+#extension GL_ARB_explicit_attrib_location : require
+
+// In variables
+in vec2 pass_TexCoord;
+
+// Uniforms
+// Id of the virtual texture, 0 for objects that only occlude
+uniform int VirtualId;
+uniform vec2 VirtualSize;
+uniform float VirtualTileSize;
+uniform int VirtualLevels;
+// Compensates the larger derivatives of the low resolution pass
+uniform float FeedbackBias;
+
+// Out variables
+// Tile x, tile y, level and texture id
+layout(location = 0) out uvec4 out_Feedback;
+
+
+void main()
+{
+  if (VirtualId == 0)
+  {
+    out_Feedback = uvec4(0u);
+    return;
+  }
+
+  // Same level as chosen when sampling in simple.frag at full resolution
+  vec2 texel = pass_TexCoord * VirtualSize;
+  float footprint = max(length(dFdx(texel)), length(dFdy(texel)));
+  int level = clamp(int(floor(log2(max(footprint, 1e-6)) + FeedbackBias)), 0, VirtualLevels - 1);
+
+  // Levels are halved and rounded down, the last tile of a row or column may be partial
+  vec2 level_size = max(floor(VirtualSize / exp2(float(level))), vec2(1.0));
+  vec2 tiles = ceil(level_size / VirtualTileSize);
+  uvec2 tile = uvec2(clamp(pass_TexCoord * level_size / VirtualTileSize, vec2(0.0), tiles - 0.001));
+  out_Feedback = uvec4(tile, uint(level), uint(VirtualId));
+}